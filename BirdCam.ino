@@ -7,6 +7,10 @@
 #include "esp_camera.h"
 #include "freertos/semphr.h"
 #include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_sleep.h"
+#include "esp_wifi.h"
+#include "driver/gpio.h"
 
 #define XPOWERS_CHIP_AXP2101
 #include "XPowersLib.h"
@@ -20,6 +24,16 @@
 
 #include <PubSubClient.h>
 #include "birdcam_ha.h"
+#include "birdcam_cam.h"
+#include "birdcam_power.h"
+#include "birdcam_timelapse.h"
+#include "birdcam_archive.h"
+#include "birdcam_export.h"
+#include "birdcam_rtsp.h"
+#include "birdcam_scene.h"
+#include "birdcam_ctrl.h"
+#include "birdcam_events.h"
+#include "birdcam_radio.h"
 
 // app_httpd.cpp
 void startCameraServer();
@@ -36,11 +50,15 @@ void startCameraServer();
 XPowersPMU PMU;
 SemaphoreHandle_t g_cam_mutex = nullptr;
 volatile uint32_t pir_count = 0;
-bool stream_active = false;
+// pir_count è incrementato sia dall'ISR sia dal task loop (pir_trigger)
+static portMUX_TYPE g_pir_mux = portMUX_INITIALIZER_UNLOCKED;
 
 // Boot time (epoch) per status web + HA
 time_t g_boot_time = 0;
 
+// Ultima richiesta web (aggiornata da app_httpd.cpp): conta come attività
+volatile uint32_t g_http_last_ms = 0;
+
 // ----------------- OLED display -----------------
 static Adafruit_SSD1306 display(128, 64, &Wire, -1);
 static bool g_display_ok = false;
@@ -53,6 +71,27 @@ static int g_framesize = (int)FRAMESIZE_QVGA; // default safe
 static int g_jpeg_quality = 12;
 static int g_img_mode = 0;
 static int g_archive_keep = 6;
+static int g_snap_max_age_ms = 1000; // cache /snapshot (0..10000)
+
+// Power manager (su batteria)
+static int g_pwr_light_idle_s = 60;  // 0 = mai light sleep
+static int g_pwr_deep_enable  = 0;   // deep sleep opzionale (perde l'archivio in PSRAM)
+static int g_pwr_deep_idle_s  = 900;
+
+// Timelapse (ring separato dall'archivio PIR)
+static int g_tl_interval_s = 0;                  // 0 = off
+static int g_tl_framesize  = (int)FRAMESIZE_VGA;
+static int g_tl_keep       = 288;                // 24 h a 5 min
+
+// ROI sensore (OV5640): % dell'area attiva, w = 100 -> campo pieno
+static int g_roi_x = 0;
+static int g_roi_y = 0;
+static int g_roi_w = 100;
+static int g_roi_profiles = 1 << CAM_PROFILE_ARCHIVE;   // di default solo l'archivio PIR
+
+// Stream MQTT: soglia di cambio scena (% celle, 0 = pubblica tutto) e keyframe
+static int g_scene_threshold  = 2;
+static int g_scene_keyframe_s = 60;
 
 // Camera image controls (persisted)
 static int g_brightness    = 0;   // -2..2
@@ -66,18 +105,34 @@ static int g_agc_gain      = 0;   // 0..30 (manual gain)
 static int g_aec_value     = 300; // 0..1200 (manual exposure)
 
 // ----------------- Archive ring (PSRAM) -----------------
+// Buffer con refcount: chi scarica li pinna, la rotazione fa solo unref
 struct Snap {
-  uint8_t* data = nullptr;
-  size_t   len  = 0;
-  time_t   ts   = 0;
+  bc_blob_t* blob = nullptr;
+  bc_blob_t* thumb = nullptr;   // miniatura per la galleria (aggiunta dopo l'archiviazione)
+  uint32_t id   = 0;   // progressivo di cattura
+  uint32_t crc  = 0;   // CRC-32 (export zip)
+  time_t   ts   = 0;   // 0 finché NTP non è sincronizzato (poi back-fill)
+  uint32_t ms   = 0;   // millis() alla cattura
 };
 
 static portMUX_TYPE snap_mux = portMUX_INITIALIZER_UNLOCKED;
 static Snap* snaps = nullptr;
 static int snap_head = -1;
 static int snap_count = 0;
+static uint32_t snap_next_id = 1;
+// Id di cattura persistenti: in NVS ("bcid"/"next") c'è la fine del blocco
+// riservato, una scrittura ogni CAPTURE_ID_BLOCK catture. Al reboot si
+// riparte da lì: gli id non tornano mai indietro (al più saltano).
+static const uint32_t CAPTURE_ID_BLOCK = 64;
+static uint32_t snap_id_limit = 0;
+
+// Eventi PIR (birdcam_events); g_ev_announced = ultimo id pubblicato su MQTT
+static ev_index_t g_events;
+static portMUX_TYPE g_ev_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t g_ev_announced = 0;
 
 static const uint32_t MAX_SNAPSHOT_BYTES = 220 * 1024;
+static const uint16_t THUMB_MIN_WIDTH = 160;
 
 // ----------------- MQTT / Home Assistant -----------------
 static WiFiClient g_wifi_client;
@@ -94,58 +149,175 @@ static uint32_t g_pir_off_at_ms = 0;
 static uint32_t g_mqtt_stream_last_ms = 0;
 static const uint32_t MQTT_STREAM_PERIOD_MS = 1000;
 
+// ----------------- Boot / rete -----------------
+static const time_t TIME_VALID_EPOCH = 1700000000;
+
+// Metriche di boot (ms da reset, 0 = non ancora)
+static uint32_t g_boot_camera_ms = 0;
+static uint32_t g_boot_wifi_ms = 0;
+static uint32_t g_boot_ntp_ms = 0;
+static uint32_t g_boot_first_capture_ms = 0;
+
+// Cattura PIR in un task dedicato: non aspetta mai Wi-Fi/MQTT/NTP
+static TaskHandle_t g_capture_task = nullptr;
+static volatile uint32_t g_capture_count = 0;
+
+// Cache Wi-Fi in NVS (namespace "bcnet"): BSSID/canale dell'ultima associazione
+// per il join veloce + IP statico opzionale (0 = DHCP)
+static uint8_t  g_net_bssid[6] = {0};
+static uint8_t  g_net_channel = 0;
+static uint32_t g_net_static[4] = {0};   // ip, gateway, subnet, dns
+static uint32_t g_wifi_begin_ms = 0;
+static bool     g_wifi_fast_join = false;
+static bool     g_time_synced = false;
+
+static inline bool time_is_synced() { return g_time_synced; }
+
+// ----------------- Power manager -----------------
+static pwr_sm_t g_pwr;
+static portMUX_TYPE g_pwr_mux = portMUX_INITIALIZER_UNLOCKED;
+static radio_policy_t g_radio;
+static portMUX_TYPE g_radio_mux = portMUX_INITIALIZER_UNLOCKED;
+static volatile int64_t g_pir_isr_us = 0;
+static volatile bool g_capture_busy = false;
+static bool g_pir_event_pending = false;     // evento PIR non ancora pubblicato su MQTT
+// Broker irraggiungibile: l'evento tiene sveglio/radio in burst al massimo
+// per PIR_UPLOAD_WAIT_MS, poi resta nell'indice e parte alla prossima connessione
+static uint32_t g_pir_upload_until_ms = 0;
+static const uint32_t PIR_UPLOAD_WAIT_MS = 20000;
+static uint32_t g_wake_hold_until_ms = 0;    // dopo un wake da timer: resta su per la telemetria
+static const uint32_t LIGHT_SLEEP_HEARTBEAT_S = 900;
+static bool g_radio_off = false;             // wake per timelapse: Wi-Fi lasciato spento
+
 // “Firmware version” per HA (metti quello che vuoi)
 static const char* FW_VERSION = "2026-01-25";
 
 // --- helpers ---
-static void free_snap(Snap &s) {
-  if (s.data) { free(s.data); s.data = nullptr; }
-  s.len = 0; s.ts = 0;
-}
-
 static void realloc_archive(int keep) {
   if (keep < 1) keep = 1;
   if (keep > 20) keep = 20;
 
-  if (snaps) {
-    for (int i = 0; i < g_archive_keep; i++) free_snap(snaps[i]);
-    free(snaps);
-    snaps = nullptr;
-  }
+  Snap* fresh = (Snap*)calloc((size_t)keep, sizeof(Snap));
 
-  snaps = (Snap*)calloc((size_t)keep, sizeof(Snap));
+  portENTER_CRITICAL(&snap_mux);
+  Snap* old = snaps;
+  int old_keep = g_archive_keep;
+  snaps = fresh;
   g_archive_keep = keep;
   snap_head = -1;
   snap_count = 0;
+  portEXIT_CRITICAL(&snap_mux);
+
+  if (old) {
+    for (int i = 0; i < old_keep; i++) {
+      bc_blob_unref(old[i].blob);
+      bc_blob_unref(old[i].thumb);
+    }
+    free(old);
+  }
 }
 
-static void store_snapshot_from_fb(const camera_fb_t* fb) {
-  if (!fb || !snaps) return;
-  if (fb->len == 0 || fb->len > MAX_SNAPSHOT_BYTES) return;
+static void load_capture_ids() {
+  Preferences p;
+  p.begin("bcid", true);
+  snap_next_id = p.getUInt("next", 1);
+  p.end();
+  if (!snap_next_id) snap_next_id = 1;
+  snap_id_limit = snap_next_id;
+  g_ev_announced = snap_next_id - 1;
+}
 
-  uint8_t* copy = (uint8_t*)heap_caps_malloc(fb->len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-  if (!copy) return;
-  memcpy(copy, fb->buf, fb->len);
+// Solo dal task di cattura. Preferences locale: prefs è del loop/httpd.
+static uint32_t alloc_capture_id() {
+  if (snap_next_id >= snap_id_limit) {
+    snap_id_limit = snap_next_id + CAPTURE_ID_BLOCK;
+    Preferences p;
+    p.begin("bcid", false);
+    p.putUInt("next", snap_id_limit);
+    p.end();
+  }
+  return snap_next_id++;
+}
+
+// Ritorna l'id della cattura (0 = non archiviata)
+static uint32_t store_snapshot(const uint8_t* buf, size_t len) {
+  if (!buf || !snaps) return 0;
+  if (len == 0 || len > MAX_SNAPSHOT_BYTES) return 0;
 
-  time_t now = time(nullptr);
+  bc_blob_t* blob = bc_blob_new(len);
+  if (!blob) return 0;
+  memcpy(blob->data, buf, len);
+  uint32_t crc = bc_crc32(0, blob->data, len);
+
+  time_t now = time_is_synced() ? time(nullptr) : 0;
+  uint32_t now_ms = millis();
+  uint32_t id = alloc_capture_id();
 
   portENTER_CRITICAL(&snap_mux);
   int next = (snap_head + 1) % g_archive_keep;
-  free_snap(snaps[next]);
-  snaps[next].data = copy;
-  snaps[next].len  = fb->len;
+  bc_blob_t* evicted = snaps[next].blob;
+  bc_blob_t* evicted_thumb = snaps[next].thumb;
+  snaps[next].blob = blob;
+  snaps[next].thumb = nullptr;
+  snaps[next].id   = id;
+  snaps[next].crc  = crc;
   snaps[next].ts   = now;
+  snaps[next].ms   = now_ms;
   snap_head = next;
   if (snap_count < g_archive_keep) snap_count++;
   portEXIT_CRITICAL(&snap_mux);
+
+  bc_blob_unref(evicted);
+  bc_blob_unref(evicted_thumb);
+  return id;
+}
+
+// Miniatura fuori dal percorso critico: l'evento PIR è già archiviato.
+// Se nel frattempo lo snapshot è uscito dal ring la miniatura si scarta.
+static void attach_thumb(uint32_t id, uint16_t w, uint16_t h) {
+  bc_snap_ref_t ref;
+  if (!bc_find_snapshot(id, &ref)) return;
+  bc_blob_t* thumb = cam_make_thumb(ref.blob->data, ref.blob->len, w, h, THUMB_MIN_WIDTH);
+  bc_snap_release(&ref, 1);
+  if (!thumb) return;   // già piccolo: la galleria usa l'originale
+
+  bool attached = false;
+  portENTER_CRITICAL(&snap_mux);
+  for (int i = 0; snaps && i < g_archive_keep; i++) {
+    if (snaps[i].blob && snaps[i].id == id && !snaps[i].thumb) {
+      snaps[i].thumb = thumb;
+      attached = true;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&snap_mux);
+  if (!attached) bc_blob_unref(thumb);
+}
+
+// Cattura nell'indice eventi, con la firma di scena per il punteggio di movimento
+static void index_capture(uint32_t id, uint16_t w, uint16_t h, time_t ts, uint32_t ms) {
+  uint8_t sig[SCENE_CELLS];
+  uint8_t* rgb = nullptr;
+  int dw = 0, dh = 0;
+  bc_snap_ref_t ref;
+  if (bc_find_snapshot(id, &ref)) {
+    rgb = cam_decode_8x(ref.blob->data, ref.blob->len, w, h, &dw, &dh);
+    bc_snap_release(&ref, 1);
+  }
+  if (rgb) {
+    scene_signature(rgb, dw, dh, sig);
+    free(rgb);
+  }
+  portENTER_CRITICAL(&g_ev_mux);
+  ev_add_capture(&g_events, id, ts, ms, rgb ? sig : nullptr);
+  portEXIT_CRITICAL(&g_ev_mux);
 }
 
 static void apply_sensor_settings() {
   sensor_t* s = esp_camera_sensor_get();
   if (!s) return;
 
-  s->set_framesize(s, (framesize_t)g_framesize);
-  s->set_quality(s, g_jpeg_quality);
+  // framesize/quality: decisi per ogni cattura dall'arbitro (birdcam_cam)
 
   int mirror = (g_img_mode == 1 || g_img_mode == 3) ? 1 : 0;
   int flip   = (g_img_mode == 2 || g_img_mode == 3) ? 1 : 0;
@@ -168,6 +340,10 @@ static void apply_sensor_settings() {
   if (s->set_aec_value)     s->set_aec_value(s, g_aec_value);
 }
 
+// Camera init (più sotto): buffer abbastanza grandi per fs, re-init a caldo se serve
+static bool camera_ensure_fb(framesize_t fs);
+static char g_cam_err[112] = "";
+
 // ----------------- bc_* API (declared in birdcam_settings.h) -----------------
 extern "C" {
 int bc_get_framesize() { return g_framesize; }
@@ -208,25 +384,51 @@ void bc_apply_cam_controls(int brightness, int contrast, int saturation, int sha
   if (g_cam_mutex) xSemaphoreGive(g_cam_mutex);
 }
 
-void bc_apply_settings(int framesize, int jpeg_quality, int img_mode) {
+int bc_apply_settings(int framesize, int jpeg_quality, int img_mode) {
   if (jpeg_quality < 10) jpeg_quality = 10;
   if (jpeg_quality > 63) jpeg_quality = 63;
 
-  g_framesize = framesize;
+  // prima della re-init: camera_ensure_fb() usa già qualità e orientamento nuovi
   g_jpeg_quality = jpeg_quality;
   g_img_mode = img_mode;
 
+  // risoluzione che non sta nel budget di memoria: resta quella di prima
+  int rc = 0;
+  if (framesize < 0 || framesize >= (int)FRAMESIZE_INVALID) framesize = g_framesize;
+  if (!camera_ensure_fb((framesize_t)framesize)) {
+    framesize = g_framesize;
+    rc = -1;
+  }
+  g_framesize = framesize;
+  tl_configure((uint32_t)g_tl_interval_s, (framesize_t)g_tl_framesize, g_jpeg_quality, g_tl_keep);
+
   if (g_cam_mutex) xSemaphoreTake(g_cam_mutex, portMAX_DELAY);
   apply_sensor_settings();
   if (g_cam_mutex) xSemaphoreGive(g_cam_mutex);
+  return rc;
 }
 
+const char* bc_get_camera_error() { return g_cam_err; }
+
 void bc_save_settings() {
   prefs.begin("birdcam", false);
   prefs.putInt("fs", g_framesize);
   prefs.putInt("jq", g_jpeg_quality);
   prefs.putInt("im", g_img_mode);
   prefs.putInt("ak", g_archive_keep);
+  prefs.putInt("sm", g_snap_max_age_ms);
+  prefs.putInt("pl", g_pwr_light_idle_s);
+  prefs.putInt("pd", g_pwr_deep_enable);
+  prefs.putInt("pi", g_pwr_deep_idle_s);
+  prefs.putInt("ti", g_tl_interval_s);
+  prefs.putInt("tf", g_tl_framesize);
+  prefs.putInt("tk", g_tl_keep);
+  prefs.putInt("rx", g_roi_x);
+  prefs.putInt("ry", g_roi_y);
+  prefs.putInt("rw", g_roi_w);
+  prefs.putInt("rp", g_roi_profiles);
+  prefs.putInt("st", g_scene_threshold);
+  prefs.putInt("sk", g_scene_keyframe_s);
   prefs.putInt("br", g_brightness);
   prefs.putInt("ct", g_contrast);
   prefs.putInt("sa", g_saturation);
@@ -239,6 +441,125 @@ void bc_save_settings() {
   prefs.end();
 }
 
+int bc_get_snapshot_max_age_ms() { return g_snap_max_age_ms; }
+int bc_set_snapshot_max_age_ms(int ms) {
+  if (ms < 0) ms = 0;
+  if (ms > 10000) ms = 10000;
+  g_snap_max_age_ms = ms;
+  return g_snap_max_age_ms;
+}
+
+void bc_get_boot_metrics(uint32_t* camera_ms, uint32_t* wifi_ms, uint32_t* ntp_ms, uint32_t* first_capture_ms) {
+  if (camera_ms) *camera_ms = g_boot_camera_ms;
+  if (wifi_ms) *wifi_ms = g_boot_wifi_ms;
+  if (ntp_ms) *ntp_ms = g_boot_ntp_ms;
+  if (first_capture_ms) *first_capture_ms = g_boot_first_capture_ms;
+}
+
+void bc_get_power_settings(int* light_idle_s, int* deep_enable, int* deep_idle_s) {
+  if (light_idle_s) *light_idle_s = g_pwr_light_idle_s;
+  if (deep_enable) *deep_enable = g_pwr_deep_enable;
+  if (deep_idle_s) *deep_idle_s = g_pwr_deep_idle_s;
+}
+
+static void pwr_apply_settings() {
+  pwr_config_t cfg = g_pwr.cfg;
+  cfg.light_idle_ms = g_pwr_light_idle_s ? (uint32_t)g_pwr_light_idle_s * 1000UL : 0xFFFFFFFFUL;
+  cfg.deep_sleep_enabled = g_pwr_deep_enable != 0;
+  cfg.deep_idle_ms = (uint32_t)g_pwr_deep_idle_s * 1000UL;
+  portENTER_CRITICAL(&g_pwr_mux);
+  g_pwr.cfg = cfg;
+  portEXIT_CRITICAL(&g_pwr_mux);
+}
+
+void bc_set_power_settings(int light_idle_s, int deep_enable, int deep_idle_s) {
+  if (light_idle_s < 0) light_idle_s = 0;
+  if (light_idle_s > 3600) light_idle_s = 3600;
+  if (deep_idle_s < 60) deep_idle_s = 60;
+  if (deep_idle_s > 86400) deep_idle_s = 86400;
+  g_pwr_light_idle_s = light_idle_s;
+  g_pwr_deep_enable = deep_enable ? 1 : 0;
+  g_pwr_deep_idle_s = deep_idle_s;
+  pwr_apply_settings();
+}
+
+void bc_get_timelapse(int* interval_s, int* framesize, int* keep) {
+  if (interval_s) *interval_s = g_tl_interval_s;
+  if (framesize) *framesize = g_tl_framesize;
+  if (keep) *keep = g_tl_keep;
+}
+
+void bc_set_timelapse(int interval_s, int framesize, int keep) {
+  if (interval_s < 0) interval_s = 0;
+  if (interval_s > 0 && interval_s < 5) interval_s = 5;
+  if (interval_s > 3600) interval_s = 3600;
+  if (keep < 1) keep = 1;
+  if (keep > TL_MAX_FRAMES) keep = TL_MAX_FRAMES;
+  if (framesize < 0 || framesize >= (int)FRAMESIZE_INVALID) framesize = g_tl_framesize;
+  if (interval_s > 0 && !camera_ensure_fb((framesize_t)framesize)) framesize = g_tl_framesize;
+  g_tl_interval_s = interval_s;
+  g_tl_framesize = framesize;
+  g_tl_keep = keep;
+  tl_configure((uint32_t)g_tl_interval_s, (framesize_t)g_tl_framesize, g_jpeg_quality, g_tl_keep);
+}
+
+static void roi_apply() {
+  cam_roi_t r;
+  r.x = (uint8_t)g_roi_x;
+  r.y = (uint8_t)g_roi_y;
+  r.w = (uint8_t)g_roi_w;
+  r.profiles = (uint8_t)g_roi_profiles;
+  cam_set_roi(&r);
+}
+
+void bc_get_roi(int* x, int* y, int* w, int* profiles) {
+  if (x) *x = g_roi_x;
+  if (y) *y = g_roi_y;
+  if (w) *w = g_roi_w;
+  if (profiles) *profiles = g_roi_profiles;
+}
+
+void bc_set_roi(int x, int y, int w, int profiles) {
+  if (w < CAM_ROI_MIN_W) w = CAM_ROI_MIN_W;
+  if (w > 100) w = 100;
+  if (x < 0) x = 0; if (x > 100 - w) x = 100 - w;
+  if (y < 0) y = 0; if (y > 100) y = 100;
+  g_roi_x = x;
+  g_roi_y = y;
+  g_roi_w = w;
+  g_roi_profiles = profiles & ((1 << CAM_PROFILE_COUNT) - 1);
+  roi_apply();
+}
+
+void bc_get_scene(int* threshold_pct, int* keyframe_s) {
+  if (threshold_pct) *threshold_pct = g_scene_threshold;
+  if (keyframe_s) *keyframe_s = g_scene_keyframe_s;
+}
+
+void bc_set_scene(int threshold_pct, int keyframe_s) {
+  if (threshold_pct < 0) threshold_pct = 0;
+  if (threshold_pct > 100) threshold_pct = 100;
+  if (keyframe_s < 10) keyframe_s = 10;
+  if (keyframe_s > 3600) keyframe_s = 3600;
+  g_scene_threshold = threshold_pct;
+  g_scene_keyframe_s = keyframe_s;
+  scene_configure(g_scene_threshold, (uint32_t)g_scene_keyframe_s);
+}
+
+void bc_get_static_ip(uint32_t out[4]) {
+  for (int i = 0; i < 4; i++) out[i] = g_net_static[i];
+}
+
+void bc_set_static_ip(const uint32_t in[4]) {
+  for (int i = 0; i < 4; i++) g_net_static[i] = in[i];
+  prefs.begin("bcnet", false);
+  prefs.putUInt("ip", g_net_static[0]);
+  prefs.putUInt("gw", g_net_static[1]);
+  prefs.putUInt("sn", g_net_static[2]);
+  prefs.putUInt("dns", g_net_static[3]);
+  prefs.end();
+}
+
 int bc_get_archive_keep() { return g_archive_keep; }
 int bc_set_archive_keep(int keep) { realloc_archive(keep); return g_archive_keep; }
 int bc_get_snapshot_count() { return snap_count; }
@@ -246,33 +567,111 @@ int bc_get_snapshot_count() { return snap_count; }
 uint32_t bc_get_snapshot_bytes_used() {
   uint32_t sum = 0;
   portENTER_CRITICAL(&snap_mux);
-  for (int i = 0; i < g_archive_keep; i++) sum += (uint32_t)snaps[i].len;
+  for (int i = 0; i < g_archive_keep; i++) {
+    if (snaps[i].blob) sum += (uint32_t)snaps[i].blob->len;
+    if (snaps[i].thumb) sum += (uint32_t)snaps[i].thumb->len;
+  }
   portEXIT_CRITICAL(&snap_mux);
   return sum;
 }
 uint32_t bc_get_snapshot_bytes_limit() { return MAX_SNAPSHOT_BYTES; }
 } // extern "C"
 
-// usata da app_httpd.cpp
-bool bc_get_snapshot(int n, const uint8_t** data, size_t* len, time_t* ts) {
-  if (!snaps || snap_count <= 0) return false;
-  if (!data || !len || !ts) return false;
-  if (n < 0) n = 0;
-  if (n >= snap_count) return false;
+// ----------------- Archivio: accesso pinnato (birdcam_archive.h) -----------------
+// chiamare con snap_mux preso
+static void pin_snap_locked(const Snap& s, bc_snap_ref_t* out) {
+  out->blob = bc_blob_ref(s.blob);
+  out->thumb = bc_blob_ref(s.thumb);
+  out->id   = s.id;
+  out->crc  = s.crc;
+  out->ts   = s.ts;
+}
 
+bool bc_get_snapshot(int n, bc_snap_ref_t* out) {
+  if (!out || n < 0) return false;
+  bool ok = false;
   portENTER_CRITICAL(&snap_mux);
-  int idx = snap_head - n;
-  while (idx < 0) idx += g_archive_keep;
+  if (snaps && n < snap_count) {
+    int idx = snap_head - n;
+    while (idx < 0) idx += g_archive_keep;
+    if (snaps[idx].blob) { pin_snap_locked(snaps[idx], out); ok = true; }
+  }
+  portEXIT_CRITICAL(&snap_mux);
+  return ok;
+}
 
-  if (!snaps[idx].data || snaps[idx].len == 0) {
-    portEXIT_CRITICAL(&snap_mux);
-    return false;
+bool bc_find_snapshot(uint32_t id, bc_snap_ref_t* out) {
+  if (!out || !id) return false;
+  bool ok = false;
+  portENTER_CRITICAL(&snap_mux);
+  for (int i = 0; snaps && i < g_archive_keep; i++) {
+    if (snaps[i].blob && snaps[i].id == id) { pin_snap_locked(snaps[i], out); ok = true; break; }
   }
-  *data = snaps[idx].data;
-  *len  = snaps[idx].len;
-  *ts   = snaps[idx].ts;
   portEXIT_CRITICAL(&snap_mux);
-  return true;
+  return ok;
+}
+
+int bc_pin_snapshots(bc_snap_ref_t* out, int max, time_t since) {
+  if (!out || max <= 0) return 0;
+  int n = 0;
+  portENTER_CRITICAL(&snap_mux);
+  for (int k = snap_count - 1; snaps && k >= 0 && n < max; k--) {
+    int idx = snap_head - k;
+    while (idx < 0) idx += g_archive_keep;
+    const Snap& s = snaps[idx];
+    if (!s.blob || (since > 0 && s.ts < since)) continue;
+    pin_snap_locked(s, &out[n++]);
+  }
+  portEXIT_CRITICAL(&snap_mux);
+  return n;
+}
+
+int bc_get_events(uint32_t since, ev_event_t* out, int max) {
+  portENTER_CRITICAL(&g_ev_mux);
+  int n = ev_since(&g_events, since, millis(), out, max);
+  portEXIT_CRITICAL(&g_ev_mux);
+  return n;
+}
+
+void bc_get_capture_range(uint32_t* oldest, uint32_t* newest) {
+  uint32_t lo = 0, hi = 0;
+  portENTER_CRITICAL(&snap_mux);
+  for (int i = 0; snaps && i < g_archive_keep; i++) {
+    if (!snaps[i].blob) continue;
+    if (!lo || snaps[i].id < lo) lo = snaps[i].id;
+    if (snaps[i].id > hi) hi = snaps[i].id;
+  }
+  portEXIT_CRITICAL(&snap_mux);
+  if (oldest) *oldest = lo;
+  if (newest) *newest = hi;
+}
+
+void bc_snap_release(bc_snap_ref_t* refs, int n) {
+  if (!refs) return;
+  for (int i = 0; i < n; i++) {
+    bc_blob_unref(refs[i].blob);
+    bc_blob_unref(refs[i].thumb);
+    refs[i].blob = nullptr;
+    refs[i].thumb = nullptr;
+  }
+}
+
+// usata da app_httpd.cpp (/status)
+const pwr_sm_t* bc_get_power() { return &g_pwr; }
+const radio_policy_t* bc_get_radio() { return &g_radio; }
+
+// frame MJPEG inviato (app_httpd.cpp): latenza e byte per la modalità radio corrente
+void bc_radio_stream_frame(uint32_t lat_ms, uint32_t bytes) {
+  portENTER_CRITICAL(&g_radio_mux);
+  radio_note_stream_latency(&g_radio, lat_ms);
+  radio_note_tx(&g_radio, bytes);
+  portEXIT_CRITICAL(&g_radio_mux);
+}
+
+static void radio_tx(uint32_t bytes) {
+  portENTER_CRITICAL(&g_radio_mux);
+  radio_note_tx(&g_radio, bytes);
+  portEXIT_CRITICAL(&g_radio_mux);
 }
 
 // ----------------- Device id / topics -----------------
@@ -312,21 +711,107 @@ static bool on_external_power() {
 }
 
 // ----------------- WiFi -----------------
-static void initWiFi() {
+static void load_net_cache() {
+  prefs.begin("bcnet", true);
+  if (prefs.getBytes("bssid", g_net_bssid, sizeof(g_net_bssid)) != sizeof(g_net_bssid)) {
+    memset(g_net_bssid, 0, sizeof(g_net_bssid));
+  }
+  g_net_channel   = prefs.getUChar("ch", 0);
+  g_net_static[0] = prefs.getUInt("ip", 0);
+  g_net_static[1] = prefs.getUInt("gw", 0);
+  g_net_static[2] = prefs.getUInt("sn", 0);
+  g_net_static[3] = prefs.getUInt("dns", 0);
+  prefs.end();
+}
+
+static void save_net_cache_if_changed() {
+  const uint8_t* bssid = WiFi.BSSID();
+  uint8_t ch = (uint8_t)WiFi.channel();
+  if (!bssid) return;
+  if (ch == g_net_channel && memcmp(bssid, g_net_bssid, sizeof(g_net_bssid)) == 0) return;
+
+  memcpy(g_net_bssid, bssid, sizeof(g_net_bssid));
+  g_net_channel = ch;
+  prefs.begin("bcnet", false);
+  prefs.putBytes("bssid", g_net_bssid, sizeof(g_net_bssid));
+  prefs.putUChar("ch", g_net_channel);
+  prefs.end();
+}
+
+// Il listen interval va nella richiesta di associazione: WiFi.begin() lo
+// lascia al default (3 beacon), qui lo allunghiamo in batteria. Vale per
+// l'associazione successiva, cioè al join dopo ogni light sleep.
+static void wifi_set_listen_interval(uint16_t li) {
+  wifi_config_t wc;
+  if (esp_wifi_get_config(WIFI_IF_STA, &wc) != ESP_OK) return;
+  if (wc.sta.listen_interval == li) return;
+  wc.sta.listen_interval = li;
+  esp_wifi_set_config(WIFI_IF_STA, &wc);
+}
+
+// Non blocca: l'associazione prosegue in background (vedi net_tick)
+static void startWiFi() {
   WiFi.mode(WIFI_STA);
-  WiFi.begin(WIFI_SSID, WIFI_PASS);
-  while (WiFi.status() != WL_CONNECTED) delay(250);
+
+  if (g_net_static[0]) {
+    WiFi.config(IPAddress(g_net_static[0]), IPAddress(g_net_static[1]),
+                IPAddress(g_net_static[2]), IPAddress(g_net_static[3]));
+  }
+
+  // join veloce: niente scan se conosciamo BSSID + canale
+  static const uint8_t ZERO[6] = {0};
+  g_wifi_fast_join = g_net_channel && memcmp(g_net_bssid, ZERO, sizeof(ZERO)) != 0;
+  if (g_wifi_fast_join) WiFi.begin(WIFI_SSID, WIFI_PASS, g_net_channel, g_net_bssid);
+  else WiFi.begin(WIFI_SSID, WIFI_PASS);
+  g_wifi_begin_ms = millis();
+  wifi_set_listen_interval(on_external_power() ? 0 : g_radio.cfg.listen_interval);
 }
 
 // ----------------- Time (NTP) -----------------
-static void initTimeNTP() {
+// SNTP parte da solo quando la rete è su: qui solo configurazione
+static void startTimeNTP() {
   configTzTime("CET-1CEST,M3.5.0/2,M10.5.0/3", "pool.ntp.org", "time.google.com", "time.cloudflare.com");
+}
+
+// Primo orario valido: boot time e timestamp delle catture fatte prima
+static void on_time_synced(time_t now) {
+  g_time_synced = true;
+  g_boot_ntp_ms = millis();
+  uint32_t now_ms = millis();
+  g_boot_time = now - (time_t)(now_ms / 1000);
 
-  time_t now = 0;
-  for (int i = 0; i < 20; i++) {
-    now = time(nullptr);
-    if (now > 1700000000) { g_boot_time = now; return; }
-    delay(250);
+  portENTER_CRITICAL(&snap_mux);
+  for (int i = 0; i < g_archive_keep; i++) {
+    if (snaps[i].blob && snaps[i].ts == 0) {
+      snaps[i].ts = now - (time_t)((now_ms - snaps[i].ms) / 1000);
+    }
+  }
+  portEXIT_CRITICAL(&snap_mux);
+  portENTER_CRITICAL(&g_ev_mux);
+  ev_time_synced(&g_events, now, now_ms);
+  portEXIT_CRITICAL(&g_ev_mux);
+  tl_time_synced(now, now_ms);
+}
+
+static void net_tick() {
+  static bool was_connected = false;
+  bool conn = WiFi.isConnected();
+
+  if (conn && !was_connected) {
+    if (!g_boot_wifi_ms) g_boot_wifi_ms = millis();
+    save_net_cache_if_changed();
+  }
+  // BSSID/canale in cache non più validi (AP cambiato): join classico con scan
+  if (!conn && g_wifi_fast_join && !g_boot_wifi_ms && millis() - g_wifi_begin_ms > 8000) {
+    g_wifi_fast_join = false;
+    WiFi.disconnect();
+    WiFi.begin(WIFI_SSID, WIFI_PASS);
+  }
+  was_connected = conn;
+
+  if (!g_time_synced) {
+    time_t now = time(nullptr);
+    if (now > TIME_VALID_EPOCH) on_time_synced(now);
   }
 }
 
@@ -393,8 +878,88 @@ static void initDisplay() {
 }
 
 // ----------------- Camera init -----------------
+// PSRAM da lasciare libera oltre a quanto i ring possono ancora occupare
+// (miniature, copie ridotte, zip); in DRAM il margine è per Wi-Fi e TCP.
+#define CAM_PSRAM_HEADROOM (256 * 1024)
+#define CAM_DRAM_HEADROOM  (64 * 1024)
+#define CAM_REINIT_WAIT_MS 3000
+
+static camera_config_t g_cam_cfg{};
+
+static size_t cam_fb_reserve() {
+  if (!psramFound()) return CAM_DRAM_HEADROOM;
+  size_t reserve = CAM_PSRAM_HEADROOM;
+  size_t arch_max = (size_t)g_archive_keep * MAX_SNAPSHOT_BYTES;
+  size_t arch_used = bc_get_snapshot_bytes_used();
+  if (arch_max > arch_used) reserve += arch_max - arch_used;
+  if (g_tl_interval_s > 0) {
+    tl_stats_t ts;
+    tl_get_stats(&ts);
+    if (TL_MAX_BYTES > ts.bytes) reserve += TL_MAX_BYTES - ts.bytes;
+  }
+  return reserve;
+}
+
+// Budget per buffer da fs: memoria libera + buffer attuali (liberati dal deinit)
+static bool cam_plan_for(framesize_t fs, cam_fb_plan_t* p) {
+  bool ps = psramFound();
+  uint32_t caps = ps ? (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) : (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  cam_arb_stats_t cs;
+  cam_arb_get_stats(&cs);
+  size_t cur = cs.fb_count > 0 ? cam_fb_bytes(cs.fb_max) : 0;
+  size_t avail = heap_caps_get_free_size(caps) + cur * (size_t)cs.fb_count;
+  size_t largest = heap_caps_get_largest_free_block(caps);
+  if (largest < cur) largest = cur;
+  size_t reserve = cam_fb_reserve();
+  if (cam_fb_plan(fs, ps, avail, largest, reserve, p)) return true;
+  snprintf(g_cam_err, sizeof(g_cam_err), "%s needs %u KB of frame buffers, %u KB available",
+           cam_framesize_name(fs), (unsigned)(p->fb_bytes / 1024),
+           (unsigned)((avail > reserve ? avail - reserve : 0) / 1024));
+  return false;
+}
+
+static void cam_cfg_apply(const cam_fb_plan_t& p) {
+  g_cam_cfg.frame_size   = p.fs;
+  g_cam_cfg.fb_count     = p.fb_count;
+  g_cam_cfg.grab_mode    = p.grab_mode;
+  g_cam_cfg.fb_location  = p.location;
+  g_cam_cfg.jpeg_quality = g_jpeg_quality;
+}
+
+// Buffer più grandi a caldo: consumatori fermi sul mutex, frame restituiti,
+// deinit/init con il nuovo piano. Se l'init fallisce si torna al piano di
+// prima (la memoria c'era). I buffer non si riducono: gli stream aperti
+// possono usare risoluzioni più grandi della nuova impostazione.
+static bool camera_ensure_fb(framesize_t fs) {
+  if (cam_arb_fits(fs)) return true;
+  cam_fb_plan_t p;
+  if (!cam_plan_for(fs, &p)) return false;
+  if (!cam_arb_suspend(CAM_REINIT_WAIT_MS)) {
+    snprintf(g_cam_err, sizeof(g_cam_err), "camera busy, %s not applied", cam_framesize_name(fs));
+    return false;
+  }
+
+  camera_config_t prev = g_cam_cfg;
+  esp_camera_deinit();
+  cam_cfg_apply(p);
+  esp_err_t err = esp_camera_init(&g_cam_cfg);
+  if (err != ESP_OK) {
+    g_cam_cfg = prev;
+    if (esp_camera_init(&g_cam_cfg) != ESP_OK) ESP.restart();
+    apply_sensor_settings();
+    cam_arb_resume(prev.frame_size, prev.fb_count, prev.jpeg_quality);
+    snprintf(g_cam_err, sizeof(g_cam_err), "camera init at %s failed (0x%x)",
+             cam_framesize_name(fs), (unsigned)err);
+    return false;
+  }
+  apply_sensor_settings();
+  cam_arb_resume(p.fs, p.fb_count, g_cam_cfg.jpeg_quality);
+  g_cam_err[0] = 0;
+  return true;
+}
+
 static void initCameraStable() {
-  camera_config_t config{};
+  camera_config_t& config = g_cam_cfg;
   config.ledc_channel = LEDC_CHANNEL_0;
   config.ledc_timer   = LEDC_TIMER_0;
 
@@ -419,20 +984,236 @@ static void initCameraStable() {
   config.xclk_freq_hz = 20000000;
   config.pixel_format = PIXFORMAT_JPEG;
 
-  config.grab_mode = CAMERA_GRAB_LATEST;
-  config.fb_location = psramFound() ? CAMERA_FB_IN_PSRAM : CAMERA_FB_IN_DRAM;
-  config.fb_count = psramFound() ? 2 : 1;
-  config.frame_size = (framesize_t)g_framesize;
-  config.jpeg_quality = g_jpeg_quality;
+  // buffer per la risoluzione più grande in uso (utente o timelapse),
+  // scendendo per area fino a QVGA finché il piano sta nel budget
+  framesize_t fs = (framesize_t)g_framesize;
+  if (g_tl_interval_s > 0 && cam_fs_area((framesize_t)g_tl_framesize) > cam_fs_area(fs)) fs = (framesize_t)g_tl_framesize;
+  if (!cam_fs_area(fs)) fs = FRAMESIZE_QVGA;
+  cam_fb_plan_t p;
+  bool ok = cam_plan_for(fs, &p);
+  while (!ok && cam_fs_area(fs) > cam_fs_area(FRAMESIZE_QVGA)) {
+    fs = cam_fs_next_smaller(fs);
+    ok = cam_plan_for(fs, &p);
+  }
+  if (!ok) {
+    // nemmeno qui c'è posto con la riserva (archivio, timelapse): un solo
+    // buffer comunque, g_cam_err resta a dire quanto manca
+    size_t b = cam_fb_bytes(fs);
+    cam_fb_plan(fs, psramFound(), b, b, 0, &p);
+  }
+  cam_cfg_apply(p);
 
   esp_err_t err = esp_camera_init(&config);
   if (err != ESP_OK) while (1) delay(1000);
 
+  // i buffer JPEG sono dimensionati su frame_size: oltre non si cattura
+  cam_arb_init(config.frame_size, config.fb_count, config.frame_size, config.jpeg_quality);
+  roi_apply();
   apply_sensor_settings();
 }
 
-// ----------------- PIR ISR -----------------
-static void IRAM_ATTR pirISR() { pir_count++; }
+// ----------------- PIR ISR + capture task -----------------
+static void IRAM_ATTR pirISR() {
+  portENTER_CRITICAL_ISR(&g_pir_mux);
+  pir_count++;
+  portEXIT_CRITICAL_ISR(&g_pir_mux);
+  g_pir_isr_us = esp_timer_get_time();
+  if (g_capture_task) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(g_capture_task, &woken);
+    if (woken) portYIELD_FROM_ISR();
+  }
+}
+
+// Cattura archivio alla risoluzione utente: l'arbitro cambia modalità
+// solo per questa cattura, gli stream web restano aperti.
+static void capture_archive(int64_t wake_us) {
+  g_capture_busy = true;
+  portENTER_CRITICAL(&g_pwr_mux);
+  pwr_event_wake(&g_pwr, wake_us);
+  portEXIT_CRITICAL(&g_pwr_mux);
+
+  framesize_t fs = (framesize_t)g_framesize;
+  if (!cam_arb_fits(fs)) fs = cam_arb_fb_max();
+
+  cam_frame_t f;
+  if (cam_arb_grab(CAM_PROFILE_ARCHIVE, fs, g_jpeg_quality, &f, portMAX_DELAY) == CAM_OK) {
+    portENTER_CRITICAL(&g_pwr_mux);
+    pwr_event_mark(&g_pwr, PWR_STAGE_CAPTURE, esp_timer_get_time());
+    portEXIT_CRITICAL(&g_pwr_mux);
+
+    time_t ts = time_is_synced() ? time(nullptr) : 0;
+    uint32_t ms = millis();
+    uint32_t id = store_snapshot(f.buf, f.len);
+    uint16_t w = f.width, h = f.height;
+    cam_arb_release(&f);
+
+    portENTER_CRITICAL(&g_pwr_mux);
+    pwr_event_mark(&g_pwr, PWR_STAGE_STORE, esp_timer_get_time());
+    portEXIT_CRITICAL(&g_pwr_mux);
+
+    if (id) {
+      attach_thumb(id, w, h);
+      index_capture(id, w, h, ts, ms);
+    }
+
+    if (!g_boot_first_capture_ms) g_boot_first_capture_ms = millis();
+    g_capture_count++;
+  }
+  g_capture_busy = false;
+}
+
+static void capture_task(void*) {
+  // PIR già alto al boot (es. reset da brownout o wake da deep sleep): cattura subito.
+  // wake = 0: il percorso misurato parte dal reset.
+  if (digitalRead(PIR_PIN) == HIGH) capture_archive(0);
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    capture_archive(g_pir_isr_us);
+  }
+}
+
+// Stesso effetto dell'ISR, dal task loop (wake da light sleep senza fronte visto)
+static void pir_trigger(int64_t t_us) {
+  portENTER_CRITICAL(&g_pir_mux);
+  pir_count++;
+  portEXIT_CRITICAL(&g_pir_mux);
+  g_pir_isr_us = t_us;
+  if (g_capture_task) xTaskNotifyGive(g_capture_task);
+}
+
+// Upload PIR da attendere: con MQTT connesso sempre, altrimenti solo entro la finestra
+static bool pir_upload_waiting(uint32_t now) {
+  if (!g_pir_event_pending) return false;
+  return mqtt.connected() || (int32_t)(g_pir_upload_until_ms - now) > 0;
+}
+
+// ----------------- Radio policy -----------------
+// Power-save Wi-Fi e burst di upload (birdcam_radio); il light sleep resta
+// al power manager. WiFi.setSleep() riapplica la modalità a ogni join.
+static void radio_apply(radio_mode_t m) {
+  switch (m) {
+    case RADIO_PS_NONE:      WiFi.setSleep(WIFI_PS_NONE); break;
+    case RADIO_PS_MIN_MODEM: WiFi.setSleep(WIFI_PS_MIN_MODEM); break;
+    case RADIO_PS_MAX_MODEM: WiFi.setSleep(WIFI_PS_MAX_MODEM); break;
+    default: break;   // RADIO_OFF: spenta da enter_light_sleep
+  }
+}
+
+static void radio_tick(bool vbus_present, bool radio_off) {
+  cam_arb_stats_t cs;
+  cam_arb_get_stats(&cs);
+
+  radio_inputs_t in = {};
+  in.now_ms = millis();
+  in.on_vbus = vbus_present;
+  in.radio_off = radio_off;
+  in.busy = digitalRead(PIR_PIN) == HIGH || g_capture_busy;
+  in.stream_clients = cs.streams;
+  // coda: catture non ancora annunciate (almeno 1 se c'è un evento) + telemetria scaduta
+  if (pir_upload_waiting(in.now_ms)) {
+    uint32_t n = snap_next_id - 1 - g_ev_announced;
+    in.uploads_queued += n ? (int)n : 1;
+  }
+  if (ha_periodic_due(in.now_ms)) in.uploads_queued++;
+  in.last_http_ms = g_http_last_ms;
+  in.mqtt_connected = mqtt.connected();
+
+  portENTER_CRITICAL(&g_radio_mux);
+  radio_mode_t prev = g_radio.mode;
+  radio_mode_t m = radio_update(&g_radio, &in);
+  portEXIT_CRITICAL(&g_radio_mux);
+
+  if (m != prev) radio_apply(m);
+}
+
+// ----------------- Power states -----------------
+static void enter_light_sleep() {
+  // Il light sleep esplicito non mantiene l'associazione: radio spenta,
+  // al risveglio join veloce (BSSID/canale in cache).
+  if (mqtt.connected()) mqtt.disconnect();
+  WiFi.disconnect(true);
+
+  uint32_t pir_before = pir_count;
+  gpio_wakeup_enable((gpio_num_t)PIR_PIN, GPIO_INTR_HIGH_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+  // sveglia al prossimo frame timelapse, se prima dell'heartbeat
+  uint64_t sleep_ms = (uint64_t)LIGHT_SLEEP_HEARTBEAT_S * 1000ULL;
+  uint32_t tl_ms = tl_ms_to_next(millis());
+  bool tl_wake = tl_ms < sleep_ms;
+  if (tl_wake) sleep_ms = tl_ms ? tl_ms : 1;
+  esp_sleep_enable_timer_wakeup(sleep_ms * 1000ULL);
+
+  radio_tick(false, true);   // il sonno va contato come radio spenta
+  esp_light_sleep_start();
+
+  int64_t woke_us = esp_timer_get_time();
+  gpio_wakeup_disable((gpio_num_t)PIR_PIN);
+  // gpio_wakeup_enable ha messo il pin a livello: senza tornare al fronte
+  // l'ISR scatterebbe in continuo finché il PIR resta alto
+  gpio_set_intr_type((gpio_num_t)PIR_PIN, GPIO_INTR_POSEDGE);
+  cam_arb_discard_before(woke_us);
+
+  if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO) {
+    if (pir_count == pir_before) pir_trigger(woke_us);
+  } else if (tl_wake) {
+    // frame timelapse: cattura e torna a dormire senza accendere la radio
+    tl_tick(millis(), time_is_synced() ? time(nullptr) : 0);
+    g_radio_off = true;
+    return;
+  } else {
+    // heartbeat: resta sveglio quanto basta per telemetria MQTT
+    g_wake_hold_until_ms = millis() + 20000;
+  }
+  g_radio_off = false;
+  startWiFi();
+}
+
+static void enter_deep_sleep() {
+  if (mqtt.connected()) {
+    mqtt.publish(g_status_topic, "offline", true);
+    mqtt.disconnect();
+  }
+  WiFi.disconnect(true);
+  display_off();
+  esp_sleep_enable_ext0_wakeup((gpio_num_t)PIR_PIN, 1);
+  esp_deep_sleep_start();
+}
+
+static void power_tick(uint16_t vbus, uint16_t batt) {
+  uint32_t now = millis();
+
+  // heartbeat: basta un paio di secondi con MQTT connesso
+  if (g_wake_hold_until_ms && mqtt.connected() && (int32_t)(g_wake_hold_until_ms - now) > 2000) {
+    g_wake_hold_until_ms = now + 2000;
+  }
+  bool hold = g_wake_hold_until_ms && (int32_t)(g_wake_hold_until_ms - now) > 0;
+  if (!hold) g_wake_hold_until_ms = 0;
+
+  cam_arb_stats_t cs;
+  cam_arb_get_stats(&cs);
+
+  pwr_inputs_t in = {};
+  in.now_ms = now;
+  in.vbus_mv = vbus;
+  in.batt_mv = batt;
+  in.pir_active = digitalRead(PIR_PIN) == HIGH || g_capture_busy;
+  in.stream_clients = cs.streams;
+  in.upload_pending = pir_upload_waiting(now) || hold;
+  in.last_http_ms = g_http_last_ms;
+
+  portENTER_CRITICAL(&g_pwr_mux);
+  pwr_state_t st = pwr_update(&g_pwr, &in);
+  portEXIT_CRITICAL(&g_pwr_mux);
+
+  if (g_radio_off && st != PWR_LIGHT_SLEEP) {
+    g_radio_off = false;
+    startWiFi();
+  }
+
+  if (st == PWR_LIGHT_SLEEP) enter_light_sleep();
+  else if (st == PWR_DEEP_SLEEP) enter_deep_sleep();
+}
 
 // ----------------- Load settings -----------------
 static void load_settings() {
@@ -441,6 +1222,19 @@ static void load_settings() {
   g_jpeg_quality = prefs.getInt("jq", 12);
   g_img_mode = prefs.getInt("im", 0);
   g_archive_keep = prefs.getInt("ak", 6);
+  g_snap_max_age_ms = prefs.getInt("sm", 1000);
+  g_pwr_light_idle_s = prefs.getInt("pl", 60);
+  g_pwr_deep_enable  = prefs.getInt("pd", 0);
+  g_pwr_deep_idle_s  = prefs.getInt("pi", 900);
+  g_tl_interval_s = prefs.getInt("ti", 0);
+  g_tl_framesize  = prefs.getInt("tf", (int)FRAMESIZE_VGA);
+  g_tl_keep       = prefs.getInt("tk", 288);
+  g_roi_x         = prefs.getInt("rx", 0);
+  g_roi_y         = prefs.getInt("ry", 0);
+  g_roi_w         = prefs.getInt("rw", 100);
+  g_roi_profiles  = prefs.getInt("rp", 1 << CAM_PROFILE_ARCHIVE);
+  g_scene_threshold  = prefs.getInt("st", 2);
+  g_scene_keyframe_s = prefs.getInt("sk", 60);
   g_brightness    = prefs.getInt("br", 0);
   g_contrast      = prefs.getInt("ct", 0);
   g_saturation    = prefs.getInt("sa", 0);
@@ -456,6 +1250,20 @@ static void load_settings() {
   if (g_jpeg_quality > 63) g_jpeg_quality = 63;
   if (g_archive_keep < 1) g_archive_keep = 1;
   if (g_archive_keep > 20) g_archive_keep = 20;
+  if (g_snap_max_age_ms < 0) g_snap_max_age_ms = 0;
+  if (g_snap_max_age_ms > 10000) g_snap_max_age_ms = 10000;
+  if (g_pwr_light_idle_s < 0) g_pwr_light_idle_s = 0; if (g_pwr_light_idle_s > 3600) g_pwr_light_idle_s = 3600;
+  if (g_pwr_deep_idle_s < 60) g_pwr_deep_idle_s = 60; if (g_pwr_deep_idle_s > 86400) g_pwr_deep_idle_s = 86400;
+  g_pwr_deep_enable = g_pwr_deep_enable ? 1 : 0;
+  if (g_tl_interval_s < 0) g_tl_interval_s = 0; if (g_tl_interval_s > 3600) g_tl_interval_s = 3600;
+  if (g_tl_interval_s > 0 && g_tl_interval_s < 5) g_tl_interval_s = 5;
+  if (g_tl_keep < 1) g_tl_keep = 1; if (g_tl_keep > TL_MAX_FRAMES) g_tl_keep = TL_MAX_FRAMES;
+  if (g_roi_w < CAM_ROI_MIN_W) g_roi_w = CAM_ROI_MIN_W; if (g_roi_w > 100) g_roi_w = 100;
+  if (g_roi_x < 0) g_roi_x = 0; if (g_roi_x > 100 - g_roi_w) g_roi_x = 100 - g_roi_w;
+  if (g_roi_y < 0) g_roi_y = 0; if (g_roi_y > 100) g_roi_y = 100;
+  g_roi_profiles &= (1 << CAM_PROFILE_COUNT) - 1;
+  if (g_scene_threshold < 0) g_scene_threshold = 0; if (g_scene_threshold > 100) g_scene_threshold = 100;
+  if (g_scene_keyframe_s < 10) g_scene_keyframe_s = 10; if (g_scene_keyframe_s > 3600) g_scene_keyframe_s = 3600;
   if (g_brightness < -2) g_brightness = -2; if (g_brightness > 2) g_brightness = 2;
   if (g_contrast < -2) g_contrast = -2; if (g_contrast > 2) g_contrast = 2;
   if (g_saturation < -2) g_saturation = -2; if (g_saturation > 2) g_saturation = 2;
@@ -468,86 +1276,165 @@ static void load_settings() {
 }
 
 
-// ----------------- Camera controls via MQTT (and HA) -----------------
-static void mqtt_publish_cam_ctrl_states() {
-  if (!mqtt.connected()) return;
-  char topic[200], val[32];
-
-  auto pubi = [&](const char* key, int v){
-    snprintf(topic, sizeof(topic), "%s/ctrl/%s", g_base_topic, key);
-    snprintf(val, sizeof(val), "%d", v);
-    mqtt.publish(topic, val, true);
-  };
-  auto pubb = [&](const char* key, bool on){
-    snprintf(topic, sizeof(topic), "%s/ctrl/%s", g_base_topic, key);
-    mqtt.publish(topic, on ? "ON" : "OFF", true);
-  };
+// ----------------- Comandi MQTT (e HA): <base>/ctrl/<key>/set -----------------
+// Un comando per ogni impostazione bc_*; lo stato retained è su <base>/ctrl/<key>.
+// I comandi arrivati in un giro di mqtt.loop() vengono raccolti e applicati
+// insieme, una chiamata al setter per gruppo e un solo salvataggio NVS.
+enum CtrlGroup : uint16_t {
+  CG_SENSOR    = 1 << 0,   // bc_apply_settings
+  CG_CAM       = 1 << 1,   // bc_apply_cam_controls
+  CG_ARCHIVE   = 1 << 2,
+  CG_SNAPSHOT  = 1 << 3,
+  CG_POWER     = 1 << 4,
+  CG_TIMELAPSE = 1 << 5,
+  CG_ROI       = 1 << 6,
+  CG_SCENE     = 1 << 7,
+  CG_NET       = 1 << 8,
+  CG_ALL       = 0x1FF
+};
 
-  pubi("brightness", g_brightness);
-  pubi("contrast",   g_contrast);
-  pubi("saturation", g_saturation);
-  pubi("sharpness",  g_sharpness);
+enum CtrlId {
+  C_FRAMESIZE, C_QUALITY, C_IMG_MODE,
+  C_BRIGHTNESS, C_CONTRAST, C_SATURATION, C_SHARPNESS,
+  C_GAIN_CTRL, C_EXPOSURE_CTRL, C_AWB, C_AGC_GAIN, C_AEC_VALUE,
+  C_ARCHIVE_KEEP, C_SNAPSHOT_MAX_AGE,
+  C_LIGHT_IDLE, C_DEEP_SLEEP, C_DEEP_IDLE,
+  C_TL_INTERVAL, C_TL_FRAMESIZE, C_TL_KEEP,
+  C_ROI_X, C_ROI_Y, C_ROI_W,
+  C_ROI_STREAM, C_ROI_SNAPSHOT, C_ROI_ARCHIVE, C_ROI_MQTT, C_ROI_TIMELAPSE,
+  C_SCENE_THRESHOLD, C_SCENE_KEYFRAME,
+  C_STATIC_IP, C_GATEWAY, C_SUBNET, C_DNS,
+  C_COUNT
+};
 
-  pubb("gain_ctrl",     g_gain_ctrl);
-  pubb("exposure_ctrl", g_exposure_ctrl);
-  pubb("awb",           g_awb);
+static const ctrl_cmd_t CTRL_TABLE[C_COUNT] = {
+  // key                   kind            group         min   max                           var
+  {"framesize",            CTRL_FRAMESIZE, CG_SENSOR,    0,    FRAMESIZE_INVALID - 1,        &g_framesize},
+  {"quality",              CTRL_INT,       CG_SENSOR,    10,   63,                           &g_jpeg_quality},
+  {"img_mode",             CTRL_INT,       CG_SENSOR,    0,    5,                            &g_img_mode},
+  {"brightness",           CTRL_INT,       CG_CAM,       -2,   2,                            &g_brightness},
+  {"contrast",             CTRL_INT,       CG_CAM,       -2,   2,                            &g_contrast},
+  {"saturation",           CTRL_INT,       CG_CAM,       -2,   2,                            &g_saturation},
+  {"sharpness",            CTRL_INT,       CG_CAM,       -2,   2,                            &g_sharpness},
+  {"gain_ctrl",            CTRL_BOOL,      CG_CAM,       0,    1,                            &g_gain_ctrl},
+  {"exposure_ctrl",        CTRL_BOOL,      CG_CAM,       0,    1,                            &g_exposure_ctrl},
+  {"awb",                  CTRL_BOOL,      CG_CAM,       0,    1,                            &g_awb},
+  {"agc_gain",             CTRL_INT,       CG_CAM,       0,    30,                           &g_agc_gain},
+  {"aec_value",            CTRL_INT,       CG_CAM,       0,    1200,                         &g_aec_value},
+  {"archive_keep",         CTRL_INT,       CG_ARCHIVE,   1,    20,                           &g_archive_keep},
+  {"snapshot_max_age_ms",  CTRL_INT,       CG_SNAPSHOT,  0,    10000,                        &g_snap_max_age_ms},
+  {"light_sleep_idle_s",   CTRL_INT,       CG_POWER,     0,    3600,                         &g_pwr_light_idle_s},
+  {"deep_sleep",           CTRL_BOOL,      CG_POWER,     0,    1,                            &g_pwr_deep_enable},
+  {"deep_sleep_idle_s",    CTRL_INT,       CG_POWER,     60,   86400,                        &g_pwr_deep_idle_s},
+  {"timelapse_interval_s", CTRL_INT,       CG_TIMELAPSE, 0,    3600,                         &g_tl_interval_s},
+  {"timelapse_framesize",  CTRL_FRAMESIZE, CG_TIMELAPSE, 0,    FRAMESIZE_INVALID - 1,        &g_tl_framesize},
+  {"timelapse_keep",       CTRL_INT,       CG_TIMELAPSE, 1,    TL_MAX_FRAMES,                &g_tl_keep},
+  {"roi_x",                CTRL_INT,       CG_ROI,       0,    100,                          &g_roi_x},
+  {"roi_y",                CTRL_INT,       CG_ROI,       0,    100,                          &g_roi_y},
+  {"roi_w",                CTRL_INT,       CG_ROI,       CAM_ROI_MIN_W, 100,                 &g_roi_w},
+  {"roi_stream",           CTRL_BIT,       CG_ROI,       1 << CAM_PROFILE_STREAM,    0,      &g_roi_profiles},
+  {"roi_snapshot",         CTRL_BIT,       CG_ROI,       1 << CAM_PROFILE_SNAPSHOT,  0,      &g_roi_profiles},
+  {"roi_archive",          CTRL_BIT,       CG_ROI,       1 << CAM_PROFILE_ARCHIVE,   0,      &g_roi_profiles},
+  {"roi_mqtt",             CTRL_BIT,       CG_ROI,       1 << CAM_PROFILE_MQTT,      0,      &g_roi_profiles},
+  {"roi_timelapse",        CTRL_BIT,       CG_ROI,       1 << CAM_PROFILE_TIMELAPSE, 0,      &g_roi_profiles},
+  {"scene_threshold",      CTRL_INT,       CG_SCENE,     0,    100,                          &g_scene_threshold},
+  {"scene_keyframe_s",     CTRL_INT,       CG_SCENE,     10,   3600,                         &g_scene_keyframe_s},
+  {"static_ip",            CTRL_IPV4,      CG_NET,       0,    0,                            &g_net_static[0]},
+  {"gateway",              CTRL_IPV4,      CG_NET,       0,    0,                            &g_net_static[1]},
+  {"subnet",               CTRL_IPV4,      CG_NET,       0,    0,                            &g_net_static[2]},
+  {"dns",                  CTRL_IPV4,      CG_NET,       0,    0,                            &g_net_static[3]},
+};
+static_assert(C_COUNT < 64, "s_ctrl_staged is a 64-bit mask");
 
-  pubi("agc_gain",  g_agc_gain);
-  pubi("aec_value", g_aec_value);
-}
+static ctrl_router_t g_ctrl;
+static int32_t  s_ctrl_stage[C_COUNT];
+static uint64_t s_ctrl_staged = 0;
 
-static void mqtt_cam_ctrl_apply_and_publish() {
-  bc_apply_cam_controls(g_brightness, g_contrast, g_saturation, g_sharpness,
-                        g_gain_ctrl, g_exposure_ctrl, g_awb,
-                        g_agc_gain, g_aec_value);
-  bc_save_settings();
-  mqtt_publish_cam_ctrl_states();
+// valore in attesa se c'è, altrimenti quello attuale
+static int32_t ctrl_value(int id) {
+  return ((s_ctrl_staged >> id) & 1) ? s_ctrl_stage[id] : ctrl_current(&CTRL_TABLE[id]);
 }
 
-static bool topic_is_ctrl_set(const char* topic, const char* key) {
-  char t[220];
-  snprintf(t, sizeof(t), "%s/ctrl/%s/set", g_base_topic, key);
-  return strcmp(topic, t) == 0;
+static void mqtt_publish_ctrl_states(uint16_t groups) {
+  if (!mqtt.connected() || !g_ctrl.table) return;
+  char topic[CTRL_PREFIX_MAX + 32], val[24];
+  memcpy(topic, g_ctrl.prefix, g_ctrl.prefix_len);
+  for (int i = 0; i < C_COUNT; i++) {
+    const ctrl_cmd_t& c = CTRL_TABLE[i];
+    if (!(c.group & groups)) continue;
+    snprintf(topic + g_ctrl.prefix_len, sizeof(topic) - g_ctrl.prefix_len, "%s", c.key);
+    int32_t v = ctrl_current(&c);
+    if (c.kind == CTRL_FRAMESIZE) snprintf(val, sizeof(val), "%s", cam_framesize_name((framesize_t)v));
+    else ctrl_format(&c, v, val, sizeof(val));
+    mqtt.publish(topic, val, true);
+  }
 }
 
 static void mqtt_callback(char* topic, byte* payload, unsigned int length) {
   if (!topic || !payload) return;
+  int id = ctrl_route(&g_ctrl, topic);
+  if (id < 0) return;
 
   char msg[64];
   unsigned int n = (length < sizeof(msg)-1) ? length : (sizeof(msg)-1);
   memcpy(msg, payload, n);
   msg[n] = 0;
 
-  auto toInt = [&](int def)->int{
-    char* end=nullptr;
-    long v=strtol(msg,&end,10);
-    if (end==msg) return def;
-    return (int)v;
-  };
-  auto toBool = [&](bool def)->bool{
-    if (!strcasecmp(msg,"ON") || !strcasecmp(msg,"1") || !strcasecmp(msg,"true")) return true;
-    if (!strcasecmp(msg,"OFF")|| !strcasecmp(msg,"0") || !strcasecmp(msg,"false")) return false;
-    return def;
-  };
-
-  bool touched = false;
-
-  if (topic_is_ctrl_set(topic, "brightness")) { g_brightness = toInt(g_brightness); touched = true; }
-  else if (topic_is_ctrl_set(topic, "contrast")) { g_contrast = toInt(g_contrast); touched = true; }
-  else if (topic_is_ctrl_set(topic, "saturation")) { g_saturation = toInt(g_saturation); touched = true; }
-  else if (topic_is_ctrl_set(topic, "sharpness")) { g_sharpness = toInt(g_sharpness); touched = true; }
-  else if (topic_is_ctrl_set(topic, "gain_ctrl")) { g_gain_ctrl = toBool(g_gain_ctrl) ? 1 : 0; touched = true; }
-  else if (topic_is_ctrl_set(topic, "exposure_ctrl")) { g_exposure_ctrl = toBool(g_exposure_ctrl) ? 1 : 0; touched = true; }
-  else if (topic_is_ctrl_set(topic, "awb")) { g_awb = toBool(g_awb) ? 1 : 0; touched = true; }
-  else if (topic_is_ctrl_set(topic, "agc_gain")) { g_agc_gain = toInt(g_agc_gain); touched = true; }
-  else if (topic_is_ctrl_set(topic, "aec_value")) { g_aec_value = toInt(g_aec_value); touched = true; }
-
-  if (touched) mqtt_cam_ctrl_apply_and_publish();
+  const ctrl_cmd_t& c = CTRL_TABLE[id];
+  int32_t v = 0;
+  if (c.kind == CTRL_FRAMESIZE) {
+    v = cam_framesize_from_str(msg, FRAMESIZE_INVALID);   // "vga" o numero
+    if (v == FRAMESIZE_INVALID) return;
+  } else if (!ctrl_parse(&c, msg, &v)) {
+    return;
+  }
+  s_ctrl_stage[id] = v;
+  s_ctrl_staged |= 1ULL << id;
+}
+
+// Dopo mqtt.loop(): applica i comandi raccolti
+static void mqtt_ctrl_apply() {
+  if (!s_ctrl_staged) return;
+  uint16_t groups = 0;
+  for (int i = 0; i < C_COUNT; i++) {
+    if ((s_ctrl_staged >> i) & 1) groups |= CTRL_TABLE[i].group;
+  }
+
+  if (groups & CG_SENSOR) bc_apply_settings(ctrl_value(C_FRAMESIZE), ctrl_value(C_QUALITY), ctrl_value(C_IMG_MODE));
+  if (groups & CG_CAM) {
+    bc_apply_cam_controls(ctrl_value(C_BRIGHTNESS), ctrl_value(C_CONTRAST), ctrl_value(C_SATURATION),
+                          ctrl_value(C_SHARPNESS), ctrl_value(C_GAIN_CTRL), ctrl_value(C_EXPOSURE_CTRL),
+                          ctrl_value(C_AWB), ctrl_value(C_AGC_GAIN), ctrl_value(C_AEC_VALUE));
+  }
+  if (groups & CG_ARCHIVE) bc_set_archive_keep(ctrl_value(C_ARCHIVE_KEEP));
+  if (groups & CG_SNAPSHOT) bc_set_snapshot_max_age_ms(ctrl_value(C_SNAPSHOT_MAX_AGE));
+  if (groups & CG_POWER) bc_set_power_settings(ctrl_value(C_LIGHT_IDLE), ctrl_value(C_DEEP_SLEEP), ctrl_value(C_DEEP_IDLE));
+  if (groups & CG_TIMELAPSE) bc_set_timelapse(ctrl_value(C_TL_INTERVAL), ctrl_value(C_TL_FRAMESIZE), ctrl_value(C_TL_KEEP));
+  if (groups & CG_ROI) {
+    int rp = g_roi_profiles;
+    for (int i = C_ROI_STREAM; i <= C_ROI_TIMELAPSE; i++) {
+      if (!((s_ctrl_staged >> i) & 1)) continue;
+      rp = s_ctrl_stage[i] ? (rp | CTRL_TABLE[i].min) : (rp & ~CTRL_TABLE[i].min);
+    }
+    bc_set_roi(ctrl_value(C_ROI_X), ctrl_value(C_ROI_Y), ctrl_value(C_ROI_W), rp);
+  }
+  if (groups & CG_SCENE) bc_set_scene(ctrl_value(C_SCENE_THRESHOLD), ctrl_value(C_SCENE_KEYFRAME));
+  if (groups & CG_NET) {
+    // come da web: tutto vuoto = DHCP, altrimenti servono gateway e subnet
+    uint32_t net[4];
+    for (int i = 0; i < 4; i++) net[i] = (uint32_t)ctrl_value(C_STATIC_IP + i);
+    if (net[0] == 0 || (net[1] && net[2])) bc_set_static_ip(net);
+  }
+
+  s_ctrl_staged = 0;
+  bc_save_settings();
+  mqtt_publish_ctrl_states(groups);
 }
 
 // ----------------- MQTT connect (Last Will OK) -----------------
 static void mqtt_connect_if_needed() {
   if (mqtt.connected()) return;
+  if (!WiFi.isConnected()) return;
 
   uint32_t now = millis();
   if (now - g_mqtt_last_try_ms < 5000) return;
@@ -573,19 +1460,18 @@ static void mqtt_connect_if_needed() {
   // Init HA module (safe to call multiple times)
   ha_init(mqtt, g_dev_id, g_base_topic, g_status_topic, FW_VERSION);
   ha_publish_discovery();
-  // Subscribe to camera control topics (HA number/switch set)
-  char sub[220];
-  const char* keys[] = {"brightness","contrast","saturation","sharpness","gain_ctrl","exposure_ctrl","awb","agc_gain","aec_value"};
-  for (auto k : keys) {
-    snprintf(sub, sizeof(sub), "%s/ctrl/%s/set", g_base_topic, k);
-    mqtt.subscribe(sub);
-  }
+  // Comandi: una sola sottoscrizione wildcard, instradati da ctrl_route()
+  ctrl_router_init(&g_ctrl, CTRL_TABLE, C_COUNT, g_base_topic);
+  char sub[CTRL_PREFIX_MAX + 8];
+  snprintf(sub, sizeof(sub), "%s+/set", g_ctrl.prefix);
+  mqtt.subscribe(sub);
   // Publish retained current states so HA UI matches device state
-  mqtt_publish_cam_ctrl_states();
+  mqtt_publish_ctrl_states(CG_ALL);
 
 
   // pubblica stati iniziali
   ha_set_boot_time(g_boot_time);
+  ha_set_boot_metrics(g_boot_wifi_ms, g_boot_first_capture_ms);
   ha_set_wifi(WiFi.isConnected() ? WiFi.RSSI() : 0, WiFi.isConnected() ? WiFi.channel() : 0);
 
   uint16_t vbus = PMU.getVbusVoltage();
@@ -595,12 +1481,17 @@ static void mqtt_connect_if_needed() {
   bool batt_present = PMU.isBatteryConnect(); // se la tua lib non ha questo, dimmelo e lo adattiamo
   ha_set_pmu(vbus, sysv, batt, vbus_present, batt_present);
 
+  scene_stats_t ss;
+  scene_get_stats(&ss);
+  ha_set_mqtt_stream_stats(ss.published, ss.skipped, ss.bytes_saved);
+
   String ipS = WiFi.isConnected() ? WiFi.localIP().toString() : String("");
   ha_publish_periodic(millis(), pir_count, snap_count, ipS.c_str());
 }
 
 // ----------------- Publish JPEG frame to MQTT camera (small) -----------------
-static bool publish_small_jpeg_to_topic(const char* topic, bool retained) {
+// scene_gate: salta il frame se la scena non è cambiata (stream periodico)
+static bool publish_small_jpeg_to_topic(const char* topic, bool retained, bool scene_gate = false) {
   if (!mqtt.connected() || !topic) return false;
 
   // PubSubClient: per payload grandi serve buffer grande.
@@ -610,76 +1501,113 @@ static bool publish_small_jpeg_to_topic(const char* topic, bool retained) {
 
   bool ok = false;
 
-  if (g_cam_mutex) xSemaphoreTake(g_cam_mutex, portMAX_DELAY);
-
-  sensor_t* s = esp_camera_sensor_get();
-  framesize_t old_fs = (framesize_t)g_framesize;
-  int old_q = g_jpeg_quality;
-
-  if (s) {
-    s->set_framesize(s, FS_MQTT);
-    s->set_quality(s, Q_MQTT);
-  }
-
-  camera_fb_t* fb = esp_camera_fb_get();
-  if (fb && fb->format == PIXFORMAT_JPEG && fb->len > 0) {
-    ok = mqtt.publish(topic, fb->buf, fb->len, retained);
-    esp_camera_fb_return(fb);
-  } else if (fb) {
-    esp_camera_fb_return(fb);
-  }
-
-  // restore
-  if (s) {
-    s->set_framesize(s, old_fs);
-    s->set_quality(s, old_q);
+  // con uno stream QVGA attivo l'arbitro riduce il suo frame invece di cambiare modalità
+  cam_frame_t f;
+  if (cam_arb_grab(CAM_PROFILE_MQTT, FS_MQTT, Q_MQTT, &f, 1000) == CAM_OK) {
+    bool send = true;
+    if (scene_gate) {
+      uint8_t sig[SCENE_CELLS];
+      int dw = 0, dh = 0;
+      uint8_t* rgb = scene_enabled() ? cam_decode_8x(f.buf, f.len, f.width, f.height, &dw, &dh) : nullptr;
+      if (rgb) {
+        scene_signature(rgb, dw, dh, sig);
+        free(rgb);
+      }
+      send = scene_should_publish(rgb ? sig : nullptr, f.len, millis());
+    }
+    if (send) {
+      // rotazione ±90: il CSS della pagina qui non c'è
+      uint8_t* rj = nullptr;
+      size_t rlen = 0;
+      if ((g_img_mode == 4 || g_img_mode == 5) &&
+          cam_rotate_jpeg(f.buf, f.len, f.width, f.height, g_img_mode == 4, Q_MQTT, &rj, &rlen)) {
+        ok = mqtt.publish(topic, rj, rlen, retained);
+        if (ok) radio_tx(rlen);
+      } else {
+        ok = mqtt.publish(topic, f.buf, f.len, retained);
+        if (ok) radio_tx(f.len);
+      }
+      free(rj);
+    }
+    cam_arb_release(&f);
   }
 
-  if (g_cam_mutex) xSemaphoreGive(g_cam_mutex);
+  return ok;
+}
 
+// Miniatura dell'ultima cattura PIR: è il frame dell'evento e non serve
+// una seconda cattura (false se la miniatura non c'è)
+static bool publish_latest_thumb(const char* topic) {
+  if (!mqtt.connected() || !topic) return false;
+  bc_snap_ref_t ref;
+  if (!bc_get_snapshot(0, &ref)) return false;
+  bool ok = ref.thumb && mqtt.publish(topic, ref.thumb->data, ref.thumb->len, true);
+  if (ok) radio_tx(ref.thumb->len);
+  bc_snap_release(&ref, 1);
   return ok;
 }
 
 void setup() {
   Serial.begin(115200);
-  delay(800);
 
   make_device_id();
 
-  pinMode(PIR_PIN, INPUT);
-  attachInterrupt(digitalPinToInterrupt(PIR_PIN), pirISR, RISING);
-
   g_cam_mutex = xSemaphoreCreateMutex();
 
+  pwr_config_t pcfg;
+  pwr_default_config(&pcfg);
+  pwr_init(&g_pwr, &pcfg, millis());
+  radio_init(&g_radio, nullptr, millis());
+
   load_settings();
+  load_capture_ids();
+  ev_init(&g_events);
+  pwr_apply_settings();
+  load_net_cache();
   realloc_archive(g_archive_keep);
 
+  // Percorso critico prima di tutto: alimentazione sensore -> camera -> PIR
   initPMU_forCamera();
-  initDisplay();
-  initWiFi();
-  initTimeNTP();
   initCameraStable();
+  g_boot_camera_ms = millis();
+  tl_init();
+  tl_configure((uint32_t)g_tl_interval_s, (framesize_t)g_tl_framesize, g_jpeg_quality, g_tl_keep);
+  scene_configure(g_scene_threshold, (uint32_t)g_scene_keyframe_s);
+
+  pinMode(PIR_PIN, INPUT);
+  // wake da deep sleep = evento PIR (la cattura parte appena il task è su)
+  if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_EXT0) pir_count++;
+  xTaskCreatePinnedToCore(capture_task, "bc_capture", 6144, nullptr, 5, &g_capture_task, 1);
+  attachInterrupt(digitalPinToInterrupt(PIR_PIN), pirISR, RISING);
+
+  initDisplay();
+
+  // Rete in background: Wi-Fi, NTP e MQTT avanzano da soli (net_tick / loop),
+  // httpd ascolta già e risponde appena c'è un IP.
+  startWiFi();
+  radio_apply(g_radio.mode);
+  startTimeNTP();
 
   // MQTT: alza buffer (ma non esagerare)
   mqtt.setBufferSize(32768);
   mqtt.setKeepAlive(30);
 
   startCameraServer();
+  rtsp_start(RTSP_PORT);
 }
 
 void loop() {
-  // Fix boot time se NTP arriva dopo
-  if (g_boot_time == 0) {
-    time_t now = time(nullptr);
-    if (now > 1700000000) g_boot_time = now;
-  }
+  // Wi-Fi (fallback scan) + NTP (back-fill timestamp)
+  net_tick();
 
   // MQTT
   mqtt_connect_if_needed();
   mqtt.loop();
+  mqtt_ctrl_apply();
 
   // Update HA cached values + periodic publish
   ha_set_boot_time(g_boot_time);
+  ha_set_boot_metrics(g_boot_wifi_ms, g_boot_first_capture_ms);
   ha_set_wifi(WiFi.isConnected() ? WiFi.RSSI() : 0, WiFi.isConnected() ? WiFi.channel() : 0);
 
   uint16_t vbus = PMU.getVbusVoltage();
@@ -689,40 +1617,72 @@ void loop() {
   bool batt_present = PMU.isBatteryConnect();
   ha_set_pmu(vbus, sysv, batt, vbus_present, batt_present);
 
+  scene_stats_t ss;
+  scene_get_stats(&ss);
+  ha_set_mqtt_stream_stats(ss.published, ss.skipped, ss.bytes_saved);
+
+  portENTER_CRITICAL(&g_radio_mux);
+  ha_set_radio(radio_mode_name(g_radio.mode), radio_avg_ma(&g_radio, RADIO_MODE_COUNT), g_radio.bursts);
+  portEXIT_CRITICAL(&g_radio_mux);
+
+  // Radio: power-save + finestra di upload (in batteria gli upload si accodano)
+  radio_tick(vbus_present, g_radio_off);
+
   String ipS = WiFi.isConnected() ? WiFi.localIP().toString() : String("");
-  ha_publish_periodic(millis(), pir_count, snap_count, ipS.c_str());
+  if (g_radio.flushing) ha_publish_periodic(millis(), pir_count, snap_count, ipS.c_str());
 
-  // PIR handling
+  // PIR handling (la cattura la fa capture_task): l'evento resta in coda
+  // finché MQTT non è connesso (es. subito dopo un wake); ogni PIR riapre
+  // la finestra di attesa
   static uint32_t last_pir_seen = 0;
   uint32_t cur = pir_count;
   if (cur != last_pir_seen) {
     last_pir_seen = cur;
+    g_pir_event_pending = true;
+    g_pir_upload_until_ms = millis() + PIR_UPLOAD_WAIT_MS;
+  }
 
-    stream_active = false; // anti-OVF
-
-    if (g_cam_mutex) xSemaphoreTake(g_cam_mutex, portMAX_DELAY);
-    camera_fb_t* fb = esp_camera_fb_get();
-    if (fb) {
-      store_snapshot_from_fb(fb);
-      esp_camera_fb_return(fb);
-
-      if (!on_external_power()) {
-        g_batt_msg_until_ms = millis() + 2500;
-        display_show_capture();
+  // HA event
+  if (g_pir_event_pending && mqtt.connected() && !g_capture_busy && g_radio.flushing) {
+    g_pir_event_pending = false;
+
+    long ts = time_is_synced() ? (long)time(nullptr) : 0;
+    ha_on_pir(pir_count, snap_count, ipS.c_str(), ts);
+    g_pir_off_at_ms = millis() + 800;
+
+    // catture nuove dall'ultimo annuncio, una pubblicazione per evento;
+    // a pagine da 4 finché ne restano (es. eventi accumulati a broker giù)
+    ev_event_t evs[4];
+    int nev;
+    do {
+      uint32_t from = g_ev_announced;
+      nev = bc_get_events(from, evs, 4);
+      for (int i = 0; i < nev; i++) {
+        char js[480];
+        if (ev_format_json(&evs[i], g_ev_announced + 1, js, sizeof(js))) ha_publish_event(js);
+        g_ev_announced = evs[i].last_id;
       }
-    }
-    if (g_cam_mutex) xSemaphoreGive(g_cam_mutex);
+      if (g_ev_announced == from) break;
+    } while (nev == 4);
 
-    // HA event
-    if (mqtt.connected()) {
-      long ts = (long)time(nullptr);
-      if (ts <= 0) ts = (long)(millis() / 1000);
+    // Snapshot MQTT retained: miniatura dell'evento, altrimenti frame piccolo
+    if (!publish_latest_thumb(ha_topic_cam_snapshot())) {
+      publish_small_jpeg_to_topic(ha_topic_cam_snapshot(), true);
+    }
 
-      ha_on_pir(pir_count, snap_count, ipS.c_str(), ts);
-      g_pir_off_at_ms = millis() + 800;
+    portENTER_CRITICAL(&g_pwr_mux);
+    pwr_event_mark(&g_pwr, PWR_STAGE_UPLOAD, esp_timer_get_time());
+    portEXIT_CRITICAL(&g_pwr_mux);
+    const pwr_event_t& ev = g_pwr.ev_last;
+    ha_set_power_event(ev.stage_us[PWR_STAGE_CAPTURE] / 1000, ev.stage_us[PWR_STAGE_UPLOAD] / 1000, ev.energy_uj / 1000);
+  }
 
-      // Snapshot MQTT retained (frame piccolo)
-      publish_small_jpeg_to_topic(ha_topic_cam_snapshot(), true);
+  static uint32_t last_capture_seen = 0;
+  if (g_capture_count != last_capture_seen) {
+    last_capture_seen = g_capture_count;
+    if (!on_external_power()) {
+      g_batt_msg_until_ms = millis() + 2500;
+      display_show_capture();
     }
   }
 
@@ -732,15 +1692,24 @@ void loop() {
     if (mqtt.connected()) ha_pir_off();
   }
 
-  // MQTT “Stream”: solo se alimentato + non stai facendo MJPEG web
-  if (mqtt.connected() && on_external_power() && !stream_active) {
+  // Timelapse (no-op se disattivato)
+  tl_tick(millis(), time_is_synced() ? time(nullptr) : 0);
+
+  // MQTT “Stream”: solo se alimentato + nessuno stream web/RTSP aperto
+  cam_arb_stats_t cs;
+  cam_arb_get_stats(&cs);
+  if (mqtt.connected() && on_external_power() && cs.streams == 0) {
     uint32_t now = millis();
     if (now - g_mqtt_stream_last_ms >= MQTT_STREAM_PERIOD_MS) {
       g_mqtt_stream_last_ms = now;
-      publish_small_jpeg_to_topic(ha_topic_cam_stream(), false);
+      publish_small_jpeg_to_topic(ha_topic_cam_stream(), false, true);
     }
   }
 
+  // Power manager: stato da VBUS/batteria + attività (può dormire qui)
+  ha_set_power_state(pwr_state_name(g_pwr.state));
+  power_tick(vbus, batt);
+
   // OLED tick
   uint32_t now_ms = millis();
   if (g_display_ok) {
@@ -757,5 +1726,5 @@ void loop() {
     }
   }
 
-  delay(50);
+  delay(g_pwr.state == PWR_FULL ? 50 : 100);
 }
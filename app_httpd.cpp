@@ -1,15 +1,28 @@
 #include "esp_http_server.h"
 #include "esp_camera.h"
 #include "freertos/semphr.h"
+#include "freertos/queue.h"
 #include <WiFi.h>
 #include <Arduino.h>
 #include <time.h>
+#include <inttypes.h>
 
 #include "esp_heap_caps.h"
 #include "esp_timer.h"
+#include "lwip/sockets.h"
 
 #include "camera_index.h"
 #include "birdcam_settings.h"
+#include "birdcam_cam.h"
+#include "birdcam_power.h"
+#include "birdcam_radio.h"
+#include "birdcam_timelapse.h"
+#include "birdcam_avi.h"
+#include "birdcam_archive.h"
+#include "birdcam_export.h"
+#include "birdcam_rtsp.h"
+#include "birdcam_scene.h"
+#include "birdcam_kernels.h"
 
 #define XPOWERS_CHIP_AXP2101
 #include "XPowersLib.h"
@@ -18,16 +31,20 @@
 extern XPowersPMU PMU;
 extern SemaphoreHandle_t g_cam_mutex;
 extern volatile uint32_t pir_count;
-extern bool stream_active;
 extern time_t g_boot_time;
+extern volatile uint32_t g_http_last_ms;
 
-// archive getter implemented in BirdCam.ino
-bool bc_get_snapshot(int n, const uint8_t** data, size_t* len, time_t* ts);
+// power manager state (BirdCam.ino)
+const pwr_sm_t* bc_get_power();
+// politica radio (BirdCam.ino)
+const radio_policy_t* bc_get_radio();
+void bc_radio_stream_frame(uint32_t lat_ms, uint32_t bytes);
 
 static httpd_handle_t camera_httpd = NULL;
 
 // ---------------- helpers ----------------
 static inline void set_common_headers(httpd_req_t *req) {
+  g_http_last_ms = millis();   // attività per il power manager
   httpd_resp_set_hdr(req, "Cache-Control", "no-store, max-age=0");
   httpd_resp_set_hdr(req, "Pragma", "no-cache");
   httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
@@ -124,150 +141,567 @@ static esp_err_t api_mode_handler(httpd_req_t *req) {
   return httpd_resp_send(req, buf, HTTPD_RESP_USE_STRLEN);
 }
 
-static esp_err_t snapshot_handler(httpd_req_t *req) {
-  if (g_cam_mutex) xSemaphoreTake(g_cam_mutex, portMAX_DELAY);
-// Snapshot "live": se la risoluzione è molto alta, scendi a VGA per aumentare l'affidabilità
-sensor_t* s = esp_camera_sensor_get();
-framesize_t old_fs = FRAMESIZE_QVGA;
-int old_q = 30;
-if (s) {
-  old_fs = s->status.framesize;
-  old_q  = s->status.quality;
-  if (old_fs > FRAMESIZE_VGA) {
-    s->set_framesize(s, FRAMESIZE_VGA);
-  }
-  // tieni la qualità corrente (o più compressa se troppo "bella")
-  int q = old_q;
-  if (q < 30) q = 30;
-  s->set_quality(s, q);
+// Parametri ?fs=&q= comuni a /snapshot e /mjpeg
+static void parse_fs_q(httpd_req_t *req, framesize_t* fs, int* q) {
+  char qs[64];
+  if (httpd_req_get_url_query_str(req, qs, sizeof(qs)) != ESP_OK) return;
+  char param[12];
+  if (httpd_query_key_value(qs, "fs", param, sizeof(param)) == ESP_OK) *fs = cam_framesize_from_str(param, *fs);
+  if (httpd_query_key_value(qs, "q", param, sizeof(param)) == ESP_OK) *q = atoi(param);
 }
 
-  camera_fb_t *fb = esp_camera_fb_get();
-  if (!fb) {
-    if (g_cam_mutex) xSemaphoreGive(g_cam_mutex);
-    return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Camera capture failed");
+static esp_err_t send_cam_error(httpd_req_t *req, cam_result_t r, framesize_t fs) {
+  set_common_headers(req);
+  if (r == CAM_ERR_TOO_LARGE) {
+    char msg[96];
+    snprintf(msg, sizeof(msg), "Frame size %s exceeds frame buffers (max %s)",
+             cam_framesize_name(fs), cam_framesize_name(cam_arb_fb_max()));
+    return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, msg);
+  }
+  if (r == CAM_ERR_BUSY) {
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_set_hdr(req, "Retry-After", "1");
+    httpd_resp_set_type(req, "text/plain");
+    return httpd_resp_sendstr(req, "Camera busy");
   }
+  return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Camera capture failed");
+}
+
+static esp_err_t snapshot_handler(httpd_req_t *req) {
+  // Default: risoluzione utente ma al massimo VGA, qualità almeno 30 (affidabilità)
+  framesize_t fs = (framesize_t)bc_get_framesize();
+  if (cam_fs_area(fs) > cam_fs_area(FRAMESIZE_VGA)) fs = FRAMESIZE_VGA;
+  if (!cam_arb_fits(fs)) fs = cam_arb_fb_max();
+  int q = bc_get_jpeg_quality();
+  if (q < 30) q = 30;
+  parse_fs_q(req, &fs, &q);
+
+  // Cache single-flight: N poller concorrenti = una sola cattura
+  cam_cached_t c;
+  cam_result_t r = cam_cache_get(fs, q, (uint32_t)bc_get_snapshot_max_age_ms(), &c, 3000);
+  if (r != CAM_OK) return send_cam_error(req, r, fs);
+
+  char age[24];
+  int64_t age_ms = (esp_timer_get_time() - c.ts_us) / 1000;
+  snprintf(age, sizeof(age), "%" PRId64, age_ms > 0 ? age_ms : (int64_t)0);
 
   httpd_resp_set_type(req, "image/jpeg");
   httpd_resp_set_hdr(req, "Content-Disposition", "inline; filename=snapshot.jpg");
+  httpd_resp_set_hdr(req, "X-Frame-Age", age);
+  httpd_resp_set_hdr(req, "Access-Control-Expose-Headers", "X-Frame-Age");
   set_common_headers(req);
 
-  esp_err_t res = httpd_resp_send(req, (const char*)fb->buf, fb->len);
-  esp_camera_fb_return(fb);
-  if (g_cam_mutex) xSemaphoreGive(g_cam_mutex);
+  esp_err_t res = httpd_resp_send(req, (const char*)c.blob->data, c.blob->len);
+  cam_cache_release(&c);
   return res;
 }
 
-// ---- MJPEG stream (5 FPS + stop controllato) ----
+// ---- Budget socket lwIP ----
+// CONFIG_LWIP_MAX_SOCKETS del core Arduino è 16, per tutto il firmware:
+//   httpd interni  3  listen, ctrl, socket temporaneo di httpd_queue_work()
+//   MQTT           1  PubSubClient (anche la discovery HA)
+//   RTSP           6  listener, 3 sessioni, RTP/RTCP di 1 sessione UDP
+//   httpd client   6  4 stream /mjpeg + 2 per pagine e API (LRU purge)
+// DNS e SNTP usano pcb UDP raw di lwIP, non socket.
+#define LWIP_SOCKET_BUDGET     16
+#define HTTPD_INTERNAL_SOCKETS 3
+#define MQTT_SOCKETS           1
+#define HTTPD_OPEN_SOCKETS (LWIP_SOCKET_BUDGET - HTTPD_INTERNAL_SOCKETS - MQTT_SOCKETS - RTSP_SOCKETS)
+#if defined(CONFIG_LWIP_MAX_SOCKETS) && CONFIG_LWIP_MAX_SOCKETS < LWIP_SOCKET_BUDGET
+#error "CONFIG_LWIP_MAX_SOCKETS sotto il budget socket del firmware"
+#endif
+
+// ---- Worker asincroni ----
+// esp_http_server esegue tutti gli handler su un solo task: le risposte lunghe
+// (MJPEG, AVI, tar/zip) passano a un pool di worker con
+// httpd_req_async_handler_begin(), così le altre pagine restano servite.
+#define ASYNC_WORKERS      4
+#define ASYNC_WORKER_STACK 8192
+
+typedef esp_err_t (*async_fn_t)(httpd_req_t *req);
+struct AsyncJob {
+  httpd_req_t* req;
+  async_fn_t   fn;
+};
+
+static QueueHandle_t g_async_q = NULL;
+static SemaphoreHandle_t g_async_idle = NULL;   // worker liberi
+static TaskHandle_t g_async_tasks[ASYNC_WORKERS];
+static volatile uint32_t g_async_rejected = 0;
+
+static bool on_async_worker() {
+  TaskHandle_t me = xTaskGetCurrentTaskHandle();
+  for (int i = 0; i < ASYNC_WORKERS; i++) if (g_async_tasks[i] == me) return true;
+  return false;
+}
+
+static void async_worker(void*) {
+  for (;;) {
+    AsyncJob job;
+    if (xQueueReceive(g_async_q, &job, portMAX_DELAY) != pdTRUE) continue;
+    job.fn(job.req);
+    httpd_req_async_handler_complete(job.req);
+    xSemaphoreGive(g_async_idle);
+  }
+}
+
+static void async_workers_start(int priority) {
+  g_async_q = xQueueCreate(ASYNC_WORKERS, sizeof(AsyncJob));
+  g_async_idle = xSemaphoreCreateCounting(ASYNC_WORKERS, ASYNC_WORKERS);
+  for (int i = 0; i < ASYNC_WORKERS; i++) {
+    xTaskCreate(async_worker, "bc_httpd_async", ASYNC_WORKER_STACK, NULL, priority, &g_async_tasks[i]);
+  }
+}
+
+// Dal task httpd: passa la richiesta a un worker (503 se sono tutti occupati)
+static esp_err_t async_submit(httpd_req_t *req, async_fn_t fn) {
+  if (!g_async_q || xSemaphoreTake(g_async_idle, 0) != pdTRUE) {
+    g_async_rejected++;
+    set_common_headers(req);
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_set_hdr(req, "Retry-After", "5");
+    httpd_resp_set_type(req, "text/plain");
+    return httpd_resp_sendstr(req, "All streaming workers busy");
+  }
+  httpd_req_t* copy = NULL;
+  if (httpd_req_async_handler_begin(req, &copy) != ESP_OK) {
+    xSemaphoreGive(g_async_idle);
+    return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "async begin failed");
+  }
+  AsyncJob job = { copy, fn };
+  xQueueSend(g_async_q, &job, portMAX_DELAY);   // c'è un worker libero: non blocca
+  return ESP_OK;
+}
+
+static int async_workers_busy() {
+  return g_async_idle ? ASYNC_WORKERS - (int)uxSemaphoreGetCount(g_async_idle) : 0;
+}
+
+// ---- MJPEG stream (fps per client + backpressure + stop controllato) ----
 #define PART_BOUNDARY "frame"
 static const char* STREAM_CONTENT_TYPE = "multipart/x-mixed-replace;boundary=" PART_BOUNDARY;
 static const char* STREAM_BOUNDARY = "\r\n--" PART_BOUNDARY "\r\n";
 static const char* STREAM_PART = "Content-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n";
 
-static esp_err_t mjpeg_handler(httpd_req_t *req) {
-  httpd_resp_set_type(req, STREAM_CONTENT_TYPE);
-  set_common_headers(req);
+static const int STREAM_FPS_DEFAULT = 5;
+static const int STREAM_FPS_MAX     = 30;
+#define MAX_STREAM_CLIENTS 4
+static_assert(HTTPD_OPEN_SOCKETS >= MAX_STREAM_CLIENTS + 2, "socket httpd: stream pieni e nessuna pagina");
+
+// Stato per client (mostrato in /status e /api/streams)
+struct StreamClient {
+  bool     used;
+  int      fd;
+  char     ip[16];
+  int      fps;
+  uint32_t started_ms;
+  uint32_t frames_sent;
+  uint32_t frames_skipped;  // slot saltati perché il socket era indietro
+  uint32_t lat_last_ms;     // glass-to-glass: cattura sensore -> fine invio
+  uint32_t lat_avg_ms;      // media mobile (1/8)
+  uint32_t lat_max_ms;
+};
+
+static StreamClient g_stream_clients[MAX_STREAM_CLIENTS];
+static portMUX_TYPE g_stream_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void peer_ip(int fd, char* out, size_t outlen) {
+  snprintf(out, outlen, "?");
+  struct sockaddr_in6 addr;
+  socklen_t alen = sizeof(addr);
+  if (fd < 0 || getpeername(fd, (struct sockaddr*)&addr, &alen) != 0) return;
+  if (addr.sin6_family == AF_INET) {
+    const uint8_t* b = (const uint8_t*)&((struct sockaddr_in*)&addr)->sin_addr.s_addr;
+    snprintf(out, outlen, "%u.%u.%u.%u", b[0], b[1], b[2], b[3]);
+  } else {
+    // IPv4-mapped (::ffff:a.b.c.d)
+    const uint8_t* b = addr.sin6_addr.s6_addr;
+    snprintf(out, outlen, "%u.%u.%u.%u", b[12], b[13], b[14], b[15]);
+  }
+}
 
-  char part_buf[64];
-  uint32_t last_frame_ms = 0;
+static int stream_client_open(int fd, int fps) {
+  int slot = -1;
+  portENTER_CRITICAL(&g_stream_mux);
+  for (int i = 0; i < MAX_STREAM_CLIENTS; i++) {
+    if (!g_stream_clients[i].used) {
+      memset(&g_stream_clients[i], 0, sizeof(StreamClient));
+      g_stream_clients[i].used = true;
+      g_stream_clients[i].fd = fd;
+      g_stream_clients[i].fps = fps;
+      g_stream_clients[i].started_ms = millis();
+      slot = i;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&g_stream_mux);
+  if (slot >= 0) peer_ip(fd, g_stream_clients[slot].ip, sizeof(g_stream_clients[slot].ip));
+  return slot;
+}
 
-  stream_active = true;
+static void stream_client_close(int slot) {
+  if (slot < 0) return;
+  portENTER_CRITICAL(&g_stream_mux);
+  g_stream_clients[slot].used = false;
+  portEXIT_CRITICAL(&g_stream_mux);
+}
 
+static void stream_client_frame(int slot, uint32_t lat_ms) {
+  if (slot < 0) return;
+  portENTER_CRITICAL(&g_stream_mux);
+  StreamClient& c = g_stream_clients[slot];
+  c.frames_sent++;
+  c.lat_last_ms = lat_ms;
+  c.lat_avg_ms = c.frames_sent == 1 ? lat_ms : (c.lat_avg_ms * 7 + lat_ms) / 8;
+  if (lat_ms > c.lat_max_ms) c.lat_max_ms = lat_ms;
+  portEXIT_CRITICAL(&g_stream_mux);
+}
 
-// Stream leggero: forza QVGA + qualità più compressa per evitare OOM quando l'utente imposta risoluzioni alte
-sensor_t* s = esp_camera_sensor_get();
-framesize_t old_fs = FRAMESIZE_QVGA;
-int old_q = 30;
-if (s) {
-  old_fs = s->status.framesize;
-  old_q  = s->status.quality;
-  s->set_framesize(s, FRAMESIZE_QVGA);
-  // qualità: numero più alto = più compressione (file più piccoli)
-  int q = old_q;
-  if (q < 30) q = 30;
-  s->set_quality(s, q);
+static void stream_client_skip(int slot, uint32_t n) {
+  if (slot < 0 || n == 0) return;
+  portENTER_CRITICAL(&g_stream_mux);
+  g_stream_clients[slot].frames_skipped += n;
+  portEXIT_CRITICAL(&g_stream_mux);
 }
 
-  while (stream_active) {
-    uint32_t now = millis();
-    if (now - last_frame_ms < 200) {
-      vTaskDelay(pdMS_TO_TICKS(10));
+static int stream_client_count() {
+  int n = 0;
+  portENTER_CRITICAL(&g_stream_mux);
+  for (int i = 0; i < MAX_STREAM_CLIENTS; i++) if (g_stream_clients[i].used) n++;
+  portEXIT_CRITICAL(&g_stream_mux);
+  return n;
+}
+
+// true se il buffer di invio lwIP ha spazio (select "writable" = sotto la soglia low-water)
+static bool sock_wait_writable(int fd, uint32_t timeout_ms) {
+  if (fd < 0) return true;
+  fd_set wfds;
+  FD_ZERO(&wfds);
+  FD_SET(fd, &wfds);
+  struct timeval tv;
+  tv.tv_sec  = timeout_ms / 1000;
+  tv.tv_usec = (timeout_ms % 1000) * 1000;
+  return select(fd + 1, NULL, &wfds, NULL, &tv) > 0;
+}
+
+static esp_err_t mjpeg_handler(httpd_req_t *req) {
+  if (!on_async_worker()) return async_submit(req, mjpeg_handler);
+
+  int fps = STREAM_FPS_DEFAULT;
+  char qs[48];
+  if (httpd_req_get_url_query_str(req, qs, sizeof(qs)) == ESP_OK) {
+    char param[8];
+    if (httpd_query_key_value(qs, "fps", param, sizeof(param)) == ESP_OK) fps = atoi(param);
+  }
+  if (fps < 1) fps = 1;
+  if (fps > STREAM_FPS_MAX) fps = STREAM_FPS_MAX;
+  const int64_t period_us = 1000000LL / fps;
+
+  // Stream leggero di default: QVGA + qualità più compressa (evita OOM a risoluzioni alte)
+  framesize_t fs = FRAMESIZE_QVGA;
+  int q = bc_get_jpeg_quality();
+  if (q < 30) q = 30;
+  parse_fs_q(req, &fs, &q);
+  if (!cam_arb_fits(fs)) return send_cam_error(req, CAM_ERR_TOO_LARGE, fs);
+
+  int fd = httpd_req_to_sockfd(req);
+  int slot = stream_client_open(fd, fps);
+  if (slot < 0) {
+    return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Too many stream clients");
+  }
+  int arb = cam_arb_stream_join(fs, q);
+
+  httpd_resp_set_type(req, STREAM_CONTENT_TYPE);
+  set_common_headers(req);
+
+  char part_buf[64];
+  int64_t next_due_us = esp_timer_get_time();
+
+  // esce su errore di invio (client chiuso) o di cattura
+  for (;;) {
+    int64_t now_us = esp_timer_get_time();
+    if (now_us < next_due_us) {
+      uint32_t wait_ms = (uint32_t)((next_due_us - now_us) / 1000);
+      vTaskDelay(pdMS_TO_TICKS(wait_ms > 10 ? 10 : (wait_ms ? wait_ms : 1)));
       continue;
     }
-    last_frame_ms = now;
 
-    if (g_cam_mutex) xSemaphoreTake(g_cam_mutex, portMAX_DELAY);
-    camera_fb_t *fb = esp_camera_fb_get();
-    if (!fb) {
-      if (g_cam_mutex) xSemaphoreGive(g_cam_mutex);
-      break;
+    // Backpressure: se il socket non ha ancora smaltito il frame precedente
+    // saltiamo lo slot invece di accodare un altro frame dentro lwIP.
+    if (!sock_wait_writable(fd, 0)) {
+      stream_client_skip(slot, 1);
+      uint32_t wait_ms = (uint32_t)(period_us / 1000);
+      if (!sock_wait_writable(fd, wait_ms ? wait_ms : 1)) {
+        next_due_us = esp_timer_get_time() + period_us;
+      } else {
+        next_due_us = esp_timer_get_time(); // appena libero: frame più fresco, subito
+      }
+      continue;
     }
 
+    // CAMERA_GRAB_LATEST: il driver restituisce sempre l'ultimo frame completo
+    cam_frame_t f;
+    cam_result_t r = cam_arb_grab(CAM_PROFILE_STREAM, fs, q, &f, (uint32_t)(period_us / 1000) + 1);
+    if (r == CAM_ERR_BUSY) {
+      // sensore occupato (es. cattura PIR): slot perso, non fermiamo lo stream
+      stream_client_skip(slot, 1);
+      next_due_us = esp_timer_get_time() + period_us;
+      continue;
+    }
+    if (r != CAM_OK) break;
+
     esp_err_t res = httpd_resp_send_chunk(req, STREAM_BOUNDARY, strlen(STREAM_BOUNDARY));
     if (res == ESP_OK) {
-      int hlen = snprintf(part_buf, sizeof(part_buf), STREAM_PART, (unsigned)fb->len);
+      int hlen = snprintf(part_buf, sizeof(part_buf), STREAM_PART, (unsigned)f.len);
       res = httpd_resp_send_chunk(req, part_buf, hlen);
     }
     if (res == ESP_OK) {
-      res = httpd_resp_send_chunk(req, (const char*)fb->buf, fb->len);
+      res = httpd_resp_send_chunk(req, (const char*)f.buf, f.len);
     }
 
-    esp_camera_fb_return(fb);
-    if (g_cam_mutex) xSemaphoreGive(g_cam_mutex);
+    int64_t captured_us = f.ts_us;
+    uint32_t sent = (uint32_t)f.len;
+    cam_arb_release(&f);
 
     if (res != ESP_OK) break;
-  }
 
-// ripristina impostazioni sensore
-{
-  sensor_t* s = esp_camera_sensor_get();
-  if (s) {
-    s->set_framesize(s, old_fs);
-    s->set_quality(s, old_q);
+    // Pacing guidato dal completamento dell'invio: se l'invio ha sforato
+    // uno o più slot, quei frame sono persi (non recuperati a raffica).
+    int64_t done_us = esp_timer_get_time();
+    if (captured_us > 0 && done_us > captured_us) {
+      uint32_t lat_ms = (uint32_t)((done_us - captured_us) / 1000);
+      stream_client_frame(slot, lat_ms);
+      bc_radio_stream_frame(lat_ms, sent);
+    }
+    next_due_us += period_us;
+    if (next_due_us < done_us) {
+      stream_client_skip(slot, (uint32_t)((done_us - next_due_us) / period_us));
+      next_due_us = done_us;
+    }
   }
-}
 
-  stream_active = false;
+  cam_arb_stream_leave(arb);
+  stream_client_close(slot);
   httpd_resp_send_chunk(req, NULL, 0);
   return ESP_OK;
 }
 
-// snapshot dal ring (n=0 ultimo, 1 precedente, etc.)
-static esp_err_t snap_n_handler(httpd_req_t *req) {
+// Statistiche stream per client (JSON)
+static esp_err_t api_streams_handler(httpd_req_t *req) {
+  httpd_resp_set_type(req, "application/json");
+  set_common_headers(req);
+
+  StreamClient snap[MAX_STREAM_CLIENTS];
+  portENTER_CRITICAL(&g_stream_mux);
+  memcpy(snap, g_stream_clients, sizeof(snap));
+  portEXIT_CRITICAL(&g_stream_mux);
+
+  uint32_t now = millis();
+  httpd_resp_sendstr_chunk(req, "[");
+  bool first = true;
+  for (int i = 0; i < MAX_STREAM_CLIENTS; i++) {
+    if (!snap[i].used) continue;
+    char item[256];
+    snprintf(item, sizeof(item),
+      "%s{\"ip\":\"%s\",\"fps\":%d,\"uptime_s\":%lu,\"sent\":%lu,\"skipped\":%lu,"
+      "\"latency_ms\":{\"last\":%lu,\"avg\":%lu,\"max\":%lu}}",
+      first ? "" : ",", snap[i].ip, snap[i].fps,
+      (unsigned long)((now - snap[i].started_ms) / 1000),
+      (unsigned long)snap[i].frames_sent, (unsigned long)snap[i].frames_skipped,
+      (unsigned long)snap[i].lat_last_ms, (unsigned long)snap[i].lat_avg_ms, (unsigned long)snap[i].lat_max_ms
+    );
+    httpd_resp_sendstr_chunk(req, item);
+    first = false;
+  }
+  httpd_resp_sendstr_chunk(req, "]");
+  return httpd_resp_sendstr_chunk(req, NULL);
+}
+
+// Politica radio per modalità: tempo, corrente media stimata, latenza stream
+// e salute della connessione MQTT (quota connessa, cadute)
+static esp_err_t api_radio_handler(httpd_req_t *req) {
+  httpd_resp_set_type(req, "application/json");
+  set_common_headers(req);
+
+  radio_policy_t r = *bc_get_radio();
+  char item[320];
+  snprintf(item, sizeof(item),
+    "{\"mode\":\"%s\",\"mode_s\":%lu,\"flushing\":%s,\"bursts\":%lu,\"transitions\":%lu,"
+    "\"listen_interval\":%u,\"batch_ms\":%lu,\"avg_ma\":%lu,\"modes\":{",
+    radio_mode_name(r.mode), (unsigned long)((millis() - r.mode_since_ms) / 1000),
+    r.flushing ? "true" : "false", (unsigned long)r.bursts, (unsigned long)r.transitions,
+    (unsigned)r.cfg.listen_interval, (unsigned long)r.cfg.batch_ms,
+    (unsigned long)radio_avg_ma(&r, RADIO_MODE_COUNT));
+  httpd_resp_sendstr_chunk(req, item);
+  for (int m = 0; m < RADIO_MODE_COUNT; m++) {
+    const radio_mode_stats_t& s = r.st[m];
+    snprintf(item, sizeof(item),
+      "%s\"%s\":{\"time_s\":%lu,\"entries\":%lu,\"avg_ma\":%lu,\"tx_kb\":%lu,"
+      "\"stream_latency_ms\":{\"frames\":%lu,\"avg\":%lu,\"max\":%lu},"
+      "\"mqtt\":{\"up_pct\":%lu,\"drops\":%lu}}",
+      m ? "," : "", radio_mode_name((radio_mode_t)m),
+      (unsigned long)(s.time_ms / 1000), (unsigned long)s.entries,
+      (unsigned long)radio_avg_ma(&r, m), (unsigned long)(s.tx_bytes / 1024),
+      (unsigned long)s.lat_frames, (unsigned long)(s.lat_frames ? s.lat_sum_ms / s.lat_frames : 0),
+      (unsigned long)s.lat_max_ms,
+      (unsigned long)(s.time_ms ? (uint64_t)s.mqtt_up_ms * 100 / s.time_ms : 0),
+      (unsigned long)s.mqtt_drops);
+    httpd_resp_sendstr_chunk(req, item);
+  }
+  httpd_resp_sendstr_chunk(req, "}}");
+  return httpd_resp_sendstr_chunk(req, NULL);
+}
+
+// Istogramma di luma per la diagnostica dell'esposizione (?fs=&q= come /snapshot).
+// Dal JPEG decodificato a 1/8: ogni campione è la media di un blocco 8x8,
+// quindi le piccole zone bruciate contano meno che nel frame pieno.
+static esp_err_t api_histogram_handler(httpd_req_t *req) {
+  framesize_t fs = (framesize_t)bc_get_framesize();
+  if (cam_fs_area(fs) > cam_fs_area(FRAMESIZE_VGA)) fs = FRAMESIZE_VGA;
+  if (!cam_arb_fits(fs)) fs = cam_arb_fb_max();
+  int q = bc_get_jpeg_quality();
+  if (q < 30) q = 30;
+  parse_fs_q(req, &fs, &q);
+  if (!cam_arb_fits(fs)) return send_cam_error(req, CAM_ERR_TOO_LARGE, fs);
+
+  cam_cached_t c;
+  cam_result_t r = cam_cache_get(fs, q, (uint32_t)bc_get_snapshot_max_age_ms(), &c, 3000);
+  if (r != CAM_OK) return send_cam_error(req, r, fs);
+  int w = 0, h = 0;
+  uint8_t* rgb = cam_decode_8x(c.blob->data, c.blob->len, c.width, c.height, &w, &h);
+  cam_cache_release(&c);
+  if (!rgb) return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "decode failed");
+
+  // luma sul posto: il buffer RGB565 è lungo il doppio
+  size_t n = (size_t)w * h;
+  uint32_t* hist = (uint32_t*)malloc(256 * sizeof(uint32_t));
+  if (hist) {
+    kern_luma(rgb, n, rgb);
+    kern_histogram(rgb, n, hist);
+  }
+  free(rgb);
+  if (!hist) return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "out of memory");
+
+  uint64_t sum = 0;
+  uint32_t dark = 0, bright = 0;
+  for (int i = 0; i < 256; i++) {
+    sum += (uint64_t)hist[i] * i;
+    if (i < 16) dark += hist[i];
+    if (i >= 240) bright += hist[i];
+  }
+
+  httpd_resp_set_type(req, "application/json");
+  set_common_headers(req);
+  char item[160];
+  snprintf(item, sizeof(item),
+    "{\"width\":%d,\"height\":%d,\"mean\":%lu,\"dark_pct\":%lu,\"bright_pct\":%lu,\"bins\":[",
+    w, h, (unsigned long)(n ? sum / n : 0),
+    (unsigned long)(n ? dark * 100 / n : 0), (unsigned long)(n ? bright * 100 / n : 0));
+  httpd_resp_sendstr_chunk(req, item);
+  for (int i = 0; i < 256; i += 16) {
+    int o = 0;
+    for (int k = i; k < i + 16; k++) {
+      o += snprintf(item + o, sizeof(item) - o, "%s%lu", k ? "," : "", (unsigned long)hist[k]);
+    }
+    httpd_resp_sendstr_chunk(req, item);
+  }
+  free(hist);
+  httpd_resp_sendstr_chunk(req, "]}");
+  return httpd_resp_sendstr_chunk(req, NULL);
+}
+
+static uint32_t cycle_count() { return ESP.getCycleCount(); }
+
+// Benchmark dei kernel (birdcam_kernels) su un'immagine sintetica ?w=&h=
+// (default 320x240): cicli per pixel di riferimento e versione veloce,
+// exact = uscite identiche bit per bit
+static esp_err_t api_kernels_handler(httpd_req_t *req) {
+  // a VGA il benchmark dura secondi: sul task httpd bloccherebbe tutto il resto
+  if (!on_async_worker()) return async_submit(req, api_kernels_handler);
+  int w = 320, h = 240;
   char qs[32];
-  int n = 0;
   if (httpd_req_get_url_query_str(req, qs, sizeof(qs)) == ESP_OK) {
     char param[8];
+    if (httpd_query_key_value(qs, "w", param, sizeof(param)) == ESP_OK) w = atoi(param);
+    if (httpd_query_key_value(qs, "h", param, sizeof(param)) == ESP_OK) h = atoi(param);
+  }
+  if (w < 16) w = 16;
+  if (w > 640) w = 640;
+  if (h < 16) h = 16;
+  if (h > 480) h = 480;
+
+  kern_bench_t b[KERN_BENCH_COUNT];
+  int n = kern_bench(cycle_count, w, h, b, KERN_BENCH_COUNT);
+  if (!n) return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "out of memory");
+
+  httpd_resp_set_type(req, "application/json");
+  set_common_headers(req);
+  char item[160];
+  snprintf(item, sizeof(item), "{\"cpu_mhz\":%lu,\"width\":%d,\"height\":%d,\"kernels\":[",
+           (unsigned long)getCpuFrequencyMhz(), w, h);
+  httpd_resp_sendstr_chunk(req, item);
+  for (int i = 0; i < n; i++) {
+    snprintf(item, sizeof(item),
+      "%s{\"name\":\"%s\",\"ref_cycles_px\":%.2f,\"fast_cycles_px\":%.2f,\"exact\":%s}",
+      i ? "," : "", b[i].name, (double)b[i].ref_cycles / b[i].pixels,
+      (double)b[i].fast_cycles / b[i].pixels, b[i].exact ? "true" : "false");
+    httpd_resp_sendstr_chunk(req, item);
+  }
+  httpd_resp_sendstr_chunk(req, "]}");
+  return httpd_resp_sendstr_chunk(req, NULL);
+}
+
+// ?id=<capture id> (stabile) oppure ?n= (0 ultimo, 1 precedente, ...): snapshot pinnato
+static bool snap_from_query(httpd_req_t *req, bc_snap_ref_t* ref, int* n_out) {
+  char qs[48];
+  int n = 0;
+  uint32_t id = 0;
+  if (httpd_req_get_url_query_str(req, qs, sizeof(qs)) == ESP_OK) {
+    char param[12];
     if (httpd_query_key_value(qs, "n", param, sizeof(param)) == ESP_OK) n = atoi(param);
+    if (httpd_query_key_value(qs, "id", param, sizeof(param)) == ESP_OK) id = (uint32_t)strtoul(param, nullptr, 10);
   }
+  if (n_out) *n_out = n;
+  return id ? bc_find_snapshot(id, ref) : bc_get_snapshot(n, ref);
+}
 
-  const uint8_t *data = nullptr;
-  size_t len = 0;
-  time_t ts = 0;
-  if (!bc_get_snapshot(n, &data, &len, &ts)) {
+static esp_err_t snap_n_handler(httpd_req_t *req) {
+  bc_snap_ref_t ref;
+  if (!snap_from_query(req, &ref, nullptr)) {
     return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No snapshot");
   }
 
   httpd_resp_set_type(req, "image/jpeg");
   set_common_headers(req);
-  return httpd_resp_send(req, (const char*)data, len);
+  esp_err_t res = httpd_resp_send(req, (const char*)ref.blob->data, ref.blob->len);
+  bc_snap_release(&ref, 1);
+  return res;
 }
 
-// Pagina HTML “foto grande” (per evitare la sensazione di pagina nera)
-static esp_err_t photo_handler(httpd_req_t *req) {
-  char qs[32];
-  int n = 0;
-  if (httpd_req_get_url_query_str(req, qs, sizeof(qs)) == ESP_OK) {
-    char param[8];
-    if (httpd_query_key_value(qs, "n", param, sizeof(param)) == ESP_OK) n = atoi(param);
+// Miniatura creata alla cattura (se manca, l'originale: già piccolo o non ancora pronta)
+static esp_err_t thumb_handler(httpd_req_t *req) {
+  bc_snap_ref_t ref;
+  if (!snap_from_query(req, &ref, nullptr)) {
+    return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No snapshot");
   }
+  const bc_blob_t* b = ref.thumb ? ref.thumb : ref.blob;
 
-  const uint8_t *data = nullptr;
-  size_t len = 0;
-  time_t ts = 0;
-  if (!bc_get_snapshot(n, &data, &len, &ts)) {
+  httpd_resp_set_type(req, "image/jpeg");
+  set_common_headers(req);
+  esp_err_t res = httpd_resp_send(req, (const char*)b->data, b->len);
+  bc_snap_release(&ref, 1);
+  return res;
+}
+
+// Pagina HTML “foto grande” (per evitare la sensazione di pagina nera)
+static esp_err_t photo_handler(httpd_req_t *req) {
+  bc_snap_ref_t ref;
+  if (!snap_from_query(req, &ref, nullptr)) {
     return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No snapshot");
   }
+  time_t ts = ref.ts;
+  uint32_t id = ref.id;
+  bc_snap_release(&ref, 1);
 
   char tsbuf[32];
   format_ts(ts, tsbuf, sizeof(tsbuf));
@@ -284,21 +718,21 @@ static esp_err_t photo_handler(httpd_req_t *req) {
   snprintf(hdr, sizeof(hdr),
     "<div class='wrap'><div class='card'>"
     "<div style='display:flex;justify-content:space-between;align-items:baseline;gap:10px;flex-wrap:wrap'>"
-    "<div style='font-weight:bold;letter-spacing:.3px'>SNAPSHOT #%d</div>"
+    "<div style='font-weight:bold;letter-spacing:.3px'>SNAPSHOT #%lu</div>"
     "<div style='opacity:.9;font-size:.95em'>%s</div>"
-    "</div><hr>", n, tsbuf
+    "</div><hr>", (unsigned long)id, tsbuf
   );
   httpd_resp_sendstr_chunk(req, hdr);
 
   char body[640];
   snprintf(body, sizeof(body),
     "<div class='media frame' style='width:100%%;max-width:1024px;background:#000'>"
-      "<img src='/snap?n=%d' style='width:100%%;height:auto;display:block'>"
+      "<img src='/snap?id=%lu' style='width:100%%;height:auto;display:block'>"
     "</div>"
     "<div style='margin-top:12px;opacity:.9'>"
       "<a href='/archive' style='text-decoration:underline'>← Back to gallery</a>"
     "</div>"
-    "</div></div></body></html>", n
+    "</div></div></body></html>", (unsigned long)id
   );
   httpd_resp_sendstr_chunk(req, body);
   return httpd_resp_sendstr_chunk(req, NULL);
@@ -322,13 +756,18 @@ static esp_err_t archive_handler(httpd_req_t *req) {
     return httpd_resp_sendstr_chunk(req, NULL);
   }
 
+  httpd_resp_sendstr_chunk(req,
+    "<div style='margin-bottom:12px;opacity:.9'>Download all: "
+    "<a href='/archive.zip' style='text-decoration:underline'>zip</a> · "
+    "<a href='/archive.tar' style='text-decoration:underline'>tar</a></div>");
   httpd_resp_sendstr_chunk(req, "<div style='display:flex;flex-wrap:wrap;gap:12px'>");
 
   for (int i = 0; i < count && i < keep; i++) {
-    const uint8_t *data = nullptr;
-    size_t len = 0;
-    time_t ts = 0;
-    if (!bc_get_snapshot(i, &data, &len, &ts)) continue;
+    bc_snap_ref_t ref;
+    if (!bc_get_snapshot(i, &ref)) continue;
+    time_t ts = ref.ts;
+    uint32_t id = ref.id;
+    bc_snap_release(&ref, 1);
 
     char tsbuf[32];
     format_ts(ts, tsbuf, sizeof(tsbuf));
@@ -336,14 +775,14 @@ static esp_err_t archive_handler(httpd_req_t *req) {
     char card[700];
     snprintf(card, sizeof(card),
       "<div class='card' style='width:210px;padding:10px'>"
-        "<a href='/photo?n=%d'>"
+        "<a href='/photo?id=%lu'>"
           "<div class='media frame' style='width:190px;height:140px;background:#000'>"
-            "<img src='/snap?n=%d' style='width:190px;height:140px;object-fit:cover;display:block'>"
+            "<img src='/thumb?id=%lu' loading='lazy' style='width:190px;height:140px;object-fit:cover;display:block'>"
           "</div>"
         "</a>"
         "<div style='margin-top:8px;font-size:12px;opacity:.9'>%s</div>"
       "</div>",
-      i, i, tsbuf
+      (unsigned long)id, (unsigned long)id, tsbuf
     );
     httpd_resp_sendstr_chunk(req, card);
   }
@@ -352,6 +791,240 @@ static esp_err_t archive_handler(httpd_req_t *req) {
   return httpd_resp_sendstr_chunk(req, NULL);
 }
 
+// /api/events?since=<id cattura>&max=16: eventi PIR con catture più nuove del
+// cursore, dal più vecchio. "next" è il cursore per la chiamata successiva,
+// "new" gli id oltre since di ogni evento, "oldest" la cattura più vecchia
+// ancora scaricabile (/snap?id=).
+static esp_err_t api_events_handler(httpd_req_t *req) {
+  uint32_t since = 0;
+  int max = 16;
+  char qs[48];
+  if (httpd_req_get_url_query_str(req, qs, sizeof(qs)) == ESP_OK) {
+    char v[12];
+    if (httpd_query_key_value(qs, "since", v, sizeof(v)) == ESP_OK) since = (uint32_t)strtoul(v, nullptr, 10);
+    if (httpd_query_key_value(qs, "max", v, sizeof(v)) == ESP_OK) max = atoi(v);
+  }
+  if (max < 1) max = 1;
+  if (max > EV_MAX) max = EV_MAX;
+
+  ev_event_t ev[EV_MAX];
+  int n = bc_get_events(since, ev, max);
+  uint32_t oldest = 0, newest = 0;
+  bc_get_capture_range(&oldest, &newest);
+  uint32_t next = n ? ev[n - 1].last_id : since;
+
+  httpd_resp_set_type(req, "application/json");
+  set_common_headers(req);
+  char item[480];
+  snprintf(item, sizeof(item), "{\"next\":%lu,\"more\":%s,\"oldest\":%lu,\"newest\":%lu,\"events\":[",
+           (unsigned long)next, newest > next ? "true" : "false", (unsigned long)oldest, (unsigned long)newest);
+  httpd_resp_sendstr_chunk(req, item);
+  for (int i = 0; i < n; i++) {
+    if (i) httpd_resp_sendstr_chunk(req, ",");
+    if (ev_format_json(&ev[i], since + 1, item, sizeof(item))) httpd_resp_sendstr_chunk(req, item);
+    else httpd_resp_sendstr_chunk(req, "null");
+  }
+  httpd_resp_sendstr_chunk(req, "]}");
+  return httpd_resp_sendstr_chunk(req, NULL);
+}
+
+// =================== EXPORT (tar / zip) ===================
+// /archive.tar, /archive.zip (?since=<epoch>): gli snapshot vengono pinnati
+// all'inizio, quindi il download è coerente anche se nel frattempo arrivano
+// nuove catture. Header generati al volo, dati inviati dai buffer pinnati.
+static const uint8_t ZEROS[TAR_BLOCK] = {0};
+
+static int export_pin(httpd_req_t *req, bc_snap_ref_t* refs, int max) {
+  time_t since = 0;
+  char qs[48];
+  if (httpd_req_get_url_query_str(req, qs, sizeof(qs)) == ESP_OK) {
+    char v[16];
+    if (httpd_query_key_value(qs, "since", v, sizeof(v)) == ESP_OK) since = (time_t)atol(v);
+  }
+  return bc_pin_snapshots(refs, max, since);
+}
+
+static void export_headers(httpd_req_t *req, const char* type, const char* ext) {
+  char disp[80];
+  char d[20] = "archive";
+  time_t now = time(nullptr);
+  if (now > 1700000000) {   // ora valida (NTP)
+    struct tm t;
+    localtime_r(&now, &t);
+    strftime(d, sizeof(d), "%Y%m%d_%H%M", &t);
+  }
+  snprintf(disp, sizeof(disp), "attachment; filename=birdcam_%s.%s", d, ext);
+  httpd_resp_set_type(req, type);
+  httpd_resp_set_hdr(req, "Content-Disposition", disp);
+  set_common_headers(req);
+}
+
+static esp_err_t archive_tar_handler(httpd_req_t *req) {
+  if (!on_async_worker()) return async_submit(req, archive_tar_handler);
+
+  bc_snap_ref_t refs[20];
+  int n = export_pin(req, refs, 20);
+  export_headers(req, "application/x-tar", "tar");
+
+  esp_err_t res = ESP_OK;
+  uint8_t hdr[TAR_BLOCK];
+  char name[40];
+  for (int i = 0; i < n && res == ESP_OK; i++) {
+    uint32_t len = (uint32_t)refs[i].blob->len;
+    export_snap_name(name, sizeof(name), refs[i].id, refs[i].ts);
+    tar_write_header(hdr, name, len, refs[i].ts);
+    res = httpd_resp_send_chunk(req, (const char*)hdr, TAR_BLOCK);
+    if (res == ESP_OK) res = httpd_resp_send_chunk(req, (const char*)refs[i].blob->data, len);
+    uint32_t pad = tar_pad_len(len);
+    if (res == ESP_OK && pad) res = httpd_resp_send_chunk(req, (const char*)ZEROS, pad);
+  }
+  // fine archivio: due blocchi vuoti
+  if (res == ESP_OK) res = httpd_resp_send_chunk(req, (const char*)ZEROS, TAR_BLOCK);
+  if (res == ESP_OK) res = httpd_resp_send_chunk(req, (const char*)ZEROS, TAR_BLOCK);
+
+  bc_snap_release(refs, n);
+  if (res != ESP_OK) return res;
+  return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+static esp_err_t archive_zip_handler(httpd_req_t *req) {
+  if (!on_async_worker()) return async_submit(req, archive_zip_handler);
+
+  bc_snap_ref_t refs[20];
+  int n = export_pin(req, refs, 20);
+  export_headers(req, "application/zip", "zip");
+
+  esp_err_t res = ESP_OK;
+  uint8_t hdr[ZIP_CENTRAL_LEN + 40];
+  char name[40];
+  uint32_t offsets[20];
+  uint32_t off = 0;
+
+  for (int i = 0; i < n && res == ESP_OK; i++) {
+    uint32_t len = (uint32_t)refs[i].blob->len;
+    export_snap_name(name, sizeof(name), refs[i].id, refs[i].ts);
+    size_t hl = zip_write_local(hdr, name, len, refs[i].crc, refs[i].ts);
+    offsets[i] = off;
+    res = httpd_resp_send_chunk(req, (const char*)hdr, hl);
+    if (res == ESP_OK) res = httpd_resp_send_chunk(req, (const char*)refs[i].blob->data, len);
+    off += (uint32_t)hl + len;
+  }
+
+  uint32_t cd_off = off;
+  for (int i = 0; i < n && res == ESP_OK; i++) {
+    export_snap_name(name, sizeof(name), refs[i].id, refs[i].ts);
+    size_t hl = zip_write_central(hdr, name, (uint32_t)refs[i].blob->len, refs[i].crc, refs[i].ts, offsets[i]);
+    res = httpd_resp_send_chunk(req, (const char*)hdr, hl);
+    off += (uint32_t)hl;
+  }
+  if (res == ESP_OK) {
+    size_t hl = zip_write_end(hdr, (uint16_t)n, off - cd_off, cd_off);
+    res = httpd_resp_send_chunk(req, (const char*)hdr, hl);
+  }
+
+  bc_snap_release(refs, n);
+  if (res != ESP_OK) return res;
+  return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// =================== TIMELAPSE ===================
+// /timelapse.avi?fps=10&since=<epoch>: MJPEG-AVI costruito al volo attorno
+// ai JPEG del ring timelapse (pinnati, inviati senza copie né transcodifica)
+static esp_err_t timelapse_avi_handler(httpd_req_t *req) {
+  if (!on_async_worker()) return async_submit(req, timelapse_avi_handler);
+
+  int fps = 10;
+  time_t since = 0;
+  char qs[64];
+  if (httpd_req_get_url_query_str(req, qs, sizeof(qs)) == ESP_OK) {
+    char v[16];
+    if (httpd_query_key_value(qs, "fps", v, sizeof(v)) == ESP_OK) fps = atoi(v);
+    if (httpd_query_key_value(qs, "since", v, sizeof(v)) == ESP_OK) since = (time_t)atol(v);
+  }
+  if (fps < 1) fps = 1;
+  if (fps > 60) fps = 60;
+
+  tl_frame_t* frames = (tl_frame_t*)heap_caps_malloc(sizeof(tl_frame_t) * TL_MAX_FRAMES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (!frames) return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "no memory");
+  int n = tl_pin(frames, TL_MAX_FRAMES, since);
+  if (n <= 0) {
+    heap_caps_free(frames);
+    return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No timelapse frames");
+  }
+
+  // un AVI ha una sola risoluzione: vale quella dell'ultimo frame
+  avi_info_t info = {};
+  info.width = frames[n - 1].width;
+  info.height = frames[n - 1].height;
+  info.fps = (uint32_t)fps;
+  for (int i = 0; i < n; i++) {
+    const tl_frame_t& f = frames[i];
+    if (f.width != info.width || f.height != info.height) continue;
+    uint32_t len = (uint32_t)f.blob->len;
+    info.frames++;
+    info.frames_bytes += len;
+    if (len & 1) info.odd_frames++;
+    if (len > info.max_frame_len) info.max_frame_len = len;
+  }
+
+  char tsbuf[24] = "birdcam";
+  time_t t0 = frames[0].ts;
+  if (t0 > 0) {
+    struct tm tm0;
+    localtime_r(&t0, &tm0);
+    strftime(tsbuf, sizeof(tsbuf), "%Y%m%d_%H%M", &tm0);
+  }
+  char disp[80];
+  snprintf(disp, sizeof(disp), "inline; filename=timelapse_%s.avi", tsbuf);
+
+  httpd_resp_set_type(req, "video/x-msvideo");
+  httpd_resp_set_hdr(req, "Content-Disposition", disp);
+  set_common_headers(req);
+
+  uint8_t hdr[AVI_HEADER_LEN];
+  avi_write_header(hdr, &info);
+  esp_err_t res = httpd_resp_send_chunk(req, (const char*)hdr, sizeof(hdr));
+
+  static const char PAD = 0;
+  for (int i = 0; i < n && res == ESP_OK; i++) {
+    const tl_frame_t& f = frames[i];
+    if (f.width != info.width || f.height != info.height) continue;
+    uint8_t ch[AVI_CHUNK_HDR_LEN];
+    avi_write_chunk_header(ch, (uint32_t)f.blob->len);
+    res = httpd_resp_send_chunk(req, (const char*)ch, sizeof(ch));
+    if (res == ESP_OK) res = httpd_resp_send_chunk(req, (const char*)f.blob->data, f.blob->len);
+    if (res == ESP_OK && (f.blob->len & 1)) res = httpd_resp_send_chunk(req, &PAD, 1);
+  }
+
+  // idx1: 32 voci per chunk HTTP
+  if (res == ESP_OK) {
+    uint8_t ih[AVI_CHUNK_HDR_LEN];
+    avi_write_index_header(ih, info.frames);
+    res = httpd_resp_send_chunk(req, (const char*)ih, sizeof(ih));
+  }
+  uint8_t idx[32 * AVI_INDEX_ENTRY_LEN];
+  size_t fill = 0;
+  uint32_t off = 4;   // primo chunk subito dopo il fourcc 'movi'
+  for (int i = 0; i < n && res == ESP_OK; i++) {
+    const tl_frame_t& f = frames[i];
+    if (f.width != info.width || f.height != info.height) continue;
+    uint32_t len = (uint32_t)f.blob->len;
+    avi_write_index_entry(idx + fill, off, len);
+    fill += AVI_INDEX_ENTRY_LEN;
+    off += AVI_CHUNK_HDR_LEN + len + (len & 1);
+    if (fill == sizeof(idx)) {
+      res = httpd_resp_send_chunk(req, (const char*)idx, fill);
+      fill = 0;
+    }
+  }
+  if (res == ESP_OK && fill) res = httpd_resp_send_chunk(req, (const char*)idx, fill);
+
+  tl_unpin(frames, n);
+  heap_caps_free(frames);
+  if (res != ESP_OK) return res;
+  return httpd_resp_send_chunk(req, NULL, 0);
+}
+
 // =================== STATUS ===================
 static esp_err_t status_handler(httpd_req_t *req) {
   set_common_headers(req);
@@ -403,7 +1076,16 @@ static esp_err_t status_handler(httpd_req_t *req) {
     "<div class='pill'>PIR: %lu</div>"
     "<div class='pill'>STREAM: %s</div>",
     ssid.c_str(), mac.c_str(), ch, rssi, bootbuf,
-    (unsigned long)pir_count, stream_active ? "ON" : "OFF"
+    (unsigned long)pir_count, stream_client_count() > 0 ? "ON" : "OFF"
+  );
+  httpd_resp_sendstr_chunk(req, line);
+
+  uint32_t b_cam = 0, b_wifi = 0, b_ntp = 0, b_cap = 0;
+  bc_get_boot_metrics(&b_cam, &b_wifi, &b_ntp, &b_cap);
+  httpd_resp_sendstr_chunk(req, "<hr>");
+  snprintf(line, sizeof(line),
+    "<div style='opacity:.9'><b>BOOT</b> · camera %lu ms · Wi-Fi %lu ms · NTP %lu ms · first capture %lu ms</div>",
+    (unsigned long)b_cam, (unsigned long)b_wifi, (unsigned long)b_ntp, (unsigned long)b_cap
   );
   httpd_resp_sendstr_chunk(req, line);
 
@@ -414,6 +1096,42 @@ static esp_err_t status_handler(httpd_req_t *req) {
   );
   httpd_resp_sendstr_chunk(req, line);
 
+  const pwr_sm_t* pw = bc_get_power();
+  snprintf(line, sizeof(line),
+    "<div style='opacity:.9'><b>POWER</b> · %s · full %lus · modem %lus · light %lus · transitions %lu</div>",
+    pwr_state_name(pw->state),
+    (unsigned long)(pw->time_in_state_ms[PWR_FULL] / 1000),
+    (unsigned long)(pw->time_in_state_ms[PWR_MODEM_SLEEP] / 1000),
+    (unsigned long)(pw->time_in_state_ms[PWR_LIGHT_SLEEP] / 1000),
+    (unsigned long)pw->transitions
+  );
+  httpd_resp_sendstr_chunk(req, line);
+  const radio_policy_t* rp = bc_get_radio();
+  snprintf(line, sizeof(line),
+    "<div style='opacity:.9'><b>RADIO</b> · %s · ~%lu mA avg · none %lus · min %lus · max %lus · off %lus · "
+    "bursts %lu · mqtt drops %lu</div>",
+    radio_mode_name(rp->mode), (unsigned long)radio_avg_ma(rp, RADIO_MODE_COUNT),
+    (unsigned long)(rp->st[RADIO_PS_NONE].time_ms / 1000),
+    (unsigned long)(rp->st[RADIO_PS_MIN_MODEM].time_ms / 1000),
+    (unsigned long)(rp->st[RADIO_PS_MAX_MODEM].time_ms / 1000),
+    (unsigned long)(rp->st[RADIO_OFF].time_ms / 1000),
+    (unsigned long)rp->bursts,
+    (unsigned long)(rp->st[RADIO_PS_NONE].mqtt_drops + rp->st[RADIO_PS_MIN_MODEM].mqtt_drops +
+                    rp->st[RADIO_PS_MAX_MODEM].mqtt_drops + rp->st[RADIO_OFF].mqtt_drops)
+  );
+  httpd_resp_sendstr_chunk(req, line);
+  if (pw->ev_last.valid) {
+    const pwr_event_t& ev = pw->ev_last;
+    snprintf(line, sizeof(line),
+      "<div style='opacity:.9'>LAST EVENT · wake→capture %lu ms · store %lu ms · upload %lu ms · ~%lu mJ (events %lu)</div>",
+      (unsigned long)(ev.stage_us[PWR_STAGE_CAPTURE] / 1000),
+      (unsigned long)(ev.stage_us[PWR_STAGE_STORE] / 1000),
+      (unsigned long)(ev.stage_us[PWR_STAGE_UPLOAD] / 1000),
+      (unsigned long)(ev.energy_uj / 1000), (unsigned long)pw->events
+    );
+    httpd_resp_sendstr_chunk(req, line);
+  }
+
   httpd_resp_sendstr_chunk(req, "<hr>");
   snprintf(line, sizeof(line),
     "<div style='opacity:.9'><b>MEM</b> · HEAP %d%% free · PSRAM %d%% free</div>"
@@ -422,6 +1140,88 @@ static esp_err_t status_handler(httpd_req_t *req) {
   );
   httpd_resp_sendstr_chunk(req, line);
 
+  cam_arb_stats_t cs;
+  cam_arb_get_stats(&cs);
+  snprintf(line, sizeof(line),
+    "<div style='opacity:.9'>CAMERA · buffers %s ×%d · mode %s%s · streams %d · "
+    "mode flips %lu · downscaled %lu · rejected %lu · busy %lu · reinits %lu</div>",
+    cam_framesize_name(cs.fb_max), cs.fb_count, cam_framesize_name(cs.cur_fs), cs.cur_roi ? " (ROI)" : "", cs.streams,
+    (unsigned long)cs.mode_flips, (unsigned long)cs.downscaled,
+    (unsigned long)cs.rejected, (unsigned long)cs.busy, (unsigned long)cs.reinits
+  );
+  httpd_resp_sendstr_chunk(req, line);
+
+  uint32_t sc_captures = 0, sc_hits = 0;
+  cam_cache_get_stats(&sc_captures, &sc_hits);
+  snprintf(line, sizeof(line),
+    "<div style='opacity:.9'>SNAPSHOT CACHE · max age %d ms · captures %lu · served from cache %lu</div>",
+    bc_get_snapshot_max_age_ms(), (unsigned long)sc_captures, (unsigned long)sc_hits
+  );
+  httpd_resp_sendstr_chunk(req, line);
+
+  snprintf(line, sizeof(line),
+    "<div style='opacity:.9'>HTTP · streaming workers %d/%d busy · rejected %lu</div>",
+    async_workers_busy(), ASYNC_WORKERS, (unsigned long)g_async_rejected
+  );
+  httpd_resp_sendstr_chunk(req, line);
+
+  {
+    tl_stats_t ts;
+    tl_get_stats(&ts);
+    int ti = 0, tf = 0, tk = 0;
+    bc_get_timelapse(&ti, &tf, &tk);
+    snprintf(line, sizeof(line),
+      "<div style='opacity:.9'>TIMELAPSE · %s · every %d s · %s · frames %d/%d · %lu KB · "
+      "captured %lu · failed %lu · <a href='/timelapse.avi' style='text-decoration:underline'>download AVI</a></div>",
+      ti ? "ON" : "OFF", ti, cam_framesize_name((framesize_t)tf), ts.frames, tk,
+      (unsigned long)(ts.bytes / 1024), (unsigned long)ts.captured, (unsigned long)ts.failed
+    );
+    httpd_resp_sendstr_chunk(req, line);
+  }
+
+  {
+    scene_stats_t ss;
+    scene_get_stats(&ss);
+    int st = 0, sk = 0;
+    bc_get_scene(&st, &sk);
+    snprintf(line, sizeof(line),
+      "<div style='opacity:.9'>MQTT STREAM · threshold %d%% · keyframe %d s · published %lu · skipped %lu · "
+      "sent %lu KB · saved %lu KB · last change %d%%</div>",
+      st, sk, (unsigned long)ss.published, (unsigned long)ss.skipped,
+      (unsigned long)(ss.bytes_sent / 1024), (unsigned long)(ss.bytes_saved / 1024), ss.last_score
+    );
+    httpd_resp_sendstr_chunk(req, line);
+  }
+
+  {
+    rtsp_stats_t rs;
+    rtsp_get_stats(&rs);
+    if (!rs.listening) snprintf(line, sizeof(line), "<div style='opacity:.9'>RTSP · port %d · not listening</div>", RTSP_PORT);
+    else snprintf(line, sizeof(line),
+      "<div style='opacity:.9'>RTSP · port %d · sessions %d (playing %d) · frames %lu · packets %lu · "
+      "%lu KB · skipped %lu</div>",
+      RTSP_PORT, rs.sessions, rs.playing, (unsigned long)rs.frames, (unsigned long)rs.packets,
+      (unsigned long)(rs.bytes / 1024), (unsigned long)rs.skipped
+    );
+    httpd_resp_sendstr_chunk(req, line);
+  }
+
+  bool stream_hdr = false;
+  for (int i = 0; i < MAX_STREAM_CLIENTS; i++) {
+    portENTER_CRITICAL(&g_stream_mux);
+    StreamClient c = g_stream_clients[i];
+    portEXIT_CRITICAL(&g_stream_mux);
+    if (!c.used) continue;
+    if (!stream_hdr) { httpd_resp_sendstr_chunk(req, "<hr>"); stream_hdr = true; }
+    snprintf(line, sizeof(line),
+      "<div style='opacity:.9'><b>STREAM</b> · %s · %d fps · sent %lu · skipped %lu · "
+      "latency %lu ms (avg %lu, max %lu)</div>",
+      c.ip, c.fps, (unsigned long)c.frames_sent, (unsigned long)c.frames_skipped,
+      (unsigned long)c.lat_last_ms, (unsigned long)c.lat_avg_ms, (unsigned long)c.lat_max_ms
+    );
+    httpd_resp_sendstr_chunk(req, line);
+  }
+
   httpd_resp_sendstr_chunk(req, "</div></div></body></html>");
   return httpd_resp_sendstr_chunk(req, NULL);
 }
@@ -464,7 +1264,19 @@ static esp_err_t settings_get_handler(httpd_req_t *req) {
   snprintf(line, sizeof(line), "<option value='%d'%s>SVGA 800×600</option>", (int)FRAMESIZE_SVGA, sel(fs,(int)FRAMESIZE_SVGA)); httpd_resp_sendstr_chunk(req, line);
   snprintf(line, sizeof(line), "<option value='%d'%s>XGA 1024×768</option>", (int)FRAMESIZE_XGA, sel(fs,(int)FRAMESIZE_XGA)); httpd_resp_sendstr_chunk(req, line);
   snprintf(line, sizeof(line), "<option value='%d'%s>UXGA 1600×1200</option>", (int)FRAMESIZE_UXGA, sel(fs,(int)FRAMESIZE_UXGA)); httpd_resp_sendstr_chunk(req, line);
-  httpd_resp_sendstr_chunk(req, "</select><br><br>");
+  httpd_resp_sendstr_chunk(req, "</select><br>");
+  {
+    // POST rifiutato (?err=cam) o ripiego al boot: buffer più piccoli del richiesto
+    char q[16] = "", v[8] = "";
+    bool err = httpd_req_get_url_query_str(req, q, sizeof(q)) == ESP_OK &&
+               httpd_query_key_value(q, "err", v, sizeof(v)) == ESP_OK && !strcmp(v, "cam");
+    const char* why = bc_get_camera_error();
+    if ((err || !cam_arb_fits((framesize_t)fs)) && why[0]) {
+      snprintf(line, sizeof(line), "<div style='opacity:.8;font-size:.9em'>Not applied: %s.</div>", why);
+      httpd_resp_sendstr_chunk(req, line);
+    }
+  }
+  httpd_resp_sendstr_chunk(req, "<br>");
 
   httpd_resp_sendstr_chunk(req, "<label>JPEG quality (10 best → 63 more compression)</label><br>");
   snprintf(line, sizeof(line), "<input name='jq' type='number' min='10' max='63' value='%d'><br><br>", jq); httpd_resp_sendstr_chunk(req, line);
@@ -474,13 +1286,16 @@ static esp_err_t settings_get_handler(httpd_req_t *req) {
   snprintf(line, sizeof(line), "<option value='1'%s>Mirror</option>", sel(im,1)); httpd_resp_sendstr_chunk(req, line);
   snprintf(line, sizeof(line), "<option value='2'%s>Flip</option>", sel(im,2)); httpd_resp_sendstr_chunk(req, line);
   snprintf(line, sizeof(line), "<option value='3'%s>Rotate 180</option>", sel(im,3)); httpd_resp_sendstr_chunk(req, line);
-  snprintf(line, sizeof(line), "<option value='4'%s>Rotate +90 (web)</option>", sel(im,4)); httpd_resp_sendstr_chunk(req, line);
-  snprintf(line, sizeof(line), "<option value='5'%s>Rotate -90 (web)</option>", sel(im,5)); httpd_resp_sendstr_chunk(req, line);
+  snprintf(line, sizeof(line), "<option value='4'%s>Rotate +90 (web/MQTT)</option>", sel(im,4)); httpd_resp_sendstr_chunk(req, line);
+  snprintf(line, sizeof(line), "<option value='5'%s>Rotate -90 (web/MQTT)</option>", sel(im,5)); httpd_resp_sendstr_chunk(req, line);
   httpd_resp_sendstr_chunk(req, "</select><br><br>");
 
   httpd_resp_sendstr_chunk(req, "<label>Archive keep (1..20)</label><br>");
   snprintf(line, sizeof(line), "<input name='ak' type='number' min='1' max='20' value='%d'><br><br>", ak); httpd_resp_sendstr_chunk(req, line);
 
+  httpd_resp_sendstr_chunk(req, "<label>Snapshot cache max age (ms, 0..10000)</label><br>");
+  snprintf(line, sizeof(line), "<input name='sm' type='number' min='0' max='10000' step='100' value='%d'><br><br>", bc_get_snapshot_max_age_ms()); httpd_resp_sendstr_chunk(req, line);
+
   httpd_resp_sendstr_chunk(req, "<hr><h3>Image controls</h3>");
   httpd_resp_sendstr_chunk(req, "<label>Brightness (-2..2)</label><br>");
   snprintf(line, sizeof(line), "<input name='br' type='number' min='-2' max='2' step='1' value='%d'><br><br>", br); httpd_resp_sendstr_chunk(req, line);
@@ -512,13 +1327,94 @@ static esp_err_t settings_get_handler(httpd_req_t *req) {
   httpd_resp_sendstr_chunk(req, "<label>Manual exposure (0..1200, used when Auto exposure=Off)</label><br>");
   snprintf(line, sizeof(line), "<input name='ev' type='number' min='0' max='1200' step='1' value='%d'><br><br>", ev); httpd_resp_sendstr_chunk(req, line);
 
+  httpd_resp_sendstr_chunk(req, "<hr><h3>Power (battery)</h3>");
+  {
+    int pl = 0, pd = 0, pi = 0;
+    bc_get_power_settings(&pl, &pd, &pi);
+    httpd_resp_sendstr_chunk(req, "<label>Light sleep after idle (s, 0 = never)</label><br>");
+    snprintf(line, sizeof(line), "<input name='pl' type='number' min='0' max='3600' value='%d'><br><br>", pl); httpd_resp_sendstr_chunk(req, line);
+    httpd_resp_sendstr_chunk(req, "<label>Deep sleep (clears the archive)</label><br><select name='pd'>");
+    snprintf(line, sizeof(line), "<option value='0'%s>Off</option>", sel(pd,0)); httpd_resp_sendstr_chunk(req, line);
+    snprintf(line, sizeof(line), "<option value='1'%s>On</option>", sel(pd,1)); httpd_resp_sendstr_chunk(req, line);
+    httpd_resp_sendstr_chunk(req, "</select><br><br>");
+    httpd_resp_sendstr_chunk(req, "<label>Deep sleep after idle (s, 60..86400)</label><br>");
+    snprintf(line, sizeof(line), "<input name='pi' type='number' min='60' max='86400' value='%d'><br><br>", pi); httpd_resp_sendstr_chunk(req, line);
+  }
+
+  httpd_resp_sendstr_chunk(req, "<hr><h3>Timelapse</h3>");
+  {
+    int ti = 0, tf = 0, tk = 0;
+    bc_get_timelapse(&ti, &tf, &tk);
+    httpd_resp_sendstr_chunk(req, "<label>Interval (s, 0 = off, 5..3600)</label><br>");
+    snprintf(line, sizeof(line), "<input name='ti' type='number' min='0' max='3600' value='%d'><br><br>", ti); httpd_resp_sendstr_chunk(req, line);
+    httpd_resp_sendstr_chunk(req, "<label>Resolution</label><br><select name='tf'>");
+    const framesize_t tl_sizes[] = {FRAMESIZE_QVGA, FRAMESIZE_VGA, FRAMESIZE_SVGA, FRAMESIZE_XGA};
+    for (framesize_t f : tl_sizes) {
+      snprintf(line, sizeof(line), "<option value='%d'%s>%s</option>", (int)f, sel(tf,(int)f), cam_framesize_name(f));
+      httpd_resp_sendstr_chunk(req, line);
+    }
+    httpd_resp_sendstr_chunk(req, "</select><br><br>");
+    snprintf(line, sizeof(line), "<label>Frames kept (1..%d, max %lu KB)</label><br>", TL_MAX_FRAMES, (unsigned long)(TL_MAX_BYTES / 1024));
+    httpd_resp_sendstr_chunk(req, line);
+    snprintf(line, sizeof(line), "<input name='tk' type='number' min='1' max='%d' value='%d'><br><br>", TL_MAX_FRAMES, tk); httpd_resp_sendstr_chunk(req, line);
+  }
+
+  httpd_resp_sendstr_chunk(req, "<hr><h3>MQTT stream</h3>");
+  {
+    int st = 0, sk = 0;
+    bc_get_scene(&st, &sk);
+    httpd_resp_sendstr_chunk(req, "<label>Skip unchanged frames: change threshold (% of cells, 0 = publish all)</label><br>");
+    snprintf(line, sizeof(line), "<input name='st' type='number' min='0' max='100' value='%d'><br><br>", st); httpd_resp_sendstr_chunk(req, line);
+    httpd_resp_sendstr_chunk(req, "<label>Keyframe: publish anyway every (s, 10..3600)</label><br>");
+    snprintf(line, sizeof(line), "<input name='sk' type='number' min='10' max='3600' value='%d'><br><br>", sk); httpd_resp_sendstr_chunk(req, line);
+  }
+
+  httpd_resp_sendstr_chunk(req, "<hr><h3>Region of interest</h3>");
+  {
+    int rx = 0, ry = 0, rw = 100, rp = 0;
+    bc_get_roi(&rx, &ry, &rw, &rp);
+    httpd_resp_sendstr_chunk(req, cam_roi_supported()
+      ? "<div style='opacity:.8;font-size:.9em'>The sensor reads only this window (% of the full view, "
+        "sensor orientation) and scales it to the requested resolution. Width 100 = full view.</div><br>"
+      : "<div style='opacity:.8;font-size:.9em'>Not supported by this sensor (OV5640 only).</div><br>");
+    httpd_resp_sendstr_chunk(req, "<label>Left / top / width (%)</label><br>");
+    snprintf(line, sizeof(line),
+      "<input name='rx' type='number' min='0' max='90' value='%d' style='width:5em'> "
+      "<input name='ry' type='number' min='0' max='100' value='%d' style='width:5em'> "
+      "<input name='rw' type='number' min='%d' max='100' value='%d' style='width:5em'><br><br>",
+      rx, ry, CAM_ROI_MIN_W, rw);
+    httpd_resp_sendstr_chunk(req, line);
+    httpd_resp_sendstr_chunk(req, "<label>Used by</label><br><input type='hidden' name='rs' value='1'>");
+    const char* names[CAM_PROFILE_COUNT] = {"Stream", "Snapshot", "PIR archive", "MQTT", "Timelapse"};
+    for (int i = 0; i < CAM_PROFILE_COUNT; i++) {
+      snprintf(line, sizeof(line), "<label><input type='checkbox' name='r%d' value='1'%s> %s</label> ",
+               i, (rp & (1 << i)) ? " checked" : "", names[i]);
+      httpd_resp_sendstr_chunk(req, line);
+    }
+    httpd_resp_sendstr_chunk(req, "<br><br>");
+  }
+
+  httpd_resp_sendstr_chunk(req, "<hr><h3>Network</h3>");
+  httpd_resp_sendstr_chunk(req, "<div style='opacity:.8;font-size:.9em'>Static IP: leave empty for DHCP. Applied on next Wi-Fi join.</div><br>");
+  {
+    uint32_t net[4];
+    bc_get_static_ip(net);
+    const char* labels[4] = {"IP address", "Gateway", "Subnet mask", "DNS"};
+    const char* names[4]  = {"ip", "gw", "sn", "dns"};
+    for (int i = 0; i < 4; i++) {
+      String v = net[i] ? IPAddress(net[i]).toString() : String("");
+      snprintf(line, sizeof(line), "<label>%s</label><br><input name='%s' value='%s'><br><br>", labels[i], names[i], v.c_str());
+      httpd_resp_sendstr_chunk(req, line);
+    }
+  }
+
   httpd_resp_sendstr_chunk(req, "<button type='submit'>Save</button>");
   httpd_resp_sendstr_chunk(req, "</form></div></div></body></html>");
   return httpd_resp_sendstr_chunk(req, NULL);
 }
 
 static esp_err_t settings_post_handler(httpd_req_t *req) {
-  char buf[256];
+  char buf[768];
   int len = httpd_req_recv(req, buf, sizeof(buf)-1);
   if (len <= 0) return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "recv failed");
   buf[len] = 0;
@@ -533,6 +1429,7 @@ static esp_err_t settings_post_handler(httpd_req_t *req) {
   int jq = geti("jq", bc_get_jpeg_quality());
   int im = geti("im", bc_get_img_mode());
   int ak = geti("ak", bc_get_archive_keep());
+  int sm = geti("sm", bc_get_snapshot_max_age_ms());
   int br = geti("br", bc_get_brightness());
   int ct = geti("ct", bc_get_contrast());
   int sa = geti("sa", bc_get_saturation());
@@ -543,13 +1440,64 @@ static esp_err_t settings_post_handler(httpd_req_t *req) {
   int gg = geti("gg", bc_get_agc_gain());
   int ev = geti("ev", bc_get_aec_value());
 
-  bc_apply_settings(fs, jq, im);
+  bool cam_err = bc_apply_settings(fs, jq, im) != 0;
   bc_apply_cam_controls(br, ct, sa, sh, gc, ec, wb, gg, ev);
   bc_set_archive_keep(ak);
+  bc_set_snapshot_max_age_ms(sm);
+  {
+    int pl = 0, pd = 0, pi = 0;
+    bc_get_power_settings(&pl, &pd, &pi);
+    bc_set_power_settings(geti("pl", pl), geti("pd", pd), geti("pi", pi));
+  }
+
+  {
+    int ti = 0, tf = 0, tk = 0;
+    bc_get_timelapse(&ti, &tf, &tk);
+    bc_set_timelapse(geti("ti", ti), geti("tf", tf), geti("tk", tk));
+  }
+
+  {
+    int st = 0, sk = 0;
+    bc_get_scene(&st, &sk);
+    bc_set_scene(geti("st", st), geti("sk", sk));
+  }
+
+  // checkbox non spuntate = assenti: i profili si leggono solo se la sezione c'era
+  {
+    int rx = 0, ry = 0, rw = 100, rp = 0;
+    bc_get_roi(&rx, &ry, &rw, &rp);
+    if (geti("rs", 0)) {
+      rp = 0;
+      for (int i = 0; i < CAM_PROFILE_COUNT; i++) {
+        char key[4];
+        snprintf(key, sizeof(key), "r%d", i);
+        if (geti(key, 0)) rp |= 1 << i;
+      }
+    }
+    bc_set_roi(geti("rx", rx), geti("ry", ry), geti("rw", rw), rp);
+  }
+
+  // IP statico: tutti e quattro vuoti = DHCP; un campo non valido lascia la config com'è
+  {
+    const char* names[4] = {"ip", "gw", "sn", "dns"};
+    uint32_t net[4];
+    bc_get_static_ip(net);
+    bool present = false, valid = true;
+    for (int i = 0; i < 4; i++) {
+      char v[20];
+      if (httpd_query_key_value(buf, names[i], v, sizeof(v)) != ESP_OK) continue;
+      present = true;
+      IPAddress a;
+      if (!v[0]) net[i] = 0;
+      else if (a.fromString(v)) net[i] = (uint32_t)a;
+      else valid = false;
+    }
+    if (present && valid && (net[0] == 0 || (net[1] && net[2]))) bc_set_static_ip(net);
+  }
   bc_save_settings();
 
   httpd_resp_set_status(req, "303 See Other");
-  httpd_resp_set_hdr(req, "Location", "/settings");
+  httpd_resp_set_hdr(req, "Location", cam_err ? "/settings?err=cam" : "/settings");
   set_common_headers(req);
   return httpd_resp_send(req, "", 0);
 }
@@ -562,13 +1510,19 @@ void startCameraServer() {
   config.server_port = 80;
   config.stack_size = 8192;
 
-  // noi registriamo ~12 handler
-  config.max_uri_handlers = 16;
+  // noi registriamo ~20 handler
+  config.max_uri_handlers = 24;
+
+  // A pieno, la connessione usata meno di recente viene chiusa invece di
+  // rifiutare le nuove (le richieste async in corso non vengono toccate).
+  config.max_open_sockets = HTTPD_OPEN_SOCKETS;
+  config.lru_purge_enable = true;
 
   if (httpd_start(&camera_httpd, &config) != ESP_OK) {
     Serial.println("httpd_start FAILED");
     return;
   }
+  async_workers_start(config.task_priority);
 
   httpd_uri_t uri_root   = { .uri="/",          .method=HTTP_GET,  .handler=root_redirect_handler,           .user_ctx=NULL };
   httpd_uri_t uri_view   = { .uri="/view",      .method=HTTP_GET,  .handler=view_handler,                    .user_ctx=NULL };
@@ -576,8 +1530,17 @@ void startCameraServer() {
   httpd_uri_t uri_snap   = { .uri="/snapshot",  .method=HTTP_GET,  .handler=snapshot_handler,                .user_ctx=NULL };
   httpd_uri_t uri_mjpeg  = { .uri="/mjpeg",     .method=HTTP_GET,  .handler=mjpeg_handler,                   .user_ctx=NULL };
   httpd_uri_t uri_mode   = { .uri="/api/mode",  .method=HTTP_GET,  .handler=api_mode_handler,                .user_ctx=NULL };
+  httpd_uri_t uri_strms  = { .uri="/api/streams", .method=HTTP_GET, .handler=api_streams_handler,            .user_ctx=NULL };
+  httpd_uri_t uri_radio  = { .uri="/api/radio", .method=HTTP_GET, .handler=api_radio_handler,                .user_ctx=NULL };
+  httpd_uri_t uri_hist   = { .uri="/api/histogram", .method=HTTP_GET, .handler=api_histogram_handler,        .user_ctx=NULL };
+  httpd_uri_t uri_kern   = { .uri="/api/kernels", .method=HTTP_GET, .handler=api_kernels_handler,            .user_ctx=NULL };
+  httpd_uri_t uri_events = { .uri="/api/events", .method=HTTP_GET, .handler=api_events_handler,              .user_ctx=NULL };
+  httpd_uri_t uri_tar    = { .uri="/archive.tar", .method=HTTP_GET, .handler=archive_tar_handler,          .user_ctx=NULL };
+  httpd_uri_t uri_zip    = { .uri="/archive.zip", .method=HTTP_GET, .handler=archive_zip_handler,          .user_ctx=NULL };
+  httpd_uri_t uri_tl     = { .uri="/timelapse.avi", .method=HTTP_GET, .handler=timelapse_avi_handler,      .user_ctx=NULL };
   httpd_uri_t uri_arch   = { .uri="/archive",   .method=HTTP_GET,  .handler=archive_handler,                 .user_ctx=NULL };
   httpd_uri_t uri_snapn  = { .uri="/snap",      .method=HTTP_GET,  .handler=snap_n_handler,                  .user_ctx=NULL };
+  httpd_uri_t uri_thumb  = { .uri="/thumb",     .method=HTTP_GET,  .handler=thumb_handler,                   .user_ctx=NULL };
   httpd_uri_t uri_photo  = { .uri="/photo",     .method=HTTP_GET,  .handler=photo_handler,                   .user_ctx=NULL };
   httpd_uri_t uri_set_g  = { .uri="/settings",  .method=HTTP_GET,  .handler=settings_get_handler,            .user_ctx=NULL };
   httpd_uri_t uri_set_p  = { .uri="/settings",  .method=HTTP_POST, .handler=settings_post_handler,           .user_ctx=NULL };
@@ -589,8 +1552,17 @@ void startCameraServer() {
   httpd_register_uri_handler(camera_httpd, &uri_snap);
   httpd_register_uri_handler(camera_httpd, &uri_mjpeg);
   httpd_register_uri_handler(camera_httpd, &uri_mode);
+  httpd_register_uri_handler(camera_httpd, &uri_strms);
+  httpd_register_uri_handler(camera_httpd, &uri_hist);
+  httpd_register_uri_handler(camera_httpd, &uri_kern);
+  httpd_register_uri_handler(camera_httpd, &uri_events);
+  httpd_register_uri_handler(camera_httpd, &uri_radio);
   httpd_register_uri_handler(camera_httpd, &uri_arch);
+  httpd_register_uri_handler(camera_httpd, &uri_tar);
+  httpd_register_uri_handler(camera_httpd, &uri_zip);
+  httpd_register_uri_handler(camera_httpd, &uri_tl);
   httpd_register_uri_handler(camera_httpd, &uri_snapn);
+  httpd_register_uri_handler(camera_httpd, &uri_thumb);
   httpd_register_uri_handler(camera_httpd, &uri_photo);
   httpd_register_uri_handler(camera_httpd, &uri_set_g);
   httpd_register_uri_handler(camera_httpd, &uri_set_p);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include "birdcam_blob.h"
+#include "birdcam_events.h"
+
+// Archivio PIR (ring in PSRAM, implementato in BirdCam.ino).
+// Gli snapshot vengono restituiti pinnati: il ring può ruotare durante
+// un download senza invalidare i buffer. Rilasciare con bc_snap_release().
+
+struct bc_snap_ref_t {
+  bc_blob_t* blob;
+  bc_blob_t* thumb;   // miniatura (nullptr se non ancora pronta o non necessaria)
+  uint32_t   id;      // progressivo di cattura (non cambia quando il ring ruota)
+  uint32_t   crc;     // CRC-32 del JPEG, calcolato all'archiviazione
+  time_t     ts;      // 0 = ora non ancora sincronizzata
+};
+
+// n = 0 ultimo, 1 precedente, ...
+bool bc_get_snapshot(int n, bc_snap_ref_t* out);
+bool bc_find_snapshot(uint32_t id, bc_snap_ref_t* out);
+
+// Snapshot con ts >= since (since = 0: tutti), dal più vecchio; ritorna quanti
+int  bc_pin_snapshots(bc_snap_ref_t* out, int max, time_t since);
+
+void bc_snap_release(bc_snap_ref_t* refs, int n);
+
+// Eventi PIR con catture più nuove dell'id since (cursore), dal più vecchio
+int  bc_get_events(uint32_t since, ev_event_t* out, int max);
+// Id della cattura più vecchia e più nuova ancora nell'archivio (0 = vuoto)
+void bc_get_capture_range(uint32_t* oldest, uint32_t* newest);
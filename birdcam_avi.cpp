@@ -0,0 +1,114 @@
+#include "birdcam_avi.h"
+
+#include <string.h>
+
+static const uint32_t AVIF_HASINDEX   = 0x00000010;
+static const uint32_t AVIIF_KEYFRAME  = 0x00000010;
+
+static inline void put_u16(uint8_t*& p, uint16_t v) {
+  p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8);
+  p += 2;
+}
+static inline void put_u32(uint8_t*& p, uint32_t v) {
+  p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+  p += 4;
+}
+static inline void put_cc(uint8_t*& p, const char* cc) {
+  memcpy(p, cc, 4);
+  p += 4;
+}
+
+static uint32_t movi_len(const avi_info_t* info) {
+  // 'movi' + per frame: header chunk + dati + padding
+  return 4 + info->frames * AVI_CHUNK_HDR_LEN + info->frames_bytes + info->odd_frames;
+}
+
+uint32_t avi_total_len(const avi_info_t* info) {
+  return AVI_HEADER_LEN - 4 + movi_len(info) + AVI_CHUNK_HDR_LEN + info->frames * AVI_INDEX_ENTRY_LEN;
+}
+
+void avi_write_header(uint8_t* out, const avi_info_t* info) {
+  uint8_t* p = out;
+  uint32_t fps = info->fps ? info->fps : 1;
+
+  put_cc(p, "RIFF");
+  put_u32(p, avi_total_len(info) - 8);
+  put_cc(p, "AVI ");
+
+  // hdrl: 4 + (8+56) + (8 + 4 + (8+56) + (8+40)) = 192
+  put_cc(p, "LIST");
+  put_u32(p, 192);
+  put_cc(p, "hdrl");
+
+  put_cc(p, "avih");
+  put_u32(p, 56);
+  put_u32(p, 1000000UL / fps);               // dwMicroSecPerFrame
+  put_u32(p, info->max_frame_len * fps);     // dwMaxBytesPerSec
+  put_u32(p, 0);                             // dwPaddingGranularity
+  put_u32(p, AVIF_HASINDEX);                 // dwFlags
+  put_u32(p, info->frames);                  // dwTotalFrames
+  put_u32(p, 0);                             // dwInitialFrames
+  put_u32(p, 1);                             // dwStreams
+  put_u32(p, info->max_frame_len);           // dwSuggestedBufferSize
+  put_u32(p, info->width);
+  put_u32(p, info->height);
+  for (int i = 0; i < 4; i++) put_u32(p, 0); // dwReserved
+
+  put_cc(p, "LIST");
+  put_u32(p, 4 + (8 + 56) + (8 + 40));
+  put_cc(p, "strl");
+
+  put_cc(p, "strh");
+  put_u32(p, 56);
+  put_cc(p, "vids");
+  put_cc(p, "MJPG");
+  put_u32(p, 0);                             // dwFlags
+  put_u16(p, 0);                             // wPriority
+  put_u16(p, 0);                             // wLanguage
+  put_u32(p, 0);                             // dwInitialFrames
+  put_u32(p, 1);                             // dwScale
+  put_u32(p, fps);                           // dwRate
+  put_u32(p, 0);                             // dwStart
+  put_u32(p, info->frames);                  // dwLength
+  put_u32(p, info->max_frame_len);           // dwSuggestedBufferSize
+  put_u32(p, 0xFFFFFFFFUL);                  // dwQuality (default)
+  put_u32(p, 0);                             // dwSampleSize
+  put_u16(p, 0); put_u16(p, 0);              // rcFrame
+  put_u16(p, info->width); put_u16(p, info->height);
+
+  put_cc(p, "strf");
+  put_u32(p, 40);
+  put_u32(p, 40);                            // biSize
+  put_u32(p, info->width);
+  put_u32(p, info->height);
+  put_u16(p, 1);                             // biPlanes
+  put_u16(p, 24);                            // biBitCount
+  put_cc(p, "MJPG");                         // biCompression
+  put_u32(p, (uint32_t)info->width * info->height * 3);
+  put_u32(p, 0); put_u32(p, 0);              // pels per meter
+  put_u32(p, 0); put_u32(p, 0);              // clr used/important
+
+  put_cc(p, "LIST");
+  put_u32(p, movi_len(info));
+  put_cc(p, "movi");
+}
+
+void avi_write_chunk_header(uint8_t out[AVI_CHUNK_HDR_LEN], uint32_t len) {
+  uint8_t* p = out;
+  put_cc(p, "00dc");
+  put_u32(p, len);
+}
+
+void avi_write_index_header(uint8_t out[AVI_CHUNK_HDR_LEN], uint32_t frames) {
+  uint8_t* p = out;
+  put_cc(p, "idx1");
+  put_u32(p, frames * AVI_INDEX_ENTRY_LEN);
+}
+
+void avi_write_index_entry(uint8_t out[AVI_INDEX_ENTRY_LEN], uint32_t offset, uint32_t len) {
+  uint8_t* p = out;
+  put_cc(p, "00dc");
+  put_u32(p, AVIIF_KEYFRAME);
+  put_u32(p, offset);
+  put_u32(p, len);
+}
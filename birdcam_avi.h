@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// MJPEG-in-AVI (RIFF) generato al volo: header, chunk '00dc' e indice
+// 'idx1' vengono scritti attorno ai JPEG già in memoria, senza copiarli.
+//
+//   RIFF 'AVI '
+//     LIST 'hdrl' { avih, LIST 'strl' { strh, strf } }
+//     LIST 'movi' { '00dc' <jpeg> [pad] ... }
+//     idx1 { 16 byte per frame }
+
+#define AVI_HEADER_LEN      224   // da 'RIFF' fino a 'movi' incluso
+#define AVI_CHUNK_HDR_LEN   8
+#define AVI_INDEX_ENTRY_LEN 16
+
+struct avi_info_t {
+  uint16_t width;
+  uint16_t height;
+  uint32_t fps;            // velocità di riproduzione
+  uint32_t frames;
+  uint32_t max_frame_len;
+  uint32_t frames_bytes;   // somma delle lunghezze JPEG (senza padding)
+  uint32_t odd_frames;     // frame di lunghezza dispari (1 byte di padding)
+};
+
+// Dimensione totale del file
+uint32_t avi_total_len(const avi_info_t* info);
+
+// Scrive AVI_HEADER_LEN byte in out
+void avi_write_header(uint8_t* out, const avi_info_t* info);
+
+// '00dc' + lunghezza (il chunk va seguito da 1 byte 0 se len è dispari)
+void avi_write_chunk_header(uint8_t out[AVI_CHUNK_HDR_LEN], uint32_t len);
+
+// 'idx1' + dimensione
+void avi_write_index_header(uint8_t out[AVI_CHUNK_HDR_LEN], uint32_t frames);
+
+// offset = posizione del chunk rispetto al fourcc 'movi' (primo frame: 4)
+void avi_write_index_entry(uint8_t out[AVI_INDEX_ENTRY_LEN], uint32_t offset, uint32_t len);
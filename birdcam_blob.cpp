@@ -0,0 +1,34 @@
+#include "birdcam_blob.h"
+
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+
+static portMUX_TYPE s_blob_mux = portMUX_INITIALIZER_UNLOCKED;
+
+bc_blob_t* bc_blob_new(size_t len) {
+  // header + dati in un'unica allocazione
+  uint8_t* mem = (uint8_t*)heap_caps_malloc(sizeof(bc_blob_t) + len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (!mem) return nullptr;
+  bc_blob_t* b = (bc_blob_t*)mem;
+  b->refs = 1;
+  b->len  = len;
+  b->data = mem + sizeof(bc_blob_t);
+  return b;
+}
+
+bc_blob_t* bc_blob_ref(bc_blob_t* b) {
+  if (!b) return nullptr;
+  portENTER_CRITICAL(&s_blob_mux);
+  b->refs++;
+  portEXIT_CRITICAL(&s_blob_mux);
+  return b;
+}
+
+void bc_blob_unref(bc_blob_t* b) {
+  if (!b) return;
+  portENTER_CRITICAL(&s_blob_mux);
+  int left = --b->refs;
+  portEXIT_CRITICAL(&s_blob_mux);
+  if (left == 0) heap_caps_free(b);
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Buffer con conteggio riferimenti (PSRAM): chi lo sta inviando lo "pinna"
+// con bc_blob_ref(), chi lo sostituisce fa solo bc_blob_unref().
+// L'ultimo unref libera la memoria.
+struct bc_blob_t {
+  int      refs;
+  size_t   len;
+  uint8_t* data;
+};
+
+bc_blob_t* bc_blob_new(size_t len);          // refs = 1, data non inizializzati
+bc_blob_t* bc_blob_ref(bc_blob_t* b);        // ritorna b (nullptr-safe)
+void       bc_blob_unref(bc_blob_t* b);      // nullptr-safe
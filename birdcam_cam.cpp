@@ -0,0 +1,630 @@
+#include "birdcam_cam.h"
+
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "img_converters.h"
+#include "birdcam_kernels.h"
+
+// ---- extern from BirdCam.ino ----
+extern SemaphoreHandle_t g_cam_mutex;
+
+#define CAM_MAX_STREAMS 8
+
+struct StreamWant {
+  bool        used;
+  framesize_t fs;
+  int         q;
+};
+
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static StreamWant s_streams[CAM_MAX_STREAMS];
+
+static framesize_t s_fb_max = FRAMESIZE_QVGA;
+static int         s_fb_count = 0;
+static int         s_fb_out = 0;            // frame del driver non ancora restituiti (s_mux)
+static framesize_t s_cur_fs = FRAMESIZE_INVALID;  // modalità attuale del sensore
+static int         s_cur_q  = -1;
+static int64_t     s_not_before_us = 0;
+static int64_t     s_mode_ts_us = 0;    // ultimo cambio di finestra a parità di dimensioni
+
+// ROI (protetta da s_mux; applicata al sensore con g_cam_mutex preso)
+static cam_roi_t s_roi = {0, 0, 100, 0};
+static uint32_t  s_roi_gen = 0;         // cambia a ogni cam_set_roi()
+static bool      s_roi_ok = false;      // sensore OV5640 con set_res_raw
+static bool      s_cur_roi = false;
+static uint32_t  s_cur_roi_gen = 0;
+
+// Area attiva OV5640 4:3 (come la tabella del driver: finestra 0,0..2623,1951,
+// offset 32/16 dentro la finestra, totali 2844x1968)
+#define OV5640_ACTIVE_W 2560
+#define OV5640_ACTIVE_H 1920
+#define OV5640_OFF_X    32
+#define OV5640_OFF_Y    16
+#define OV5640_HTS      2844
+
+static uint32_t s_mode_flips = 0;
+static uint32_t s_downscaled = 0;
+static uint32_t s_rejected   = 0;
+static uint32_t s_busy       = 0;
+static uint32_t s_reinits    = 0;
+
+// Cache snapshot
+struct CacheEntry {
+  bc_blob_t*  blob;
+  framesize_t fs;
+  int         q;
+  uint16_t    width;
+  uint16_t    height;
+  int64_t     ts_us;
+  uint32_t    roi_gen;
+  uint32_t    gen;       // catture completate (letto senza s_cache_mutex sotto s_mux)
+};
+static SemaphoreHandle_t s_cache_mutex = nullptr;  // serializza le catture (single-flight)
+static CacheEntry s_cache = {};
+static uint32_t s_cache_captures = 0;
+static uint32_t s_cache_hits     = 0;
+
+struct FsName { const char* name; framesize_t fs; };
+static const FsName FS_NAMES[] = {
+  {"96x96", FRAMESIZE_96X96}, {"qqvga", FRAMESIZE_QQVGA}, {"qcif", FRAMESIZE_QCIF},
+  {"hqvga", FRAMESIZE_HQVGA}, {"240x240", FRAMESIZE_240X240}, {"qvga", FRAMESIZE_QVGA},
+  {"cif", FRAMESIZE_CIF}, {"hvga", FRAMESIZE_HVGA}, {"vga", FRAMESIZE_VGA},
+  {"svga", FRAMESIZE_SVGA}, {"xga", FRAMESIZE_XGA}, {"hd", FRAMESIZE_HD},
+  {"sxga", FRAMESIZE_SXGA}, {"uxga", FRAMESIZE_UXGA},
+};
+
+static inline int clamp_q(int q) {
+  if (q < 10) q = 10;
+  if (q > 63) q = 63;
+  return q;
+}
+
+// Qualità sensore (10 migliore .. 63 più compressa) -> qualità encoder software (1..100)
+static inline uint8_t sensor_q_to_jpge(int q) {
+  int jq = 100 - (clamp_q(q) * 80) / 63;
+  return (uint8_t)jq;
+}
+
+// Riduzione esatta from -> to (2x/4x/8x su entrambi gli assi), altrimenti JPG_SCALE_NONE
+static jpg_scale_t scale_for(framesize_t from, framesize_t to) {
+  if (from == to || from >= FRAMESIZE_INVALID || to >= FRAMESIZE_INVALID) return JPG_SCALE_NONE;
+  uint16_t fw = resolution[from].width, fh = resolution[from].height;
+  uint16_t tw = resolution[to].width,   th = resolution[to].height;
+  for (int sc = (int)JPG_SCALE_2X; sc <= (int)JPG_SCALE_8X; sc++) {
+    int div = 1 << sc;
+    if (fw == tw * div && fh == th * div) return (jpg_scale_t)sc;
+  }
+  return JPG_SCALE_NONE;
+}
+
+// Modalità degli stream: la più grande richiesta (con la sua qualità)
+static bool stream_mode(framesize_t* fs, int* q) {
+  bool any = false;
+  portENTER_CRITICAL(&s_mux);
+  for (int i = 0; i < CAM_MAX_STREAMS; i++) {
+    if (!s_streams[i].used) continue;
+    if (!any || cam_fs_area(s_streams[i].fs) > cam_fs_area(*fs)) { *fs = s_streams[i].fs; *q = s_streams[i].q; }
+    any = true;
+  }
+  portEXIT_CRITICAL(&s_mux);
+  return any;
+}
+
+static bool roi_for(cam_profile_t prof, uint32_t* gen) {
+  portENTER_CRITICAL(&s_mux);
+  bool on = s_roi_ok && s_roi.w < 100 && (s_roi.profiles & (1u << prof));
+  if (gen) *gen = s_roi_gen;
+  portEXIT_CRITICAL(&s_mux);
+  return on;
+}
+
+// Finestra del sensore per la ROI, uscita = framesize fs (scalata dall'ISP).
+// Niente binning: il punto è il dettaglio ottico pieno.
+static void apply_roi(sensor_t* s, framesize_t fs) {
+  cam_roi_t r;
+  portENTER_CRITICAL(&s_mux);
+  r = s_roi;
+  portEXIT_CRITICAL(&s_mux);
+
+  int ow = resolution[fs].width, oh = resolution[fs].height;
+  int w = (OV5640_ACTIVE_W * r.w / 100) & ~15;
+  if (w < ow) w = ow;
+  int h = (w * oh / ow) & ~7;
+  if (h > OV5640_ACTIVE_H) { h = OV5640_ACTIVE_H; w = (h * ow / oh) & ~15; }
+  if (h < oh) h = oh;
+
+  int x = (OV5640_ACTIVE_W * r.x / 100) & ~7;
+  int y = (OV5640_ACTIVE_H * r.y / 100) & ~7;
+  if (x + w > OV5640_ACTIVE_W) x = OV5640_ACTIVE_W - w;
+  if (y + h > OV5640_ACTIVE_H) y = OV5640_ACTIVE_H - h;
+
+  int win_w = w + 2 * OV5640_OFF_X - 1;   // come 2623 per 2560
+  int win_h = h + 2 * OV5640_OFF_Y - 1;   // come 1951 per 1920
+  // VTS ridotto con la finestra: meno righe lette per frame -> più fps
+  int vts = win_h + 1 + OV5640_OFF_Y;
+  s->set_res_raw(s, x, y, x + win_w, y + win_h, OV5640_OFF_X, OV5640_OFF_Y,
+                 OV5640_HTS, vts, ow, oh, true, false);
+}
+
+// Chiamare con g_cam_mutex preso
+static void set_mode(framesize_t fs, int q, bool roi) {
+  sensor_t* s = esp_camera_sensor_get();
+  if (!s) return;
+  portENTER_CRITICAL(&s_mux);
+  uint32_t gen = s_roi_gen;
+  portEXIT_CRITICAL(&s_mux);
+  if (fs != s_cur_fs || roi != s_cur_roi || (roi && gen != s_cur_roi_gen)) {
+    // set_framesize imposta PLL e finestra piena; la ROI la restringe dopo
+    s->set_framesize(s, fs);
+    if (roi) apply_roi(s, fs);
+    // stesse dimensioni, contenuto diverso: i frame già in coda non valgono
+    if (fs == s_cur_fs) s_mode_ts_us = esp_timer_get_time();
+    s_cur_fs = fs;
+    s_cur_roi = roi;
+    s_cur_roi_gen = gen;
+    s_mode_flips++;
+  }
+  if (q != s_cur_q) {
+    s->set_quality(s, q);
+    s_cur_q = q;
+  }
+}
+
+// Dopo un cambio di modalità il driver può avere ancora un frame della
+// modalità precedente: scartiamo i frame con dimensioni sbagliate.
+static camera_fb_t* grab_fb_matching(framesize_t fs) {
+  for (int i = 0; i < 3; i++) {
+    camera_fb_t* fb = esp_camera_fb_get();
+    if (!fb) return nullptr;
+    int64_t ts = (int64_t)fb->timestamp.tv_sec * 1000000LL + fb->timestamp.tv_usec;
+    if (fb->format == PIXFORMAT_JPEG && fb->len > 0 && ts >= s_not_before_us && ts >= s_mode_ts_us &&
+        fb->width == resolution[fs].width && fb->height == resolution[fs].height) {
+      return fb;
+    }
+    esp_camera_fb_return(fb);
+  }
+  return nullptr;
+}
+
+// Decodifica ridotta (scala DCT del decoder) + riencode; jpg da liberare con free()
+static bool scale_jpeg(const uint8_t* src, size_t len, uint16_t w, uint16_t h, jpg_scale_t sc,
+                       uint8_t jq, uint8_t** jpg, size_t* jlen, uint16_t* ow, uint16_t* oh) {
+  int div = 1 << (int)sc;
+  w = (uint16_t)(w / div);
+  h = (uint16_t)(h / div);
+  size_t rgb_len = (size_t)w * h * 2;
+
+  uint8_t* rgb = (uint8_t*)heap_caps_malloc(rgb_len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (!rgb) return false;
+
+  *jpg = nullptr;
+  *jlen = 0;
+  bool ok = jpg2rgb565(src, len, rgb, sc) &&
+            fmt2jpg(rgb, rgb_len, w, h, PIXFORMAT_RGB565, jq, jpg, jlen);
+  free(rgb);
+  if (!ok) {
+    if (*jpg) free(*jpg);
+    *jpg = nullptr;
+    return false;
+  }
+  *ow = w;
+  *oh = h;
+  return true;
+}
+
+static bool downscale(const camera_fb_t* fb, jpg_scale_t sc, int q, cam_frame_t* out) {
+  uint8_t* jpg = nullptr;
+  size_t jlen = 0;
+  uint16_t w = 0, h = 0;
+  if (!scale_jpeg(fb->buf, fb->len, fb->width, fb->height, sc, sensor_q_to_jpge(q), &jpg, &jlen, &w, &h)) {
+    return false;
+  }
+  out->scaled = jpg;
+  out->buf    = jpg;
+  out->len    = jlen;
+  out->width  = w;
+  out->height = h;
+  return true;
+}
+
+bc_blob_t* cam_make_thumb(const uint8_t* jpg, size_t len, uint16_t w, uint16_t h, uint16_t min_w) {
+  if (!jpg || !len || !w || !h) return nullptr;
+  int sc = (int)JPG_SCALE_NONE;
+  while (sc < (int)JPG_SCALE_8X && (w >> (sc + 1)) >= min_w) sc++;
+  if (sc == (int)JPG_SCALE_NONE) return nullptr;
+
+  uint8_t* out = nullptr;
+  size_t olen = 0;
+  uint16_t tw = 0, th = 0;
+  if (!scale_jpeg(jpg, len, w, h, (jpg_scale_t)sc, 60, &out, &olen, &tw, &th)) return nullptr;
+
+  bc_blob_t* b = bc_blob_new(olen);
+  if (b) memcpy(b->data, out, olen);
+  free(out);
+  return b;
+}
+
+uint8_t* cam_decode_8x(const uint8_t* jpg, size_t len, uint16_t w, uint16_t h, int* dw, int* dh) {
+  int ow = w / 8, oh = h / 8;
+  if (!jpg || !len || ow < 1 || oh < 1) return nullptr;
+  uint8_t* rgb = (uint8_t*)heap_caps_malloc((size_t)ow * oh * 2, MALLOC_CAP_8BIT);
+  if (!rgb) return nullptr;
+  if (!jpg2rgb565(jpg, len, rgb, JPG_SCALE_8X)) {
+    free(rgb);
+    return nullptr;
+  }
+  if (dw) *dw = ow;
+  if (dh) *dh = oh;
+  return rgb;
+}
+
+bool cam_rotate_jpeg(const uint8_t* jpg, size_t len, uint16_t w, uint16_t h, bool cw, int q,
+                     uint8_t** out, size_t* olen) {
+  if (!jpg || !len || !w || !h || !out || !olen) return false;
+  size_t rgb_len = (size_t)w * h * 2;
+  uint8_t* rgb = (uint8_t*)heap_caps_malloc(rgb_len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  uint8_t* rot = (uint8_t*)heap_caps_malloc(rgb_len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  *out = nullptr;
+  *olen = 0;
+  bool ok = rgb && rot && jpg2rgb565(jpg, len, rgb, JPG_SCALE_NONE);
+  if (ok) {
+    kern_rotate90(rgb, w, h, rot, cw);
+    ok = fmt2jpg(rot, rgb_len, h, w, PIXFORMAT_RGB565, sensor_q_to_jpge(q), out, olen);
+  }
+  free(rgb);
+  free(rot);
+  if (!ok && *out) {
+    free(*out);
+    *out = nullptr;
+  }
+  return ok;
+}
+
+void cam_arb_init(framesize_t fb_max, int fb_count, framesize_t cur_fs, int cur_q) {
+  s_fb_max = fb_max;
+  s_fb_count = fb_count;
+  s_cur_fs = cur_fs;
+  s_cur_q  = cur_q;
+  if (!s_cache_mutex) s_cache_mutex = xSemaphoreCreateMutex();
+  sensor_t* s = esp_camera_sensor_get();
+  s_roi_ok = s && s->id.PID == OV5640_PID && s->set_res_raw;
+}
+
+size_t cam_fb_bytes(framesize_t fs) {
+  return cam_fs_area(fs) / CAM_FB_JPEG_DIV;
+}
+
+bool cam_fb_plan(framesize_t fs, bool psram, size_t avail, size_t largest, size_t reserve,
+                 cam_fb_plan_t* out) {
+  if (!out) return false;
+  size_t b = cam_fb_bytes(fs);
+  out->fs        = fs;
+  out->fb_bytes  = b;
+  out->location  = psram ? CAMERA_FB_IN_PSRAM : CAMERA_FB_IN_DRAM;
+  out->fb_count  = 1;
+  out->grab_mode = CAMERA_GRAB_WHEN_EMPTY;   // con un solo buffer LATEST non ha senso
+  if (!b || b > largest || b + reserve > avail) return false;
+  // in DRAM un buffer solo: la RAM interna serve a Wi-Fi e TCP
+  if (psram && 2 * b + reserve <= avail) {
+    out->fb_count  = 2;
+    out->grab_mode = CAMERA_GRAB_LATEST;
+  }
+  return true;
+}
+
+bool cam_arb_suspend(uint32_t wait_ms) {
+  int64_t t0 = esp_timer_get_time();
+  if (g_cam_mutex && xSemaphoreTake(g_cam_mutex, pdMS_TO_TICKS(wait_ms)) != pdTRUE) return false;
+  // chi ha già un frame lo restituisce presto (stream: dopo l'invio)
+  for (;;) {
+    portENTER_CRITICAL(&s_mux);
+    int out = s_fb_out;
+    portEXIT_CRITICAL(&s_mux);
+    if (out <= 0) return true;
+    if (esp_timer_get_time() - t0 > (int64_t)wait_ms * 1000) break;
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+  if (g_cam_mutex) xSemaphoreGive(g_cam_mutex);
+  return false;
+}
+
+void cam_arb_resume(framesize_t fb_max, int fb_count, int cur_q) {
+  // il driver riparte a fb_max, finestra piena: la prossima cattura reimposta la modalità
+  s_fb_max = fb_max;
+  s_fb_count = fb_count;
+  s_cur_fs = fb_max;
+  s_cur_q  = cur_q;
+  s_cur_roi = false;
+  s_mode_ts_us = esp_timer_get_time();
+  sensor_t* s = esp_camera_sensor_get();
+  s_roi_ok = s && s->id.PID == OV5640_PID && s->set_res_raw;
+  s_reinits++;
+  if (g_cam_mutex) xSemaphoreGive(g_cam_mutex);
+}
+
+bool cam_roi_supported() { return s_roi_ok; }
+
+void cam_set_roi(const cam_roi_t* roi) {
+  if (!roi) return;
+  cam_roi_t r = *roi;
+  if (r.w < CAM_ROI_MIN_W) r.w = CAM_ROI_MIN_W;
+  if (r.w > 100) r.w = 100;
+  if (r.x > 100 - r.w) r.x = 100 - r.w;
+  if (r.y > 100) r.y = 100;
+  r.profiles &= (1u << CAM_PROFILE_COUNT) - 1;
+  portENTER_CRITICAL(&s_mux);
+  s_roi = r;
+  s_roi_gen++;
+  portEXIT_CRITICAL(&s_mux);
+}
+
+void cam_get_roi(cam_roi_t* out) {
+  if (!out) return;
+  portENTER_CRITICAL(&s_mux);
+  *out = s_roi;
+  portEXIT_CRITICAL(&s_mux);
+}
+
+uint32_t cam_fs_area(framesize_t fs) {
+  if (fs < 0 || fs >= FRAMESIZE_INVALID) return 0;
+  return (uint32_t)resolution[fs].width * resolution[fs].height;
+}
+
+framesize_t cam_arb_fb_max() { return s_fb_max; }
+
+void cam_arb_discard_before(int64_t t_us) { s_not_before_us = t_us; }
+
+// i buffer sono dimensionati sui pixel di s_fb_max, non sulla sua posizione nell'enum
+bool cam_arb_fits(framesize_t fs) {
+  uint32_t a = cam_fs_area(fs);
+  return a && a <= cam_fs_area(s_fb_max);
+}
+
+int cam_arb_stream_join(framesize_t fs, int q) {
+  int h = -1;
+  portENTER_CRITICAL(&s_mux);
+  for (int i = 0; i < CAM_MAX_STREAMS; i++) {
+    if (!s_streams[i].used) {
+      s_streams[i].used = true;
+      s_streams[i].fs = fs;
+      s_streams[i].q = clamp_q(q);
+      h = i;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&s_mux);
+  return h;
+}
+
+void cam_arb_stream_leave(int h) {
+  if (h < 0 || h >= CAM_MAX_STREAMS) return;
+  portENTER_CRITICAL(&s_mux);
+  s_streams[h].used = false;
+  portEXIT_CRITICAL(&s_mux);
+}
+
+static void release_fb(camera_fb_t* fb) {
+  esp_camera_fb_return(fb);
+  portENTER_CRITICAL(&s_mux);
+  s_fb_out--;
+  portEXIT_CRITICAL(&s_mux);
+}
+
+cam_result_t cam_arb_grab(cam_profile_t prof, framesize_t fs, int q,
+                          cam_frame_t* out, uint32_t wait_ms)
+{
+  if (!out) return CAM_ERR_CAPTURE;
+  memset(out, 0, sizeof(*out));
+  q = clamp_q(q);
+
+  if (!cam_arb_fits(fs)) {
+    s_rejected++;
+    return CAM_ERR_TOO_LARGE;
+  }
+
+  // Con stream attivi il sensore resta nella loro modalità se possiamo
+  // servire la richiesta dallo stesso frame (uguale o riduzione esatta).
+  // Il frame dello stream serve solo se la finestra (ROI o piena) è la stessa.
+  framesize_t mode_fs = fs;
+  int mode_q = q;
+  bool roi = roi_for(prof, nullptr);
+  framesize_t sfs = FRAMESIZE_QVGA;
+  int sq = q;
+  if (stream_mode(&sfs, &sq)) {
+    bool sroi = roi_for(CAM_PROFILE_STREAM, nullptr);
+    if (prof == CAM_PROFILE_STREAM ||
+        (sroi == roi && (sfs == fs || scale_for(sfs, fs) != JPG_SCALE_NONE))) {
+      mode_fs = sfs;
+      mode_q = sq;
+    }
+  }
+
+  if (g_cam_mutex) {
+    TickType_t ticks = (wait_ms == portMAX_DELAY) ? portMAX_DELAY : pdMS_TO_TICKS(wait_ms);
+    if (xSemaphoreTake(g_cam_mutex, ticks) != pdTRUE) {
+      s_busy++;
+      return CAM_ERR_BUSY;
+    }
+  }
+  set_mode(mode_fs, mode_q, roi);
+  camera_fb_t* fb = grab_fb_matching(mode_fs);
+  if (fb) {
+    portENTER_CRITICAL(&s_mux);
+    s_fb_out++;
+    portEXIT_CRITICAL(&s_mux);
+  }
+  if (g_cam_mutex) xSemaphoreGive(g_cam_mutex);
+
+  if (!fb) return CAM_ERR_CAPTURE;
+
+  out->fb     = fb;
+  out->buf    = fb->buf;
+  out->len    = fb->len;
+  out->width  = (uint16_t)fb->width;
+  out->height = (uint16_t)fb->height;
+  out->ts_us  = (int64_t)fb->timestamp.tv_sec * 1000000LL + fb->timestamp.tv_usec;
+
+  if (mode_fs != fs) {
+    jpg_scale_t sc = scale_for(mode_fs, fs);
+    if (sc != JPG_SCALE_NONE && downscale(fb, sc, q, out)) {
+      release_fb(fb);
+      out->fb = nullptr;
+      s_downscaled++;
+    }
+    // altrimenti: frame nativo della modalità stream (più grande del richiesto)
+  }
+  return CAM_OK;
+}
+
+void cam_arb_release(cam_frame_t* f) {
+  if (!f) return;
+  if (f->fb) release_fb(f->fb);
+  if (f->scaled) free(f->scaled);
+  f->fb = nullptr;
+  f->scaled = nullptr;
+  f->buf = nullptr;
+  f->len = 0;
+}
+
+void cam_arb_get_stats(cam_arb_stats_t* out) {
+  if (!out) return;
+  int n = 0;
+  portENTER_CRITICAL(&s_mux);
+  for (int i = 0; i < CAM_MAX_STREAMS; i++) if (s_streams[i].used) n++;
+  portEXIT_CRITICAL(&s_mux);
+
+  out->fb_max     = s_fb_max;
+  out->fb_count   = s_fb_count;
+  out->cur_fs     = s_cur_fs;
+  out->cur_roi    = s_cur_roi;
+  out->streams    = n;
+  out->mode_flips = s_mode_flips;
+  out->downscaled = s_downscaled;
+  out->rejected   = s_rejected;
+  out->busy       = s_busy;
+  out->reinits    = s_reinits;
+}
+
+framesize_t cam_framesize_from_str(const char* s, framesize_t def) {
+  if (!s || !s[0]) return def;
+  if (s[0] >= '0' && s[0] <= '9' && !strchr(s, 'x')) {
+    int v = atoi(s);
+    for (const FsName& e : FS_NAMES) {
+      if ((int)e.fs == v) return e.fs;
+    }
+    return def;
+  }
+  for (const FsName& e : FS_NAMES) {
+    if (!strcasecmp(s, e.name)) return e.fs;
+  }
+  return def;
+}
+
+const char* cam_framesize_name(framesize_t fs) {
+  for (const FsName& e : FS_NAMES) {
+    if (e.fs == fs) return e.name;
+  }
+  return "?";
+}
+
+framesize_t cam_fs_next_smaller(framesize_t fs) {
+  uint32_t a = cam_fs_area(fs);
+  framesize_t best = FRAMESIZE_INVALID;
+  for (const FsName& e : FS_NAMES) {
+    uint32_t ea = cam_fs_area(e.fs);
+    if (ea < a && (best == FRAMESIZE_INVALID || ea > cam_fs_area(best))) best = e.fs;
+  }
+  return best;
+}
+
+cam_result_t cam_cache_get(framesize_t fs, int q, uint32_t max_age_ms,
+                           cam_cached_t* out, uint32_t wait_ms)
+{
+  if (!out) return CAM_ERR_CAPTURE;
+  memset(out, 0, sizeof(*out));
+  q = clamp_q(q);
+  if (!cam_arb_fits(fs)) {
+    s_rejected++;
+    return CAM_ERR_TOO_LARGE;
+  }
+
+  // Generazione letta prima di mettersi in coda: se cambia mentre si
+  // attende, la cattura in corso è finita e il suo frame vale anche per noi.
+  portENTER_CRITICAL(&s_mux);
+  const uint32_t seen_gen = s_cache.gen;
+  portEXIT_CRITICAL(&s_mux);
+
+  if (s_cache_mutex) {
+    TickType_t ticks = (wait_ms == portMAX_DELAY) ? portMAX_DELAY : pdMS_TO_TICKS(wait_ms);
+    if (xSemaphoreTake(s_cache_mutex, ticks) != pdTRUE) {
+      s_busy++;
+      return CAM_ERR_BUSY;
+    }
+  }
+
+  // Valido se abbastanza giovane, oppure prodotto dalla cattura dietro cui
+  // eravamo in coda. Non basta il timestamp: è quello dell'esposizione,
+  // iniziata prima che arrivassero le richieste in attesa.
+  uint32_t roi_gen = 0;
+  roi_for(CAM_PROFILE_SNAPSHOT, &roi_gen);
+  if (s_cache.blob && s_cache.fs == fs && s_cache.q == q && s_cache.roi_gen == roi_gen) {
+    int64_t now_us = esp_timer_get_time();
+    bool fresh = (now_us - s_cache.ts_us) <= (int64_t)max_age_ms * 1000LL;
+    if (fresh || s_cache.gen != seen_gen) {
+      out->blob   = bc_blob_ref(s_cache.blob);
+      out->width  = s_cache.width;
+      out->height = s_cache.height;
+      out->ts_us  = s_cache.ts_us;
+      out->hit    = true;
+      s_cache_hits++;
+      if (s_cache_mutex) xSemaphoreGive(s_cache_mutex);
+      return CAM_OK;
+    }
+  }
+
+  cam_frame_t f;
+  cam_result_t r = cam_arb_grab(CAM_PROFILE_SNAPSHOT, fs, q, &f, wait_ms);
+  if (r == CAM_OK) {
+    bc_blob_t* b = bc_blob_new(f.len);
+    if (b) {
+      memcpy(b->data, f.buf, f.len);
+      bc_blob_unref(s_cache.blob);
+      s_cache.blob   = b;   // riferimento della cache
+      s_cache.fs     = fs;
+      s_cache.q      = q;
+      s_cache.roi_gen = roi_gen;
+      s_cache.width  = f.width;
+      s_cache.height = f.height;
+      // timestamp del sensore (per i frame ridotti quello della sorgente);
+      // se il driver non lo dà, l'ora della cattura
+      s_cache.ts_us  = f.ts_us > 0 ? f.ts_us : esp_timer_get_time();
+      portENTER_CRITICAL(&s_mux);
+      s_cache.gen++;
+      portEXIT_CRITICAL(&s_mux);
+      s_cache_captures++;
+
+      out->blob   = bc_blob_ref(b);
+      out->width  = s_cache.width;
+      out->height = s_cache.height;
+      out->ts_us  = s_cache.ts_us;
+    } else {
+      r = CAM_ERR_CAPTURE;
+    }
+    cam_arb_release(&f);
+  }
+
+  if (s_cache_mutex) xSemaphoreGive(s_cache_mutex);
+  return r;
+}
+
+void cam_cache_release(cam_cached_t* c) {
+  if (!c) return;
+  bc_blob_unref(c->blob);
+  c->blob = nullptr;
+}
+
+void cam_cache_get_stats(uint32_t* captures, uint32_t* hits) {
+  if (captures) *captures = s_cache_captures;
+  if (hits) *hits = s_cache_hits;
+}
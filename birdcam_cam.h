@@ -0,0 +1,165 @@
+#pragma once
+
+#include <Arduino.h>
+#include "esp_camera.h"
+#include "birdcam_blob.h"
+
+// Arbitro della modalità sensore: unico punto d'accesso ai frame per
+// stream, snapshot, archivio PIR e MQTT.
+//
+// - la risoluzione richiesta deve stare nei frame buffer allocati
+//   (altrimenti CAM_ERR_TOO_LARGE, invece di un FB-OVF in cattura);
+//   per ingrandirli il driver si re-inizializza a caldo (cam_arb_suspend)
+// - con uno stream attivo, le richieste più piccole vengono servite
+//   riducendo (2x/4x/8x) il frame dello stream, senza cambiare modalità
+// - le altre richieste attendono il sensore (coda sul mutex) e cambiano
+//   modalità solo per il tempo della cattura
+
+enum cam_profile_t {
+  CAM_PROFILE_STREAM = 0,
+  CAM_PROFILE_SNAPSHOT,
+  CAM_PROFILE_ARCHIVE,
+  CAM_PROFILE_MQTT,
+  CAM_PROFILE_TIMELAPSE,
+  CAM_PROFILE_COUNT
+};
+
+enum cam_result_t {
+  CAM_OK = 0,
+  CAM_ERR_TOO_LARGE,   // non entra nei frame buffer
+  CAM_ERR_BUSY,        // sensore occupato oltre wait_ms
+  CAM_ERR_CAPTURE      // esp_camera_fb_get fallita
+};
+
+struct cam_frame_t {
+  const uint8_t* buf;
+  size_t   len;
+  uint16_t width;
+  uint16_t height;
+  int64_t  ts_us;        // istante di cattura (esp_timer)
+  camera_fb_t* fb;       // frame del driver, restituito da cam_arb_release()
+  uint8_t* scaled;       // copia ridotta, liberata da cam_arb_release()
+};
+
+struct cam_arb_stats_t {
+  framesize_t fb_max;
+  int         fb_count;
+  framesize_t cur_fs;
+  bool        cur_roi;   // il sensore sta usando la finestra ROI
+  int         streams;
+  uint32_t    mode_flips;
+  uint32_t    downscaled;
+  uint32_t    rejected;
+  uint32_t    busy;
+  uint32_t    reinits;
+};
+
+// Da chiamare dopo esp_camera_init(): fb_max = frame_size usato per allocare i buffer
+void cam_arb_init(framesize_t fb_max, int fb_count, framesize_t cur_fs, int cur_q);
+
+// ---- Frame buffer: budget e re-init a caldo ----
+// In JPEG il driver alloca fb_count buffer da w*h/5 byte per il frame_size
+// di init. Il piano sceglie quanti buffer stanno in avail lasciando reserve
+// libera (2 + grab latest se possibile, altrimenti 1 + grab when empty);
+// false se non ne sta nemmeno uno (out è compilato comunque).
+#define CAM_FB_JPEG_DIV 5
+
+struct cam_fb_plan_t {
+  framesize_t          fs;
+  int                  fb_count;
+  camera_grab_mode_t   grab_mode;
+  camera_fb_location_t location;
+  size_t               fb_bytes;   // per buffer
+};
+
+size_t cam_fb_bytes(framesize_t fs);
+bool cam_fb_plan(framesize_t fs, bool psram, size_t avail, size_t largest, size_t reserve,
+                 cam_fb_plan_t* out);
+
+// Ferma i consumatori per esp_camera_deinit(): prende g_cam_mutex e attende
+// che tutti i frame del driver siano restituiti. false (e niente preso) se
+// non succede entro wait_ms.
+bool cam_arb_suspend(uint32_t wait_ms);
+// Dopo esp_camera_init() (nuovi buffer o quelli di prima): rilascia g_cam_mutex
+void cam_arb_resume(framesize_t fb_max, int fb_count, int cur_q);
+
+// Pixel del frame (0 se fs non è valido). L'ordine dell'enum framesize_t
+// non è quello delle dimensioni (P_HD dopo FHD, 240X240 tra HQVGA e QVGA):
+// i confronti "più grande di" passano da qui.
+uint32_t cam_fs_area(framesize_t fs);
+
+framesize_t cam_arb_fb_max();
+
+// Dopo un light sleep i buffer del driver contengono frame vecchi:
+// le catture successive scartano i frame più vecchi di t_us
+void cam_arb_discard_before(int64_t t_us);
+bool cam_arb_fits(framesize_t fs);
+
+// Stream: dichiara la modalità desiderata (ritorna un handle, -1 se pieno)
+int  cam_arb_stream_join(framesize_t fs, int q);
+void cam_arb_stream_leave(int h);
+
+cam_result_t cam_arb_grab(cam_profile_t prof, framesize_t fs, int q,
+                          cam_frame_t* out, uint32_t wait_ms);
+void cam_arb_release(cam_frame_t* f);
+
+void cam_arb_get_stats(cam_arb_stats_t* out);
+
+// ---- ROI: finestra del sensore (solo OV5640) ----
+// Il sensore legge solo la regione della mangiatoia e la riduce al framesize
+// richiesto: più dettaglio ottico a parità di pixel, frame piccoli e più fps.
+// x, y = angolo in alto a sinistra, w = larghezza, in % dell'area attiva
+// 2560x1920, nell'orientamento del sensore (prima di mirror/flip); l'altezza
+// segue il rapporto del framesize. La finestra non scende sotto il framesize
+// (niente upscaling).
+#define CAM_ROI_MIN_W 10
+
+struct cam_roi_t {
+  uint8_t x;
+  uint8_t y;
+  uint8_t w;          // CAM_ROI_MIN_W..100 (100 = campo pieno)
+  uint8_t profiles;   // bit (1 << cam_profile_t) dei profili che la usano
+};
+
+bool cam_roi_supported();
+void cam_set_roi(const cam_roi_t* roi);
+void cam_get_roi(cam_roi_t* out);
+
+// ---- Cache snapshot (single-flight) ----
+// Un solo frame "ultimo" per /snapshot. Le richieste che arrivano mentre
+// una cattura è in corso la attendono e ricevono lo stesso buffer pinnato;
+// entro max_age_ms si riusa il frame senza toccare il sensore.
+struct cam_cached_t {
+  bc_blob_t* blob;
+  uint16_t   width;
+  uint16_t   height;
+  int64_t    ts_us;
+  bool       hit;        // servito dalla cache (nessuna nuova cattura)
+};
+
+cam_result_t cam_cache_get(framesize_t fs, int q, uint32_t max_age_ms,
+                           cam_cached_t* out, uint32_t wait_ms);
+void cam_cache_release(cam_cached_t* c);
+void cam_cache_get_stats(uint32_t* captures, uint32_t* hits);
+
+// Miniatura di un JPEG (w x h): riduzione 2x/4x/8x più forte che lascia
+// almeno min_w pixel di larghezza. nullptr se già abbastanza piccolo o errore.
+bc_blob_t* cam_make_thumb(const uint8_t* jpg, size_t len, uint16_t w, uint16_t h, uint16_t min_w);
+
+// Decodifica a 1/8 (scala DCT, quasi gratis) in RGB565: buffer da liberare
+// con free(), *dw x *dh pixel. Per i confronti di scena (birdcam_scene).
+uint8_t* cam_decode_8x(const uint8_t* jpg, size_t len, uint16_t w, uint16_t h, int* dw, int* dh);
+
+// JPEG w x h ruotato di 90° (cw = orario): decodifica, kern_rotate90, riencode
+// a qualità q (scala sensore). Per le immagini MQTT con img_mode 4/5, che non
+// passano dal CSS della pagina. *out da liberare con free().
+bool cam_rotate_jpeg(const uint8_t* jpg, size_t len, uint16_t w, uint16_t h, bool cw, int q,
+                     uint8_t** out, size_t* olen);
+
+// "qvga", "vga", ... oppure valore numerico di framesize_t; solo le
+// risoluzioni della lista (96x96..uxga), il resto dà def
+framesize_t cam_framesize_from_str(const char* s, framesize_t def);
+const char* cam_framesize_name(framesize_t fs);
+// Risoluzione della lista subito più piccola di fs (per area);
+// FRAMESIZE_INVALID se fs è già la più piccola
+framesize_t cam_fs_next_smaller(framesize_t fs);
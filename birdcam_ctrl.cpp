@@ -0,0 +1,108 @@
+#include "birdcam_ctrl.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static uint32_t hash_n(const char* s, size_t n) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < n; i++) h = (h ^ (uint8_t)s[i]) * 16777619u;
+  return h;
+}
+
+bool ctrl_router_init(ctrl_router_t* r, const ctrl_cmd_t* table, int count, const char* base_topic) {
+  if (!r || !table || count <= 0 || count >= 255 || count * 2 > CTRL_INDEX_SLOTS) return false;
+  memset(r, 0, sizeof(*r));
+  int n = snprintf(r->prefix, sizeof(r->prefix), "%s/ctrl/", base_topic ? base_topic : "");
+  if (n <= 0 || n >= (int)sizeof(r->prefix)) return false;
+  r->prefix_len = (size_t)n;
+  r->table = table;
+  r->count = count;
+  for (int i = 0; i < count; i++) {
+    uint32_t slot = ctrl_hash(table[i].key) & (CTRL_INDEX_SLOTS - 1);
+    while (r->index[slot]) slot = (slot + 1) & (CTRL_INDEX_SLOTS - 1);
+    r->index[slot] = (uint8_t)(i + 1);
+  }
+  return true;
+}
+
+int ctrl_route(const ctrl_router_t* r, const char* topic) {
+  if (!r || !r->table || !topic || strncmp(topic, r->prefix, r->prefix_len) != 0) return -1;
+  const char* key = topic + r->prefix_len;
+  const char* slash = strchr(key, '/');
+  if (!slash || strcmp(slash, "/set") != 0) return -1;
+  size_t n = (size_t)(slash - key);
+
+  uint32_t slot = hash_n(key, n) & (CTRL_INDEX_SLOTS - 1);
+  while (r->index[slot]) {
+    int id = r->index[slot] - 1;
+    const char* k = r->table[id].key;
+    if (strlen(k) == n && memcmp(k, key, n) == 0) return id;
+    slot = (slot + 1) & (CTRL_INDEX_SLOTS - 1);
+  }
+  return -1;
+}
+
+static bool parse_bool(const char* msg, int32_t* out) {
+  if (!strcasecmp(msg, "ON") || !strcmp(msg, "1") || !strcasecmp(msg, "true")) { *out = 1; return true; }
+  if (!strcasecmp(msg, "OFF") || !strcmp(msg, "0") || !strcasecmp(msg, "false")) { *out = 0; return true; }
+  return false;
+}
+
+static bool parse_ipv4(const char* msg, uint32_t* out) {
+  if (!msg[0]) { *out = 0; return true; }
+  unsigned a, b, c, d;
+  char tail;
+  if (sscanf(msg, "%u.%u.%u.%u%c", &a, &b, &c, &d, &tail) != 4) return false;
+  if (a > 255 || b > 255 || c > 255 || d > 255) return false;
+  *out = a | (b << 8) | (c << 16) | ((uint32_t)d << 24);   // ordine di IPAddress
+  return true;
+}
+
+bool ctrl_parse(const ctrl_cmd_t* c, const char* msg, int32_t* out) {
+  if (!c || !msg || !out) return false;
+  switch (c->kind) {
+    case CTRL_BOOL:
+    case CTRL_BIT:
+      return parse_bool(msg, out);
+    case CTRL_IPV4: {
+      uint32_t ip = 0;
+      if (!parse_ipv4(msg, &ip)) return false;
+      *out = (int32_t)ip;
+      return true;
+    }
+    default: {
+      char* end = nullptr;
+      long v = strtol(msg, &end, 10);
+      if (end == msg) return false;
+      if (v < c->min) v = c->min;
+      if (v > c->max) v = c->max;
+      *out = (int32_t)v;
+      return true;
+    }
+  }
+}
+
+int32_t ctrl_current(const ctrl_cmd_t* c) {
+  if (!c || !c->var) return 0;
+  if (c->kind == CTRL_IPV4) return (int32_t)*(const uint32_t*)c->var;
+  int v = *(const int*)c->var;
+  if (c->kind == CTRL_BIT) return (v & c->min) ? 1 : 0;
+  return v;
+}
+
+size_t ctrl_format(const ctrl_cmd_t* c, int32_t v, char* out, size_t outlen) {
+  if (!c || !out || !outlen) return 0;
+  int n;
+  if (c->kind == CTRL_BOOL || c->kind == CTRL_BIT) {
+    n = snprintf(out, outlen, "%s", v ? "ON" : "OFF");
+  } else if (c->kind == CTRL_IPV4) {
+    uint32_t ip = (uint32_t)v;
+    if (!ip) n = snprintf(out, outlen, "%s", "");
+    else n = snprintf(out, outlen, "%u.%u.%u.%u", ip & 0xFF, (ip >> 8) & 0xFF, (ip >> 16) & 0xFF, ip >> 24);
+  } else {
+    n = snprintf(out, outlen, "%ld", (long)v);
+  }
+  return n > 0 ? ((size_t)n < outlen ? (size_t)n : outlen - 1) : 0;
+}
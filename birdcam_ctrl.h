@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Router dei comandi MQTT "<base>/ctrl/<key>/set": tabella statica dei comandi
+// (definita da chi la usa) + indice hash costruito una volta. Il prefisso si
+// confronta una sola volta, la chiave si risolve in O(1).
+// Modulo puro: niente Arduino/IDF.
+
+enum ctrl_kind_t : uint8_t {
+  CTRL_INT = 0,     // intero, limitato a min..max
+  CTRL_BOOL,        // ON/OFF, 1/0, true/false
+  CTRL_BIT,         // come BOOL, su un bit (maschera in min) di un int
+  CTRL_FRAMESIZE,   // intero framesize_t (i nomi li risolve il chiamante)
+  CTRL_IPV4         // "a.b.c.d" o vuoto (= 0), uint32_t come IPAddress
+};
+
+struct ctrl_cmd_t {
+  const char* key;
+  uint8_t     kind;
+  uint16_t    group;   // i comandi dello stesso gruppo vanno al setter insieme
+  int32_t     min;
+  int32_t     max;
+  const void* var;     // valore corrente: int*, uint32_t* per CTRL_IPV4
+};
+
+#define CTRL_INDEX_SLOTS 128   // potenza di 2, > 2x i comandi
+#define CTRL_PREFIX_MAX  128
+
+struct ctrl_router_t {
+  const ctrl_cmd_t* table;
+  int      count;
+  uint8_t  index[CTRL_INDEX_SLOTS];   // 0 = vuoto, altrimenti id + 1
+  char     prefix[CTRL_PREFIX_MAX];   // "<base>/ctrl/"
+  size_t   prefix_len;
+};
+
+// FNV-1a, anche a compile time
+constexpr uint32_t ctrl_hash(const char* s, uint32_t h = 2166136261u) {
+  return *s ? ctrl_hash(s + 1, (h ^ (uint8_t)*s) * 16777619u) : h;
+}
+
+bool ctrl_router_init(ctrl_router_t* r, const ctrl_cmd_t* table, int count, const char* base_topic);
+
+// id del comando per "<prefix><key>/set", -1 se il topic non è un comando noto
+int ctrl_route(const ctrl_router_t* r, const char* topic);
+
+// Payload -> valore; false se non valido (il comando va ignorato)
+bool ctrl_parse(const ctrl_cmd_t* c, const char* msg, int32_t* out);
+
+int32_t ctrl_current(const ctrl_cmd_t* c);
+
+// Valore come payload di stato ("ON"/"OFF", "a.b.c.d", numero)
+size_t ctrl_format(const ctrl_cmd_t* c, int32_t v, char* out, size_t outlen);
@@ -0,0 +1,103 @@
+#include "birdcam_events.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void ev_init(ev_index_t* x) {
+  if (!x) return;
+  memset(x, 0, sizeof(*x));
+  x->head = -1;
+}
+
+const ev_event_t* ev_add_capture(ev_index_t* x, uint32_t id, time_t ts, uint32_t now_ms,
+                                 const uint8_t* sig) {
+  if (!x || !id) return nullptr;
+
+  // movimento fra questa cattura e la precedente (anche dell'evento prima)
+  int score = 0;
+  if (sig && x->have_sig) score = scene_score(x->last_sig, sig);
+  if (sig) memcpy(x->last_sig, sig, SCENE_CELLS);
+  x->have_sig = sig != nullptr;
+
+  ev_event_t* e = x->count ? &x->ev[x->head] : nullptr;
+  if (e && id == e->last_id + 1 && now_ms - e->end_ms <= EV_GAP_MS) {
+    e->last_id = id;
+    e->end_ts  = ts;
+    e->end_ms  = now_ms;
+    if (score > e->score) e->score = (uint8_t)score;
+    return e;
+  }
+
+  x->head = (x->head + 1) % EV_MAX;
+  if (x->count < EV_MAX) x->count++;
+  e = &x->ev[x->head];
+  e->id       = id;
+  e->last_id  = id;
+  e->start_ts = e->end_ts = ts;
+  e->start_ms = e->end_ms = now_ms;
+  e->score    = (uint8_t)score;
+  e->open     = false;
+  return e;
+}
+
+int ev_since(const ev_index_t* x, uint32_t since, uint32_t now_ms, ev_event_t* out, int max) {
+  if (!x || !out || max <= 0) return 0;
+  // dal più nuovo indietro fino al primo già visto dal client
+  int k = 0;
+  while (k < x->count) {
+    int idx = (x->head - k + EV_MAX) % EV_MAX;
+    if (x->ev[idx].last_id <= since) break;
+    k++;
+  }
+  // i più vecchi prima: il resto alla prossima pagina
+  int n = k < max ? k : max;
+  for (int i = 0; i < n; i++) {
+    int idx = (x->head - (k - 1 - i) + EV_MAX * 2) % EV_MAX;
+    out[i] = x->ev[idx];
+    out[i].open = idx == x->head && now_ms - out[i].end_ms <= EV_GAP_MS;
+  }
+  return n;
+}
+
+void ev_time_synced(ev_index_t* x, time_t now, uint32_t now_ms) {
+  if (!x) return;
+  for (int i = 0; i < x->count; i++) {
+    ev_event_t& e = x->ev[(x->head - i + EV_MAX) % EV_MAX];
+    if (e.start_ts == 0) e.start_ts = now - (time_t)((now_ms - e.start_ms) / 1000);
+    if (e.end_ts == 0)   e.end_ts   = now - (time_t)((now_ms - e.end_ms) / 1000);
+  }
+}
+
+size_t ev_format_json(const ev_event_t* e, uint32_t new_from, char* buf, size_t cap) {
+  if (!e || !buf || !cap) return 0;
+  int n = snprintf(buf, cap,
+    "{\"event\":%lu,\"first\":%lu,\"last\":%lu,\"captures\":%lu,\"start\":%ld,\"end\":%ld,"
+    "\"duration_ms\":%lu,\"score\":%u,\"open\":%s",
+    (unsigned long)e->id, (unsigned long)e->id, (unsigned long)e->last_id,
+    (unsigned long)(e->last_id - e->id + 1), (long)e->start_ts, (long)e->end_ts,
+    (unsigned long)(e->end_ms - e->start_ms), (unsigned)e->score, e->open ? "true" : "false");
+  if (n < 0 || (size_t)n >= cap) return 0;
+  size_t len = (size_t)n;
+
+  if (new_from) {
+    if (new_from < e->id) new_from = e->id;
+    if (e->last_id >= EV_JSON_MAX_NEW && new_from < e->last_id - EV_JSON_MAX_NEW + 1) {
+      new_from = e->last_id - EV_JSON_MAX_NEW + 1;
+    }
+    n = snprintf(buf + len, cap - len, ",\"new\":[");
+    if (n < 0 || (size_t)n >= cap - len) return 0;
+    len += (size_t)n;
+    for (uint32_t id = new_from; id <= e->last_id; id++) {
+      n = snprintf(buf + len, cap - len, "%s%lu", id == new_from ? "" : ",", (unsigned long)id);
+      if (n < 0 || (size_t)n >= cap - len) return 0;
+      len += (size_t)n;
+    }
+    n = snprintf(buf + len, cap - len, "]");
+    if (n < 0 || (size_t)n >= cap - len) return 0;
+    len += (size_t)n;
+  }
+  if (len + 2 > cap) return 0;
+  buf[len++] = '}';
+  buf[len] = 0;
+  return len;
+}
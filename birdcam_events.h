@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "birdcam_scene.h"
+
+// Indice degli eventi PIR: catture archiviate raggruppate per evento, con
+// inizio/fine e un punteggio di movimento. Gli id di cattura crescono sempre
+// (anche fra i reboot), quindi un client sincronizza con un cursore:
+// ev_since(since) scorre dal più nuovo e si ferma al primo già visto, il
+// costo dipende dai nuovi eventi e non dalla dimensione dell'archivio.
+// Modulo puro: il chiamante serializza gli accessi (mux in BirdCam.ino).
+
+#define EV_MAX    32
+#define EV_GAP_MS 30000   // cattura entro 30 s dalla precedente: stesso evento
+
+struct ev_event_t {
+  uint32_t id;          // id della prima cattura (= id dell'evento)
+  uint32_t last_id;     // catture id..last_id, consecutive
+  time_t   start_ts;    // 0 = ora non ancora sincronizzata
+  time_t   end_ts;
+  uint32_t start_ms;    // millis()
+  uint32_t end_ms;
+  uint8_t  score;       // massima % di celle cambiate fra catture consecutive
+  bool     open;        // compilato da ev_since: può ancora ricevere catture
+};
+
+struct ev_index_t {
+  ev_event_t ev[EV_MAX];
+  int      head;        // ultimo evento (-1 = nessuno)
+  int      count;
+  uint8_t  last_sig[SCENE_CELLS];   // firma dell'ultima cattura (scene_signature)
+  bool     have_sig;
+};
+
+void ev_init(ev_index_t* x);
+
+// Cattura archiviata: estende l'evento aperto o ne apre uno nuovo.
+// sig = firma di scena della cattura (nullptr se la decodifica è fallita).
+const ev_event_t* ev_add_capture(ev_index_t* x, uint32_t id, time_t ts, uint32_t now_ms,
+                                 const uint8_t* sig);
+
+// Eventi con catture più nuove di since (id di cattura), dal più vecchio;
+// al più max: il cursore successivo è il last_id dell'ultimo restituito.
+// Un evento ancora aperto ricompare finché riceve catture.
+int ev_since(const ev_index_t* x, uint32_t since, uint32_t now_ms, ev_event_t* out, int max);
+
+// NTP arrivato dopo gli eventi: ricostruisce i ts dai millis()
+void ev_time_synced(ev_index_t* x, time_t now, uint32_t now_ms);
+
+// Oggetto JSON dell'evento; new_from > 0 aggiunge "new": gli id da new_from
+// a last_id (al più gli ultimi EV_JSON_MAX_NEW). Ritorna la lunghezza (0 = non sta).
+#define EV_JSON_MAX_NEW 20
+size_t ev_format_json(const ev_event_t* e, uint32_t new_from, char* buf, size_t cap);
@@ -0,0 +1,150 @@
+#include "birdcam_export.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// ---------------- CRC-32 ----------------
+static uint32_t s_crc_table[256];
+static bool s_crc_ready = false;
+
+static void crc_init() {
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t c = i;
+    for (int k = 0; k < 8; k++) c = (c & 1) ? (0xEDB88320UL ^ (c >> 1)) : (c >> 1);
+    s_crc_table[i] = c;
+  }
+  s_crc_ready = true;
+}
+
+uint32_t bc_crc32(uint32_t crc, const uint8_t* data, size_t len) {
+  if (!s_crc_ready) crc_init();
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) crc = s_crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
+
+void export_snap_name(char* out, size_t outlen, uint32_t id, time_t ts) {
+  if (ts <= 0) {
+    snprintf(out, outlen, "snap_%lu.jpg", (unsigned long)id);
+    return;
+  }
+  struct tm t;
+  localtime_r(&ts, &t);
+  char d[20];
+  strftime(d, sizeof(d), "%Y%m%d_%H%M%S", &t);
+  snprintf(out, outlen, "%s_%lu.jpg", d, (unsigned long)id);
+}
+
+// ---------------- tar ----------------
+static void octal(char* out, size_t width, uint32_t v) {
+  // width-1 cifre + NUL
+  snprintf(out, width, "%0*lo", (int)(width - 1), (unsigned long)v);
+}
+
+void tar_write_header(uint8_t out[TAR_BLOCK], const char* name, uint32_t size, time_t mtime) {
+  memset(out, 0, TAR_BLOCK);
+  char* h = (char*)out;
+  strncpy(h + 0, name, 99);
+  octal(h + 100, 8, 0644);                            // mode
+  octal(h + 108, 8, 0);                               // uid
+  octal(h + 116, 8, 0);                               // gid
+  octal(h + 124, 12, size);
+  octal(h + 136, 12, mtime > 0 ? (uint32_t)mtime : 0);
+  h[156] = '0';                                       // file regolare
+  memcpy(h + 257, "ustar", 6);
+  memcpy(h + 263, "00", 2);
+  strncpy(h + 265, "birdcam", 31);                    // uname
+  strncpy(h + 297, "birdcam", 31);                    // gname
+
+  // checksum: somma dei byte con il campo chksum a spazi
+  memset(h + 148, ' ', 8);
+  uint32_t sum = 0;
+  for (int i = 0; i < TAR_BLOCK; i++) sum += out[i];
+  snprintf(h + 148, 7, "%06lo", (unsigned long)(sum & 0777777));   // max 512*255
+  h[154] = 0;
+  h[155] = ' ';
+}
+
+uint32_t tar_pad_len(uint32_t size) {
+  return (TAR_BLOCK - (size % TAR_BLOCK)) % TAR_BLOCK;
+}
+
+// ---------------- zip ----------------
+static inline void put_u16(uint8_t*& p, uint16_t v) {
+  p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8);
+  p += 2;
+}
+static inline void put_u32(uint8_t*& p, uint32_t v) {
+  p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+  p += 4;
+}
+
+static void dos_time(time_t t, uint16_t* dtime, uint16_t* ddate) {
+  if (t <= 0) { *dtime = 0; *ddate = (0 << 9) | (1 << 5) | 1; return; }   // 1980-01-01
+  struct tm tm;
+  localtime_r(&t, &tm);
+  int y = tm.tm_year + 1900;
+  if (y < 1980) y = 1980;
+  *dtime = (uint16_t)((tm.tm_hour << 11) | (tm.tm_min << 5) | (tm.tm_sec / 2));
+  *ddate = (uint16_t)(((y - 1980) << 9) | ((tm.tm_mon + 1) << 5) | tm.tm_mday);
+}
+
+size_t zip_write_local(uint8_t* out, const char* name, uint32_t size, uint32_t crc, time_t mtime) {
+  uint16_t dt, dd;
+  dos_time(mtime, &dt, &dd);
+  size_t nlen = strlen(name);
+  uint8_t* p = out;
+  put_u32(p, 0x04034b50);
+  put_u16(p, 10);            // version needed
+  put_u16(p, 0);             // flags
+  put_u16(p, 0);             // stored
+  put_u16(p, dt);
+  put_u16(p, dd);
+  put_u32(p, crc);
+  put_u32(p, size);          // compressed
+  put_u32(p, size);          // uncompressed
+  put_u16(p, (uint16_t)nlen);
+  put_u16(p, 0);             // extra
+  memcpy(p, name, nlen);
+  return ZIP_LOCAL_LEN + nlen;
+}
+
+size_t zip_write_central(uint8_t* out, const char* name, uint32_t size, uint32_t crc, time_t mtime,
+                         uint32_t local_offset) {
+  uint16_t dt, dd;
+  dos_time(mtime, &dt, &dd);
+  size_t nlen = strlen(name);
+  uint8_t* p = out;
+  put_u32(p, 0x02014b50);
+  put_u16(p, 0x031E);        // made by: unix, 3.0
+  put_u16(p, 10);
+  put_u16(p, 0);
+  put_u16(p, 0);
+  put_u16(p, dt);
+  put_u16(p, dd);
+  put_u32(p, crc);
+  put_u32(p, size);
+  put_u32(p, size);
+  put_u16(p, (uint16_t)nlen);
+  put_u16(p, 0);             // extra
+  put_u16(p, 0);             // comment
+  put_u16(p, 0);             // disk
+  put_u16(p, 0);             // internal attr
+  put_u32(p, 0100644UL << 16);  // external attr: file regolare 0644
+  put_u32(p, local_offset);
+  memcpy(p, name, nlen);
+  return ZIP_CENTRAL_LEN + nlen;
+}
+
+size_t zip_write_end(uint8_t out[ZIP_END_LEN], uint16_t entries, uint32_t cd_size, uint32_t cd_offset) {
+  uint8_t* p = out;
+  put_u32(p, 0x06054b50);
+  put_u16(p, 0);
+  put_u16(p, 0);
+  put_u16(p, entries);
+  put_u16(p, entries);
+  put_u32(p, cd_size);
+  put_u32(p, cd_offset);
+  put_u16(p, 0);             // comment
+  return ZIP_END_LEN;
+}
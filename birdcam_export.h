@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+// Export dell'archivio come tar (ustar) o zip "stored" (senza compressione):
+// solo gli header, generati al volo; i dati si inviano direttamente dai
+// buffer pinnati, con RAM costante qualunque sia la dimensione.
+
+// CRC-32 (IEEE, come zip/gzip); crc = 0 per iniziare, poi concatenabile
+uint32_t bc_crc32(uint32_t crc, const uint8_t* data, size_t len);
+
+// "20260215_143210_42.jpg" (ora locale) o "snap_42.jpg" se ts = 0
+void export_snap_name(char* out, size_t outlen, uint32_t id, time_t ts);
+
+// ---- tar (ustar) ----
+#define TAR_BLOCK 512
+
+void     tar_write_header(uint8_t out[TAR_BLOCK], const char* name, uint32_t size, time_t mtime);
+uint32_t tar_pad_len(uint32_t size);     // zeri dopo i dati fino al blocco
+// fine archivio: 2 blocchi di zeri
+
+// ---- zip (stored, CRC/size noti in anticipo: niente data descriptor) ----
+#define ZIP_LOCAL_LEN   30   // + nome
+#define ZIP_CENTRAL_LEN 46   // + nome
+#define ZIP_END_LEN     22
+
+size_t zip_write_local(uint8_t* out, const char* name, uint32_t size, uint32_t crc, time_t mtime);
+size_t zip_write_central(uint8_t* out, const char* name, uint32_t size, uint32_t crc, time_t mtime,
+                         uint32_t local_offset);
+size_t zip_write_end(uint8_t out[ZIP_END_LEN], uint16_t entries, uint32_t cd_size, uint32_t cd_offset);
@@ -8,6 +8,14 @@ static char g_status_topic[128] = {0};
 static char g_fw_version[32] = {0};
 
 static time_t   g_boot_time = 0;
+static uint32_t g_boot_wifi_ms = 0;
+static uint32_t g_boot_first_capture_ms = 0;
+
+static char     g_power_state[16] = {0};
+static char     g_radio_mode[16] = {0};
+static uint32_t g_radio_avg_ma = 0, g_radio_bursts = 0;
+static uint32_t g_ev_capture_ms = 0, g_ev_upload_ms = 0, g_ev_energy_mj = 0;
+static uint32_t g_ms_published = 0, g_ms_skipped = 0, g_ms_saved = 0;
 static int      g_wifi_rssi = 0;
 static int      g_wifi_ch   = 0;
 
@@ -65,6 +73,15 @@ void ha_init(PubSubClient& client,
 }
 
 void ha_set_boot_time(time_t boot_time_epoch) { g_boot_time = boot_time_epoch; }
+void ha_set_boot_metrics(uint32_t wifi_ms, uint32_t first_capture_ms) {
+  g_boot_wifi_ms = wifi_ms;
+  g_boot_first_capture_ms = first_capture_ms;
+}
+void ha_set_mqtt_stream_stats(uint32_t published, uint32_t skipped, uint32_t bytes_saved) {
+  g_ms_published = published;
+  g_ms_skipped = skipped;
+  g_ms_saved = bytes_saved;
+}
 void ha_set_wifi(int rssi, int channel) { g_wifi_rssi = rssi; g_wifi_ch = channel; }
 void ha_set_pmu(uint16_t vbus_mv, uint16_t sys_mv, uint16_t batt_mv,
                 bool vbus_present, bool batt_present)
@@ -74,6 +91,36 @@ void ha_set_pmu(uint16_t vbus_mv, uint16_t sys_mv, uint16_t batt_mv,
   g_batt_present = batt_present;
 }
 
+void ha_set_power_state(const char* state) {
+  strncpy(g_power_state, state ? state : "", sizeof(g_power_state) - 1);
+}
+
+void ha_set_radio(const char* mode, uint32_t avg_ma, uint32_t bursts) {
+  strncpy(g_radio_mode, mode ? mode : "", sizeof(g_radio_mode) - 1);
+  g_radio_avg_ma = avg_ma;
+  g_radio_bursts = bursts;
+}
+
+void ha_set_power_event(uint32_t wake_to_capture_ms, uint32_t wake_to_upload_ms, uint32_t energy_mj) {
+  g_ev_capture_ms = wake_to_capture_ms;
+  g_ev_upload_ms = wake_to_upload_ms;
+  g_ev_energy_mj = energy_mj;
+  if (!mqtt_ok()) return;
+
+  char t[160], v[24];
+  snprintf(t, sizeof(t), "%s/event_capture_ms", g_base_topic);
+  snprintf(v, sizeof(v), "%lu", (unsigned long)g_ev_capture_ms);
+  pub_retained(t, v);
+
+  snprintf(t, sizeof(t), "%s/event_upload_ms", g_base_topic);
+  snprintf(v, sizeof(v), "%lu", (unsigned long)g_ev_upload_ms);
+  pub_retained(t, v);
+
+  snprintf(t, sizeof(t), "%s/event_energy_mj", g_base_topic);
+  snprintf(v, sizeof(v), "%lu", (unsigned long)g_ev_energy_mj);
+  pub_retained(t, v);
+}
+
 const char* ha_topic_cam_snapshot() { return g_topic_cam_snapshot; }
 const char* ha_topic_cam_stream()   { return g_topic_cam_stream; }
 
@@ -160,6 +207,138 @@ disco_one("sensor", "last_snap_2_url",
   "}"
 );
 
+// ---------- Eventi PIR ----------
+disco_one("sensor", "last_motion",
+  "{"
+    "\"name\":\"BirdCam Last Motion\","
+    "\"unique_id\":\"birdcam_" + String(g_dev_id) + "_last_motion\","
+    "\"state_topic\":\"" + String(g_base_topic) + "/last_motion\","
+    + avail + ","
+    "\"device_class\":\"timestamp\","
+    "\"icon\":\"mdi:motion-sensor\","
+    + dev +
+  "}"
+);
+
+// stato = id evento, attributi = tutto il JSON (catture nuove, inizio/fine, punteggio)
+disco_one("sensor", "last_event",
+  "{"
+    "\"name\":\"BirdCam Last Event\","
+    "\"unique_id\":\"birdcam_" + String(g_dev_id) + "_last_event\","
+    "\"state_topic\":\"" + String(g_base_topic) + "/last_event\","
+    "\"value_template\":\"{{ value_json.event }}\","
+    "\"json_attributes_topic\":\"" + String(g_base_topic) + "/last_event\","
+    + avail + ","
+    "\"icon\":\"mdi:bird\","
+    + dev +
+  "}"
+);
+
+// ---------- Diagnostics: boot timing ----------
+disco_one("sensor", "boot_first_capture_ms",
+  "{"
+    "\"name\":\"BirdCam Boot to First Capture\","
+    "\"unique_id\":\"birdcam_" + String(g_dev_id) + "_boot_first_capture_ms\","
+    "\"state_topic\":\"" + String(g_base_topic) + "/boot_first_capture_ms\","
+    + avail + ","
+    "\"unit_of_measurement\":\"ms\","
+    "\"icon\":\"mdi:timer-outline\","
+    "\"entity_category\":\"diagnostic\","
+    + dev +
+  "}"
+);
+
+disco_one("sensor", "boot_wifi_ms",
+  "{"
+    "\"name\":\"BirdCam Boot to Wi-Fi\","
+    "\"unique_id\":\"birdcam_" + String(g_dev_id) + "_boot_wifi_ms\","
+    "\"state_topic\":\"" + String(g_base_topic) + "/boot_wifi_ms\","
+    + avail + ","
+    "\"unit_of_measurement\":\"ms\","
+    "\"icon\":\"mdi:timer-outline\","
+    "\"entity_category\":\"diagnostic\","
+    + dev +
+  "}"
+);
+
+// ---------- Diagnostics: power manager ----------
+disco_one("sensor", "power_state",
+  "{"
+    "\"name\":\"BirdCam Power State\","
+    "\"unique_id\":\"birdcam_" + String(g_dev_id) + "_power_state\","
+    "\"state_topic\":\"" + String(g_base_topic) + "/power_state\","
+    + avail + ","
+    "\"icon\":\"mdi:power-sleep\","
+    "\"entity_category\":\"diagnostic\","
+    + dev +
+  "}"
+);
+
+disco_one("sensor", "radio_mode",
+  "{"
+    "\"name\":\"BirdCam Radio Mode\","
+    "\"unique_id\":\"birdcam_" + String(g_dev_id) + "_radio_mode\","
+    "\"state_topic\":\"" + String(g_base_topic) + "/radio_mode\","
+    + avail + ","
+    "\"icon\":\"mdi:wifi-cog\","
+    "\"entity_category\":\"diagnostic\","
+    + dev +
+  "}"
+);
+
+disco_one("sensor", "radio_avg_ma",
+  "{"
+    "\"name\":\"BirdCam Average Current\","
+    "\"unique_id\":\"birdcam_" + String(g_dev_id) + "_radio_avg_ma\","
+    "\"state_topic\":\"" + String(g_base_topic) + "/radio_avg_ma\","
+    + avail + ","
+    "\"unit_of_measurement\":\"mA\","
+    "\"device_class\":\"current\","
+    "\"state_class\":\"measurement\","
+    "\"entity_category\":\"diagnostic\","
+    + dev +
+  "}"
+);
+
+disco_one("sensor", "event_capture_ms",
+  "{"
+    "\"name\":\"BirdCam Wake to Capture\","
+    "\"unique_id\":\"birdcam_" + String(g_dev_id) + "_event_capture_ms\","
+    "\"state_topic\":\"" + String(g_base_topic) + "/event_capture_ms\","
+    + avail + ","
+    "\"unit_of_measurement\":\"ms\","
+    "\"icon\":\"mdi:timer-outline\","
+    "\"entity_category\":\"diagnostic\","
+    + dev +
+  "}"
+);
+
+disco_one("sensor", "event_upload_ms",
+  "{"
+    "\"name\":\"BirdCam Wake to Upload\","
+    "\"unique_id\":\"birdcam_" + String(g_dev_id) + "_event_upload_ms\","
+    "\"state_topic\":\"" + String(g_base_topic) + "/event_upload_ms\","
+    + avail + ","
+    "\"unit_of_measurement\":\"ms\","
+    "\"icon\":\"mdi:timer-outline\","
+    "\"entity_category\":\"diagnostic\","
+    + dev +
+  "}"
+);
+
+disco_one("sensor", "event_energy_mj",
+  "{"
+    "\"name\":\"BirdCam Energy per Event\","
+    "\"unique_id\":\"birdcam_" + String(g_dev_id) + "_event_energy_mj\","
+    "\"state_topic\":\"" + String(g_base_topic) + "/event_energy_mj\","
+    + avail + ","
+    "\"unit_of_measurement\":\"mJ\","
+    "\"icon\":\"mdi:lightning-bolt\","
+    "\"entity_category\":\"diagnostic\","
+    + dev +
+  "}"
+);
+
 // Charging inferred: VBUS present AND battery present
 disco_one("binary_sensor", "batt_charging",
   "{"
@@ -174,6 +353,77 @@ disco_one("binary_sensor", "batt_charging",
   "}"
 );
 
+  // ---------- Diagnostics: stream MQTT (soppressione scena statica) ----------
+  {
+    struct StreamSensor { const char* key; const char* name; const char* unit; };
+    const StreamSensor sensors[] = {
+      {"stream_published", "BirdCam Stream Frames Published", ""},
+      {"stream_skipped",   "BirdCam Stream Frames Skipped", ""},
+      {"stream_saved_kb",  "BirdCam Stream Bytes Saved", "kB"},
+    };
+    for (const StreamSensor& x : sensors) {
+      disco_one("sensor", x.key,
+        "{"
+          "\"name\":\"" + String(x.name) + "\","
+          "\"unique_id\":\"birdcam_" + String(g_dev_id) + "_" + x.key + "\","
+          "\"state_topic\":\"" + String(g_base_topic) + "/" + x.key + "\","
+          + avail + ","
+          + (x.unit[0] ? "\"unit_of_measurement\":\"" + String(x.unit) + "\"," : String("")) +
+          "\"state_class\":\"total_increasing\","
+          "\"icon\":\"mdi:image-filter-hdr\","
+          "\"entity_category\":\"diagnostic\","
+          + dev +
+        "}"
+      );
+    }
+  }
+
+  // ---------- Controlli: ROI sensore (<base>/ctrl/<key>, set su .../set) ----------
+  {
+    struct RoiNum { const char* key; const char* name; int min; };
+    const RoiNum nums[] = {
+      {"roi_x", "BirdCam ROI X", 0}, {"roi_y", "BirdCam ROI Y", 0}, {"roi_w", "BirdCam ROI Width", 10},
+    };
+    for (const RoiNum& n : nums) {
+      disco_one("number", n.key,
+        "{"
+          "\"name\":\"" + String(n.name) + "\","
+          "\"unique_id\":\"birdcam_" + String(g_dev_id) + "_" + n.key + "\","
+          "\"state_topic\":\"" + String(g_base_topic) + "/ctrl/" + n.key + "\","
+          "\"command_topic\":\"" + String(g_base_topic) + "/ctrl/" + n.key + "/set\","
+          + avail + ","
+          "\"min\":" + String(n.min) + ",\"max\":100,\"step\":1,"
+          "\"unit_of_measurement\":\"%\","
+          "\"icon\":\"mdi:crop\","
+          "\"entity_category\":\"config\","
+          + dev +
+        "}"
+      );
+    }
+
+    struct RoiSw { const char* key; const char* name; };
+    const RoiSw sws[] = {
+      {"roi_stream", "BirdCam ROI Stream"}, {"roi_snapshot", "BirdCam ROI Snapshot"},
+      {"roi_archive", "BirdCam ROI PIR Archive"}, {"roi_mqtt", "BirdCam ROI MQTT"},
+      {"roi_timelapse", "BirdCam ROI Timelapse"},
+    };
+    for (const RoiSw& w : sws) {
+      disco_one("switch", w.key,
+        "{"
+          "\"name\":\"" + String(w.name) + "\","
+          "\"unique_id\":\"birdcam_" + String(g_dev_id) + "_" + w.key + "\","
+          "\"state_topic\":\"" + String(g_base_topic) + "/ctrl/" + w.key + "\","
+          "\"command_topic\":\"" + String(g_base_topic) + "/ctrl/" + w.key + "/set\","
+          + avail + ","
+          "\"payload_on\":\"ON\",\"payload_off\":\"OFF\","
+          "\"icon\":\"mdi:crop-free\","
+          "\"entity_category\":\"config\","
+          + dev +
+        "}"
+      );
+    }
+  }
+
   // ---------- Camera MQTT: Snapshot (retained) ----------
   disco_one("camera", "snapshot",
     "{"
@@ -197,6 +447,10 @@ disco_one("binary_sensor", "batt_charging",
   );
 }
 
+bool ha_periodic_due(uint32_t now_ms) {
+  return mqtt_ok() && now_ms - g_last_periodic_ms >= 60000;
+}
+
 void ha_publish_periodic(uint32_t now_ms,
                          uint32_t pir_count,
                          int archive_count,
@@ -228,6 +482,40 @@ void ha_publish_periodic(uint32_t now_ms,
   snprintf(v, sizeof(v), "%ld", (long)g_boot_time);
   pub_retained(t, v);
 
+  snprintf(t, sizeof(t), "%s/boot_first_capture_ms", g_base_topic);
+  snprintf(v, sizeof(v), "%lu", (unsigned long)g_boot_first_capture_ms);
+  pub_retained(t, v);
+
+  snprintf(t, sizeof(t), "%s/boot_wifi_ms", g_base_topic);
+  snprintf(v, sizeof(v), "%lu", (unsigned long)g_boot_wifi_ms);
+  pub_retained(t, v);
+
+  snprintf(t, sizeof(t), "%s/power_state", g_base_topic);
+  pub_retained(t, g_power_state);
+
+  snprintf(t, sizeof(t), "%s/radio_mode", g_base_topic);
+  pub_retained(t, g_radio_mode);
+
+  snprintf(t, sizeof(t), "%s/radio_avg_ma", g_base_topic);
+  snprintf(v, sizeof(v), "%lu", (unsigned long)g_radio_avg_ma);
+  pub_retained(t, v);
+
+  snprintf(t, sizeof(t), "%s/radio_bursts", g_base_topic);
+  snprintf(v, sizeof(v), "%lu", (unsigned long)g_radio_bursts);
+  pub_retained(t, v);
+
+  snprintf(t, sizeof(t), "%s/stream_published", g_base_topic);
+  snprintf(v, sizeof(v), "%lu", (unsigned long)g_ms_published);
+  pub_retained(t, v);
+
+  snprintf(t, sizeof(t), "%s/stream_skipped", g_base_topic);
+  snprintf(v, sizeof(v), "%lu", (unsigned long)g_ms_skipped);
+  pub_retained(t, v);
+
+  snprintf(t, sizeof(t), "%s/stream_saved_kb", g_base_topic);
+  snprintf(v, sizeof(v), "%lu", (unsigned long)(g_ms_saved / 1024));
+  pub_retained(t, v);
+
   snprintf(t, sizeof(t), "%s/vbus_mv", g_base_topic);
   snprintf(v, sizeof(v), "%u", (unsigned)g_vbus);
   pub_retained(t, v);
@@ -291,9 +579,27 @@ void ha_on_pir(uint32_t pir_count, int archive_count, const char* ip, long ts_ep
   snprintf(v, sizeof(v), "%d", archive_count);
   pub_retained(t, v);
 
+  // Ultimo movimento (sensore timestamp HA): solo con l'ora valida
+  if (ts_epoch > 0) {
+    time_t tt = (time_t)ts_epoch;
+    struct tm tm_utc;
+    gmtime_r(&tt, &tm_utc);
+    snprintf(t, sizeof(t), "%s/last_motion", g_base_topic);
+    strftime(v, sizeof(v), "%Y-%m-%dT%H:%M:%S+00:00", &tm_utc);
+    pub_retained(t, v);
+  }
+
   // Se vuoi, qui potremmo anche pubblicare URL http (ma tu vuoi snapshot in MQTT: già lo fai via camera topic)
   (void)ip;
-  (void)ts_epoch;
+}
+
+void ha_publish_event(const char* json) {
+  if (!mqtt_ok() || !json) return;
+  char t[160];
+  snprintf(t, sizeof(t), "%s/event", g_base_topic);
+  pub(t, json);
+  snprintf(t, sizeof(t), "%s/last_event", g_base_topic);
+  pub_retained(t, json);
 }
 
 void ha_pir_off() {
@@ -1,35 +1,48 @@
-#pragma once
-
-#include <Arduino.h>
-#include <time.h>
-#include <PubSubClient.h>
-
-// Init (da chiamare una volta dopo che hai calcolato dev_id/topic)
-void ha_init(PubSubClient& client,
-             const char* dev_id,
-             const char* base_topic,
-             const char* status_topic,
-             const char* fw_version);
-
-// Discovery (da chiamare ad ogni connessione MQTT riuscita)
-void ha_publish_discovery();
-
-// Setters (aggiorna cache interna per discovery/telemetria)
-void ha_set_boot_time(time_t boot_time_epoch);
-void ha_set_wifi(int rssi, int channel);
-void ha_set_pmu(uint16_t vbus_mv, uint16_t sys_mv, uint16_t batt_mv,
-                bool vbus_present, bool batt_present);
-
-// Telemetria periodica (consigliato 60s)
-void ha_publish_periodic(uint32_t now_ms,
-                         uint32_t pir_count,
-                         int archive_count,
-                         const char* ip);
-
-// Eventi PIR
-void ha_on_pir(uint32_t pir_count, int archive_count, const char* ip, long ts_epoch);
-void ha_pir_off();
-
-// Topic helper per camera (così BirdCam.ino sa dove pubblicare i frame)
-const char* ha_topic_cam_snapshot(); // retained frame
-const char* ha_topic_cam_stream();   // non-retained frames
+#pragma once
+
+#include <Arduino.h>
+#include <time.h>
+#include <PubSubClient.h>
+
+// Init (da chiamare una volta dopo che hai calcolato dev_id/topic)
+void ha_init(PubSubClient& client,
+             const char* dev_id,
+             const char* base_topic,
+             const char* status_topic,
+             const char* fw_version);
+
+// Discovery (da chiamare ad ogni connessione MQTT riuscita)
+void ha_publish_discovery();
+
+// Setters (aggiorna cache interna per discovery/telemetria)
+void ha_set_boot_time(time_t boot_time_epoch);
+void ha_set_boot_metrics(uint32_t wifi_ms, uint32_t first_capture_ms);
+void ha_set_power_state(const char* state);
+// Politica radio: modalità power-save, corrente media stimata (mA), burst di upload
+void ha_set_radio(const char* mode, uint32_t avg_ma, uint32_t bursts);
+// Ultimo evento: wake->cattura, wake->upload (ms) e energia stimata (mJ)
+void ha_set_power_event(uint32_t wake_to_capture_ms, uint32_t wake_to_upload_ms, uint32_t energy_mj);
+// Stream MQTT con soppressione scena statica: frame pubblicati/saltati, byte risparmiati
+void ha_set_mqtt_stream_stats(uint32_t published, uint32_t skipped, uint32_t bytes_saved);
+void ha_set_wifi(int rssi, int channel);
+void ha_set_pmu(uint16_t vbus_mv, uint16_t sys_mv, uint16_t batt_mv,
+                bool vbus_present, bool batt_present);
+
+// Telemetria periodica (consigliato 60s); due = intervallo scaduto, per
+// accodarla al prossimo burst di upload
+bool ha_periodic_due(uint32_t now_ms);
+void ha_publish_periodic(uint32_t now_ms,
+                         uint32_t pir_count,
+                         int archive_count,
+                         const char* ip);
+
+// Eventi PIR (ts_epoch = 0: ora non ancora sincronizzata)
+void ha_on_pir(uint32_t pir_count, int archive_count, const char* ip, long ts_epoch);
+// Evento con gli id delle catture nuove (JSON di ev_format_json): <base>/event,
+// più <base>/last_event retained per il sensore HA
+void ha_publish_event(const char* json);
+void ha_pir_off();
+
+// Topic helper per camera (così BirdCam.ino sa dove pubblicare i frame)
+const char* ha_topic_cam_snapshot(); // retained frame
+const char* ha_topic_cam_stream();   // non-retained frames
@@ -0,0 +1,298 @@
+#include "birdcam_kernels.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Le versioni SWAR leggono parole a 32 bit little-endian (Xtensa, x86, ARM)
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "SWAR kernels assume little-endian");
+
+#define LANES(v) ((uint32_t)(v) * 0x00010001u)   // stesso valore nelle due corsie a 16 bit
+
+// Load a 32 bit da indirizzo allineato (su Xtensa un solo l32i)
+static inline uint32_t load32a(const uint8_t* p) {
+  uint32_t w;
+  memcpy(&w, __builtin_assume_aligned(p, 4), 4);
+  return w;
+}
+
+static inline uint8_t luma1(const uint8_t* p) {
+  uint16_t v = (uint16_t)((p[0] << 8) | p[1]);
+  uint32_t r = (v >> 11) << 3, g = ((v >> 5) & 0x3F) << 2, b = (v & 0x1F) << 3;
+  return (uint8_t)((r * 77 + g * 150 + b * 29) >> 8);
+}
+
+// Due pixel RGB565 big-endian in una parola -> due luma (corsie a 16 bit).
+// Il massimo per corsia è 248*77 + 252*150 + 248*29 = 64088: niente riporti.
+static inline uint32_t luma2(uint32_t w) {
+  uint32_t v = ((w & 0x00FF00FFu) << 8) | ((w >> 8) & 0x00FF00FFu);   // byte swap per corsia
+  uint32_t r = (v >> 8) & 0x00F800F8u;
+  uint32_t g = (v >> 3) & 0x00FC00FCu;
+  uint32_t b = (v << 3) & 0x00F800F8u;
+  return ((r * 77 + g * 150 + b * 29) >> 8) & 0x00FF00FFu;
+}
+
+// ---------------- luma ----------------
+void kern_luma_ref(const uint8_t* p, size_t n, uint8_t* y) {
+  for (size_t i = 0; i < n; i++) y[i] = luma1(p + 2 * i);
+}
+
+void kern_luma(const uint8_t* p, size_t n, uint8_t* y) {
+  while (n && ((uintptr_t)p & 3)) { *y++ = luma1(p); p += 2; n--; }
+  while (n >= 4) {
+    uint32_t a = luma2(load32a(p));
+    uint32_t b = luma2(load32a(p + 4));
+    y[0] = (uint8_t)a; y[1] = (uint8_t)(a >> 16);
+    y[2] = (uint8_t)b; y[3] = (uint8_t)(b >> 16);
+    p += 8; y += 4; n -= 4;
+  }
+  while (n) { *y++ = luma1(p); p += 2; n--; }
+}
+
+// ---------------- griglia di luma ----------------
+void kern_luma_grid_ref(const uint8_t* rgb, int w, int h, int gw, int gh, uint8_t* out) {
+  for (int gy = 0; gy < gh; gy++) {
+    int y0 = gy * h / gh, y1 = (gy + 1) * h / gh;
+    if (y1 <= y0) y1 = y0 + 1;
+    for (int gx = 0; gx < gw; gx++) {
+      int x0 = gx * w / gw, x1 = (gx + 1) * w / gw;
+      if (x1 <= x0) x1 = x0 + 1;
+      uint32_t sum = 0, n = 0;
+      for (int y = y0; y < y1 && y < h; y++) {
+        for (int x = x0; x < x1 && x < w; x++) {
+          sum += luma1(rgb + ((size_t)y * w + x) * 2);
+          n++;
+        }
+      }
+      out[gy * gw + gx] = (uint8_t)(n ? sum / n : 0);
+    }
+  }
+}
+
+// Somma di byte a 4 per volta (corsie a 16 bit, svuotate prima del riporto)
+static uint32_t sum_bytes(const uint8_t* y, size_t n) {
+  uint32_t s = 0;
+  while (n && ((uintptr_t)y & 3)) { s += *y++; n--; }
+  while (n >= 4) {
+    size_t k = n / 4;
+    if (k > 128) k = 128;                     // 128 * 2 * 255 < 65536
+    uint32_t acc = 0;
+    for (size_t i = 0; i < k; i++, y += 4) {
+      uint32_t w = load32a(y);
+      acc += (w & 0x00FF00FFu) + ((w >> 8) & 0x00FF00FFu);
+    }
+    s += (acc & 0xFFFF) + (acc >> 16);
+    n -= k * 4;
+  }
+  while (n) { s += *y++; n--; }
+  return s;
+}
+
+void kern_luma_grid(const uint8_t* rgb, int w, int h, int gw, int gh, uint8_t* out) {
+  if (gw > KERN_GRID_MAX_W || w <= 0) { kern_luma_grid_ref(rgb, w, h, gw, gh, out); return; }
+  uint32_t line[64];                          // 256 luma, allineati
+  uint8_t* ly = (uint8_t*)line;
+  int xs[KERN_GRID_MAX_W], xe[KERN_GRID_MAX_W];   // colonne [xs, xe) di ogni cella
+  for (int gx = 0; gx < gw; gx++) {
+    int x0 = gx * w / gw, x1 = (gx + 1) * w / gw;
+    if (x1 <= x0) x1 = x0 + 1;
+    xs[gx] = x0;
+    xe[gx] = x1 > w ? w : x1;
+  }
+  uint32_t sums[KERN_GRID_MAX_W];
+  for (int gy = 0; gy < gh; gy++) {
+    int y0 = gy * h / gh, y1 = (gy + 1) * h / gh;
+    if (y1 <= y0) y1 = y0 + 1;
+    if (y1 > h) y1 = h;
+    memset(sums, 0, sizeof(sums));
+    for (int y = y0; y < y1; y++) {
+      const uint8_t* row = rgb + (size_t)y * w * 2;
+      // luma della riga a blocchi di 256, poi le somme delle celle che il blocco copre
+      for (int c0 = 0; c0 < w; c0 += (int)sizeof(line)) {
+        int c1 = c0 + (int)sizeof(line) < w ? c0 + (int)sizeof(line) : w;
+        kern_luma(row + (size_t)c0 * 2, (size_t)(c1 - c0), ly);
+        for (int gx = 0; gx < gw; gx++) {
+          int a = xs[gx] > c0 ? xs[gx] : c0;
+          int b = xe[gx] < c1 ? xe[gx] : c1;
+          if (a < b) sums[gx] += sum_bytes(ly + (a - c0), (size_t)(b - a));
+        }
+      }
+    }
+    for (int gx = 0; gx < gw; gx++) {
+      uint32_t n = (y1 > y0 && xe[gx] > xs[gx]) ? (uint32_t)(y1 - y0) * (uint32_t)(xe[gx] - xs[gx]) : 0;
+      out[gy * gw + gx] = (uint8_t)(n ? sums[gx] / n : 0);
+    }
+  }
+}
+
+// ---------------- differenza fra frame ----------------
+uint32_t kern_diff_count_ref(const uint8_t* a, const uint8_t* b, size_t n, uint8_t delta) {
+  uint32_t c = 0;
+  for (size_t i = 0; i < n; i++) {
+    int d = (int)a[i] - (int)b[i];
+    if (d > delta || d < -(int)delta) c++;
+  }
+  return c;
+}
+
+// Corsie a 16 bit con x = 256 + a - b (1..511): il bit 15 di x + K1 dice
+// a - b > delta, quello di K2 - x dice a - b < -delta.
+static inline uint32_t diff_lanes(uint32_t a, uint32_t b, uint32_t k1, uint32_t k2) {
+  uint32_t x = (a | LANES(0x100)) - b;
+  return (((x + k1) | (k2 - x)) & 0x80008000u) >> 15;
+}
+
+uint32_t kern_diff_count(const uint8_t* a, const uint8_t* b, size_t n, uint8_t delta) {
+  uint32_t c = 0;
+  while (n && ((uintptr_t)a & 3)) {
+    int d = (int)*a++ - (int)*b++;
+    if (d > delta || d < -(int)delta) c++;
+    n--;
+  }
+  if ((uintptr_t)b & 3) return c + kern_diff_count_ref(a, b, n, delta);
+
+  const uint32_t k1 = LANES(0x8000 - 257 - delta);
+  const uint32_t k2 = LANES(0x8000 + 255 - delta);
+  while (n >= 4) {
+    size_t k = n / 4;
+    if (k > 16384) k = 16384;                 // 2 per parola per corsia
+    uint32_t acc = 0;
+    for (size_t i = 0; i < k; i++, a += 4, b += 4) {
+      uint32_t wa = load32a(a), wb = load32a(b);
+      acc += diff_lanes(wa & 0x00FF00FFu, wb & 0x00FF00FFu, k1, k2);
+      acc += diff_lanes((wa >> 8) & 0x00FF00FFu, (wb >> 8) & 0x00FF00FFu, k1, k2);
+    }
+    c += (acc & 0xFFFF) + (acc >> 16);
+    n -= k * 4;
+  }
+  return c + kern_diff_count_ref(a, b, n, delta);
+}
+
+// ---------------- istogramma ----------------
+void kern_histogram_ref(const uint8_t* y, size_t n, uint32_t hist[256]) {
+  memset(hist, 0, 256 * sizeof(uint32_t));
+  for (size_t i = 0; i < n; i++) hist[y[i]]++;
+}
+
+// Due istogrammi alternati: incrementi consecutivi dello stesso livello
+// (zone uniformi) non aspettano lo store precedente
+void kern_histogram(const uint8_t* y, size_t n, uint32_t hist[256]) {
+  uint32_t h1[256];
+  memset(hist, 0, 256 * sizeof(uint32_t));
+  memset(h1, 0, sizeof(h1));
+  while (n && ((uintptr_t)y & 3)) { hist[*y++]++; n--; }
+  for (; n >= 4; n -= 4, y += 4) {
+    uint32_t w = load32a(y);
+    hist[w & 0xFF]++;
+    h1[(w >> 8) & 0xFF]++;
+    hist[(w >> 16) & 0xFF]++;
+    h1[w >> 24]++;
+  }
+  while (n) { hist[*y++]++; n--; }
+  for (int i = 0; i < 256; i++) hist[i] += h1[i];
+}
+
+// ---------------- rotazione ----------------
+void kern_rotate90_ref(const uint8_t* src, int w, int h, uint8_t* dst, bool cw) {
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      // uscita h x w: orario (x, y) -> (h-1-y, x), antiorario -> (y, w-1-x)
+      size_t o = cw ? (size_t)x * h + (h - 1 - y) : (size_t)(w - 1 - x) * h + y;
+      dst[o * 2]     = src[((size_t)y * w + x) * 2];
+      dst[o * 2 + 1] = src[((size_t)y * w + x) * 2 + 1];
+    }
+  }
+}
+
+// A tile 16x16: le righe lette e scritte restano in cache invece di
+// attraversare la PSRAM con passo h a ogni pixel
+#define ROT_TILE 16
+
+void kern_rotate90(const uint8_t* src, int w, int h, uint8_t* dst, bool cw) {
+  if (((uintptr_t)src | (uintptr_t)dst) & 1) { kern_rotate90_ref(src, w, h, dst, cw); return; }
+  const uint16_t* s = (const uint16_t*)src;
+  uint16_t* d = (uint16_t*)dst;
+  for (int ty = 0; ty < h; ty += ROT_TILE) {
+    int ye = ty + ROT_TILE < h ? ty + ROT_TILE : h;
+    for (int tx = 0; tx < w; tx += ROT_TILE) {
+      int xe = tx + ROT_TILE < w ? tx + ROT_TILE : w;
+      for (int x = tx; x < xe; x++) {
+        // riga di uscita: scritture contigue, letture lungo la colonna x
+        if (cw) {
+          uint16_t* o = d + (size_t)x * h + (h - 1 - ty);
+          const uint16_t* i = s + (size_t)ty * w + x;
+          for (int y = ty; y < ye; y++, i += w) *o-- = *i;
+        } else {
+          uint16_t* o = d + (size_t)(w - 1 - x) * h + ty;
+          const uint16_t* i = s + (size_t)ty * w + x;
+          for (int y = ty; y < ye; y++, i += w) *o++ = *i;
+        }
+      }
+    }
+  }
+}
+
+// ---------------- benchmark ----------------
+static uint32_t lcg(uint32_t* st) {
+  *st = *st * 1664525u + 1013904223u;
+  return *st >> 8;
+}
+
+int kern_bench(uint32_t (*cycles)(), int w, int h, kern_bench_t* out, int max) {
+  if (!cycles || !out || w < 16 || h < 16 || max < KERN_BENCH_COUNT) return 0;
+  size_t n = (size_t)w * h;
+  uint8_t* rgb  = (uint8_t*)malloc(n * 2);
+  uint8_t* rot0 = (uint8_t*)malloc(n * 2);
+  uint8_t* rot1 = (uint8_t*)malloc(n * 2);
+  uint8_t* ya   = (uint8_t*)malloc(n);
+  uint8_t* yb   = (uint8_t*)malloc(n);
+  uint8_t* yc   = (uint8_t*)malloc(n);
+  uint32_t* h0  = (uint32_t*)malloc(256 * sizeof(uint32_t));
+  uint32_t* h1  = (uint32_t*)malloc(256 * sizeof(uint32_t));
+  int cnt = 0;
+  if (rgb && rot0 && rot1 && ya && yb && yc && h0 && h1) {
+    uint32_t st = 0xB1DCA3u;
+    for (size_t i = 0; i < n * 2; i++) rgb[i] = (uint8_t)lcg(&st);
+
+    uint32_t t0, t1, t2;
+    bool ok;
+
+    t0 = cycles(); kern_luma_ref(rgb, n, ya);
+    t1 = cycles(); kern_luma(rgb, n, yb);
+    t2 = cycles();
+    out[cnt++] = {"luma", (uint32_t)n, t1 - t0, t2 - t1, memcmp(ya, yb, n) == 0};
+
+    uint8_t g0[KERN_GRID_MAX_W * 24], g1[KERN_GRID_MAX_W * 24];
+    t0 = cycles(); kern_luma_grid_ref(rgb, w, h, 16, 12, g0);
+    t1 = cycles(); kern_luma_grid(rgb, w, h, 16, 12, g1);
+    t2 = cycles();
+    out[cnt++] = {"luma_grid", (uint32_t)n, t1 - t0, t2 - t1, memcmp(g0, g1, 16 * 12) == 0};
+
+    // secondo frame: stessa scena con un quarto dei pixel perturbati
+    for (size_t i = 0; i < n; i++) yc[i] = (lcg(&st) & 3) ? ya[i] : (uint8_t)(ya[i] + (lcg(&st) & 63) - 32);
+    uint32_t c0, c1;
+    t0 = cycles(); c0 = kern_diff_count_ref(ya, yc, n, 10);
+    t1 = cycles(); c1 = kern_diff_count(ya, yc, n, 10);
+    t2 = cycles();
+    ok = c0 == c1 && kern_diff_count_ref(ya, yc, n, 0) == kern_diff_count(ya, yc, n, 0) &&
+         kern_diff_count_ref(ya, yc, n, 255) == kern_diff_count(ya, yc, n, 255);
+    out[cnt++] = {"diff_count", (uint32_t)n, t1 - t0, t2 - t1, ok};
+
+    t0 = cycles(); kern_histogram_ref(ya, n, h0);
+    t1 = cycles(); kern_histogram(ya, n, h1);
+    t2 = cycles();
+    out[cnt++] = {"histogram", (uint32_t)n, t1 - t0, t2 - t1, memcmp(h0, h1, 256 * sizeof(uint32_t)) == 0};
+
+    t0 = cycles(); kern_rotate90_ref(rgb, w, h, rot0, true);
+    t1 = cycles(); kern_rotate90(rgb, w, h, rot1, true);
+    t2 = cycles();
+    ok = memcmp(rot0, rot1, n * 2) == 0;
+    kern_rotate90_ref(rgb, w, h, rot0, false);
+    kern_rotate90(rgb, w, h, rot1, false);
+    ok = ok && memcmp(rot0, rot1, n * 2) == 0;
+    out[cnt++] = {"rotate90", (uint32_t)n, t1 - t0, t2 - t1, ok};
+  }
+  free(rgb); free(rot0); free(rot1);
+  free(ya); free(yb); free(yc);
+  free(h0); free(h1);
+  return cnt;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Kernel per-pixel su RGB565 big-endian (come jpg2rgb565) e luma a 8 bit.
+// Ogni kernel ha una versione di riferimento kern_*_ref (scalare, un pixel
+// alla volta) e quella usata dal firmware: SWAR a 32 bit (due pixel RGB565 o
+// quattro byte di luma per load), loop srotolati, tile per la PSRAM.
+// Le due versioni danno risultati identici bit per bit: kern_bench() lo
+// verifica sul dispositivo (/api/kernels).
+// Modulo puro: nessuna dipendenza da Arduino/IDF.
+
+#define KERN_GRID_MAX_W 32
+
+// Luma BT.601 intera: (r*77 + g*150 + b*29) >> 8, r/g/b espansi a 8 bit.
+// y può coincidere con rgb565 (sul posto).
+void kern_luma(const uint8_t* rgb565, size_t n, uint8_t* y);
+void kern_luma_ref(const uint8_t* rgb565, size_t n, uint8_t* y);
+
+// Media di luma per cella, griglia gw x gh (gw <= KERN_GRID_MAX_W) su w x h;
+// le celle si dividono w e h come gx*w/gw .. (gx+1)*w/gw
+void kern_luma_grid(const uint8_t* rgb565, int w, int h, int gw, int gh, uint8_t* out);
+void kern_luma_grid_ref(const uint8_t* rgb565, int w, int h, int gw, int gh, uint8_t* out);
+
+// Differenza fra frame: pixel con |a - b| > delta
+uint32_t kern_diff_count(const uint8_t* a, const uint8_t* b, size_t n, uint8_t delta);
+uint32_t kern_diff_count_ref(const uint8_t* a, const uint8_t* b, size_t n, uint8_t delta);
+
+// Istogramma a 256 livelli (azzera hist)
+void kern_histogram(const uint8_t* y, size_t n, uint32_t hist[256]);
+void kern_histogram_ref(const uint8_t* y, size_t n, uint32_t hist[256]);
+
+// Rotazione di 90° RGB565: w x h -> h x w (cw = orario, come rotate(90deg) nel CSS)
+void kern_rotate90(const uint8_t* src, int w, int h, uint8_t* dst, bool cw);
+void kern_rotate90_ref(const uint8_t* src, int w, int h, uint8_t* dst, bool cw);
+
+// ---- Benchmark / self-check ----
+struct kern_bench_t {
+  const char* name;
+  uint32_t    pixels;
+  uint32_t    ref_cycles;
+  uint32_t    fast_cycles;
+  bool        exact;        // uscita identica al riferimento
+};
+
+#define KERN_BENCH_COUNT 5
+
+// Esegue ogni kernel (riferimento e veloce) su un'immagine sintetica w x h
+// (pseudo-casuale, deterministica) contando i cicli con cycles().
+// Ritorna il numero di voci scritte (0 = memoria insufficiente).
+int kern_bench(uint32_t (*cycles)(), int w, int h, kern_bench_t* out, int max);
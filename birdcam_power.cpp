@@ -0,0 +1,113 @@
+#include "birdcam_power.h"
+
+#include <string.h>
+
+static const char* STATE_NAMES[PWR_STATE_COUNT] = {
+  "full", "modem_sleep", "light_sleep", "deep_sleep"
+};
+
+void pwr_default_config(pwr_config_t* cfg) {
+  if (!cfg) return;
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->vbus_present_mv    = 1000;
+  cfg->batt_critical_mv   = 3300;
+  cfg->light_idle_ms      = 60000;
+  cfg->deep_idle_ms       = 900000;
+  cfg->deep_sleep_enabled = false;
+
+  cfg->state_ma[PWR_FULL]        = 180;
+  cfg->state_ma[PWR_MODEM_SLEEP] = 70;
+  cfg->state_ma[PWR_LIGHT_SLEEP] = 12;  // camera alimentata, CPU/radio ferme
+  cfg->state_ma[PWR_DEEP_SLEEP]  = 1;
+  cfg->capture_ma = 160;
+  cfg->upload_ma  = 220;
+}
+
+void pwr_init(pwr_sm_t* sm, const pwr_config_t* cfg, uint32_t now_ms) {
+  if (!sm) return;
+  memset(sm, 0, sizeof(*sm));
+  if (cfg) sm->cfg = *cfg;
+  else pwr_default_config(&sm->cfg);
+  sm->state = PWR_FULL;
+  sm->state_since_ms = now_ms;
+  sm->last_activity_ms = now_ms;
+  sm->last_update_ms = now_ms;
+}
+
+static pwr_state_t next_state(const pwr_sm_t* sm, const pwr_inputs_t* in) {
+  const pwr_config_t& c = sm->cfg;
+
+  if (in->vbus_mv > c.vbus_present_mv) return PWR_FULL;
+
+  if (c.deep_sleep_enabled && in->batt_mv && in->batt_mv < c.batt_critical_mv &&
+      !in->pir_active && !in->upload_pending) {
+    return PWR_DEEP_SLEEP;
+  }
+
+  uint32_t idle = in->now_ms - sm->last_activity_ms;
+  if (idle < c.light_idle_ms) return PWR_MODEM_SLEEP;
+  if (c.deep_sleep_enabled && idle >= c.deep_idle_ms) return PWR_DEEP_SLEEP;
+  return PWR_LIGHT_SLEEP;
+}
+
+pwr_state_t pwr_update(pwr_sm_t* sm, const pwr_inputs_t* in) {
+  if (!sm || !in) return PWR_FULL;
+
+  sm->time_in_state_ms[sm->state] += in->now_ms - sm->last_update_ms;
+  sm->last_update_ms = in->now_ms;
+  sm->batt_mv = in->batt_mv;
+
+  bool active = in->pir_active || in->stream_clients > 0 || in->upload_pending;
+  if (active) sm->last_activity_ms = in->now_ms;
+  if (in->last_http_ms && (int32_t)(in->last_http_ms - sm->last_activity_ms) > 0) {
+    sm->last_activity_ms = in->last_http_ms;
+  }
+
+  pwr_state_t ns = next_state(sm, in);
+  if (ns != sm->state) {
+    sm->state = ns;
+    sm->state_since_ms = in->now_ms;
+    sm->transitions++;
+  }
+  return sm->state;
+}
+
+void pwr_event_wake(pwr_sm_t* sm, int64_t t_us) {
+  if (!sm) return;
+  sm->ev_wake_us = t_us;
+  sm->ev_stage = PWR_STAGE_CAPTURE;
+  memset(&sm->ev_cur, 0, sizeof(sm->ev_cur));
+}
+
+// Energia = V * I * t, con I dal modello: cattura/archivio a capture_ma,
+// upload a upload_ma (uJ = mV * mA * us / 1e6)
+static uint32_t event_energy_uj(const pwr_sm_t* sm, const pwr_event_t* ev) {
+  uint32_t mv = sm->batt_mv ? sm->batt_mv : 3700;
+  uint64_t t_cap = ev->stage_us[PWR_STAGE_STORE];
+  uint64_t t_up  = ev->stage_us[PWR_STAGE_UPLOAD] > t_cap ? ev->stage_us[PWR_STAGE_UPLOAD] - t_cap : 0;
+  uint64_t uj = ((uint64_t)mv * sm->cfg.capture_ma * t_cap + (uint64_t)mv * sm->cfg.upload_ma * t_up) / 1000000ULL;
+  return (uint32_t)uj;
+}
+
+void pwr_event_mark(pwr_sm_t* sm, pwr_stage_t stage, int64_t t_us) {
+  if (!sm || sm->ev_stage == 0 || stage <= PWR_STAGE_WAKE || stage >= PWR_STAGE_COUNT) return;
+  if (stage < sm->ev_stage) return;   // tappa già registrata
+
+  int64_t dt = t_us - sm->ev_wake_us;
+  uint32_t v = dt > 0 ? (uint32_t)dt : 0;
+  // tappe saltate (es. store fallito) ereditano il tempo della tappa corrente
+  for (int s = sm->ev_stage; s <= stage; s++) sm->ev_cur.stage_us[s] = v;
+  sm->ev_stage = (uint8_t)(stage + 1);
+
+  if (stage == PWR_STAGE_UPLOAD) {
+    sm->ev_cur.valid = true;
+    sm->ev_cur.energy_uj = event_energy_uj(sm, &sm->ev_cur);
+    sm->ev_last = sm->ev_cur;
+    sm->ev_stage = 0;
+    sm->events++;
+  }
+}
+
+const char* pwr_state_name(pwr_state_t s) {
+  return (s >= 0 && s < PWR_STATE_COUNT) ? STATE_NAMES[s] : "?";
+}
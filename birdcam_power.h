@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Gestione alimentazione: macchina a stati pura (niente Arduino/IDF),
+// alimentata con letture PMU/PIR e applicata da BirdCam.ino.
+//
+//   VBUS presente                      -> PWR_FULL
+//   batteria + attività (PIR/stream/upload/http) -> PWR_MODEM_SLEEP
+//   batteria + idle >= light_idle_ms   -> PWR_LIGHT_SLEEP (radio off, wake da PIR)
+//   batteria + idle >= deep_idle_ms    -> PWR_DEEP_SLEEP  (se abilitato)
+//   batteria sotto batt_critical_mv    -> PWR_DEEP_SLEEP  (se abilitato)
+
+enum pwr_state_t {
+  PWR_FULL = 0,
+  PWR_MODEM_SLEEP,
+  PWR_LIGHT_SLEEP,
+  PWR_DEEP_SLEEP,
+  PWR_STATE_COUNT
+};
+
+// Tappe del percorso evento: wake -> cattura -> archivio -> upload
+enum pwr_stage_t {
+  PWR_STAGE_WAKE = 0,
+  PWR_STAGE_CAPTURE,
+  PWR_STAGE_STORE,
+  PWR_STAGE_UPLOAD,
+  PWR_STAGE_COUNT
+};
+
+struct pwr_config_t {
+  uint16_t vbus_present_mv;   // soglia VBUS (come on_external_power)
+  uint16_t batt_critical_mv;  // sotto: deep sleep (se abilitato)
+  uint32_t light_idle_ms;     // idle su batteria prima del light sleep
+  uint32_t deep_idle_ms;      // idle su batteria prima del deep sleep
+  bool     deep_sleep_enabled;
+
+  // Modello di consumo (mA) per la stima energetica: il PMU AXP2101
+  // misura tensioni ma non la corrente di batteria.
+  uint16_t state_ma[PWR_STATE_COUNT];
+  uint16_t capture_ma;        // camera + CPU durante wake/cattura/archivio
+  uint16_t upload_ma;         // radio attiva durante l'upload
+};
+
+struct pwr_inputs_t {
+  uint32_t now_ms;
+  uint16_t vbus_mv;
+  uint16_t batt_mv;
+  bool     pir_active;        // livello PIR alto o cattura in corso
+  int      stream_clients;    // MJPEG/RTSP collegati
+  bool     upload_pending;    // evento non ancora pubblicato
+  uint32_t last_http_ms;      // ultima richiesta web (0 = mai)
+};
+
+struct pwr_event_t {
+  bool     valid;
+  uint32_t stage_us[PWR_STAGE_COUNT]; // tempo da wake a fine tappa (wake = 0)
+  uint32_t energy_uj;                 // stima wake -> upload
+};
+
+struct pwr_sm_t {
+  pwr_config_t cfg;
+  pwr_state_t  state;
+  uint32_t     state_since_ms;
+  uint32_t     last_activity_ms;
+  uint32_t     last_update_ms;
+  uint32_t     time_in_state_ms[PWR_STATE_COUNT];
+  uint32_t     transitions;
+  uint16_t     batt_mv;
+
+  // evento in corso / ultimo completato
+  int64_t      ev_wake_us;
+  uint8_t      ev_stage;              // prossima tappa attesa
+  pwr_event_t  ev_cur;
+  pwr_event_t  ev_last;
+  uint32_t     events;
+};
+
+void        pwr_default_config(pwr_config_t* cfg);
+void        pwr_init(pwr_sm_t* sm, const pwr_config_t* cfg, uint32_t now_ms);
+
+// Ritorna il nuovo stato (uguale al precedente se nessuna transizione)
+pwr_state_t pwr_update(pwr_sm_t* sm, const pwr_inputs_t* in);
+
+// Strumentazione evento (t_us = esp_timer o clock simulato)
+void        pwr_event_wake(pwr_sm_t* sm, int64_t t_us);
+void        pwr_event_mark(pwr_sm_t* sm, pwr_stage_t stage, int64_t t_us);
+
+const char* pwr_state_name(pwr_state_t s);
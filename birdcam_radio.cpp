@@ -0,0 +1,131 @@
+#include "birdcam_radio.h"
+
+#include <string.h>
+
+static const char* MODE_NAMES[RADIO_MODE_COUNT] = {
+  "none", "min_modem", "max_modem", "off"
+};
+
+void radio_default_config(radio_config_t* cfg) {
+  if (!cfg) return;
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->idle_ms         = 10000;
+  cfg->listen_interval = 10;     // ~1 s con beacon a 102.4 ms
+  cfg->batch_ms        = 5000;
+  cfg->batch_max       = 4;
+
+  // stessi valori di pwr_default_config dove coincidono
+  cfg->mode_ma[RADIO_PS_NONE]      = 180;
+  cfg->mode_ma[RADIO_PS_MIN_MODEM] = 70;
+  cfg->mode_ma[RADIO_PS_MAX_MODEM] = 45;
+  cfg->mode_ma[RADIO_OFF]          = 12;
+  cfg->tx_ma   = 40;
+  cfg->tx_kbps = 4000;
+}
+
+void radio_init(radio_policy_t* p, const radio_config_t* cfg, uint32_t now_ms) {
+  if (!p) return;
+  memset(p, 0, sizeof(*p));
+  if (cfg) p->cfg = *cfg;
+  else radio_default_config(&p->cfg);
+  p->mode = RADIO_PS_NONE;
+  p->mode_since_ms = now_ms;
+  p->last_update_ms = now_ms;
+  p->last_activity_ms = now_ms;
+  p->st[RADIO_PS_NONE].entries = 1;
+}
+
+// Coda upload: il burst parte quando conviene svegliare la radio, poi
+// resta aperto finché la coda non è vuota
+static void update_flush(radio_policy_t* p, const radio_inputs_t* in) {
+  const radio_config_t& c = p->cfg;
+
+  if (in->uploads_queued <= 0) {
+    p->flushing = false;
+    p->queued = false;
+    return;
+  }
+  if (!p->queued) {
+    p->queued = true;
+    p->queued_since_ms = in->now_ms;
+  }
+  if (p->flushing || in->radio_off) return;
+
+  bool now = in->on_vbus || in->stream_clients > 0 ||
+             in->uploads_queued >= c.batch_max ||
+             in->now_ms - p->queued_since_ms >= c.batch_ms;
+  if (now) {
+    p->flushing = true;
+    p->bursts++;
+  }
+}
+
+static radio_mode_t next_mode(const radio_policy_t* p, const radio_inputs_t* in) {
+  if (in->radio_off) return RADIO_OFF;
+  if (in->stream_clients > 0 || p->flushing || in->on_vbus) return RADIO_PS_NONE;
+  if (in->now_ms - p->last_activity_ms < p->cfg.idle_ms) return RADIO_PS_MIN_MODEM;
+  return RADIO_PS_MAX_MODEM;
+}
+
+radio_mode_t radio_update(radio_policy_t* p, const radio_inputs_t* in) {
+  if (!p || !in) return RADIO_PS_NONE;
+
+  // tempo e carica alla modalità in cui sono stati passati
+  uint32_t dt = in->now_ms - p->last_update_ms;
+  radio_mode_stats_t& s = p->st[p->mode];
+  s.time_ms += dt;
+  s.charge_uas += (uint64_t)p->cfg.mode_ma[p->mode] * dt;   // mA * ms = uA * s
+  if (p->mqtt_was_up) s.mqtt_up_ms += dt;
+  if (p->mqtt_was_up && !in->mqtt_connected) s.mqtt_drops++;
+  p->mqtt_was_up = in->mqtt_connected;
+  p->last_update_ms = in->now_ms;
+
+  if (in->busy || in->stream_clients > 0 || in->uploads_queued > 0) p->last_activity_ms = in->now_ms;
+  if (in->last_http_ms && (int32_t)(in->last_http_ms - p->last_activity_ms) > 0) {
+    p->last_activity_ms = in->last_http_ms;
+  }
+
+  update_flush(p, in);
+
+  radio_mode_t nm = next_mode(p, in);
+  if (nm != p->mode) {
+    p->mode = nm;
+    p->mode_since_ms = in->now_ms;
+    p->st[nm].entries++;
+    p->transitions++;
+  }
+  return p->mode;
+}
+
+void radio_note_tx(radio_policy_t* p, uint32_t bytes) {
+  if (!p || !bytes) return;
+  radio_mode_stats_t& s = p->st[p->mode];
+  s.tx_bytes += bytes;
+  if (p->cfg.tx_kbps) {
+    uint64_t tx_ms = (uint64_t)bytes * 8 / p->cfg.tx_kbps;   // kbit/s = bit/ms
+    s.charge_uas += (uint64_t)p->cfg.tx_ma * tx_ms;
+  }
+}
+
+void radio_note_stream_latency(radio_policy_t* p, uint32_t lat_ms) {
+  if (!p) return;
+  radio_mode_stats_t& s = p->st[p->mode];
+  s.lat_frames++;
+  s.lat_sum_ms += lat_ms;
+  if (lat_ms > s.lat_max_ms) s.lat_max_ms = lat_ms;
+}
+
+uint32_t radio_avg_ma(const radio_policy_t* p, int mode) {
+  if (!p || mode < 0 || mode > RADIO_MODE_COUNT) return 0;
+  uint64_t charge = 0, t = 0;
+  for (int m = 0; m < RADIO_MODE_COUNT; m++) {
+    if (mode != RADIO_MODE_COUNT && m != mode) continue;
+    charge += p->st[m].charge_uas;
+    t      += p->st[m].time_ms;
+  }
+  return t ? (uint32_t)(charge / t) : 0;
+}
+
+const char* radio_mode_name(radio_mode_t m) {
+  return (m >= 0 && m < RADIO_MODE_COUNT) ? MODE_NAMES[m] : "?";
+}
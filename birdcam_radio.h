@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Politica della radio Wi-Fi: modalità power-save e finestre di trasmissione.
+// Macchina a stati pura (niente Arduino/IDF) come birdcam_power: BirdCam.ino
+// la alimenta e applica la modalità con WiFi.setSleep().
+//
+//   stream MJPEG/RTSP o burst di upload in corso -> RADIO_PS_NONE
+//   VBUS presente                                 -> RADIO_PS_NONE
+//   batteria + attività recente (PIR/http/coda)   -> RADIO_PS_MIN_MODEM
+//   batteria + idle >= idle_ms                    -> RADIO_PS_MAX_MODEM (listen_interval lungo)
+//   radio spenta (light sleep)                    -> RADIO_OFF
+//
+// Upload in batteria: gli upload in coda aspettano finché il più vecchio ha
+// batch_ms o sono batch_max, poi partono tutti in un burst (flushing) e la
+// radio torna a dormire. Con VBUS o uno stream attivo partono subito.
+
+enum radio_mode_t {
+  RADIO_PS_NONE = 0,
+  RADIO_PS_MIN_MODEM,
+  RADIO_PS_MAX_MODEM,
+  RADIO_OFF,
+  RADIO_MODE_COUNT
+};
+
+struct radio_config_t {
+  uint32_t idle_ms;           // batteria: idle prima di MAX_MODEM
+  uint16_t listen_interval;   // beacon fra due risvegli in MAX_MODEM (0 = default IDF)
+  uint32_t batch_ms;          // batteria: attesa massima di un upload in coda
+  uint8_t  batch_max;         // batteria: upload in coda che fanno partire il burst
+
+  // Modello di consumo della scheda (mA) per modalità e durante la
+  // trasmissione: il PMU misura tensioni ma non la corrente (vedi birdcam_power).
+  uint16_t mode_ma[RADIO_MODE_COUNT];
+  uint16_t tx_ma;             // in più durante la trasmissione
+  uint16_t tx_kbps;           // throughput stimato per il tempo di trasmissione
+};
+
+struct radio_inputs_t {
+  uint32_t now_ms;
+  bool     on_vbus;
+  bool     radio_off;         // light sleep / Wi-Fi spento
+  bool     busy;              // PIR alto o cattura in corso
+  int      stream_clients;    // MJPEG/RTSP collegati
+  int      uploads_queued;    // pubblicazioni MQTT in attesa (evento PIR, telemetria)
+  uint32_t last_http_ms;      // ultima richiesta web (0 = mai)
+  bool     mqtt_connected;
+};
+
+// Statistiche per modalità (il tempo passato in quella modalità)
+struct radio_mode_stats_t {
+  uint32_t time_ms;
+  uint32_t entries;
+  uint64_t charge_uas;        // carica stimata (uA*s): corrente media = charge / time
+  uint32_t tx_bytes;
+  uint32_t lat_frames;        // latenza stream (cattura -> invio completato)
+  uint32_t lat_sum_ms;
+  uint32_t lat_max_ms;
+  uint32_t mqtt_up_ms;        // MQTT connesso
+  uint32_t mqtt_drops;        // connessioni perse (keepalive scaduto o rete)
+};
+
+struct radio_policy_t {
+  radio_config_t cfg;
+  radio_mode_t   mode;
+  uint32_t       mode_since_ms;
+  uint32_t       last_update_ms;
+  uint32_t       last_activity_ms;
+  bool           mqtt_was_up;
+
+  bool           flushing;      // burst di upload in corso: trasmettere ora
+  bool           queued;
+  uint32_t       queued_since_ms;
+  uint32_t       bursts;
+  uint32_t       transitions;
+
+  radio_mode_stats_t st[RADIO_MODE_COUNT];
+};
+
+void         radio_default_config(radio_config_t* cfg);
+void         radio_init(radio_policy_t* p, const radio_config_t* cfg, uint32_t now_ms);
+
+// Ritorna la nuova modalità; p->flushing dice se gli upload in coda possono partire
+radio_mode_t radio_update(radio_policy_t* p, const radio_inputs_t* in);
+
+// Misure attribuite alla modalità corrente
+void         radio_note_tx(radio_policy_t* p, uint32_t bytes);
+void         radio_note_stream_latency(radio_policy_t* p, uint32_t lat_ms);
+
+// Corrente media stimata (mA) in una modalità, o complessiva con RADIO_MODE_COUNT
+uint32_t     radio_avg_ma(const radio_policy_t* p, int mode);
+
+const char*  radio_mode_name(radio_mode_t m);
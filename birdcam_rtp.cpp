@@ -0,0 +1,151 @@
+#include "birdcam_rtp.h"
+
+#include <string.h>
+
+static inline uint16_t be16(const uint8_t* p) { return (uint16_t)((p[0] << 8) | p[1]); }
+
+static inline void put_be16(uint8_t*& p, uint16_t v) {
+  p[0] = (uint8_t)(v >> 8); p[1] = (uint8_t)v;
+  p += 2;
+}
+static inline void put_be32(uint8_t*& p, uint32_t v) {
+  p[0] = (uint8_t)(v >> 24); p[1] = (uint8_t)(v >> 16); p[2] = (uint8_t)(v >> 8); p[3] = (uint8_t)v;
+  p += 4;
+}
+
+bool rtp_jpeg_parse(const uint8_t* p, size_t len, rtp_jpeg_t* j) {
+  if (!p || !j || len < 4 || p[0] != 0xFF || p[1] != 0xD8) return false;
+  memset(j, 0, sizeof(*j));
+
+  bool have_sof = false;
+  uint8_t qt_mask = 0;
+  size_t i = 2;
+  while (i + 4 <= len) {
+    if (p[i] != 0xFF) return false;
+    uint8_t m = p[i + 1];
+    if (m == 0xFF) { i++; continue; }                          // byte di riempimento
+    if (m == 0xD8 || (m >= 0xD0 && m <= 0xD7)) { i += 2; continue; }
+
+    size_t seglen = be16(p + i + 2);
+    if (seglen < 2 || i + 2 + seglen > len) return false;
+    const uint8_t* seg = p + i + 4;
+    size_t n = seglen - 2;
+
+    if (m == 0xDB) {                                           // DQT
+      for (size_t k = 0; k + 65 <= n; k += 65) {
+        if (seg[k] >> 4) return false;                         // solo tabelle a 8 bit
+        uint8_t tq = seg[k] & 0x0F;
+        if (tq > 1) return false;
+        memcpy(j->qt + 64 * tq, seg + k + 1, 64);
+        qt_mask |= (uint8_t)(1 << tq);
+      }
+    } else if (m == 0xC0) {                                    // SOF0 baseline
+      if (n < 15 || seg[0] != 8 || seg[5] != 3) return false;
+      j->height = be16(seg + 1);
+      j->width  = be16(seg + 3);
+      if (!j->width || !j->height || j->width > 2040 || j->height > 2040) return false;
+      uint8_t samp = seg[7];
+      if (samp == 0x21) j->type = 0;
+      else if (samp == 0x22) j->type = 1;
+      else return false;
+      // RFC 2435: Y con tabella 0, Cb/Cr 1x1 con tabella 1
+      if (seg[8] != 0 || seg[10] != 0x11 || seg[11] != 1 || seg[13] != 0x11 || seg[14] != 1) return false;
+      have_sof = true;
+    } else if (m >= 0xC1 && m <= 0xCF && m != 0xC4 && m != 0xC8 && m != 0xCC) {
+      return false;                                            // progressivo/aritmetico
+    } else if (m == 0xDD) {                                    // DRI
+      if (n < 2) return false;
+      j->dri = be16(seg);
+    } else if (m == 0xDA) {                                    // SOS: da qui lo scan
+      size_t start = i + 2 + seglen;
+      size_t end = len;
+      // EOI in coda (il driver può lasciare qualche byte dopo)
+      for (size_t k = len; k >= start + 2 && k + 32 >= len; k--) {
+        if (p[k - 2] == 0xFF && p[k - 1] == 0xD9) { end = k - 2; break; }
+      }
+      if (!have_sof || qt_mask != 0x03 || end <= start) return false;
+      j->scan = p + start;
+      j->scan_len = end - start;
+      j->qt_len = 128;
+      if (j->dri) j->type += 64;
+      return true;
+    }
+    i += 2 + seglen;
+  }
+  return false;
+}
+
+size_t rtp_jpeg_packet(const rtp_jpeg_t* j, size_t* offset, uint16_t seq, uint32_t ts,
+                       uint32_t ssrc, uint8_t* buf, size_t cap) {
+  if (!j || !offset || !buf || *offset >= j->scan_len) return 0;
+  size_t off = *offset;
+
+  size_t hdr = RTP_HDR_LEN + RTP_JPEG_HDR_LEN + (j->dri ? 4 : 0) + (off == 0 ? 4 + j->qt_len : 0);
+  if (cap <= hdr) return 0;
+  size_t chunk = j->scan_len - off;
+  if (chunk > cap - hdr) chunk = cap - hdr;
+  bool last = off + chunk >= j->scan_len;
+
+  uint8_t* p = buf;
+  *p++ = 0x80;                                                 // V=2
+  *p++ = (uint8_t)((last ? 0x80 : 0) | RTP_PT_JPEG);
+  put_be16(p, seq);
+  put_be32(p, ts);
+  put_be32(p, ssrc);
+
+  put_be32(p, (uint32_t)off & 0x00FFFFFF);                     // type-specific 0 + fragment offset
+  *p++ = j->type;
+  *p++ = 255;                                                  // Q: tabelle in-band
+  *p++ = (uint8_t)(j->width / 8);
+  *p++ = (uint8_t)(j->height / 8);
+
+  if (j->dri) {
+    // restart interval non allineati ai pacchetti: F = L = 1, count = 0x3FFF
+    put_be16(p, j->dri);
+    put_be16(p, 0xFFFF);
+  }
+  if (off == 0) {
+    *p++ = 0;                                                  // MBZ
+    *p++ = 0;                                                  // precisione 8 bit
+    put_be16(p, j->qt_len);
+    memcpy(p, j->qt, j->qt_len);
+    p += j->qt_len;
+  }
+
+  memcpy(p, j->scan + off, chunk);
+  p += chunk;
+  *offset = off + chunk;
+  return (size_t)(p - buf);
+}
+
+size_t rtcp_sender_report(uint8_t* buf, size_t cap, uint32_t ssrc,
+                          uint32_t ntp_sec, uint32_t ntp_frac, uint32_t rtp_ts,
+                          uint32_t packets, uint32_t octets, const char* cname) {
+  size_t clen = cname ? strlen(cname) : 0;
+  if (clen > 255) clen = 255;
+  // SDES: header 4 + ssrc 4 + item (2 + clen) + END (1), arrotondato a 4
+  size_t sdes = (8 + 2 + clen + 1 + 3) & ~(size_t)3;
+  if (!buf || cap < 28 + sdes) return 0;
+
+  uint8_t* p = buf;
+  *p++ = 0x80;                                                 // V=2, RC=0
+  *p++ = 200;                                                  // SR
+  put_be16(p, 6);
+  put_be32(p, ssrc);
+  put_be32(p, ntp_sec);
+  put_be32(p, ntp_frac);
+  put_be32(p, rtp_ts);
+  put_be32(p, packets);
+  put_be32(p, octets);
+
+  uint8_t* s = p;
+  memset(s, 0, sdes);
+  *p++ = 0x81;                                                 // V=2, SC=1
+  *p++ = 202;                                                  // SDES
+  put_be16(p, (uint16_t)(sdes / 4 - 1));
+  put_be32(p, ssrc);
+  *p++ = 1;                                                    // CNAME
+  *p++ = (uint8_t)clen;
+  if (clen) memcpy(p, cname, clen);
+  return 28 + sdes;
+}
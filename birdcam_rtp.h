@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// JPEG su RTP (RFC 2435) + RTCP sender report (RFC 3550).
+// Modulo puro: nessuna dipendenza da Arduino/IDF/socket.
+
+#define RTP_PT_JPEG      26
+#define RTP_HDR_LEN      12
+#define RTP_JPEG_HDR_LEN 8
+#define RTP_MAX_PACKET   1400   // sotto la MTU Wi-Fi anche con header IP/UDP
+
+// Frame JPEG baseline scomposto per la pacchettizzazione: le tabelle di
+// quantizzazione viaggiano in-band (Q = 255), il resto è il solo scan.
+struct rtp_jpeg_t {
+  const uint8_t* scan;      // dati entropy-coded dopo SOS (senza EOI), puntano nel JPEG
+  size_t   scan_len;
+  uint16_t width;
+  uint16_t height;
+  uint8_t  type;            // 0 = 4:2:2, 1 = 4:2:0 (+64 con restart marker)
+  uint16_t dri;             // restart interval (0 = nessuno)
+  uint8_t  qt[128];         // luma + chroma
+  uint8_t  qt_len;          // 64 o 128
+};
+
+// false se il JPEG non è rappresentabile (progressivo, >2040 px, 16 bit, ...)
+bool rtp_jpeg_parse(const uint8_t* jpg, size_t len, rtp_jpeg_t* out);
+
+// Pacchetto RTP successivo a partire da *offset (0 al primo) in buf (cap >= 200).
+// Ritorna la lunghezza del pacchetto (0 = frame finito) e avanza *offset;
+// il bit marker è sull'ultimo pacchetto del frame.
+size_t rtp_jpeg_packet(const rtp_jpeg_t* j, size_t* offset, uint16_t seq, uint32_t ts,
+                       uint32_t ssrc, uint8_t* buf, size_t cap);
+
+// SR + SDES(CNAME) composto; ntp_sec/ntp_frac = istante di rtp_ts
+size_t rtcp_sender_report(uint8_t* buf, size_t cap, uint32_t ssrc,
+                          uint32_t ntp_sec, uint32_t ntp_frac, uint32_t rtp_ts,
+                          uint32_t packets, uint32_t octets, const char* cname);
@@ -0,0 +1,564 @@
+#include "birdcam_rtsp.h"
+
+#include <Arduino.h>
+#include <sys/time.h>
+#include "lwip/sockets.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+
+#include "birdcam_cam.h"
+#include "birdcam_rtp.h"
+#include "birdcam_settings.h"
+
+static const uint32_t SESSION_TIMEOUT_MS = 60000;   // senza richieste né RTCP dal client
+static const uint32_t RTCP_SR_PERIOD_MS  = 5000;
+static const int      FPS_DEFAULT = 5;              // come /mjpeg
+static const int      FPS_MAX     = 30;
+
+struct RtspSession {
+  bool     used;
+  int      fd;                 // connessione RTSP (e RTP se interleaved)
+  char     rx[1024];
+  size_t   rx_len;
+  char     base[96];           // Content-Base
+  uint32_t id;
+
+  framesize_t fs;              // da ?fs=&q=&fps= nell'URL
+  int      q;
+  int      fps;
+
+  bool     setup;
+  bool     tcp;
+  uint8_t  ch_rtp, ch_rtcp;
+  int      udp_rtp, udp_rtcp;
+  struct sockaddr_in peer_rtp, peer_rtcp;
+
+  bool     playing;
+  int      arb;                // handle stream dell'arbitro
+  int64_t  next_due_us;
+  uint32_t last_seen_ms;
+  uint32_t last_sr_ms;
+  uint16_t seq;
+  uint32_t ssrc;
+  uint32_t ts_base;
+  uint32_t packets;
+  uint32_t octets;
+};
+
+static RtspSession s_sess[RTSP_MAX_SESSIONS];
+static uint16_t s_port = RTSP_PORT;
+static uint8_t  s_pkt[4 + RTP_MAX_PACKET];   // 4 byte davanti per l'header interleaved '$'
+
+static volatile bool s_listening = false;
+static volatile uint32_t s_frames = 0, s_packets = 0, s_bytes = 0, s_skipped = 0;
+
+// ---------------- sessioni ----------------
+static void sess_reset(RtspSession& s) {
+  memset(&s, 0, sizeof(s));
+  s.fd = -1;
+  s.udp_rtp = -1;
+  s.udp_rtcp = -1;
+  s.arb = -1;
+}
+
+static void sess_stop(RtspSession& s) {
+  if (!s.playing) return;
+  cam_arb_stream_leave(s.arb);
+  s.arb = -1;
+  s.playing = false;
+}
+
+static void sess_close(RtspSession& s) {
+  sess_stop(s);
+  if (s.fd >= 0) close(s.fd);
+  if (s.udp_rtp >= 0) close(s.udp_rtp);
+  if (s.udp_rtcp >= 0) close(s.udp_rtcp);
+  sess_reset(s);
+}
+
+static bool send_all(int fd, const uint8_t* p, size_t len) {
+  while (len) {
+    int n = send(fd, p, len, 0);
+    if (n <= 0) return false;
+    p += n;
+    len -= (size_t)n;
+  }
+  return true;
+}
+
+static bool sock_writable(int fd) {
+  fd_set wf;
+  FD_ZERO(&wf);
+  FD_SET(fd, &wf);
+  struct timeval tv = {0, 0};
+  return select(fd + 1, NULL, &wf, NULL, &tv) > 0;
+}
+
+static int udp_bind(uint16_t port) {
+  int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (fd < 0) return -1;
+  struct sockaddr_in a;
+  memset(&a, 0, sizeof(a));
+  a.sin_family = AF_INET;
+  a.sin_port = htons(port);
+  a.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(fd, (struct sockaddr*)&a, sizeof(a)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// pkt punta a s_pkt + 4 (o a un buffer con 4 byte liberi davanti)
+static bool send_rtp(RtspSession& s, bool rtcp, uint8_t* pkt, size_t len) {
+  if (s.tcp) {
+    uint8_t* h = pkt - 4;
+    h[0] = '$';
+    h[1] = rtcp ? s.ch_rtcp : s.ch_rtp;
+    h[2] = (uint8_t)(len >> 8);
+    h[3] = (uint8_t)len;
+    return send_all(s.fd, h, len + 4);
+  }
+  int fd = rtcp ? s.udp_rtcp : s.udp_rtp;
+  const struct sockaddr_in* to = rtcp ? &s.peer_rtcp : &s.peer_rtp;
+  sendto(fd, pkt, len, 0, (const struct sockaddr*)to, sizeof(*to));
+  return true;   // UDP: una perdita non chiude la sessione
+}
+
+// ---------------- richieste RTSP ----------------
+// "Nome: valore" (case-insensitive)
+static bool hdr_get(const char* req, const char* name, char* out, size_t outlen) {
+  size_t nl = strlen(name);
+  for (const char* line = req; *line; ) {
+    const char* eol = strstr(line, "\r\n");
+    if (!eol) break;
+    if ((size_t)(eol - line) > nl && !strncasecmp(line, name, nl) && line[nl] == ':') {
+      const char* v = line + nl + 1;
+      while (*v == ' ') v++;
+      size_t n = (size_t)(eol - v);
+      if (n >= outlen) n = outlen - 1;
+      memcpy(out, v, n);
+      out[n] = 0;
+      return true;
+    }
+    line = eol + 2;
+  }
+  return false;
+}
+
+// ?fs=vga&q=20&fps=10 (il client può appendere /track1 dopo la query)
+static void parse_url_params(RtspSession& s, const char* url) {
+  const char* p = strchr(url, '?');
+  if (!p) return;
+  p++;
+  while (*p) {
+    char key[8] = {0}, val[16] = {0};
+    size_t k = 0, v = 0;
+    while (*p && *p != '=' && *p != '&' && *p != '/') { if (k < sizeof(key) - 1) key[k++] = *p; p++; }
+    if (*p == '=') {
+      p++;
+      while (*p && *p != '&' && *p != '/') { if (v < sizeof(val) - 1) val[v++] = *p; p++; }
+    }
+    if (!strcmp(key, "fs")) s.fs = cam_framesize_from_str(val, s.fs);
+    else if (!strcmp(key, "q")) s.q = atoi(val);
+    else if (!strcmp(key, "fps")) s.fps = atoi(val);
+    if (*p == '/') break;
+    if (*p) p++;
+  }
+  if (s.fps < 1) s.fps = 1;
+  if (s.fps > FPS_MAX) s.fps = FPS_MAX;
+}
+
+static void reply(RtspSession& s, const char* status, const char* cseq, const char* extra, const char* body) {
+  char buf[900];
+  int n = snprintf(buf, sizeof(buf), "RTSP/1.0 %s\r\nCSeq: %s\r\nServer: BirdCam\r\n%s", status, cseq, extra ? extra : "");
+  if (n < 0 || n >= (int)sizeof(buf)) return;
+  if (body) n += snprintf(buf + n, sizeof(buf) - n, "Content-Length: %u\r\n\r\n%s", (unsigned)strlen(body), body);
+  else n += snprintf(buf + n, sizeof(buf) - n, "\r\n");
+  if (n >= (int)sizeof(buf)) n = sizeof(buf) - 1;
+  send_all(s.fd, (const uint8_t*)buf, (size_t)n);
+}
+
+static void handle_describe(RtspSession& s, const char* url, const char* cseq) {
+  if (!cam_arb_fits(s.fs)) {
+    reply(s, "453 Not Enough Bandwidth", cseq, NULL, NULL);
+    return;
+  }
+  // Content-Base: URL senza query, con '/' finale
+  size_t n = strcspn(url, "?");
+  if (n > sizeof(s.base) - 2) n = sizeof(s.base) - 2;
+  memcpy(s.base, url, n);
+  if (n == 0 || s.base[n - 1] != '/') s.base[n++] = '/';
+  s.base[n] = 0;
+
+  char ip[16] = "0.0.0.0";
+  struct sockaddr_in la;
+  socklen_t ll = sizeof(la);
+  if (getsockname(s.fd, (struct sockaddr*)&la, &ll) == 0) inet_ntop(AF_INET, &la.sin_addr, ip, sizeof(ip));
+
+  char sdp[320];
+  snprintf(sdp, sizeof(sdp),
+    "v=0\r\n"
+    "o=- %lu 1 IN IP4 %s\r\n"
+    "s=BirdCam\r\n"
+    "c=IN IP4 0.0.0.0\r\n"
+    "t=0 0\r\n"
+    "a=control:*\r\n"
+    "m=video 0 RTP/AVP %d\r\n"
+    "a=control:track1\r\n"
+    "a=framerate:%d\r\n",
+    (unsigned long)s.id, ip, RTP_PT_JPEG, s.fps);
+
+  char extra[160];
+  snprintf(extra, sizeof(extra), "Content-Base: %s\r\nContent-Type: application/sdp\r\n", s.base);
+  reply(s, "200 OK", cseq, extra, sdp);
+}
+
+static void handle_setup(RtspSession& s, const char* req, const char* cseq) {
+  char tr[160];
+  if (!hdr_get(req, "Transport", tr, sizeof(tr)) || strstr(tr, "multicast")) {
+    reply(s, "461 Unsupported Transport", cseq, NULL, NULL);
+    return;
+  }
+
+  char extra[256];
+  if (strstr(tr, "RTP/AVP/TCP")) {
+    int a = 0, b = 1;
+    const char* il = strstr(tr, "interleaved=");
+    if (il) sscanf(il + 12, "%d-%d", &a, &b);
+    s.tcp = true;
+    s.ch_rtp = (uint8_t)a;
+    s.ch_rtcp = (uint8_t)b;
+    snprintf(extra, sizeof(extra),
+      "Transport: RTP/AVP/TCP;unicast;interleaved=%d-%d;ssrc=%08lX\r\nSession: %08lX;timeout=%lu\r\n",
+      a, b, (unsigned long)s.ssrc, (unsigned long)s.id, (unsigned long)(SESSION_TIMEOUT_MS / 1000));
+  } else {
+    const char* cp = strstr(tr, "client_port=");
+    int a = 0, b = 0;
+    if (!cp || sscanf(cp + 12, "%d-%d", &a, &b) < 1 || a <= 0) {
+      reply(s, "461 Unsupported Transport", cseq, NULL, NULL);
+      return;
+    }
+    if (b <= 0) b = a + 1;
+
+    int slot = (int)(&s - s_sess);
+    int udp = 0;
+    for (int i = 0; i < RTSP_MAX_SESSIONS; i++) if (i != slot && s_sess[i].udp_rtp >= 0) udp++;
+    if (s.udp_rtp < 0 && udp >= RTSP_MAX_UDP_SESSIONS) {
+      reply(s, "461 Unsupported Transport", cseq, NULL, NULL);   // budget socket: solo TCP
+      return;
+    }
+    uint16_t sp = (uint16_t)(RTSP_UDP_BASE_PORT + 2 * slot);
+    if (s.udp_rtp < 0) s.udp_rtp = udp_bind(sp);
+    if (s.udp_rtcp < 0) s.udp_rtcp = udp_bind(sp + 1);
+    struct sockaddr_in pa;
+    socklen_t pl = sizeof(pa);
+    if (s.udp_rtp < 0 || s.udp_rtcp < 0 || getpeername(s.fd, (struct sockaddr*)&pa, &pl) != 0) {
+      reply(s, "500 Internal Server Error", cseq, NULL, NULL);
+      return;
+    }
+    s.tcp = false;
+    s.peer_rtp = pa;
+    s.peer_rtp.sin_port = htons((uint16_t)a);
+    s.peer_rtcp = pa;
+    s.peer_rtcp.sin_port = htons((uint16_t)b);
+    snprintf(extra, sizeof(extra),
+      "Transport: RTP/AVP;unicast;client_port=%d-%d;server_port=%u-%u;ssrc=%08lX\r\nSession: %08lX;timeout=%lu\r\n",
+      a, b, (unsigned)sp, (unsigned)(sp + 1), (unsigned long)s.ssrc, (unsigned long)s.id,
+      (unsigned long)(SESSION_TIMEOUT_MS / 1000));
+  }
+  s.setup = true;
+  reply(s, "200 OK", cseq, extra, NULL);
+}
+
+static void handle_play(RtspSession& s, const char* cseq) {
+  if (!s.setup) {
+    reply(s, "455 Method Not Valid in This State", cseq, NULL, NULL);
+    return;
+  }
+  if (!s.playing) {
+    s.arb = cam_arb_stream_join(s.fs, s.q);
+    s.playing = true;
+    s.next_due_us = esp_timer_get_time();
+    s.last_sr_ms = millis();
+  }
+  uint32_t rtptime = s.ts_base + (uint32_t)((uint64_t)esp_timer_get_time() * 9 / 100);
+  char extra[220];
+  snprintf(extra, sizeof(extra),
+    "Session: %08lX\r\nRange: npt=0.000-\r\nRTP-Info: url=%strack1;seq=%u;rtptime=%lu\r\n",
+    (unsigned long)s.id, s.base, (unsigned)s.seq, (unsigned long)rtptime);
+  reply(s, "200 OK", cseq, extra, NULL);
+}
+
+static void handle_request(RtspSession& s, const char* req) {
+  char method[16] = {0}, url[128] = {0};
+  char cseq[12] = "0";
+  hdr_get(req, "CSeq", cseq, sizeof(cseq));
+  if (sscanf(req, "%15s %127s", method, url) != 2) {
+    reply(s, "400 Bad Request", cseq, NULL, NULL);
+    return;
+  }
+  s.last_seen_ms = millis();
+  parse_url_params(s, url);
+
+  char sess[32];
+  snprintf(sess, sizeof(sess), "Session: %08lX\r\n", (unsigned long)s.id);
+
+  if (!strcmp(method, "OPTIONS")) {
+    reply(s, "200 OK", cseq, "Public: OPTIONS, DESCRIBE, SETUP, PLAY, PAUSE, TEARDOWN, GET_PARAMETER\r\n", NULL);
+  } else if (!strcmp(method, "DESCRIBE")) {
+    handle_describe(s, url, cseq);
+  } else if (!strcmp(method, "SETUP")) {
+    handle_setup(s, req, cseq);
+  } else if (!strcmp(method, "PLAY")) {
+    handle_play(s, cseq);
+  } else if (!strcmp(method, "PAUSE")) {
+    sess_stop(s);
+    reply(s, "200 OK", cseq, sess, NULL);
+  } else if (!strcmp(method, "GET_PARAMETER") || !strcmp(method, "SET_PARAMETER")) {
+    reply(s, "200 OK", cseq, sess, NULL);   // keepalive
+  } else if (!strcmp(method, "TEARDOWN")) {
+    reply(s, "200 OK", cseq, sess, NULL);
+    sess_close(s);
+  } else {
+    reply(s, "501 Not Implemented", cseq, NULL, NULL);
+  }
+}
+
+static void rx_consume(RtspSession& s, size_t n) {
+  if (n >= s.rx_len) { s.rx_len = 0; return; }
+  memmove(s.rx, s.rx + n, s.rx_len - n);
+  s.rx_len -= n;
+}
+
+static void sess_read(RtspSession& s) {
+  int n = recv(s.fd, s.rx + s.rx_len, sizeof(s.rx) - 1 - s.rx_len, 0);
+  if (n <= 0) {
+    sess_close(s);
+    return;
+  }
+  s.rx_len += (size_t)n;
+
+  while (s.used && s.rx_len) {
+    // RTCP interleaved dal client (receiver report): vale come keepalive
+    if (s.rx[0] == '$') {
+      if (s.rx_len < 4) return;
+      size_t plen = 4 + (((uint8_t)s.rx[2] << 8) | (uint8_t)s.rx[3]);
+      if (plen > sizeof(s.rx) - 1) { sess_close(s); return; }
+      if (s.rx_len < plen) return;
+      s.last_seen_ms = millis();
+      rx_consume(s, plen);
+      continue;
+    }
+
+    s.rx[s.rx_len] = 0;
+    char* end = strstr(s.rx, "\r\n\r\n");
+    if (!end) {
+      if (s.rx_len >= sizeof(s.rx) - 1) sess_close(s);   // richiesta troppo lunga
+      return;
+    }
+    size_t hlen = (size_t)(end + 4 - s.rx);
+    char cl[12];
+    end[2] = 0;   // header terminati dopo l'ultimo CRLF
+    size_t body = hdr_get(s.rx, "Content-Length", cl, sizeof(cl)) ? (size_t)atoi(cl) : 0;
+    end[2] = '\r';
+    if (hlen + body > sizeof(s.rx) - 1) { sess_close(s); return; }
+    if (s.rx_len < hlen + body) return;
+
+    end[2] = 0;
+    handle_request(s, s.rx);
+    if (!s.used) return;   // TEARDOWN
+    rx_consume(s, hlen + body);
+  }
+}
+
+static void accept_client(int lfd) {
+  int fd = accept(lfd, NULL, NULL);
+  if (fd < 0) return;
+
+  RtspSession* s = NULL;
+  for (int i = 0; i < RTSP_MAX_SESSIONS; i++) if (!s_sess[i].used) { s = &s_sess[i]; break; }
+  if (!s) {
+    close(fd);
+    return;
+  }
+
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  struct timeval to = {2, 0};   // client bloccato: la sessione cade invece di fermare il server
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &to, sizeof(to));
+
+  sess_reset(*s);
+  s->used = true;
+  s->fd = fd;
+  s->id = esp_random();
+  s->ssrc = esp_random();
+  s->ts_base = esp_random();
+  s->seq = (uint16_t)esp_random();
+  s->fs = FRAMESIZE_QVGA;
+  s->q = bc_get_jpeg_quality() < 30 ? 30 : bc_get_jpeg_quality();
+  s->fps = FPS_DEFAULT;
+  s->last_seen_ms = millis();
+}
+
+// ---------------- RTP / RTCP ----------------
+static void send_frame(RtspSession& s, const rtp_jpeg_t& jp, int64_t ts_us) {
+  if (s.tcp && !sock_writable(s.fd)) {   // backpressure: frame saltato, non accodato
+    s_skipped++;
+    return;
+  }
+  uint32_t rtp_ts = s.ts_base + (uint32_t)((uint64_t)ts_us * 9 / 100);   // 90 kHz
+  size_t off = 0;
+  for (;;) {
+    size_t n = rtp_jpeg_packet(&jp, &off, s.seq, rtp_ts, s.ssrc, s_pkt + 4, RTP_MAX_PACKET);
+    if (!n) break;
+    if (!send_rtp(s, false, s_pkt + 4, n)) {
+      sess_close(s);
+      return;
+    }
+    s.seq++;
+    s.packets++;
+    s.octets += (uint32_t)(n - RTP_HDR_LEN);
+    s_packets++;
+    s_bytes += (uint32_t)n;
+  }
+  s_frames++;
+}
+
+// Un frame per combinazione fs/q: le sessioni con gli stessi parametri lo condividono
+static void send_due_frames() {
+  bool done[RTSP_MAX_SESSIONS] = {false};
+  for (int i = 0; i < RTSP_MAX_SESSIONS; i++) {
+    RtspSession& a = s_sess[i];
+    int64_t now = esp_timer_get_time();
+    if (!a.used || !a.playing || done[i] || now < a.next_due_us) continue;
+
+    int64_t period = 1000000LL / a.fps;
+    cam_frame_t f;
+    cam_result_t r = cam_arb_grab(CAM_PROFILE_STREAM, a.fs, a.q, &f, (uint32_t)(period / 1000) + 1);
+    rtp_jpeg_t jp;
+    bool ok = r == CAM_OK && rtp_jpeg_parse(f.buf, f.len, &jp);
+    int64_t ts_us = (r == CAM_OK && f.ts_us > 0) ? f.ts_us : now;
+
+    for (int k = i; k < RTSP_MAX_SESSIONS; k++) {
+      RtspSession& b = s_sess[k];
+      if (!b.used || !b.playing || done[k] || b.fs != a.fs || b.q != a.q || now < b.next_due_us) continue;
+      done[k] = true;
+      if (ok) send_frame(b, jp, ts_us);
+      else s_skipped++;
+      if (!b.used) continue;
+      int64_t p = 1000000LL / b.fps;
+      int64_t t = esp_timer_get_time();
+      b.next_due_us += p;
+      if (b.next_due_us < t) b.next_due_us = t;
+    }
+    if (r == CAM_OK) cam_arb_release(&f);
+  }
+}
+
+static void send_sender_reports() {
+  uint32_t now_ms = millis();
+  for (int i = 0; i < RTSP_MAX_SESSIONS; i++) {
+    RtspSession& s = s_sess[i];
+    if (!s.used || !s.playing || now_ms - s.last_sr_ms < RTCP_SR_PERIOD_MS) continue;
+    s.last_sr_ms = now_ms;
+
+    // NTP dall'orologio di sistema (se sincronizzato, altrimenti da boot)
+    int64_t now_us = esp_timer_get_time();
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    uint64_t sec = (uint64_t)tv.tv_sec, usec = (uint64_t)tv.tv_usec;
+    if (tv.tv_sec < 1700000000) { sec = (uint64_t)(now_us / 1000000); usec = (uint64_t)(now_us % 1000000); }
+    uint32_t ntp_sec = (uint32_t)(sec + 2208988800ULL);
+    uint32_t ntp_frac = (uint32_t)((usec << 32) / 1000000ULL);
+    uint32_t rtp_ts = s.ts_base + (uint32_t)((uint64_t)now_us * 9 / 100);
+
+    uint8_t buf[4 + 64];
+    size_t n = rtcp_sender_report(buf + 4, sizeof(buf) - 4, s.ssrc, ntp_sec, ntp_frac, rtp_ts,
+                                  s.packets, s.octets, "birdcam");
+    if (n && !send_rtp(s, true, buf + 4, n)) sess_close(s);
+  }
+}
+
+// ---------------- task ----------------
+static void rtsp_task(void*) {
+  int lfd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  int one = 1;
+  setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in a;
+  memset(&a, 0, sizeof(a));
+  a.sin_family = AF_INET;
+  a.sin_port = htons(s_port);
+  a.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (lfd < 0 || bind(lfd, (struct sockaddr*)&a, sizeof(a)) != 0 || listen(lfd, 2) != 0) {
+    if (lfd >= 0) close(lfd);
+    vTaskDelete(NULL);
+    return;
+  }
+  s_listening = true;
+
+  for (;;) {
+    fd_set rf;
+    FD_ZERO(&rf);
+    FD_SET(lfd, &rf);
+    int maxfd = lfd;
+    int64_t now = esp_timer_get_time();
+    int64_t wait_us = 200000;
+    for (int i = 0; i < RTSP_MAX_SESSIONS; i++) {
+      RtspSession& s = s_sess[i];
+      if (!s.used) continue;
+      FD_SET(s.fd, &rf);
+      if (s.fd > maxfd) maxfd = s.fd;
+      if (s.udp_rtcp >= 0) {
+        FD_SET(s.udp_rtcp, &rf);
+        if (s.udp_rtcp > maxfd) maxfd = s.udp_rtcp;
+      }
+      if (s.playing && s.next_due_us - now < wait_us) wait_us = s.next_due_us - now;
+    }
+    if (wait_us < 0) wait_us = 0;
+    struct timeval tv = { (time_t)(wait_us / 1000000), (suseconds_t)(wait_us % 1000000) };
+
+    if (select(maxfd + 1, &rf, NULL, NULL, &tv) > 0) {
+      if (FD_ISSET(lfd, &rf)) accept_client(lfd);
+      for (int i = 0; i < RTSP_MAX_SESSIONS; i++) {
+        RtspSession& s = s_sess[i];
+        if (s.used && s.fd >= 0 && FD_ISSET(s.fd, &rf)) sess_read(s);
+        if (s.used && s.udp_rtcp >= 0 && FD_ISSET(s.udp_rtcp, &rf)) {
+          uint8_t rr[256];
+          recv(s.udp_rtcp, rr, sizeof(rr), 0);   // receiver report: keepalive
+          s.last_seen_ms = millis();
+        }
+      }
+    }
+
+    send_due_frames();
+    send_sender_reports();
+
+    uint32_t now_ms = millis();
+    for (int i = 0; i < RTSP_MAX_SESSIONS; i++) {
+      RtspSession& s = s_sess[i];
+      if (s.used && now_ms - s.last_seen_ms > SESSION_TIMEOUT_MS) sess_close(s);
+    }
+  }
+}
+
+void rtsp_start(uint16_t port) {
+  for (int i = 0; i < RTSP_MAX_SESSIONS; i++) sess_reset(s_sess[i]);
+  s_port = port;
+  xTaskCreate(rtsp_task, "bc_rtsp", 6144, NULL, 4, NULL);
+}
+
+void rtsp_get_stats(rtsp_stats_t* out) {
+  if (!out) return;
+  memset(out, 0, sizeof(*out));
+  out->listening = s_listening;
+  for (int i = 0; i < RTSP_MAX_SESSIONS; i++) {
+    if (!s_sess[i].used) continue;
+    out->sessions++;
+    if (s_sess[i].playing) out->playing++;
+  }
+  out->frames = s_frames;
+  out->packets = s_packets;
+  out->bytes = s_bytes;
+  out->skipped = s_skipped;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+
+// Server RTSP (RFC 2326) per NVR (Frigate, go2rtc, VLC, ffmpeg):
+//   rtsp://<ip>/mjpeg[?fs=vga&q=20&fps=10]
+// JPEG su RTP (RFC 2435) via UDP o interleaved su TCP, sender report RTCP.
+// I frame arrivano dallo stesso arbitro di /mjpeg (birdcam_cam).
+
+#ifndef RTSP_PORT
+#define RTSP_PORT          554
+#endif
+#define RTSP_MAX_SESSIONS  3
+#define RTSP_MAX_UDP_SESSIONS 1   // le altre solo interleaved su TCP (461: il client ripiega)
+#ifndef RTSP_UDP_BASE_PORT
+#define RTSP_UDP_BASE_PORT 6970   // sessione i: 6970+2i (RTP) / 6971+2i (RTCP)
+#endif
+// socket lwIP: listener + connessione di ogni sessione + RTP/RTCP delle sessioni UDP
+#define RTSP_SOCKETS (1 + RTSP_MAX_SESSIONS + 2 * RTSP_MAX_UDP_SESSIONS)
+
+struct rtsp_stats_t {
+  bool     listening;    // false: bind/listen falliti (porta occupata o socket finiti)
+  int      sessions;     // connessioni RTSP aperte
+  int      playing;
+  uint32_t frames;
+  uint32_t packets;
+  uint32_t bytes;
+  uint32_t skipped;      // frame saltati (sensore occupato o socket indietro)
+};
+
+void rtsp_start(uint16_t port);
+void rtsp_get_stats(rtsp_stats_t* out);
@@ -0,0 +1,67 @@
+#include "birdcam_scene.h"
+
+#include <string.h>
+
+#include "birdcam_kernels.h"
+
+static int      s_threshold = 2;
+static uint32_t s_keyframe_ms = 60000;
+
+static uint8_t  s_ref[SCENE_CELLS];   // firma dell'ultimo frame pubblicato
+static bool     s_have_ref = false;
+static uint32_t s_ref_ms = 0;
+
+static scene_stats_t s_stats = {0, 0, 0, 0, -1};
+
+void scene_signature(const uint8_t* rgb, int w, int h, uint8_t sig[SCENE_CELLS]) {
+  kern_luma_grid(rgb, w, h, SCENE_GRID_W, SCENE_GRID_H, sig);
+}
+
+int scene_score(const uint8_t a[SCENE_CELLS], const uint8_t b[SCENE_CELLS]) {
+  int shift = 0;
+  for (int i = 0; i < SCENE_CELLS; i++) shift += (int)b[i] - (int)a[i];
+  shift /= SCENE_CELLS;
+  int changed = 0;
+  for (int i = 0; i < SCENE_CELLS; i++) {
+    int d = (int)b[i] - (int)a[i] - shift;
+    if (d > SCENE_CELL_DELTA || d < -SCENE_CELL_DELTA) changed++;
+  }
+  return changed * 100 / SCENE_CELLS;
+}
+
+void scene_configure(int threshold_pct, uint32_t keyframe_s) {
+  if (threshold_pct < 0) threshold_pct = 0;
+  if (threshold_pct > 100) threshold_pct = 100;
+  s_threshold = threshold_pct;
+  s_keyframe_ms = keyframe_s * 1000UL;
+}
+
+bool scene_enabled() { return s_threshold > 0; }
+
+bool scene_should_publish(const uint8_t* sig, size_t jpg_len, uint32_t now_ms) {
+  if (s_threshold <= 0) sig = nullptr;
+
+  int score = -1;
+  bool publish = true;
+  if (sig && s_have_ref) {
+    score = scene_score(s_ref, sig);
+    bool keyframe = s_keyframe_ms && now_ms - s_ref_ms >= s_keyframe_ms;
+    publish = score >= s_threshold || keyframe;
+  }
+  if (publish) {
+    // il riferimento è l'ultimo pubblicato: una deriva lenta prima o poi scatta
+    if (sig) memcpy(s_ref, sig, sizeof(s_ref));
+    s_have_ref = sig != nullptr;
+    s_ref_ms = now_ms;
+  }
+
+  // contatori a 32 bit letti da /status senza lock: al più un campo in ritardo
+  s_stats.last_score = score;
+  if (publish) { s_stats.published++; s_stats.bytes_sent += (uint32_t)jpg_len; }
+  else         { s_stats.skipped++;   s_stats.bytes_saved += (uint32_t)jpg_len; }
+  return publish;
+}
+
+void scene_get_stats(scene_stats_t* out) {
+  if (out) *out = s_stats;
+}
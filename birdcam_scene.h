@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Rilevatore di scena statica per lo stream MQTT: firma = griglia di luma
+// SCENE_GRID_W x SCENE_GRID_H dal JPEG decodificato a 1/8 (cam_decode_8x).
+// Il frame si pubblica se la firma si discosta dall'ultima pubblicata oltre
+// la soglia, oppure allo scadere del keyframe.
+// Modulo puro: la decodifica sta in birdcam_cam, qui solo firma e decisione.
+
+#define SCENE_GRID_W     16
+#define SCENE_GRID_H     12
+#define SCENE_CELLS      (SCENE_GRID_W * SCENE_GRID_H)
+#define SCENE_CELL_DELTA 10    // luma: sotto questa differenza la cella è invariata
+
+struct scene_stats_t {
+  uint32_t published;
+  uint32_t skipped;
+  uint32_t bytes_sent;
+  uint32_t bytes_saved;   // somma dei JPEG non pubblicati
+  int      last_score;    // % celle cambiate nell'ultimo confronto (-1 = nessuno)
+};
+
+// threshold_pct = 0 disattiva la soppressione (si pubblica tutto)
+void scene_configure(int threshold_pct, uint32_t keyframe_s);
+bool scene_enabled();
+
+// true se il frame va pubblicato; aggiorna riferimento e contatori.
+// sig = nullptr (decodifica fallita o soppressione spenta): si pubblica.
+bool scene_should_publish(const uint8_t* sig, size_t jpg_len, uint32_t now_ms);
+
+void scene_get_stats(scene_stats_t* out);
+
+// Media di luma per cella da un'immagine RGB565 (big-endian, come jpg2rgb565),
+// calcolata da kern_luma_grid (birdcam_kernels)
+void scene_signature(const uint8_t* rgb565, int w, int h, uint8_t sig[SCENE_CELLS]);
+// % di celle cambiate, al netto dello spostamento medio (nuvole, AEC)
+int  scene_score(const uint8_t a[SCENE_CELLS], const uint8_t b[SCENE_CELLS]);
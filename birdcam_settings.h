@@ -10,9 +10,16 @@ int bc_get_framesize();
 int bc_get_jpeg_quality();
 int bc_get_img_mode();
 
-void bc_apply_settings(int framesize, int jpeg_quality, int img_mode);
+// -1 se la risoluzione non sta nel budget dei frame buffer (resta la precedente,
+// motivo in bc_get_camera_error()); se serve, la camera si re-inizializza a caldo
+int bc_apply_settings(int framesize, int jpeg_quality, int img_mode);
+const char* bc_get_camera_error();
 void bc_save_settings();
 
+// Età massima (ms) del frame in cache per /snapshot (0..10000)
+int bc_get_snapshot_max_age_ms();
+int bc_set_snapshot_max_age_ms(int ms);
+
 int bc_get_archive_keep();
 int bc_set_archive_keep(int keep);
 
@@ -20,6 +27,30 @@ int bc_get_snapshot_count();
 uint32_t bc_get_snapshot_bytes_used();
 uint32_t bc_get_snapshot_bytes_limit();
 
+// Metriche di boot (ms da reset, 0 = non ancora avvenuto)
+void bc_get_boot_metrics(uint32_t* camera_ms, uint32_t* wifi_ms, uint32_t* ntp_ms, uint32_t* first_capture_ms);
+
+// Power manager su batteria: light sleep dopo N s di inattività (0 = mai),
+// deep sleep opzionale (perde l'archivio in PSRAM) dopo N s
+void bc_get_power_settings(int* light_idle_s, int* deep_enable, int* deep_idle_s);
+void bc_set_power_settings(int light_idle_s, int deep_enable, int deep_idle_s);
+
+// Timelapse: intervallo in s (0 = off, 5..3600), framesize, frame tenuti (1..TL_MAX_FRAMES)
+void bc_get_timelapse(int* interval_s, int* framesize, int* keep);
+void bc_set_timelapse(int interval_s, int framesize, int keep);
+
+// ROI sensore (OV5640): x, y, w in % dell'area attiva (w 10..100, 100 = campo pieno),
+// profiles = bit (1 << cam_profile_t) dei profili che la usano
+void bc_get_roi(int* x, int* y, int* w, int* profiles);
+void bc_set_roi(int x, int y, int w, int profiles);
+
+// Stream MQTT: soglia cambio scena in % celle (0 = pubblica tutto), keyframe 10..3600 s
+void bc_get_scene(int* threshold_pct, int* keyframe_s);
+void bc_set_scene(int threshold_pct, int keyframe_s);
+
+// IP statico (ip, gateway, subnet, dns; 0 = DHCP), applicato alla prossima associazione
+void bc_get_static_ip(uint32_t out[4]);
+void bc_set_static_ip(const uint32_t in[4]);
 
 // Camera image controls (persisted)
 int bc_get_brightness();      // -2..2
@@ -0,0 +1,153 @@
+#include "birdcam_timelapse.h"
+
+#include "esp_heap_caps.h"
+#include "birdcam_cam.h"
+
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static tl_frame_t* s_ring = nullptr;   // TL_MAX_FRAMES voci, in PSRAM
+static int s_head = 0;                 // voce più vecchia
+static int s_count = 0;
+static uint32_t s_bytes = 0;
+
+static uint32_t s_interval_ms = 0;
+static framesize_t s_fs = FRAMESIZE_VGA;
+static int s_q = 12;
+static int s_keep = 288;
+static uint32_t s_last_ms = 0;
+static bool s_armed = false;           // primo frame subito dopo l'attivazione
+
+static uint32_t s_captured = 0, s_failed = 0, s_evicted = 0;
+
+void tl_init() {
+  if (s_ring) return;
+  size_t sz = sizeof(tl_frame_t) * TL_MAX_FRAMES;
+  s_ring = (tl_frame_t*)heap_caps_calloc(1, sz, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (!s_ring) s_ring = (tl_frame_t*)calloc(1, sz);
+}
+
+// chiamare con s_mux preso; ritorna il blob da rilasciare fuori dalla sezione critica
+static bc_blob_t* drop_oldest_locked() {
+  tl_frame_t& f = s_ring[s_head];
+  bc_blob_t* b = f.blob;
+  s_bytes -= b ? (uint32_t)b->len : 0;
+  f.blob = nullptr;
+  s_head = (s_head + 1) % TL_MAX_FRAMES;
+  s_count--;
+  s_evicted++;
+  return b;
+}
+
+static void trim(int keep, uint32_t extra_bytes) {
+  for (;;) {
+    bc_blob_t* b = nullptr;
+    portENTER_CRITICAL(&s_mux);
+    if (s_count > 0 && (s_count > keep || s_bytes + extra_bytes > TL_MAX_BYTES)) b = drop_oldest_locked();
+    portEXIT_CRITICAL(&s_mux);
+    if (!b) break;
+    bc_blob_unref(b);
+  }
+}
+
+void tl_configure(uint32_t interval_s, framesize_t fs, int q, int keep) {
+  if (keep < 1) keep = 1;
+  if (keep > TL_MAX_FRAMES) keep = TL_MAX_FRAMES;
+  uint32_t iv = interval_s * 1000UL;
+  if (iv && iv != s_interval_ms) s_armed = true;
+  s_interval_ms = iv;
+  s_fs = fs;
+  s_q = q;
+  s_keep = keep;
+  trim(keep, 0);
+}
+
+bool tl_tick(uint32_t now_ms, time_t ts) {
+  if (!s_ring || !s_interval_ms) return false;
+  if (!s_armed && now_ms - s_last_ms < s_interval_ms) return false;
+  s_armed = false;
+  s_last_ms = now_ms;
+
+  framesize_t fs = cam_arb_fits(s_fs) ? s_fs : cam_arb_fb_max();
+  cam_frame_t f;
+  if (cam_arb_grab(CAM_PROFILE_TIMELAPSE, fs, s_q, &f, 2000) != CAM_OK) {
+    s_failed++;
+    return false;
+  }
+
+  bc_blob_t* b = (f.len <= TL_MAX_BYTES) ? bc_blob_new(f.len) : nullptr;
+  if (!b) {
+    cam_arb_release(&f);
+    s_failed++;
+    return false;
+  }
+  memcpy(b->data, f.buf, f.len);
+  uint16_t w = f.width, h = f.height;
+  cam_arb_release(&f);
+
+  // spazio per il nuovo frame: via i più vecchi
+  trim(s_keep - 1, (uint32_t)b->len);
+
+  portENTER_CRITICAL(&s_mux);
+  tl_frame_t& slot = s_ring[(s_head + s_count) % TL_MAX_FRAMES];
+  slot.blob = b;
+  slot.width = w;
+  slot.height = h;
+  slot.ts = ts;
+  slot.ms = now_ms;
+  s_count++;
+  s_bytes += (uint32_t)b->len;
+  portEXIT_CRITICAL(&s_mux);
+
+  s_captured++;
+  return true;
+}
+
+uint32_t tl_ms_to_next(uint32_t now_ms) {
+  if (!s_ring || !s_interval_ms) return UINT32_MAX;
+  if (s_armed) return 0;
+  uint32_t el = now_ms - s_last_ms;
+  return el >= s_interval_ms ? 0 : s_interval_ms - el;
+}
+
+void tl_time_synced(time_t now, uint32_t now_ms) {
+  if (!s_ring) return;
+  portENTER_CRITICAL(&s_mux);
+  for (int i = 0; i < s_count; i++) {
+    tl_frame_t& f = s_ring[(s_head + i) % TL_MAX_FRAMES];
+    if (f.ts == 0) f.ts = now - (time_t)((now_ms - f.ms) / 1000);
+  }
+  portEXIT_CRITICAL(&s_mux);
+}
+
+int tl_pin(tl_frame_t* out, int max, time_t since) {
+  if (!s_ring || !out || max <= 0) return 0;
+  int n = 0;
+  portENTER_CRITICAL(&s_mux);
+  for (int i = 0; i < s_count && n < max; i++) {
+    const tl_frame_t& f = s_ring[(s_head + i) % TL_MAX_FRAMES];
+    if (since > 0 && f.ts < since) continue;
+    out[n] = f;
+    bc_blob_ref(out[n].blob);
+    n++;
+  }
+  portEXIT_CRITICAL(&s_mux);
+  return n;
+}
+
+void tl_unpin(tl_frame_t* frames, int n) {
+  if (!frames) return;
+  for (int i = 0; i < n; i++) {
+    bc_blob_unref(frames[i].blob);
+    frames[i].blob = nullptr;
+  }
+}
+
+void tl_get_stats(tl_stats_t* out) {
+  if (!out) return;
+  portENTER_CRITICAL(&s_mux);
+  out->frames = s_count;
+  out->bytes = s_bytes;
+  portEXIT_CRITICAL(&s_mux);
+  out->captured = s_captured;
+  out->failed = s_failed;
+  out->evicted = s_evicted;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Arduino.h>
+#include <time.h>
+#include "esp_camera.h"
+#include "birdcam_blob.h"
+
+// Timelapse: cattura a intervallo fisso in un ring PSRAM separato
+// dall'archivio PIR (limitato a keep frame e TL_MAX_BYTES).
+// I frame sono blob con refcount: /timelapse.avi li pinna e li invia
+// così come sono, senza copie.
+
+#define TL_MAX_FRAMES 1440                 // 24 h a 1 frame/min
+#define TL_MAX_BYTES  (3UL * 1024 * 1024)
+
+struct tl_frame_t {
+  bc_blob_t* blob;
+  uint16_t   width;
+  uint16_t   height;
+  time_t     ts;      // 0 = ora non ancora sincronizzata
+  uint32_t   ms;      // millis() di cattura
+};
+
+struct tl_stats_t {
+  int      frames;
+  uint32_t bytes;
+  uint32_t captured;
+  uint32_t failed;
+  uint32_t evicted;
+};
+
+void tl_init();
+
+// interval_s = 0 disattiva la cattura (il ring resta disponibile)
+void tl_configure(uint32_t interval_s, framesize_t fs, int q, int keep);
+
+// Dal loop: cattura se l'intervallo è scaduto. ts = epoch corrente o 0.
+bool tl_tick(uint32_t now_ms, time_t ts);
+
+// ms al prossimo frame (UINT32_MAX se disattivato): limita il light sleep
+uint32_t tl_ms_to_next(uint32_t now_ms);
+
+// NTP arrivato dopo le catture: ricostruisce ts dai millis()
+void tl_time_synced(time_t now, uint32_t now_ms);
+
+// Copia in out i frame (dal più vecchio) con ts >= since, pinnati:
+// vanno restituiti con tl_unpin()
+int  tl_pin(tl_frame_t* out, int max, time_t since);
+void tl_unpin(tl_frame_t* frames, int n);
+
+void tl_get_stats(tl_stats_t* out);
@@ -0,0 +1,32 @@
+#pragma once
+
+// Micro-benchmark host dei moduli puri: tempo per operazione sulla macchina
+// di sviluppo, per confrontare varianti (non è il tempo sull'ESP32-S3).
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+// ripetizioni: argv[1] se c'è (ctest passa un valore piccolo, solo per
+// tenerli compilati e funzionanti), altrimenti def
+inline long bench_rounds(int argc, char** argv, long def) {
+  long n = argc > 1 ? atol(argv[1]) : def;
+  return n > 0 ? n : def;
+}
+
+template <typename F>
+double bench_ns(long ops, F&& f) {
+  auto t0 = std::chrono::steady_clock::now();
+  f();
+  auto dt = std::chrono::steady_clock::now() - t0;
+  return std::chrono::duration<double, std::nano>(dt).count() / (double)ops;
+}
+
+inline void bench_print(const char* name, double ns_per_op) {
+  printf("%-28s %10.1f ns/op\n", name, ns_per_op);
+}
+
+// impedisce al compilatore di scartare il risultato
+inline void bench_sink(long v) {
+  static volatile long sink;
+  sink = sink + v;
+}
@@ -0,0 +1,84 @@
+// Router MQTT: indice hash di ctrl_route contro una ricerca lineare sulle
+// 34 chiavi, e ctrl_parse per tipo di comando.
+#include "bench.h"
+#include "ctrl_keys.h"
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char* BASE = "birdcam/665544332211";
+
+// riferimento: prefisso + confronto chiave per chiave
+int route_linear(const ctrl_router_t* r, const char* topic) {
+  if (strncmp(topic, r->prefix, r->prefix_len) != 0) return -1;
+  const char* key = topic + r->prefix_len;
+  for (int i = 0; i < r->count; i++) {
+    size_t n = strlen(r->table[i].key);
+    if (!strncmp(key, r->table[i].key, n) && !strcmp(key + n, "/set")) return i;
+  }
+  return -1;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  long rounds = bench_rounds(argc, argv, 200000);
+
+  static int      ints[CTRL_KEY_COUNT];
+  static uint32_t ips[CTRL_KEY_COUNT];
+  ctrl_cmd_t cmds[CTRL_KEY_COUNT];
+  for (int i = 0; i < CTRL_KEY_COUNT; i++) {
+    const ctrl_key_t& k = CTRL_KEYS[i];
+    cmds[i] = ctrl_cmd_t{k.key, k.kind, 1, k.min, k.kind == CTRL_FRAMESIZE ? 13 : k.max,
+                         k.kind == CTRL_IPV4 ? (const void*)&ips[i] : (const void*)&ints[i]};
+  }
+  ctrl_router_t r;
+  if (!ctrl_router_init(&r, cmds, CTRL_KEY_COUNT, BASE)) return 1;
+
+  // tutte le chiavi + topic che non sono comandi (come i retained di stato)
+  std::vector<std::string> topics;
+  for (const ctrl_key_t& k : CTRL_KEYS) topics.push_back(std::string(BASE) + "/ctrl/" + k.key + "/set");
+  for (const char* t : {"/ctrl/quality", "/ctrl/nope/set", "/status", "/ctrl/roi_timelapse"}) topics.push_back(std::string(BASE) + t);
+  for (const std::string& t : topics) {
+    if (ctrl_route(&r, t.c_str()) != route_linear(&r, t.c_str())) {
+      fprintf(stderr, "bench_ctrl: %s instradato diversamente\n", t.c_str());
+      return 1;
+    }
+  }
+
+  long ops = rounds * (long)topics.size();
+  bench_print("ctrl_route (hash)", bench_ns(ops, [&] {
+    long s = 0;
+    for (long n = 0; n < rounds; n++) for (const std::string& t : topics) s += ctrl_route(&r, t.c_str());
+    bench_sink(s);
+  }));
+  bench_print("route lineare", bench_ns(ops, [&] {
+    long s = 0;
+    for (long n = 0; n < rounds; n++) for (const std::string& t : topics) s += route_linear(&r, t.c_str());
+    bench_sink(s);
+  }));
+
+  struct { const char* name; int id; const char* msg; } parses[] = {
+    {"ctrl_parse int", 13, "2500"},
+    {"ctrl_parse bool", 7, "ON"},
+    {"ctrl_parse ipv4", 30, "192.168.1.50"},
+  };
+  for (auto& p : parses) {
+    bench_print(p.name, bench_ns(rounds, [&] {
+      long s = 0;
+      int32_t v;
+      for (long n = 0; n < rounds; n++) if (ctrl_parse(&cmds[p.id], p.msg, &v)) s += v;
+      bench_sink(s);
+    }));
+  }
+  char buf[24];
+  bench_print("ctrl_format ipv4", bench_ns(rounds, [&] {
+    long s = 0;
+    for (long n = 0; n < rounds; n++) s += (long)ctrl_format(&cmds[30], (int32_t)(0x3201A8C0u + (uint32_t)n), buf, sizeof(buf));
+    bench_sink(s);
+  }));
+  return 0;
+}
@@ -0,0 +1,44 @@
+// Kernel di immagine: riferimento scalare contro versione SWAR, con lo stesso
+// kern_bench() di /api/kernels e un orologio in ns al posto dei cicli.
+#include "bench.h"
+#include "birdcam_kernels.h"
+
+#include <chrono>
+
+namespace {
+
+uint32_t clock_ns() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  long rounds = bench_rounds(argc, argv, 50);
+  const struct { int w, h; } sizes[] = {{96, 96}, {320, 240}, {640, 480}};
+  bool exact = true;
+  for (auto& sz : sizes) {
+    // minimo su più giri: meno rumore dallo scheduler
+    kern_bench_t best[KERN_BENCH_COUNT] = {};
+    for (long r = 0; r < rounds; r++) {
+      kern_bench_t kb[KERN_BENCH_COUNT];
+      int n = kern_bench(clock_ns, sz.w, sz.h, kb, KERN_BENCH_COUNT);
+      if (n != KERN_BENCH_COUNT) return 1;
+      for (int i = 0; i < n; i++) {
+        exact = exact && kb[i].exact;
+        if (r == 0 || kb[i].ref_cycles < best[i].ref_cycles) best[i].ref_cycles = kb[i].ref_cycles;
+        if (r == 0 || kb[i].fast_cycles < best[i].fast_cycles) best[i].fast_cycles = kb[i].fast_cycles;
+        best[i].name = kb[i].name;
+        best[i].pixels = kb[i].pixels;
+      }
+    }
+    printf("%dx%d\n", sz.w, sz.h);
+    for (const kern_bench_t& k : best) {
+      double ref = (double)k.ref_cycles / k.pixels, fast = (double)k.fast_cycles / k.pixels;
+      printf("  %-12s ref %7.3f  fast %7.3f ns/px  x%.2f\n", k.name, ref, fast, fast > 0 ? ref / fast : 0.0);
+    }
+  }
+  if (!exact) fprintf(stderr, "bench_kernels: uscita diversa dal riferimento\n");
+  return exact ? 0 : 1;
+}
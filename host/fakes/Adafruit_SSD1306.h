@@ -0,0 +1,7 @@
+#pragma once
+#include "Wire.h"
+#define SSD1306_SWITCHCAPVCC 2
+#define SSD1306_WHITE 1
+#define SSD1306_DISPLAYOFF 0xAE
+#define SSD1306_DISPLAYON 0xAF
+class Adafruit_SSD1306 { public: Adafruit_SSD1306(int,int,TwoWire*,int); bool begin(int,int); void setRotation(int); void clearDisplay(); void display(); void ssd1306_command(int); void setTextColor(int); void setTextSize(int); void setCursor(int,int); size_t print(const char*); size_t print(const String&); size_t printf(const char*, ...); };
@@ -0,0 +1,74 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <string>
+#include <sys/time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "esp_err.h"
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define PROGMEM
+#define INPUT 1
+#define INPUT_PULLDOWN 9
+#define RISING 1
+#define CHANGE 3
+#define HIGH 1
+#define LOW 0
+typedef uint8_t byte;
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t);
+void configTzTime(const char*, const char*, const char* = nullptr, const char* = nullptr);
+void pinMode(int, int);
+int digitalRead(int);
+int digitalPinToInterrupt(int);
+void attachInterrupt(int, void(*)(), int);
+void detachInterrupt(int);
+bool psramFound();
+class String {
+ public:
+  String(const char* s = "") : s_(s ? s : "") {}
+  String(int v) : s_(std::to_string(v)) {}
+  String(unsigned v) : s_(std::to_string(v)) {}
+  String(long v) : s_(std::to_string(v)) {}
+  String(unsigned long v) : s_(std::to_string(v)) {}
+  const char* c_str() const { return s_.c_str(); }
+  size_t length() const { return s_.size(); }
+  void reserve(size_t n) { s_.reserve(n); }
+  String& operator+=(const String& o) { s_ += o.s_; return *this; }
+  String& operator+=(const char* o) { s_ += o; return *this; }
+  String& operator+=(char c) { s_ += c; return *this; }
+  friend String operator+(const String& a, const String& b) { String r(a); r += b; return r; }
+  friend String operator+(const String& a, const char* b) { String r(a); r += b; return r; }
+  friend String operator+(const char* a, const String& b) { String r(a); r += b; return r; }
+ private:
+  std::string s_;
+};
+class HardwareSerial {
+ public:
+  void begin(unsigned long);
+  size_t println(const char*);
+  size_t println(const String&);
+  size_t print(const char*);
+  size_t printf(const char*, ...);
+};
+extern HardwareSerial Serial;
+class EspClass {
+ public:
+  uint64_t getEfuseMac();
+  uint32_t getCycleCount();
+  uint32_t getFreePsram();
+  uint32_t getPsramSize();
+  void restart();
+};
+extern EspClass ESP;
+uint32_t getCpuFrequencyMhz();
@@ -0,0 +1,13 @@
+#pragma once
+#include "Arduino.h"
+class IPAddress {
+ public:
+  IPAddress();
+  IPAddress(uint32_t);
+  IPAddress(uint8_t, uint8_t, uint8_t, uint8_t);
+  String toString() const;
+  bool fromString(const char*);
+  operator uint32_t() const;
+ private:
+  uint8_t b_[4];
+};
@@ -0,0 +1,14 @@
+#pragma once
+#include "Arduino.h"
+class Preferences { public:
+ bool begin(const char*, bool readOnly=false); void end();
+ size_t putInt(const char*, int32_t); int32_t getInt(const char*, int32_t=0);
+ size_t putUInt(const char*, uint32_t); uint32_t getUInt(const char*, uint32_t=0);
+ size_t putUChar(const char*, uint8_t); uint8_t getUChar(const char*, uint8_t=0);
+ size_t putBytes(const char*, const void*, size_t); size_t getBytes(const char*, void*, size_t);
+ size_t putString(const char*, const char*); String getString(const char*, const String& = String());
+ bool remove(const char*); bool isKey(const char*);
+ private:
+ std::string ns_;
+ bool ro_ = true;
+};
@@ -0,0 +1,33 @@
+#pragma once
+#include "Arduino.h"
+#include "WiFi.h"
+#include <string>
+#define MQTT_CALLBACK_SIGNATURE void (*callback)(char*, uint8_t*, unsigned int)
+#define MQTT_CONNECTION_TIMEOUT -4
+#define MQTT_CONNECTION_LOST -3
+#define MQTT_CONNECT_FAILED -2
+#define MQTT_DISCONNECTED -1
+#define MQTT_CONNECTED 0
+class PubSubClient { public:
+ PubSubClient(WiFiClient&);
+ ~PubSubClient();
+ PubSubClient& setServer(const char*, uint16_t);
+ PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE);
+ bool connect(const char*, const char*, const char*, const char*, uint8_t, bool, const char*);
+ bool connected(); bool loop(); int state();
+ bool publish(const char*, const char*, bool);
+ bool publish(const char*, const char*);
+ bool publish(const char*, const uint8_t*, unsigned int, bool);
+ bool subscribe(const char*); void disconnect(); bool setBufferSize(uint16_t); PubSubClient& setKeepAlive(uint16_t);
+ bool beginPublish(const char*, unsigned int, bool); size_t write(const uint8_t*, size_t); int endPublish();
+ private:
+  void (*cb_)(char*, uint8_t*, unsigned int) = nullptr;
+  uint8_t* buf_ = nullptr;
+  uint16_t buf_size_ = 0;
+  int      id_ = -1;          // sessione nel broker (mqtt.cpp)
+  int      state_ = MQTT_DISCONNECTED;
+  std::string stream_topic_;  // beginPublish .. endPublish
+  std::string stream_;
+  unsigned    stream_len_ = 0;
+  bool        stream_retained_ = false;
+};
@@ -0,0 +1,27 @@
+#pragma once
+#include "Arduino.h"
+#include "IPAddress.h"
+#include "esp_wifi.h"
+#define WIFI_STA 1
+typedef enum { WL_IDLE_STATUS, WL_CONNECTED = 3, WL_DISCONNECTED = 6 } wl_status_t;
+class WiFiClass {
+ public:
+  bool mode(int);
+  wl_status_t begin(const char*, const char*, int32_t channel = 0, const uint8_t* bssid = nullptr, bool connect = true);
+  bool config(IPAddress, IPAddress, IPAddress, IPAddress dns1 = IPAddress(), IPAddress dns2 = IPAddress());
+  wl_status_t status();
+  bool isConnected();
+  IPAddress localIP();
+  int8_t RSSI();
+  int32_t channel();
+  uint8_t* BSSID();
+  String SSID();
+  String macAddress();
+  bool setSleep(bool);
+  bool setSleep(wifi_ps_type_t);
+  bool setAutoReconnect(bool);
+  bool disconnect(bool wifioff = false);
+  bool reconnect();
+};
+extern WiFiClass WiFi;
+class WiFiClient { public: int connect(const char*, uint16_t); bool connected(); };
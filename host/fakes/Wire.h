@@ -0,0 +1,4 @@
+#pragma once
+#include "Arduino.h"
+class TwoWire { public: bool begin(int, int); };
+extern TwoWire Wire;
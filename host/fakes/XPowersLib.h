@@ -0,0 +1,12 @@
+#pragma once
+#include "Wire.h"
+#define AXP2101_SLAVE_ADDRESS 0x34
+#define XPOWERS_CHG_LED_OFF 0
+class XPowersPMU { public:
+ bool begin(TwoWire&, uint8_t, int, int);
+ void setALDO1Voltage(int); void enableALDO1(); void setALDO2Voltage(int); void enableALDO2();
+ void setALDO3Voltage(int); void enableALDO3(); void setALDO4Voltage(int); void enableALDO4();
+ void setBLDO1Voltage(int); void enableBLDO1(); void disableTSPinMeasure(); void setChargingLedMode(int);
+ void enableVbusVoltageMeasure(); void enableSystemVoltageMeasure(); void enableBattVoltageMeasure(); void enableBattDetection();
+ uint16_t getVbusVoltage(); uint16_t getSystemVoltage(); uint16_t getBattVoltage(); bool isBatteryConnect(); int getBatteryPercent(); bool isVbusIn();
+};
@@ -0,0 +1,139 @@
+// Arduino core, esp_timer, Serial, ESP e periferiche senza stato (I2C, OLED).
+#include "Arduino.h"
+#include "IPAddress.h"
+#include "Wire.h"
+#include "Adafruit_SSD1306.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+
+#include "sim.h"
+
+#include <stdarg.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+
+namespace {
+using clk = std::chrono::steady_clock;
+const clk::time_point t_boot = clk::now();
+std::atomic<uint32_t> s_serial_lines{0};
+
+bool serial_on() {
+  static const bool on = getenv("BIRDCAM_SIM_SERIAL") && atoi(getenv("BIRDCAM_SIM_SERIAL")) != 0;
+  return on;
+}
+
+size_t serial_out(const char* s, size_t n) {
+  for (size_t i = 0; i < n; i++) if (s[i] == '\n') s_serial_lines++;
+  if (serial_on()) fwrite(s, 1, n, stderr);
+  return n;
+}
+}  // namespace
+
+// ---- tempo ----
+int64_t esp_timer_get_time() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(clk::now() - t_boot).count();
+}
+uint32_t millis() { return (uint32_t)(esp_timer_get_time() / 1000); }
+uint32_t micros() { return (uint32_t)esp_timer_get_time(); }
+void delay(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+void configTzTime(const char* tz, const char*, const char*, const char*) {
+  // l'orologio dell'host è già sincronizzato: basta il fuso
+  setenv("TZ", tz, 1);
+  tzset();
+}
+
+uint32_t getCpuFrequencyMhz() { return 240; }
+
+uint32_t esp_random() {
+  static std::mt19937 rng(0xB1DCA11u);
+  static std::mutex m;
+  std::lock_guard<std::mutex> lk(m);
+  return rng();
+}
+
+const char* esp_err_to_name(esp_err_t err) {
+  switch (err) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    default: return "UNKNOWN ERROR";
+  }
+}
+
+// ---- Serial ----
+HardwareSerial Serial;
+void HardwareSerial::begin(unsigned long) {}
+size_t HardwareSerial::print(const char* s) { return serial_out(s, strlen(s)); }
+size_t HardwareSerial::println(const char* s) { size_t n = print(s); return n + serial_out("\n", 1); }
+size_t HardwareSerial::println(const String& s) { return println(s.c_str()); }
+size_t HardwareSerial::printf(const char* fmt, ...) {
+  char buf[512];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+  if (n < 0) return 0;
+  return serial_out(buf, (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1);
+}
+
+uint32_t sim_serial_lines() { return s_serial_lines.load(); }
+
+// ---- ESP ----
+EspClass ESP;
+uint64_t EspClass::getEfuseMac() { return 0x665544332211ULL; }
+// contatore cicli a 240 MHz dall'orologio dell'host
+uint32_t EspClass::getCycleCount() {
+  return (uint32_t)(std::chrono::duration_cast<std::chrono::nanoseconds>(clk::now() - t_boot).count() * 240 / 1000);
+}
+void EspClass::restart() {
+  fprintf(stderr, "sim: ESP.restart()\n");
+  sim_exit(3);
+}
+
+// ---- IPAddress (byte in ordine di memoria, come su ESP32) ----
+IPAddress::IPAddress() : IPAddress(0u) {}
+IPAddress::IPAddress(uint32_t a) { memcpy(b_, &a, 4); }
+IPAddress::IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) { b_[0] = a; b_[1] = b; b_[2] = c; b_[3] = d; }
+String IPAddress::toString() const {
+  char s[16];
+  snprintf(s, sizeof(s), "%u.%u.%u.%u", b_[0], b_[1], b_[2], b_[3]);
+  return String(s);
+}
+bool IPAddress::fromString(const char* s) {
+  unsigned a, b, c, d;
+  if (!s || sscanf(s, "%u.%u.%u.%u", &a, &b, &c, &d) != 4 || a > 255 || b > 255 || c > 255 || d > 255) return false;
+  *this = IPAddress((uint8_t)a, (uint8_t)b, (uint8_t)c, (uint8_t)d);
+  return true;
+}
+IPAddress::operator uint32_t() const {
+  uint32_t a;
+  memcpy(&a, b_, 4);
+  return a;
+}
+
+// ---- I2C / OLED: nessun effetto ----
+TwoWire Wire;
+bool TwoWire::begin(int, int) { return true; }
+
+Adafruit_SSD1306::Adafruit_SSD1306(int, int, TwoWire*, int) {}
+bool Adafruit_SSD1306::begin(int, int) { return true; }
+void Adafruit_SSD1306::setRotation(int) {}
+void Adafruit_SSD1306::clearDisplay() {}
+void Adafruit_SSD1306::display() {}
+void Adafruit_SSD1306::ssd1306_command(int) {}
+void Adafruit_SSD1306::setTextColor(int) {}
+void Adafruit_SSD1306::setTextSize(int) {}
+void Adafruit_SSD1306::setCursor(int, int) {}
+size_t Adafruit_SSD1306::print(const char* s) { return s ? strlen(s) : 0; }
+size_t Adafruit_SSD1306::print(const String& s) { return s.length(); }
+size_t Adafruit_SSD1306::printf(const char*, ...) { return 0; }
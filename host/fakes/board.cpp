@@ -0,0 +1,237 @@
+// Scheda simulata: PIR su un pin con il suo tipo di interrupt, light/deep
+// sleep, PMU AXP2101 con VBUS e batteria pilotati dallo scenario.
+#include "Arduino.h"
+#include "XPowersLib.h"
+#include "esp_sleep.h"
+#include "driver/gpio.h"
+
+#include "sim.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+typedef void (*isr_t)();
+
+struct Pin {
+  int             num = -1;
+  bool            level = false;
+  gpio_int_type_t intr = GPIO_INTR_DISABLE;
+  isr_t           isr = nullptr;
+  bool            wake = false;
+  gpio_int_type_t wake_type = GPIO_INTR_DISABLE;
+};
+
+std::mutex              s_m;
+std::condition_variable s_cv;
+Pin                     s_pin;          // un solo pin con interrupt: il PIR
+std::atomic<uint32_t>   s_isr_calls{0};
+std::atomic<bool>       s_vbus{true};
+std::atomic<uint16_t>   s_batt_mv{3950};
+
+bool                      s_sleeping = false;
+std::atomic<uint32_t>     s_light_sleeps{0};
+std::atomic<bool>         s_deep = false;
+bool                      s_gpio_wake = false;
+uint64_t                  s_timer_wake_us = 0;
+esp_sleep_wakeup_cause_t  s_cause = ESP_SLEEP_WAKEUP_UNDEFINED;
+std::once_flag            s_level_once;
+
+void call_isr(isr_t isr) {
+  if (!isr) return;
+  s_isr_calls++;
+  isr();
+}
+
+bool level_pending_locked() {
+  return s_pin.isr && !s_sleeping && s_pin.level &&
+         (s_pin.intr == GPIO_INTR_HIGH_LEVEL);
+}
+
+// Interrupt a livello: finché il pin resta al livello l'ISR rientra di
+// continuo (sul chip affama la CPU). Qui un thread la richiama ogni 50 us.
+void level_irq_thread() {
+  std::unique_lock<std::mutex> lk(s_m);
+  for (;;) {
+    s_cv.wait(lk, [] { return level_pending_locked(); });
+    isr_t isr = s_pin.isr;
+    lk.unlock();
+    call_isr(isr);
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+    lk.lock();
+  }
+}
+
+void set_intr_locked(gpio_int_type_t t) {
+  s_pin.intr = t;
+  std::call_once(s_level_once, [] { std::thread(level_irq_thread).detach(); });
+}
+
+}  // namespace
+
+// ---- pin ----
+void pinMode(int pin, int) {
+  std::lock_guard<std::mutex> lk(s_m);
+  s_pin.num = pin;
+}
+
+int digitalRead(int pin) {
+  std::lock_guard<std::mutex> lk(s_m);
+  return pin == s_pin.num && s_pin.level ? HIGH : LOW;
+}
+
+int digitalPinToInterrupt(int pin) { return pin; }
+
+void attachInterrupt(int pin, void (*isr)(), int mode) {
+  std::lock_guard<std::mutex> lk(s_m);
+  s_pin.num = pin;
+  s_pin.isr = isr;
+  set_intr_locked(mode == CHANGE ? GPIO_INTR_ANYEDGE : GPIO_INTR_POSEDGE);
+  s_cv.notify_all();
+}
+
+void detachInterrupt(int) {
+  std::lock_guard<std::mutex> lk(s_m);
+  s_pin.isr = nullptr;
+  s_pin.intr = GPIO_INTR_DISABLE;
+}
+
+bool psramFound() { return true; }
+
+esp_err_t gpio_set_intr_type(gpio_num_t pin, gpio_int_type_t t) {
+  std::lock_guard<std::mutex> lk(s_m);
+  if (pin != s_pin.num) return ESP_ERR_INVALID_ARG;
+  set_intr_locked(t);
+  s_cv.notify_all();
+  return ESP_OK;
+}
+
+esp_err_t gpio_wakeup_enable(gpio_num_t pin, gpio_int_type_t t) {
+  if (t != GPIO_INTR_HIGH_LEVEL && t != GPIO_INTR_LOW_LEVEL) return ESP_ERR_INVALID_ARG;
+  std::lock_guard<std::mutex> lk(s_m);
+  if (pin != s_pin.num) return ESP_ERR_INVALID_ARG;
+  s_pin.wake = true;
+  s_pin.wake_type = t;
+  set_intr_locked(t);
+  s_cv.notify_all();
+  return ESP_OK;
+}
+
+esp_err_t gpio_wakeup_disable(gpio_num_t pin) {
+  std::lock_guard<std::mutex> lk(s_m);
+  if (pin != s_pin.num) return ESP_ERR_INVALID_ARG;
+  s_pin.wake = false;
+  return ESP_OK;
+}
+
+void sim_set_pir(bool high) {
+  isr_t edge = nullptr;
+  {
+    std::lock_guard<std::mutex> lk(s_m);
+    bool prev = s_pin.level;
+    s_pin.level = high;
+    if (!s_sleeping && high != prev && s_pin.isr) {
+      if ((high && s_pin.intr == GPIO_INTR_POSEDGE) || (!high && s_pin.intr == GPIO_INTR_NEGEDGE) ||
+          s_pin.intr == GPIO_INTR_ANYEDGE) {
+        edge = s_pin.isr;
+      }
+    }
+    s_cv.notify_all();
+  }
+  call_isr(edge);
+}
+
+uint32_t sim_pir_isr_calls() { return s_isr_calls.load(); }
+
+// ---- sleep ----
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t us) {
+  std::lock_guard<std::mutex> lk(s_m);
+  s_timer_wake_us = us;
+  return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_gpio_wakeup() {
+  std::lock_guard<std::mutex> lk(s_m);
+  s_gpio_wake = true;
+  return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_ext0_wakeup(gpio_num_t, int) { return ESP_OK; }
+
+// Blocca finché il pin di wake è al livello o scade il timer
+esp_err_t esp_light_sleep_start() {
+  std::unique_lock<std::mutex> lk(s_m);
+  s_sleeping = true;
+  s_light_sleeps++;
+  auto gpio_ready = [] {
+    if (!s_gpio_wake || !s_pin.wake) return false;
+    return s_pin.wake_type == GPIO_INTR_HIGH_LEVEL ? s_pin.level : !s_pin.level;
+  };
+  bool by_gpio;
+  if (s_timer_wake_us) {
+    by_gpio = s_cv.wait_for(lk, std::chrono::microseconds(s_timer_wake_us), gpio_ready);
+  } else {
+    s_cv.wait(lk, gpio_ready);
+    by_gpio = true;
+  }
+  s_cause = by_gpio ? ESP_SLEEP_WAKEUP_GPIO : ESP_SLEEP_WAKEUP_TIMER;
+  s_sleeping = false;
+  s_gpio_wake = false;
+  s_timer_wake_us = 0;
+  s_cv.notify_all();
+  return ESP_OK;
+}
+
+void esp_deep_sleep_start() {
+  s_deep = true;
+  // il chip si spegne: il task che ci arriva non riparte più
+  for (;;) std::this_thread::sleep_for(std::chrono::hours(1));
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause() {
+  std::lock_guard<std::mutex> lk(s_m);
+  return s_cause;
+}
+
+bool sim_in_light_sleep() {
+  std::lock_guard<std::mutex> lk(s_m);
+  return s_sleeping;
+}
+uint32_t sim_light_sleeps() { return s_light_sleeps.load(); }
+bool sim_deep_slept() { return s_deep.load(); }
+
+// ---- PMU ----
+void sim_set_vbus(bool present) { s_vbus = present; }
+void sim_set_batt_mv(uint16_t mv) { s_batt_mv = mv; }
+
+bool XPowersPMU::begin(TwoWire&, uint8_t, int, int) { return true; }
+void XPowersPMU::setALDO1Voltage(int) {}
+void XPowersPMU::enableALDO1() {}
+void XPowersPMU::setALDO2Voltage(int) {}
+void XPowersPMU::enableALDO2() {}
+void XPowersPMU::setALDO3Voltage(int) {}
+void XPowersPMU::enableALDO3() {}
+void XPowersPMU::setALDO4Voltage(int) {}
+void XPowersPMU::enableALDO4() {}
+void XPowersPMU::setBLDO1Voltage(int) {}
+void XPowersPMU::enableBLDO1() {}
+void XPowersPMU::disableTSPinMeasure() {}
+void XPowersPMU::setChargingLedMode(int) {}
+void XPowersPMU::enableVbusVoltageMeasure() {}
+void XPowersPMU::enableSystemVoltageMeasure() {}
+void XPowersPMU::enableBattVoltageMeasure() {}
+void XPowersPMU::enableBattDetection() {}
+uint16_t XPowersPMU::getVbusVoltage() { return s_vbus ? 5020 : 0; }
+uint16_t XPowersPMU::getSystemVoltage() { return s_vbus ? 5000 : s_batt_mv.load(); }
+uint16_t XPowersPMU::getBattVoltage() { return s_batt_mv.load(); }
+bool XPowersPMU::isBatteryConnect() { return true; }
+int XPowersPMU::getBatteryPercent() {
+  int mv = s_batt_mv.load();
+  int pct = (mv - 3300) * 100 / (4200 - 3300);
+  return pct < 0 ? 0 : (pct > 100 ? 100 : pct);
+}
+bool XPowersPMU::isVbusIn() { return s_vbus.load(); }
@@ -0,0 +1,378 @@
+// esp32-camera simulato. Il sensore produce un frame ogni periodo (fps fissi)
+// e il driver li consegna come esp_camera_fb_get():
+//   CAMERA_GRAB_LATEST      -> ultimo frame completo non ancora consegnato
+//   CAMERA_GRAB_WHEN_EMPTY  -> il frame catturato appena il buffer si è
+//                              liberato (può essere vecchio di più periodi)
+// Buffer: fb_count x (w*h/5) byte nel pool di fb_location; un JPEG più grande
+// va in overflow e si scarta come FB-OVF. I frame vengono da una cartella di
+// JPEG (sim_camera_replay) o da una scena sintetica (gradiente + blob).
+#include "esp_camera.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+#include "sim.h"
+#include "sim_jpeg.h"
+
+#include <dirent.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+const resolution_info_t resolution[] = {
+  {   96,   96, ASPECT_RATIO_1X1   },  // 96x96
+  {  160,  120, ASPECT_RATIO_4X3   },  // QQVGA
+  {  176,  144, ASPECT_RATIO_5X4   },  // QCIF
+  {  240,  176, ASPECT_RATIO_4X3   },  // HQVGA
+  {  240,  240, ASPECT_RATIO_1X1   },  // 240x240
+  {  320,  240, ASPECT_RATIO_4X3   },  // QVGA
+  {  400,  296, ASPECT_RATIO_4X3   },  // CIF
+  {  480,  320, ASPECT_RATIO_3X2   },  // HVGA
+  {  640,  480, ASPECT_RATIO_4X3   },  // VGA
+  {  800,  600, ASPECT_RATIO_4X3   },  // SVGA
+  { 1024,  768, ASPECT_RATIO_4X3   },  // XGA
+  { 1280,  720, ASPECT_RATIO_16X9  },  // HD
+  { 1280, 1024, ASPECT_RATIO_5X4   },  // SXGA
+  { 1600, 1200, ASPECT_RATIO_4X3   },  // UXGA
+  { 1920, 1080, ASPECT_RATIO_16X9  },  // FHD
+  {  720, 1280, ASPECT_RATIO_9X16  },  // Portrait HD
+  {  864, 1536, ASPECT_RATIO_9X16  },  // Portrait 3MP
+  { 2048, 1536, ASPECT_RATIO_4X3   },  // QXGA
+  { 2560, 1440, ASPECT_RATIO_16X9  },  // QHD
+  { 2560, 1600, ASPECT_RATIO_16X10 },  // WQXGA
+  { 1080, 1920, ASPECT_RATIO_9X16  },  // Portrait FHD
+  { 2560, 1920, ASPECT_RATIO_4X3   },  // QSXGA
+};
+
+namespace {
+
+const int SYNTH_PHASES = 24;
+const size_t JPEG_CACHE_MAX = 96;
+
+struct Mode {
+  uint16_t w = 320, h = 240;
+  int      q = 12;
+};
+
+struct Slot {
+  uint8_t*    buf = nullptr;
+  camera_fb_t fb = {};
+  bool        out = false;
+};
+
+std::mutex              s_m;
+std::condition_variable s_cv;
+bool                    s_inited = false;
+camera_config_t         s_cfg = {};
+size_t                  s_fb_bytes = 0;
+std::vector<Slot>       s_slots;
+sensor_t                s_sensor = {};
+
+int      s_fps = 25;
+int64_t  s_t0_us = 0;
+int64_t  s_last_index = -1;
+int64_t  s_last_return_us = 0;
+
+// modalità corrente e precedente: i frame esposti prima del cambio restano vecchi
+Mode     s_mode, s_prev_mode;
+int64_t  s_mode_change_us = 0;
+
+std::vector<std::string> s_replay;
+std::map<std::tuple<int, int, int, int>, std::vector<uint8_t>> s_cache;   // (src, w, h, q)
+std::vector<std::vector<uint8_t>> s_replay_rgb;
+std::vector<std::pair<int, int>>  s_replay_dims;
+
+sim_camera_stats_t s_stats = {};
+
+int64_t period_us() { return 1000000LL / (s_fps > 0 ? s_fps : 1); }
+
+void synth_rgb(int w, int h, int phase, std::vector<uint8_t>& rgb) {
+  rgb.resize((size_t)w * h * 3);
+  // blob che attraversa la scena: cambio di scena a ogni frame
+  int bx = w / 8 + (w * 3 / 4) * phase / SYNTH_PHASES;
+  int by = h / 2 + (h / 6) * ((phase % 6) - 3) / 3;
+  int r2 = (w / 10) * (w / 10);
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      uint8_t* p = &rgb[((size_t)y * w + x) * 3];
+      p[0] = (uint8_t)(90 + 60 * y / h);
+      p[1] = (uint8_t)(120 + 80 * x / w);
+      p[2] = (uint8_t)(200 - 90 * y / h);
+      int dx = x - bx, dy = y - by;
+      if (dx * dx + dy * dy < r2) { p[0] = 200; p[1] = 90; p[2] = 40; }
+    }
+  }
+}
+
+// nearest neighbour: la camera vera scala con il suo ISP
+void resize_rgb(const std::vector<uint8_t>& src, int sw, int sh, int w, int h, std::vector<uint8_t>& out) {
+  out.resize((size_t)w * h * 3);
+  for (int y = 0; y < h; y++) {
+    int sy = y * sh / h;
+    for (int x = 0; x < w; x++) {
+      int sx = x * sw / w;
+      memcpy(&out[((size_t)y * w + x) * 3], &src[((size_t)sy * sw + sx) * 3], 3);
+    }
+  }
+}
+
+// JPEG del frame k nella modalità m (con s_m preso)
+const std::vector<uint8_t>& frame_jpeg(int64_t k, const Mode& m) {
+  int src = s_replay.empty() ? (int)(k % SYNTH_PHASES) : (int)(k % (int64_t)s_replay.size());
+  auto key = std::make_tuple(src, (int)m.w, (int)m.h, m.q);
+  auto it = s_cache.find(key);
+  if (it != s_cache.end()) return it->second;
+  if (s_cache.size() >= JPEG_CACHE_MAX) s_cache.clear();
+
+  std::vector<uint8_t> rgb;
+  if (s_replay.empty()) {
+    synth_rgb(m.w, m.h, src, rgb);
+  } else {
+    auto d = s_replay_dims[(size_t)src];
+    resize_rgb(s_replay_rgb[(size_t)src], d.first, d.second, m.w, m.h, rgb);
+  }
+  std::vector<uint8_t>& out = s_cache[key];
+  sim_jpeg_encode(rgb.data(), m.w, m.h, sim_jpeg_quality_from_sensor(m.q), out);
+  return out;
+}
+
+// ---- sensore ----
+int set_framesize(sensor_t* s, framesize_t fs) {
+  if (fs < 0 || fs >= FRAMESIZE_INVALID) return -1;
+  std::lock_guard<std::mutex> lk(s_m);
+  s->status.framesize = fs;
+  s_prev_mode = s_mode;
+  s_mode.w = resolution[fs].width;
+  s_mode.h = resolution[fs].height;
+  s_mode_change_us = esp_timer_get_time();
+  return 0;
+}
+
+int set_quality(sensor_t* s, int q) {
+  std::lock_guard<std::mutex> lk(s_m);
+  s->status.quality = (uint8_t)q;
+  s_prev_mode = s_mode;
+  s_mode.q = q;
+  s_mode_change_us = esp_timer_get_time();
+  return 0;
+}
+
+int set_res_raw(sensor_t*, int, int, int, int, int, int, int, int, int out_x, int out_y, bool, bool) {
+  std::lock_guard<std::mutex> lk(s_m);
+  s_prev_mode = s_mode;
+  s_mode.w = (uint16_t)out_x;
+  s_mode.h = (uint16_t)out_y;
+  s_mode_change_us = esp_timer_get_time();
+  return 0;
+}
+
+int set_ctrl(sensor_t*, int) { return 0; }
+
+void sensor_init() {
+  s_sensor.id.PID = OV5640_PID;
+  s_sensor.set_framesize = set_framesize;
+  s_sensor.set_quality = set_quality;
+  s_sensor.set_res_raw = set_res_raw;
+  s_sensor.set_hmirror = set_ctrl;
+  s_sensor.set_vflip = set_ctrl;
+  s_sensor.set_brightness = set_ctrl;
+  s_sensor.set_contrast = set_ctrl;
+  s_sensor.set_saturation = set_ctrl;
+  s_sensor.set_sharpness = set_ctrl;
+  s_sensor.set_gain_ctrl = set_ctrl;
+  s_sensor.set_exposure_ctrl = set_ctrl;
+  s_sensor.set_whitebal = set_ctrl;
+  s_sensor.set_awb_gain = set_ctrl;
+  s_sensor.set_agc_gain = set_ctrl;
+  s_sensor.set_aec_value = set_ctrl;
+}
+
+void free_slots() {
+  for (Slot& sl : s_slots) heap_caps_free(sl.buf);
+  s_slots.clear();
+}
+
+}  // namespace
+
+esp_err_t esp_camera_init(const camera_config_t* cfg) {
+  if (!cfg || cfg->frame_size < 0 || cfg->frame_size >= FRAMESIZE_INVALID || cfg->fb_count < 1) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lk(s_m);
+  if (s_inited) return ESP_ERR_INVALID_STATE;
+  s_cfg = *cfg;
+  s_fb_bytes = (size_t)resolution[cfg->frame_size].width * resolution[cfg->frame_size].height / 5;
+  uint32_t caps = cfg->fb_location == CAMERA_FB_IN_PSRAM ? (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+                                                         : (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  s_slots.assign(cfg->fb_count, Slot());
+  for (Slot& sl : s_slots) {
+    sl.buf = (uint8_t*)heap_caps_malloc(s_fb_bytes, caps);
+    if (!sl.buf) {
+      free_slots();
+      return ESP_ERR_NO_MEM;
+    }
+  }
+  sensor_init();
+  s_sensor.status.framesize = cfg->frame_size;
+  s_sensor.status.quality = (uint8_t)cfg->jpeg_quality;
+  s_mode.w = resolution[cfg->frame_size].width;
+  s_mode.h = resolution[cfg->frame_size].height;
+  s_mode.q = cfg->jpeg_quality;
+  s_prev_mode = s_mode;
+  s_t0_us = esp_timer_get_time();
+  s_last_index = -1;
+  s_last_return_us = s_t0_us;
+  s_inited = true;
+  s_stats.inits++;
+  return ESP_OK;
+}
+
+esp_err_t esp_camera_deinit() {
+  std::lock_guard<std::mutex> lk(s_m);
+  if (!s_inited) return ESP_ERR_INVALID_STATE;
+  free_slots();
+  s_inited = false;
+  s_cv.notify_all();
+  return ESP_OK;
+}
+
+sensor_t* esp_camera_sensor_get() {
+  std::lock_guard<std::mutex> lk(s_m);
+  return s_inited ? &s_sensor : nullptr;
+}
+
+camera_fb_t* esp_camera_fb_get() {
+  std::unique_lock<std::mutex> lk(s_m);
+  const int64_t deadline = esp_timer_get_time() + 4000000;   // come FB_GET_TIMEOUT del driver
+  Slot* slot = nullptr;
+  while (s_inited && !slot) {
+    for (Slot& sl : s_slots) if (!sl.out) { slot = &sl; break; }
+    if (slot) break;
+    if (s_cv.wait_for(lk, std::chrono::milliseconds(100)) == std::cv_status::timeout &&
+        esp_timer_get_time() > deadline) {
+      return nullptr;
+    }
+  }
+  if (!slot) return nullptr;
+
+  for (;;) {
+    const int64_t per = period_us();
+    int64_t now = esp_timer_get_time();
+    int64_t latest = (now - s_t0_us) / per;
+    int64_t k;
+    if (s_cfg.grab_mode == CAMERA_GRAB_LATEST) {
+      k = latest > s_last_index ? latest : s_last_index + 1;
+    } else {
+      k = (s_last_return_us - s_t0_us + per - 1) / per;
+      if (k <= s_last_index) k = s_last_index + 1;
+    }
+    int64_t ready_us = s_t0_us + k * per;
+    if (ready_us > now) {
+      lk.unlock();
+      std::this_thread::sleep_for(std::chrono::microseconds(ready_us - now));
+      lk.lock();
+      if (!s_inited) return nullptr;
+    }
+    s_last_index = k;
+    if (esp_timer_get_time() > deadline) return nullptr;
+
+    // esposizione iniziata prima del cambio di modalità: frame nella modalità precedente
+    const Mode& m = ready_us - per < s_mode_change_us ? s_prev_mode : s_mode;
+    const std::vector<uint8_t>& jpg = frame_jpeg(k, m);
+    if (jpg.size() > s_fb_bytes) {
+      s_stats.overflow++;
+      continue;
+    }
+    if (latest - k >= 1) s_stats.stale++;
+    memcpy(slot->buf, jpg.data(), jpg.size());
+    slot->out = true;
+    camera_fb_t& fb = slot->fb;
+    fb.buf = slot->buf;
+    fb.len = jpg.size();
+    fb.width = m.w;
+    fb.height = m.h;
+    fb.format = PIXFORMAT_JPEG;
+    // come cam_hal: timestamp preso al VSYNC, cioè all'inizio del frame
+    int64_t vsync_us = ready_us - per;
+    fb.timestamp.tv_sec = (time_t)(vsync_us / 1000000);
+    fb.timestamp.tv_usec = (suseconds_t)(vsync_us % 1000000);
+    s_stats.frames++;
+    return &fb;
+  }
+}
+
+void esp_camera_fb_return(camera_fb_t* fb) {
+  std::lock_guard<std::mutex> lk(s_m);
+  for (Slot& sl : s_slots) {
+    if (&sl.fb == fb) {
+      sl.out = false;
+      s_last_return_us = esp_timer_get_time();
+    }
+  }
+  s_cv.notify_all();
+}
+
+// ---- controllo dagli scenari ----
+bool sim_camera_replay(const char* dir, int fps) {
+  std::vector<std::string> files;
+  DIR* d = dir ? opendir(dir) : nullptr;
+  if (!d) return false;
+  while (dirent* e = readdir(d)) {
+    std::string n = e->d_name;
+    std::string lo = n;
+    std::transform(lo.begin(), lo.end(), lo.begin(), ::tolower);
+    if (lo.size() > 4 && (lo.rfind(".jpg") == lo.size() - 4 || lo.rfind(".jpeg") == lo.size() - 5)) {
+      files.push_back(std::string(dir) + "/" + n);
+    }
+  }
+  closedir(d);
+  std::sort(files.begin(), files.end());
+
+  std::vector<std::string> ok;
+  std::vector<std::vector<uint8_t>> rgbs;
+  std::vector<std::pair<int, int>> dims;
+  for (const std::string& f : files) {
+    FILE* fp = fopen(f.c_str(), "rb");
+    if (!fp) continue;
+    std::vector<uint8_t> data;
+    uint8_t buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) data.insert(data.end(), buf, buf + n);
+    fclose(fp);
+    std::vector<uint8_t> rgb;
+    int w = 0, h = 0;
+    if (!sim_jpeg_decode(data.data(), data.size(), 0, rgb, &w, &h)) {
+      fprintf(stderr, "sim: %s non è un JPEG baseline, saltato\n", f.c_str());
+      continue;
+    }
+    ok.push_back(f);
+    rgbs.push_back(std::move(rgb));
+    dims.emplace_back(w, h);
+  }
+  if (ok.empty()) return false;
+
+  std::lock_guard<std::mutex> lk(s_m);
+  s_replay = ok;
+  s_replay_rgb = std::move(rgbs);
+  s_replay_dims = dims;
+  s_cache.clear();
+  if (fps > 0) s_fps = fps;
+  return true;
+}
+
+void sim_camera_set_fps(int fps) {
+  std::lock_guard<std::mutex> lk(s_m);
+  if (fps > 0) s_fps = fps;
+}
+
+void sim_camera_get_stats(sim_camera_stats_t* out) {
+  if (!out) return;
+  std::lock_guard<std::mutex> lk(s_m);
+  *out = s_stats;
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include "esp_err.h"
+typedef int gpio_num_t;
+typedef enum { GPIO_INTR_DISABLE, GPIO_INTR_POSEDGE, GPIO_INTR_NEGEDGE, GPIO_INTR_ANYEDGE, GPIO_INTR_LOW_LEVEL, GPIO_INTR_HIGH_LEVEL } gpio_int_type_t;
+esp_err_t gpio_set_intr_type(gpio_num_t, gpio_int_type_t);
+// come in IDF: imposta anche il tipo di interrupt del pin al livello di wake
+esp_err_t gpio_wakeup_enable(gpio_num_t, gpio_int_type_t);
+// come in IDF: toglie solo il wake, il tipo di interrupt resta a livello
+esp_err_t gpio_wakeup_disable(gpio_num_t);
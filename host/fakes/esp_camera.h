@@ -0,0 +1,61 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/time.h>
+#include "esp_err.h"
+typedef enum { PIXFORMAT_RGB565, PIXFORMAT_YUV422, PIXFORMAT_GRAYSCALE, PIXFORMAT_JPEG, PIXFORMAT_RGB888 } pixformat_t;
+typedef enum { FRAMESIZE_96X96, FRAMESIZE_QQVGA, FRAMESIZE_QCIF, FRAMESIZE_HQVGA, FRAMESIZE_240X240, FRAMESIZE_QVGA, FRAMESIZE_CIF, FRAMESIZE_HVGA, FRAMESIZE_VGA, FRAMESIZE_SVGA, FRAMESIZE_XGA, FRAMESIZE_HD, FRAMESIZE_SXGA, FRAMESIZE_UXGA, FRAMESIZE_FHD, FRAMESIZE_P_HD, FRAMESIZE_P_3MP, FRAMESIZE_QXGA, FRAMESIZE_QHD, FRAMESIZE_WQXGA, FRAMESIZE_P_FHD, FRAMESIZE_QSXGA, FRAMESIZE_INVALID } framesize_t;
+typedef enum { ASPECT_RATIO_4X3, ASPECT_RATIO_3X2, ASPECT_RATIO_16X10, ASPECT_RATIO_5X3, ASPECT_RATIO_16X9, ASPECT_RATIO_21X9, ASPECT_RATIO_5X4, ASPECT_RATIO_1X1, ASPECT_RATIO_9X16 } aspect_ratio_t;
+typedef struct { const uint16_t width; const uint16_t height; const aspect_ratio_t aspect_ratio; } resolution_info_t;
+extern const resolution_info_t resolution[];
+typedef enum { CAMERA_GRAB_WHEN_EMPTY, CAMERA_GRAB_LATEST } camera_grab_mode_t;
+typedef enum { CAMERA_FB_IN_PSRAM, CAMERA_FB_IN_DRAM } camera_fb_location_t;
+typedef enum { LEDC_CHANNEL_0 } ledc_channel_t;
+typedef enum { LEDC_TIMER_0 } ledc_timer_t;
+typedef struct {
+  int pin_pwdn, pin_reset, pin_xclk;
+  union { int pin_sccb_sda; int pin_sscb_sda; };
+  union { int pin_sccb_scl; int pin_sscb_scl; };
+  int pin_d7, pin_d6, pin_d5, pin_d4, pin_d3, pin_d2, pin_d1, pin_d0;
+  int pin_vsync, pin_href, pin_pclk;
+  int xclk_freq_hz;
+  ledc_timer_t ledc_timer;
+  ledc_channel_t ledc_channel;
+  pixformat_t pixel_format;
+  framesize_t frame_size;
+  int jpeg_quality;
+  size_t fb_count;
+  camera_fb_location_t fb_location;
+  camera_grab_mode_t grab_mode;
+} camera_config_t;
+typedef struct {
+  uint8_t* buf; size_t len; size_t width; size_t height; pixformat_t format; struct timeval timestamp;
+} camera_fb_t;
+typedef struct { framesize_t framesize; bool scale; bool binning; uint8_t quality; int8_t brightness; } camera_status_t;
+typedef struct { uint16_t PID; } sensor_id_t;
+#define OV5640_PID 0x5640
+typedef struct _sensor sensor_t;
+struct _sensor {
+  sensor_id_t id;
+  camera_status_t status;
+  int (*set_framesize)(sensor_t*, framesize_t);
+  int (*set_quality)(sensor_t*, int);
+  int (*set_hmirror)(sensor_t*, int);
+  int (*set_vflip)(sensor_t*, int);
+  int (*set_brightness)(sensor_t*, int);
+  int (*set_contrast)(sensor_t*, int);
+  int (*set_saturation)(sensor_t*, int);
+  int (*set_sharpness)(sensor_t*, int);
+  int (*set_gain_ctrl)(sensor_t*, int);
+  int (*set_exposure_ctrl)(sensor_t*, int);
+  int (*set_whitebal)(sensor_t*, int);
+  int (*set_awb_gain)(sensor_t*, int);
+  int (*set_agc_gain)(sensor_t*, int);
+  int (*set_aec_value)(sensor_t*, int);
+  int (*set_res_raw)(sensor_t*, int startX, int startY, int endX, int endY, int offsetX, int offsetY, int totalX, int totalY, int outputX, int outputY, bool scale, bool binning);
+};
+esp_err_t esp_camera_init(const camera_config_t*);
+esp_err_t esp_camera_deinit();
+camera_fb_t* esp_camera_fb_get();
+void esp_camera_fb_return(camera_fb_t*);
+sensor_t* esp_camera_sensor_get();
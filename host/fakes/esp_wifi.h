@@ -0,0 +1,11 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+typedef enum { WIFI_PS_NONE, WIFI_PS_MIN_MODEM, WIFI_PS_MAX_MODEM } wifi_ps_type_t;
+typedef enum { WIFI_IF_STA, WIFI_IF_AP } wifi_interface_t;
+typedef struct { uint8_t ssid[32]; uint8_t password[64]; uint8_t bssid[6]; bool bssid_set; uint8_t channel; uint16_t listen_interval; } wifi_sta_config_t;
+typedef union { wifi_sta_config_t sta; } wifi_config_t;
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t);
+esp_err_t esp_wifi_get_ps(wifi_ps_type_t*);
+esp_err_t esp_wifi_get_config(wifi_interface_t, wifi_config_t*);
+esp_err_t esp_wifi_set_config(wifi_interface_t, wifi_config_t*);
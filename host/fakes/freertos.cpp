@@ -0,0 +1,229 @@
+// FreeRTOS su pthread: task = thread staccato, notifiche e semafori con
+// mutex + condition variable, sezioni critiche su un solo mutex ricorsivo
+// (sul device portMUX è uno spinlock con gli interrupt spenti).
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using clk = std::chrono::steady_clock;
+
+struct Task {
+  std::string             name;
+  TaskFunction_t          fn = nullptr;
+  void*                   arg = nullptr;
+  std::mutex              m;
+  std::condition_variable cv;
+  uint32_t                notify = 0;
+};
+
+thread_local Task* t_self = nullptr;
+
+std::recursive_mutex& crit() {
+  static std::recursive_mutex m;
+  return m;
+}
+
+// false se scaduto; portMAX_DELAY = attesa infinita
+template <class Pred>
+bool wait_for(std::unique_lock<std::mutex>& lk, std::condition_variable& cv, TickType_t ticks, Pred pred) {
+  if (ticks == portMAX_DELAY) { cv.wait(lk, pred); return true; }
+  return cv.wait_for(lk, std::chrono::milliseconds(ticks), pred);
+}
+
+struct Sem {
+  std::mutex              m;
+  std::condition_variable cv;
+  UBaseType_t             count;
+  UBaseType_t             max;
+  std::deque<uint64_t>    waiters;   // biglietti in ordine di arrivo
+  uint64_t                next_ticket = 0;
+};
+
+struct Queue {
+  std::mutex                        m;
+  std::condition_variable           cv;
+  std::deque<std::vector<uint8_t>>  items;
+  UBaseType_t                       len;
+  UBaseType_t                       item_size;
+};
+
+void* task_main(void* p) {
+  Task* t = (Task*)p;
+  t_self = t;
+  pthread_setname_np(pthread_self(), t->name.substr(0, 15).c_str());
+  t->fn(t->arg);
+  return nullptr;
+}
+
+}  // namespace
+
+// ---- critical sections ----
+void portENTER_CRITICAL(portMUX_TYPE*) { crit().lock(); }
+void portEXIT_CRITICAL(portMUX_TYPE*) { crit().unlock(); }
+void portENTER_CRITICAL_ISR(portMUX_TYPE*) { crit().lock(); }
+void portEXIT_CRITICAL_ISR(portMUX_TYPE*) { crit().unlock(); }
+
+// ---- task ----
+void vTaskDelay(TickType_t ticks) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks ? ticks : 1));
+}
+
+TickType_t xTaskGetTickCount() {
+  static const clk::time_point t0 = clk::now();
+  return (TickType_t)std::chrono::duration_cast<std::chrono::milliseconds>(clk::now() - t0).count();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  // thread non creati da xTaskCreate (main, httpd, client di test): handle pigro
+  if (!t_self) {
+    t_self = new Task();
+    t_self->name = "ext";
+  }
+  return t_self;
+}
+
+void vTaskDelete(TaskHandle_t h) {
+  if (h == nullptr || h == t_self) pthread_exit(nullptr);
+  // cancellare un altro task non serve al firmware
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t, void* arg,
+                                   UBaseType_t, TaskHandle_t* out, BaseType_t) {
+  Task* t = new Task();
+  t->name = name ? name : "";
+  t->fn = fn;
+  t->arg = arg;
+  if (out) *out = t;
+  // pthread diretto: vTaskDelete(NULL) esce con pthread_exit()
+  pthread_t th;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  int rc = pthread_create(&th, &attr, task_main, t);
+  pthread_attr_destroy(&attr);
+  return rc == 0 ? pdPASS : pdFALSE;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stack, void* arg,
+                       UBaseType_t prio, TaskHandle_t* out) {
+  return xTaskCreatePinnedToCore(fn, name, stack, arg, prio, out, tskNO_AFFINITY);
+}
+
+void xTaskNotifyGive(TaskHandle_t h) {
+  Task* t = (Task*)h;
+  if (!t) return;
+  {
+    std::lock_guard<std::mutex> lk(t->m);
+    t->notify++;
+  }
+  t->cv.notify_all();
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t h, BaseType_t* woken) {
+  xTaskNotifyGive(h);
+  if (woken) *woken = pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+  Task* t = (Task*)xTaskGetCurrentTaskHandle();
+  std::unique_lock<std::mutex> lk(t->m);
+  if (!wait_for(lk, t->cv, ticks, [t] { return t->notify > 0; })) return 0;
+  uint32_t v = t->notify;
+  t->notify = clear ? 0 : v - 1;
+  return v;
+}
+
+// ---- semafori (mutex = conteggio 1, senza ereditarietà di priorità) ----
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial) {
+  Sem* s = new Sem();
+  s->max = max;
+  s->count = initial;
+  return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() { return xSemaphoreCreateCounting(1, 1); }
+SemaphoreHandle_t xSemaphoreCreateBinary() { return xSemaphoreCreateCounting(1, 0); }
+
+// Attese in ordine di arrivo, come la lista eventi di FreeRTOS a pari
+// priorità: con std::mutex un task sfortunato può perdere ogni giro.
+BaseType_t xSemaphoreTake(SemaphoreHandle_t h, TickType_t ticks) {
+  Sem* s = (Sem*)h;
+  std::unique_lock<std::mutex> lk(s->m);
+  if (s->count > 0 && s->waiters.empty()) {
+    s->count--;
+    return pdTRUE;
+  }
+  if (ticks == 0) return pdFALSE;
+  uint64_t me = s->next_ticket++;
+  s->waiters.push_back(me);
+  bool ok = wait_for(lk, s->cv, ticks, [s, me] { return s->count > 0 && s->waiters.front() == me; });
+  s->waiters.erase(std::find(s->waiters.begin(), s->waiters.end(), me));
+  if (ok) s->count--;
+  else s->cv.notify_all();   // il primo della fila può essere cambiato
+  return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t h) {
+  Sem* s = (Sem*)h;
+  {
+    std::lock_guard<std::mutex> lk(s->m);
+    if (s->count >= s->max) return pdFALSE;
+    s->count++;
+  }
+  s->cv.notify_all();
+  return pdTRUE;
+}
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t h) {
+  Sem* s = (Sem*)h;
+  std::lock_guard<std::mutex> lk(s->m);
+  return s->count;
+}
+
+// ---- code ----
+QueueHandle_t xQueueCreate(UBaseType_t len, UBaseType_t item_size) {
+  Queue* q = new Queue();
+  q->len = len;
+  q->item_size = item_size;
+  return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t h, const void* item, TickType_t ticks) {
+  Queue* q = (Queue*)h;
+  std::unique_lock<std::mutex> lk(q->m);
+  if (!wait_for(lk, q->cv, ticks, [q] { return q->items.size() < q->len; })) return pdFALSE;
+  const uint8_t* p = (const uint8_t*)item;
+  q->items.emplace_back(p, p + q->item_size);
+  q->cv.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t h, void* out, TickType_t ticks) {
+  Queue* q = (Queue*)h;
+  std::unique_lock<std::mutex> lk(q->m);
+  if (!wait_for(lk, q->cv, ticks, [q] { return !q->items.empty(); })) return pdFALSE;
+  memcpy(out, q->items.front().data(), q->item_size);
+  q->items.pop_front();
+  q->cv.notify_all();
+  return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t h) {
+  Queue* q = (Queue*)h;
+  std::lock_guard<std::mutex> lk(q->m);
+  return (UBaseType_t)q->items.size();
+}
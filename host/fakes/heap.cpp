@@ -0,0 +1,157 @@
+// heap_caps con i budget dell'ESP32-S3 (PSRAM 8 MB, interna 320 KB):
+// oltre il budget l'allocazione fallisce come sul device. Anche malloc/
+// calloc/realloc/free del firmware passano di qui (-Wl,--wrap=...), con la
+// regola di CONFIG_SPIRAM_USE_MALLOC: piccoli in interna, grandi in PSRAM.
+#include "esp_heap_caps.h"
+#include "Arduino.h"
+
+#include "sim.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mutex>
+#include <unordered_map>
+
+extern "C" void* __real_malloc(size_t n);
+extern "C" void* __real_realloc(void* p, size_t n);
+extern "C" void __real_free(void* p);
+
+namespace {
+
+const size_t POOL_TOTAL[2] = {320 * 1024, 8 * 1024 * 1024};
+const size_t ALWAYS_INTERNAL = 16384;
+
+struct Alloc {
+  size_t size;
+  int    pool;
+};
+
+std::mutex& heap_m() {
+  static std::mutex m;
+  return m;
+}
+std::unordered_map<void*, Alloc>& live() {
+  static std::unordered_map<void*, Alloc> m;
+  return m;
+}
+size_t s_used[2] = {0, 0};
+size_t s_peak[2] = {0, 0};
+
+int pool_for(uint32_t caps, size_t n) {
+  if (caps & MALLOC_CAP_SPIRAM) return SIM_POOL_PSRAM;
+  if (caps & MALLOC_CAP_INTERNAL) return SIM_POOL_INTERNAL;
+  // solo MALLOC_CAP_8BIT (= malloc con CONFIG_SPIRAM_USE_MALLOC): fino a
+  // SPIRAM_MALLOC_ALWAYSINTERNAL interna se c'è posto, oltre in PSRAM
+  if (n > ALWAYS_INTERNAL) return SIM_POOL_PSRAM;
+  std::lock_guard<std::mutex> lk(heap_m());
+  return s_used[SIM_POOL_INTERNAL] + n <= POOL_TOTAL[SIM_POOL_INTERNAL] ? SIM_POOL_INTERNAL : SIM_POOL_PSRAM;
+}
+
+bool untrack(void* p) {
+  if (!p) return false;
+  std::lock_guard<std::mutex> lk(heap_m());
+  auto it = live().find(p);
+  if (it == live().end()) return false;
+  s_used[it->second.pool] -= it->second.size;
+  live().erase(it);
+  return true;
+}
+
+}  // namespace
+
+extern "C" void __wrap_free(void* p) {
+  untrack(p);
+  __real_free(p);
+}
+
+extern "C" void* __wrap_malloc(size_t n) { return heap_caps_malloc(n, MALLOC_CAP_8BIT); }
+
+extern "C" void* __wrap_calloc(size_t n, size_t size) { return heap_caps_calloc(n, size, MALLOC_CAP_8BIT); }
+
+extern "C" void* __wrap_realloc(void* p, size_t n) {
+  if (!p) return __wrap_malloc(n);
+  if (!n) {
+    __wrap_free(p);
+    return nullptr;
+  }
+  size_t old;
+  {
+    std::lock_guard<std::mutex> lk(heap_m());
+    auto it = live().find(p);
+    // allocato dentro libc (strdup, ...): fuori dai conti
+    if (it == live().end()) return __real_realloc(p, n);
+    old = it->second.size;
+  }
+  void* q = __wrap_malloc(n);
+  if (!q) return nullptr;
+  memcpy(q, p, old < n ? old : n);
+  __wrap_free(p);
+  return q;
+}
+
+void* heap_caps_malloc(size_t n, uint32_t caps) {
+  if (!n) return nullptr;
+  int pool = pool_for(caps, n);
+  {
+    std::lock_guard<std::mutex> lk(heap_m());
+    if (s_used[pool] + n > POOL_TOTAL[pool]) return nullptr;
+    s_used[pool] += n;
+    if (s_used[pool] > s_peak[pool]) s_peak[pool] = s_used[pool];
+  }
+  void* p = __real_malloc(n);
+  std::lock_guard<std::mutex> lk(heap_m());
+  if (!p) {
+    s_used[pool] -= n;
+    return nullptr;
+  }
+  live()[p] = Alloc{n, pool};
+  return p;
+}
+
+void* heap_caps_calloc(size_t n, size_t size, uint32_t caps) {
+  if (size && n > SIZE_MAX / size) return nullptr;
+  void* p = heap_caps_malloc(n * size, caps);
+  if (p) memset(p, 0, n * size);
+  return p;
+}
+
+void heap_caps_free(void* p) { __wrap_free(p); }
+
+size_t heap_caps_get_total_size(uint32_t caps) {
+  return POOL_TOTAL[caps & MALLOC_CAP_SPIRAM ? SIM_POOL_PSRAM : SIM_POOL_INTERNAL];
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+  int pool = caps & MALLOC_CAP_SPIRAM ? SIM_POOL_PSRAM : SIM_POOL_INTERNAL;
+  std::lock_guard<std::mutex> lk(heap_m());
+  return POOL_TOTAL[pool] - s_used[pool];
+}
+
+// niente frammentazione nel modello
+size_t heap_caps_get_largest_free_block(uint32_t caps) { return heap_caps_get_free_size(caps); }
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+  int pool = caps & MALLOC_CAP_SPIRAM ? SIM_POOL_PSRAM : SIM_POOL_INTERNAL;
+  std::lock_guard<std::mutex> lk(heap_m());
+  return POOL_TOTAL[pool] - s_peak[pool];
+}
+
+uint32_t EspClass::getFreePsram() { return (uint32_t)heap_caps_get_free_size(MALLOC_CAP_SPIRAM); }
+uint32_t EspClass::getPsramSize() { return (uint32_t)POOL_TOTAL[SIM_POOL_PSRAM]; }
+
+size_t sim_heap_used(int pool) {
+  std::lock_guard<std::mutex> lk(heap_m());
+  return s_used[pool & 1];
+}
+
+size_t sim_heap_peak(int pool) {
+  std::lock_guard<std::mutex> lk(heap_m());
+  return s_peak[pool & 1];
+}
+
+void sim_heap_reset_peak() {
+  std::lock_guard<std::mutex> lk(heap_m());
+  s_peak[0] = s_used[0];
+  s_peak[1] = s_used[1];
+}
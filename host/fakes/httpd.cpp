@@ -0,0 +1,581 @@
+// esp_http_server su socket POSIX, con la stessa forma dell'originale:
+// un solo task server che fa select() sul listener e sulle sessioni ferme,
+// gli handler girano su quel task (uno alla volta), le richieste passate a
+// httpd_req_async_handler_begin() tengono la sessione occupata finché
+// httpd_req_async_handler_complete(). A pieno (max_open_sockets) con
+// lru_purge_enable si chiude la sessione ferma usata meno di recente, mai una
+// occupata da un handler async. Timeout di ricezione/invio dalla config.
+#include "esp_http_server.h"
+#include "lwip/sockets.h"
+
+#include "sim.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const size_t MAX_HDR_LEN = 4096;
+const size_t MAX_URI_LEN = 512;
+// CONFIG_LWIP_TCP_SND_BUF_DEFAULT dell'Arduino core: senza questo Linux
+// allarga il buffer di invio fino a MB e select() "writable" non frena mai
+const int LWIP_TCP_SND_BUF = 5760;
+
+struct Server;
+
+struct Sess {
+  int         fd = -1;
+  std::string rx;            // byte già letti e non consumati (pipelining)
+  bool        busy = false;  // richiesta async in corso
+  uint64_t    lru = 0;
+};
+
+struct Aux {
+  Server*     srv = nullptr;
+  Sess*       sess = nullptr;
+  std::string path;
+  std::string query;
+  bool        has_query = false;
+  size_t      body_left = 0;
+  bool        conn_close = false;
+
+  std::string status = "200 OK";
+  std::string type = "text/html";
+  std::vector<std::pair<std::string, std::string>> hdrs;
+  bool        hdr_sent = false;
+  bool        chunked = false;
+  bool        done = false;
+  bool        failed = false;
+  bool        async = false;   // la richiesta è passata a una copia async
+};
+
+struct Server {
+  httpd_config_t          cfg;
+  int                     lfd = -1;
+  int                     wake[2] = {-1, -1};
+  std::mutex              m;
+  std::vector<httpd_uri_t> uris;
+  std::vector<std::unique_ptr<Sess>> sess;
+  uint64_t                lru_clock = 0;
+};
+
+std::atomic<uint16_t> s_req_port{0};
+std::atomic<uint16_t> s_bound_port{0};
+
+Aux* aux_of(httpd_req_t* r) { return r ? (Aux*)r->aux : nullptr; }
+
+bool send_all(int fd, const char* p, size_t len) {
+  while (len) {
+    ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;   // EAGAIN = send_wait_timeout scaduto
+    p += n;
+    len -= (size_t)n;
+  }
+  return true;
+}
+
+void set_timeouts(int fd, const httpd_config_t& cfg) {
+  struct timeval rt = {(time_t)cfg.recv_wait_timeout, 0};
+  struct timeval st = {(time_t)cfg.send_wait_timeout, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &rt, sizeof(rt));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &st, sizeof(st));
+}
+
+void wake_server(Server* s) {
+  char c = 1;
+  if (write(s->wake[1], &c, 1) < 0) {}
+}
+
+// con s->m preso
+void sess_close_locked(Server* s, Sess* ss) {
+  for (size_t i = 0; i < s->sess.size(); i++) {
+    if (s->sess[i].get() == ss) {
+      if (s->cfg.close_fn) s->cfg.close_fn(s, ss->fd);
+      else close(ss->fd);
+      s->sess.erase(s->sess.begin() + (long)i);
+      return;
+    }
+  }
+}
+
+void sess_close(Server* s, Sess* ss) {
+  std::lock_guard<std::mutex> lk(s->m);
+  sess_close_locked(s, ss);
+}
+
+bool send_headers(httpd_req_t* r, const char* len_hdr) {
+  Aux* a = aux_of(r);
+  std::string h = "HTTP/1.1 " + a->status + "\r\nContent-Type: " + a->type + "\r\n" + len_hdr;
+  for (auto& kv : a->hdrs) h += kv.first + ": " + kv.second + "\r\n";
+  h += "\r\n";
+  a->hdr_sent = true;
+  return send_all(a->sess->fd, h.data(), h.size());
+}
+
+const char* reason(int code) {
+  switch (code) {
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 408: return "Request Timeout";
+    case 414: return "URI Too Long";
+    case 431: return "Request Header Fields Too Large";
+    default:  return "Internal Server Error";
+  }
+}
+
+void send_status_close(int fd, int code) {
+  char buf[160];
+  int n = snprintf(buf, sizeof(buf), "HTTP/1.1 %d %s\r\nContent-Type: text/plain\r\nContent-Length: 0\r\nConnection: close\r\n\r\n",
+                   code, reason(code));
+  send_all(fd, buf, (size_t)n);
+}
+
+// scarta il corpo non letto dall'handler (come httpd_req_delete)
+bool drain_body(Aux* a) {
+  char buf[1024];
+  while (a->body_left) {
+    if (!a->sess->rx.empty()) {
+      size_t n = std::min(a->body_left, a->sess->rx.size());
+      a->sess->rx.erase(0, n);
+      a->body_left -= n;
+      continue;
+    }
+    ssize_t n = recv(a->sess->fd, buf, std::min(a->body_left, sizeof(buf)), 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    a->body_left -= (size_t)n;
+  }
+  return true;
+}
+
+// fine richiesta: la sessione torna in ascolto o viene chiusa
+void finish(Server* s, Aux* a, esp_err_t ret) {
+  bool keep = ret == ESP_OK && !a->failed && a->done && !a->conn_close && drain_body(a);
+  std::lock_guard<std::mutex> lk(s->m);
+  if (!keep) {
+    sess_close_locked(s, a->sess);
+  } else {
+    a->sess->busy = false;
+    a->sess->lru = ++s->lru_clock;
+  }
+}
+
+std::string header_value(const std::string& head, const char* name) {
+  size_t nl = strlen(name);
+  size_t pos = head.find("\r\n");
+  while (pos != std::string::npos && pos + 2 < head.size()) {
+    size_t start = pos + 2;
+    size_t end = head.find("\r\n", start);
+    if (end == std::string::npos) end = head.size();
+    if (end - start > nl && head[start + nl] == ':' && strncasecmp(head.c_str() + start, name, nl) == 0) {
+      size_t v = start + nl + 1;
+      while (v < end && head[v] == ' ') v++;
+      return head.substr(v, end - v);
+    }
+    pos = end;
+  }
+  return std::string();
+}
+
+// legge e serve una richiesta sulla sessione (task server)
+void serve_one(Server* s, Sess* ss) {
+  size_t hdr_end;
+  char buf[1024];
+  while ((hdr_end = ss->rx.find("\r\n\r\n")) == std::string::npos) {
+    if (ss->rx.size() > MAX_HDR_LEN) {
+      send_status_close(ss->fd, 431);
+      sess_close(s, ss);
+      return;
+    }
+    ssize_t n = recv(ss->fd, buf, sizeof(buf), 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && !ss->rx.empty()) {
+      send_status_close(ss->fd, 408);
+    }
+    if (n <= 0) {
+      sess_close(s, ss);
+      return;
+    }
+    ss->rx.append(buf, (size_t)n);
+  }
+  std::string head = ss->rx.substr(0, hdr_end + 2);
+  ss->rx.erase(0, hdr_end + 4);
+
+  size_t sp1 = head.find(' ');
+  size_t sp2 = sp1 == std::string::npos ? sp1 : head.find(' ', sp1 + 1);
+  if (sp2 == std::string::npos) {
+    send_status_close(ss->fd, 400);
+    sess_close(s, ss);
+    return;
+  }
+  std::string method = head.substr(0, sp1);
+  std::string uri = head.substr(sp1 + 1, sp2 - sp1 - 1);
+  if (uri.size() > MAX_URI_LEN) {
+    send_status_close(ss->fd, 414);
+    sess_close(s, ss);
+    return;
+  }
+
+  std::unique_ptr<Aux> a(new Aux());
+  a->srv = s;
+  a->sess = ss;
+  size_t q = uri.find('?');
+  a->path = uri.substr(0, q);
+  if (q != std::string::npos) {
+    a->has_query = true;
+    a->query = uri.substr(q + 1);
+  }
+  std::string cl = header_value(head, "Content-Length");
+  long content_len = cl.empty() ? 0 : strtol(cl.c_str(), nullptr, 10);
+  a->body_left = content_len > 0 ? (size_t)content_len : 0;
+  std::string conn = header_value(head, "Connection");
+  a->conn_close = strcasecmp(conn.c_str(), "close") == 0 || head.find("HTTP/1.0\r\n") != std::string::npos;
+
+  httpd_method_t m = method == "POST" ? HTTP_POST : HTTP_GET;
+  const httpd_uri_t* h = nullptr;
+  bool path_known = false;
+  {
+    std::lock_guard<std::mutex> lk(s->m);
+    for (const httpd_uri_t& u : s->uris) {
+      if (a->path != u.uri) continue;
+      path_known = true;
+      if (u.method == m) {
+        h = &u;
+        break;
+      }
+    }
+    ss->busy = true;   // fuori dal select mentre l'handler gira
+  }
+
+  httpd_req_t* req = (httpd_req_t*)calloc(1, sizeof(httpd_req_t));
+  req->handle = s;
+  req->method = m;
+  memcpy((char*)req->uri, uri.c_str(), uri.size() + 1);
+  req->content_len = (int)a->body_left;
+  req->aux = a.get();
+  req->user_ctx = h ? h->user_ctx : nullptr;
+
+  esp_err_t ret;
+  if (!h && path_known) {
+    httpd_resp_set_status(req, "405 Method Not Allowed");
+    httpd_resp_set_type(req, "text/plain");
+    ret = httpd_resp_sendstr(req, reason(405));
+  } else if (!h) {
+    ret = httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, nullptr);
+  } else {
+    ret = h->handler(req);
+  }
+  if (!a->async) finish(s, a.get(), ret);
+  free(req);
+}
+
+void server_thread(Server* s) {
+  for (;;) {
+    std::vector<pollfd> fds;
+    std::vector<Sess*>  who;
+    {
+      std::lock_guard<std::mutex> lk(s->m);
+      fds.push_back({s->wake[0], POLLIN, 0});
+      who.push_back(nullptr);
+      fds.push_back({s->lfd, POLLIN, 0});
+      who.push_back(nullptr);
+      for (auto& ss : s->sess) {
+        if (ss->busy) continue;
+        // richiesta già nel buffer (pipelining): servila subito
+        fds.push_back({ss->fd, POLLIN, 0});
+        who.push_back(ss.get());
+        if (ss->rx.find("\r\n\r\n") != std::string::npos) fds.back().revents = POLLIN;
+      }
+    }
+    bool ready_now = false;
+    for (auto& p : fds) ready_now |= p.revents != 0;
+    if (!ready_now && poll(fds.data(), fds.size(), -1) < 0) continue;
+
+    if (fds[0].revents) {
+      char tmp[64];
+      if (read(s->wake[0], tmp, sizeof(tmp)) < 0) {}
+    }
+    if (fds[1].revents & POLLIN) {
+      int fd = accept(s->lfd, nullptr, nullptr);
+      if (fd >= 0) {
+        std::lock_guard<std::mutex> lk(s->m);
+        if (s->sess.size() >= s->cfg.max_open_sockets) {
+          Sess* victim = nullptr;
+          if (s->cfg.lru_purge_enable) {
+            for (auto& ss : s->sess) {
+              if (!ss->busy && (!victim || ss->lru < victim->lru)) victim = ss.get();
+            }
+          }
+          if (victim) {
+            sess_close_locked(s, victim);
+            // il puntatore in who[] è morto
+            for (auto& w : who) if (w == victim) w = nullptr;
+          }
+        }
+        if (s->sess.size() >= s->cfg.max_open_sockets) {
+          close(fd);
+        } else {
+          set_timeouts(fd, s->cfg);
+          int one = 1;
+          setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+          setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &LWIP_TCP_SND_BUF, sizeof(LWIP_TCP_SND_BUF));
+          std::unique_ptr<Sess> ss(new Sess());
+          ss->fd = fd;
+          ss->lru = ++s->lru_clock;
+          s->sess.push_back(std::move(ss));
+        }
+      }
+    }
+    for (size_t i = 2; i < fds.size(); i++) {
+      if (!who[i] || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+      {
+        // può essere stata chiusa da una richiesta precedente di questo giro
+        std::lock_guard<std::mutex> lk(s->m);
+        bool alive = false;
+        for (auto& ss : s->sess) alive |= ss.get() == who[i];
+        if (!alive || who[i]->busy) continue;
+      }
+      serve_one(s, who[i]);
+    }
+  }
+}
+
+}  // namespace
+
+void sim_set_http_port(uint16_t port) { s_req_port = port; }
+uint16_t sim_http_port() { return s_bound_port.load(); }
+
+httpd_config_t HTTPD_DEFAULT_CONFIG() {
+  httpd_config_t c = {};
+  c.task_priority = 5;
+  c.stack_size = 4096;
+  c.core_id = 0x7FFFFFFF;   // tskNO_AFFINITY
+  c.server_port = 80;
+  c.ctrl_port = 32768;
+  c.max_open_sockets = 7;
+  c.max_uri_handlers = 8;
+  c.max_resp_headers = 8;
+  c.backlog_conn = 5;
+  c.lru_purge_enable = false;
+  c.recv_wait_timeout = 5;
+  c.send_wait_timeout = 5;
+  return c;
+}
+
+// la porta della config (80) è ignorata: si usa quella della simulazione
+esp_err_t httpd_start(httpd_handle_t* handle, const httpd_config_t* cfg) {
+  if (!handle || !cfg) return ESP_ERR_INVALID_ARG;
+  Server* s = new Server();
+  s->cfg = *cfg;
+  s->lfd = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(s->lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in a = {};
+  a.sin_family = AF_INET;
+  a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  a.sin_port = htons(s_req_port.load());
+  socklen_t al = sizeof(a);
+  if (s->lfd < 0 || bind(s->lfd, (struct sockaddr*)&a, sizeof(a)) != 0 ||
+      listen(s->lfd, cfg->backlog_conn ? cfg->backlog_conn : 5) != 0 || pipe(s->wake) != 0 ||
+      getsockname(s->lfd, (struct sockaddr*)&a, &al) != 0) {
+    if (s->lfd >= 0) close(s->lfd);
+    delete s;
+    return ESP_ERR_HTTPD_TASK;
+  }
+  s_bound_port = ntohs(a.sin_port);
+  std::thread(server_thread, s).detach();
+  *handle = s;
+  return ESP_OK;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t h, const httpd_uri_t* u) {
+  Server* s = (Server*)h;
+  if (!s || !u || !u->uri || !u->handler) return ESP_ERR_INVALID_ARG;
+  std::lock_guard<std::mutex> lk(s->m);
+  if (s->uris.size() >= s->cfg.max_uri_handlers) return ESP_ERR_HTTPD_HANDLERS_FULL;
+  for (const httpd_uri_t& x : s->uris) {
+    if (x.method == u->method && strcmp(x.uri, u->uri) == 0) return ESP_ERR_HTTPD_HANDLER_EXISTS;
+  }
+  s->uris.push_back(*u);
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t* r, const char* k, const char* v) {
+  Aux* a = aux_of(r);
+  if (!a || !k || !v) return ESP_ERR_INVALID_ARG;
+  if (a->hdrs.size() >= a->srv->cfg.max_resp_headers) return ESP_ERR_HTTPD_RESP_HDR;
+  a->hdrs.emplace_back(k, v);
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t* r, const char* t) {
+  Aux* a = aux_of(r);
+  if (!a || !t) return ESP_ERR_INVALID_ARG;
+  a->type = t;
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t* r, const char* st) {
+  Aux* a = aux_of(r);
+  if (!a || !st) return ESP_ERR_INVALID_ARG;
+  a->status = st;
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t* r, const char* buf, ssize_t len) {
+  Aux* a = aux_of(r);
+  if (!a) return ESP_ERR_INVALID_ARG;
+  if (len == HTTPD_RESP_USE_STRLEN) len = buf ? (ssize_t)strlen(buf) : 0;
+  if (len < 0 || (!buf && len)) return ESP_ERR_INVALID_ARG;
+  char cl[48];
+  snprintf(cl, sizeof(cl), "Content-Length: %ld\r\n", (long)len);
+  bool ok = send_headers(r, cl) && send_all(a->sess->fd, buf, (size_t)len);
+  a->done = true;
+  if (!ok) a->failed = true;
+  return ok ? ESP_OK : ESP_ERR_HTTPD_RESP_SEND;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t* r, const char* buf, ssize_t len) {
+  Aux* a = aux_of(r);
+  if (!a) return ESP_ERR_INVALID_ARG;
+  if (a->failed) return ESP_ERR_HTTPD_RESP_SEND;
+  if (len == HTTPD_RESP_USE_STRLEN) len = buf ? (ssize_t)strlen(buf) : 0;
+  if (!a->hdr_sent) {
+    a->chunked = true;
+    if (!send_headers(r, "Transfer-Encoding: chunked\r\n")) {
+      a->failed = true;
+      return ESP_ERR_HTTPD_RESP_SEND;
+    }
+  }
+  bool ok;
+  if (!buf || len <= 0) {
+    ok = send_all(a->sess->fd, "0\r\n\r\n", 5);
+    a->done = true;
+  } else {
+    char sz[16];
+    int n = snprintf(sz, sizeof(sz), "%lx\r\n", (unsigned long)len);
+    ok = send_all(a->sess->fd, sz, (size_t)n) && send_all(a->sess->fd, buf, (size_t)len) &&
+         send_all(a->sess->fd, "\r\n", 2);
+  }
+  if (!ok) a->failed = true;
+  return ok ? ESP_OK : ESP_ERR_HTTPD_RESP_SEND;
+}
+
+esp_err_t httpd_resp_sendstr_chunk(httpd_req_t* r, const char* s) {
+  return httpd_resp_send_chunk(r, s, s ? (ssize_t)strlen(s) : 0);
+}
+
+esp_err_t httpd_resp_sendstr(httpd_req_t* r, const char* s) {
+  return httpd_resp_send(r, s, s ? (ssize_t)strlen(s) : 0);
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t* r, httpd_err_code_t code, const char* msg) {
+  int st;
+  switch (code) {
+    case HTTPD_400_BAD_REQUEST: st = 400; break;
+    case HTTPD_404_NOT_FOUND:   st = 404; break;
+    case HTTPD_408_REQ_TIMEOUT: st = 408; break;
+    default:                    st = 500; break;
+  }
+  Aux* a = aux_of(r);
+  if (!a) return ESP_ERR_INVALID_ARG;
+  char line[64];
+  snprintf(line, sizeof(line), "%d %s", st, reason(st));
+  a->status = line;
+  a->type = "text/html";
+  return httpd_resp_send(r, msg ? msg : reason(st), HTTPD_RESP_USE_STRLEN);
+}
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t* r, char* buf, size_t len) {
+  Aux* a = aux_of(r);
+  if (!a || !buf || !len) return ESP_ERR_INVALID_ARG;
+  if (!a->has_query) return ESP_ERR_NOT_FOUND;
+  size_t n = std::min(a->query.size(), len - 1);
+  memcpy(buf, a->query.data(), n);
+  buf[n] = 0;
+  return n < a->query.size() ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+}
+
+esp_err_t httpd_query_key_value(const char* qry, const char* key, char* val, size_t len) {
+  if (!qry || !key || !val || !len) return ESP_ERR_INVALID_ARG;
+  size_t kl = strlen(key);
+  const char* p = qry;
+  while (*p) {
+    const char* end = strchr(p, '&');
+    if (!end) end = p + strlen(p);
+    const char* eq = (const char*)memchr(p, '=', (size_t)(end - p));
+    const char* kend = eq ? eq : end;
+    if ((size_t)(kend - p) == kl && strncmp(p, key, kl) == 0) {
+      const char* v = eq ? eq + 1 : end;
+      size_t vl = (size_t)(end - v);
+      size_t n = std::min(vl, len - 1);
+      memcpy(val, v, n);
+      val[n] = 0;
+      return n < vl ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+    }
+    p = *end ? end + 1 : end;
+  }
+  return ESP_ERR_NOT_FOUND;
+}
+
+int httpd_req_recv(httpd_req_t* r, char* buf, size_t len) {
+  Aux* a = aux_of(r);
+  if (!a || !buf) return HTTPD_SOCK_ERR_INVALID;
+  if (!a->body_left || !len) return 0;
+  size_t want = std::min(len, a->body_left);
+  if (!a->sess->rx.empty()) {
+    size_t n = std::min(want, a->sess->rx.size());
+    memcpy(buf, a->sess->rx.data(), n);
+    a->sess->rx.erase(0, n);
+    a->body_left -= n;
+    return (int)n;
+  }
+  for (;;) {
+    ssize_t n = recv(a->sess->fd, buf, want, 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return HTTPD_SOCK_ERR_TIMEOUT;
+    if (n <= 0) return HTTPD_SOCK_ERR_FAIL;
+    a->body_left -= (size_t)n;
+    return (int)n;
+  }
+}
+
+int httpd_req_to_sockfd(httpd_req_t* r) {
+  Aux* a = aux_of(r);
+  return a ? a->sess->fd : -1;
+}
+
+esp_err_t httpd_req_async_handler_begin(httpd_req_t* r, httpd_req_t** out) {
+  Aux* a = aux_of(r);
+  if (!a || !out) return ESP_ERR_INVALID_ARG;
+  httpd_req_t* copy = (httpd_req_t*)calloc(1, sizeof(httpd_req_t));
+  memcpy((void*)copy, r, sizeof(*r));
+  Aux* ca = new Aux(*a);
+  copy->aux = ca;
+  a->async = true;
+  *out = copy;
+  return ESP_OK;
+}
+
+esp_err_t httpd_req_async_handler_complete(httpd_req_t* r) {
+  Aux* a = aux_of(r);
+  if (!a) return ESP_ERR_INVALID_ARG;
+  Server* s = a->srv;
+  finish(s, a, ESP_OK);
+  delete a;
+  free(r);
+  wake_server(s);
+  return ESP_OK;
+}
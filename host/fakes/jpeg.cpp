@@ -0,0 +1,637 @@
+// Codec JPEG baseline (vedi sim_jpeg.h) + img_converters.h di esp32-camera.
+#include "sim_jpeg.h"
+#include "img_converters.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+const uint8_t ZIGZAG[64] = {
+   0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+  12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+  35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+  58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+const uint8_t STD_LUMA_Q[64] = {
+  16, 11, 10, 16, 24, 40, 51, 61,  12, 12, 14, 19, 26, 58, 60, 55,
+  14, 13, 16, 24, 40, 57, 69, 56,  14, 17, 22, 29, 51, 87, 80, 62,
+  18, 22, 37, 56, 68,109,103, 77,  24, 35, 55, 64, 81,104,113, 92,
+  49, 64, 78, 87,103,121,120,101,  72, 92, 95, 98,112,100,103, 99
+};
+const uint8_t STD_CHROMA_Q[64] = {
+  17, 18, 24, 47, 99, 99, 99, 99,  18, 21, 26, 66, 99, 99, 99, 99,
+  24, 26, 56, 99, 99, 99, 99, 99,  47, 66, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99,  99, 99, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99,  99, 99, 99, 99, 99, 99, 99, 99
+};
+
+// Annex K.3
+const uint8_t DC_LUMA_BITS[16] = {0,1,5,1,1,1,1,1,1,0,0,0,0,0,0,0};
+const uint8_t DC_LUMA_VAL[12]  = {0,1,2,3,4,5,6,7,8,9,10,11};
+const uint8_t DC_CHROMA_BITS[16] = {0,3,1,1,1,1,1,1,1,1,1,0,0,0,0,0};
+const uint8_t DC_CHROMA_VAL[12]  = {0,1,2,3,4,5,6,7,8,9,10,11};
+const uint8_t AC_LUMA_BITS[16] = {0,2,1,3,3,2,4,3,5,5,4,4,0,0,1,0x7d};
+const uint8_t AC_LUMA_VAL[162] = {
+  0x01,0x02,0x03,0x00,0x04,0x11,0x05,0x12,0x21,0x31,0x41,0x06,0x13,0x51,0x61,0x07,
+  0x22,0x71,0x14,0x32,0x81,0x91,0xa1,0x08,0x23,0x42,0xb1,0xc1,0x15,0x52,0xd1,0xf0,
+  0x24,0x33,0x62,0x72,0x82,0x09,0x0a,0x16,0x17,0x18,0x19,0x1a,0x25,0x26,0x27,0x28,
+  0x29,0x2a,0x34,0x35,0x36,0x37,0x38,0x39,0x3a,0x43,0x44,0x45,0x46,0x47,0x48,0x49,
+  0x4a,0x53,0x54,0x55,0x56,0x57,0x58,0x59,0x5a,0x63,0x64,0x65,0x66,0x67,0x68,0x69,
+  0x6a,0x73,0x74,0x75,0x76,0x77,0x78,0x79,0x7a,0x83,0x84,0x85,0x86,0x87,0x88,0x89,
+  0x8a,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99,0x9a,0xa2,0xa3,0xa4,0xa5,0xa6,0xa7,
+  0xa8,0xa9,0xaa,0xb2,0xb3,0xb4,0xb5,0xb6,0xb7,0xb8,0xb9,0xba,0xc2,0xc3,0xc4,0xc5,
+  0xc6,0xc7,0xc8,0xc9,0xca,0xd2,0xd3,0xd4,0xd5,0xd6,0xd7,0xd8,0xd9,0xda,0xe1,0xe2,
+  0xe3,0xe4,0xe5,0xe6,0xe7,0xe8,0xe9,0xea,0xf1,0xf2,0xf3,0xf4,0xf5,0xf6,0xf7,0xf8,
+  0xf9,0xfa
+};
+const uint8_t AC_CHROMA_BITS[16] = {0,2,1,2,4,4,3,4,7,5,4,4,0,1,2,0x77};
+const uint8_t AC_CHROMA_VAL[162] = {
+  0x00,0x01,0x02,0x03,0x11,0x04,0x05,0x21,0x31,0x06,0x12,0x41,0x51,0x07,0x61,0x71,
+  0x13,0x22,0x32,0x81,0x08,0x14,0x42,0x91,0xa1,0xb1,0xc1,0x09,0x23,0x33,0x52,0xf0,
+  0x15,0x62,0x72,0xd1,0x0a,0x16,0x24,0x34,0xe1,0x25,0xf1,0x17,0x18,0x19,0x1a,0x26,
+  0x27,0x28,0x29,0x2a,0x35,0x36,0x37,0x38,0x39,0x3a,0x43,0x44,0x45,0x46,0x47,0x48,
+  0x49,0x4a,0x53,0x54,0x55,0x56,0x57,0x58,0x59,0x5a,0x63,0x64,0x65,0x66,0x67,0x68,
+  0x69,0x6a,0x73,0x74,0x75,0x76,0x77,0x78,0x79,0x7a,0x82,0x83,0x84,0x85,0x86,0x87,
+  0x88,0x89,0x8a,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99,0x9a,0xa2,0xa3,0xa4,0xa5,
+  0xa6,0xa7,0xa8,0xa9,0xaa,0xb2,0xb3,0xb4,0xb5,0xb6,0xb7,0xb8,0xb9,0xba,0xc2,0xc3,
+  0xc4,0xc5,0xc6,0xc7,0xc8,0xc9,0xca,0xd2,0xd3,0xd4,0xd5,0xd6,0xd7,0xd8,0xd9,0xda,
+  0xe2,0xe3,0xe4,0xe5,0xe6,0xe7,0xe8,0xe9,0xea,0xf2,0xf3,0xf4,0xf5,0xf6,0xf7,0xf8,
+  0xf9,0xfa
+};
+
+// cos((2x+1)u*pi/16) * C(u)/2
+struct DctTable {
+  float c[8][8];
+  DctTable() {
+    for (int u = 0; u < 8; u++) {
+      float cu = u == 0 ? (float)(1.0 / sqrt(2.0)) : 1.0f;
+      for (int x = 0; x < 8; x++) c[u][x] = cu * 0.5f * (float)cos((2 * x + 1) * u * M_PI / 16.0);
+    }
+  }
+};
+const DctTable& dct() {
+  static const DctTable t;
+  return t;
+}
+
+void fdct8x8(const float in[64], float out[64]) {
+  const DctTable& t = dct();
+  float tmp[64];
+  for (int y = 0; y < 8; y++)
+    for (int u = 0; u < 8; u++) {
+      float s = 0;
+      for (int x = 0; x < 8; x++) s += in[y * 8 + x] * t.c[u][x];
+      tmp[y * 8 + u] = s;
+    }
+  for (int u = 0; u < 8; u++)
+    for (int v = 0; v < 8; v++) {
+      float s = 0;
+      for (int y = 0; y < 8; y++) s += tmp[y * 8 + u] * t.c[v][y];
+      out[v * 8 + u] = s;
+    }
+}
+
+void idct8x8(const float in[64], float out[64]) {
+  const DctTable& t = dct();
+  float tmp[64];
+  for (int v = 0; v < 8; v++)
+    for (int x = 0; x < 8; x++) {
+      float s = 0;
+      for (int u = 0; u < 8; u++) s += in[v * 8 + u] * t.c[u][x];
+      tmp[v * 8 + x] = s;
+    }
+  for (int x = 0; x < 8; x++)
+    for (int y = 0; y < 8; y++) {
+      float s = 0;
+      for (int v = 0; v < 8; v++) s += tmp[v * 8 + x] * t.c[v][y];
+      out[y * 8 + x] = s;
+    }
+}
+
+inline uint8_t clamp8(float v) {
+  int i = (int)lrintf(v);
+  return (uint8_t)(i < 0 ? 0 : (i > 255 ? 255 : i));
+}
+
+void scale_qtable(const uint8_t* base, int quality, uint8_t* out) {
+  if (quality < 1) quality = 1;
+  if (quality > 100) quality = 100;
+  int s = quality < 50 ? 5000 / quality : 200 - quality * 2;
+  for (int i = 0; i < 64; i++) {
+    int v = (base[i] * s + 50) / 100;
+    out[i] = (uint8_t)(v < 1 ? 1 : (v > 255 ? 255 : v));
+  }
+}
+
+// ---------------- encoder ----------------
+struct HuffEnc {
+  uint16_t code[256];
+  uint8_t  len[256];
+  void build(const uint8_t bits[16], const uint8_t* vals) {
+    memset(len, 0, sizeof(len));
+    uint16_t c = 0;
+    int k = 0;
+    for (int l = 1; l <= 16; l++) {
+      for (int i = 0; i < bits[l - 1]; i++) {
+        code[vals[k]] = c++;
+        len[vals[k]] = (uint8_t)l;
+        k++;
+      }
+      c <<= 1;
+    }
+  }
+};
+
+struct BitWriter {
+  std::vector<uint8_t>& out;
+  uint32_t acc = 0;
+  int      n = 0;
+  explicit BitWriter(std::vector<uint8_t>& o) : out(o) {}
+  void put(uint32_t bits, int len) {
+    for (int i = len - 1; i >= 0; i--) {
+      acc = (acc << 1) | ((bits >> i) & 1);
+      if (++n == 8) {
+        out.push_back((uint8_t)acc);
+        if ((uint8_t)acc == 0xFF) out.push_back(0);
+        acc = 0;
+        n = 0;
+      }
+    }
+  }
+  void flush() {
+    while (n) put(1, 1);
+  }
+};
+
+int bit_size(int v) {
+  if (v < 0) v = -v;
+  int n = 0;
+  while (v) { n++; v >>= 1; }
+  return n;
+}
+
+void encode_block(BitWriter& bw, const float px[64], const uint8_t* q, int& pred,
+                  const HuffEnc& dc, const HuffEnc& ac) {
+  float f[64];
+  float in[64];
+  for (int i = 0; i < 64; i++) in[i] = px[i] - 128.0f;
+  fdct8x8(in, f);
+  int zz[64];
+  for (int i = 0; i < 64; i++) zz[i] = (int)lrintf(f[ZIGZAG[i]] / q[ZIGZAG[i]]);
+
+  int diff = zz[0] - pred;
+  pred = zz[0];
+  int s = bit_size(diff);
+  bw.put(dc.code[s], dc.len[s]);
+  if (s) bw.put((uint32_t)(diff < 0 ? diff + (1 << s) - 1 : diff), s);
+
+  int run = 0;
+  for (int i = 1; i < 64; i++) {
+    if (zz[i] == 0) { run++; continue; }
+    while (run > 15) { bw.put(ac.code[0xF0], ac.len[0xF0]); run -= 16; }
+    int v = zz[i];
+    int sz = bit_size(v);
+    int sym = (run << 4) | sz;
+    bw.put(ac.code[sym], ac.len[sym]);
+    bw.put((uint32_t)(v < 0 ? v + (1 << sz) - 1 : v), sz);
+    run = 0;
+  }
+  if (run) bw.put(ac.code[0x00], ac.len[0x00]);
+}
+
+void put16(std::vector<uint8_t>& o, int v) {
+  o.push_back((uint8_t)(v >> 8));
+  o.push_back((uint8_t)v);
+}
+
+void put_dht(std::vector<uint8_t>& o, int cls_id, const uint8_t bits[16], const uint8_t* vals) {
+  int n = 0;
+  for (int i = 0; i < 16; i++) n += bits[i];
+  o.push_back(0xFF); o.push_back(0xC4);
+  put16(o, 2 + 1 + 16 + n);
+  o.push_back((uint8_t)cls_id);
+  o.insert(o.end(), bits, bits + 16);
+  o.insert(o.end(), vals, vals + n);
+}
+
+// ---------------- decoder ----------------
+struct HuffDec {
+  bool     ok = false;
+  int32_t  maxcode[18];
+  int32_t  valptr[17];
+  uint16_t mincode[17];
+  uint8_t  vals[256];
+  void build(const uint8_t bits[16], const uint8_t* v, int n) {
+    memcpy(vals, v, (size_t)n);
+    int code = 0, k = 0;
+    for (int l = 1; l <= 16; l++) {
+      valptr[l] = k;
+      mincode[l] = (uint16_t)code;
+      code += bits[l - 1];
+      k += bits[l - 1];
+      maxcode[l] = bits[l - 1] ? code - 1 : -1;
+      code <<= 1;
+    }
+    maxcode[17] = 0x7FFFFFFF;
+    ok = true;
+  }
+};
+
+struct Comp {
+  int id = 0, h = 1, v = 1, tq = 0, td = 0, ta = 0;
+  int bw = 0, bh = 0;          // blocchi per riga/colonna (MCU intere)
+  int pred = 0;
+  std::vector<float> plane;    // campioni (pieno) o medie di blocco (solo DC)
+};
+
+struct BitReader {
+  const uint8_t* p;
+  const uint8_t* end;
+  uint32_t acc = 0;
+  int      n = 0;
+  bool     marker = false;
+  int bit() {
+    if (n == 0) {
+      uint8_t b = 0;
+      if (!marker && p < end) {
+        b = *p++;
+        if (b == 0xFF) {
+          uint8_t nx = p < end ? *p : 0;
+          if (nx == 0x00) p++;
+          else { marker = true; b = 0; p--; }
+        }
+      }
+      acc = b;
+      n = 8;
+    }
+    n--;
+    return (acc >> n) & 1;
+  }
+  int bits(int k) {
+    int v = 0;
+    for (int i = 0; i < k; i++) v = (v << 1) | bit();
+    return v;
+  }
+  // RSTn: riallinea al byte e salta il marker
+  void restart() {
+    n = 0;
+    marker = false;
+    while (p + 1 < end && !(p[0] == 0xFF && p[1] >= 0xD0 && p[1] <= 0xD7)) p++;
+    if (p + 1 < end) p += 2;
+  }
+};
+
+int decode_sym(BitReader& br, const HuffDec& h) {
+  int code = br.bit();
+  int l = 1;
+  while (l <= 16 && code > h.maxcode[l]) {
+    code = (code << 1) | br.bit();
+    l++;
+  }
+  if (l > 16) return -1;
+  return h.vals[h.valptr[l] + code - h.mincode[l]];
+}
+
+inline int extend(int v, int s) {
+  return v < (1 << (s - 1)) ? v - (1 << s) + 1 : v;
+}
+
+struct Decoder {
+  int width = 0, height = 0;
+  int hmax = 1, vmax = 1;
+  int restart = 0;
+  uint16_t q[4][64];
+  HuffDec dc[4], ac[4];
+  std::vector<Comp> comps;
+  const uint8_t* scan = nullptr;
+  const uint8_t* end = nullptr;
+  bool progressive = false;
+
+  bool parse(const uint8_t* src, size_t len, bool header_only) {
+    const uint8_t* p = src;
+    end = src + len;
+    if (len < 4 || p[0] != 0xFF || p[1] != 0xD8) return false;
+    p += 2;
+    while (p + 4 <= end) {
+      if (p[0] != 0xFF) { p++; continue; }
+      uint8_t m = p[1];
+      if (m == 0xFF) { p++; continue; }
+      p += 2;
+      if (m == 0xD8 || (m >= 0xD0 && m <= 0xD7) || m == 0x01) continue;
+      if (m == 0xD9) return false;
+      int seg = (p[0] << 8) | p[1];
+      if (seg < 2 || p + seg > end) return false;
+      const uint8_t* s = p + 2;
+      int n = seg - 2;
+      switch (m) {
+        case 0xDB:
+          while (n > 0) {
+            int pq = s[0] >> 4, tq = s[0] & 3;
+            s++; n--;
+            for (int i = 0; i < 64; i++) {
+              q[tq][ZIGZAG[i]] = pq ? (uint16_t)((s[2 * i] << 8) | s[2 * i + 1]) : s[i];
+            }
+            s += pq ? 128 : 64;
+            n -= pq ? 128 : 64;
+          }
+          break;
+        case 0xC0: case 0xC1: case 0xC2: {
+          progressive = m == 0xC2;
+          height = (s[1] << 8) | s[2];
+          width = (s[3] << 8) | s[4];
+          int nc = s[5];
+          if (nc != 1 && nc != 3) return false;
+          comps.assign((size_t)nc, Comp());
+          for (int i = 0; i < nc; i++) {
+            comps[i].id = s[6 + 3 * i];
+            comps[i].h = s[7 + 3 * i] >> 4;
+            comps[i].v = s[7 + 3 * i] & 15;
+            comps[i].tq = s[8 + 3 * i] & 3;
+            if (comps[i].h < 1 || comps[i].h > 2 || comps[i].v < 1 || comps[i].v > 2) return false;
+            if (comps[i].h > hmax) hmax = comps[i].h;
+            if (comps[i].v > vmax) vmax = comps[i].v;
+          }
+          if (nc == 1) comps[0].h = comps[0].v = hmax = vmax = 1;
+          if (header_only) return width > 0 && height > 0;
+          break;
+        }
+        case 0xC4:
+          while (n > 0) {
+            int tc = s[0] >> 4, th = s[0] & 3;
+            const uint8_t* bits = s + 1;
+            int cnt = 0;
+            for (int i = 0; i < 16; i++) cnt += bits[i];
+            if (cnt > 256) return false;
+            (tc ? ac[th] : dc[th]).build(bits, s + 17, cnt);
+            s += 17 + cnt;
+            n -= 17 + cnt;
+          }
+          break;
+        case 0xDD:
+          restart = (s[0] << 8) | s[1];
+          break;
+        case 0xDA: {
+          int ns = s[0];
+          for (int i = 0; i < ns; i++) {
+            for (Comp& c : comps) {
+              if (c.id == s[1 + 2 * i]) { c.td = s[2 + 2 * i] >> 4; c.ta = s[2 + 2 * i] & 3; }
+            }
+          }
+          if (ns != (int)comps.size()) return false;   // solo scansioni interleaved
+          scan = p + seg;
+          return !progressive && width > 0 && height > 0;
+        }
+        default:
+          break;
+      }
+      p += seg;
+    }
+    return false;
+  }
+
+  // dc_only: un campione per blocco (media), altrimenti IDCT piena
+  bool decode(bool dc_only) {
+    int mcux = (width + 8 * hmax - 1) / (8 * hmax);
+    int mcuy = (height + 8 * vmax - 1) / (8 * vmax);
+    int bs = dc_only ? 1 : 8;
+    for (Comp& c : comps) {
+      c.bw = mcux * c.h;
+      c.bh = mcuy * c.v;
+      c.plane.assign((size_t)c.bw * bs * c.bh * bs, 0.0f);
+      c.pred = 0;
+      if (!dc[c.td].ok || !ac[c.ta].ok) return false;
+    }
+    BitReader br{scan, end};
+    int mcus = 0;
+    float coef[64], pix[64];
+    for (int my = 0; my < mcuy; my++) {
+      for (int mx = 0; mx < mcux; mx++) {
+        if (restart && mcus && mcus % restart == 0) {
+          br.restart();
+          for (Comp& c : comps) c.pred = 0;
+        }
+        mcus++;
+        for (Comp& c : comps) {
+          const uint16_t* qt = q[c.tq];
+          for (int by = 0; by < c.v; by++) {
+            for (int bx = 0; bx < c.h; bx++) {
+              int s = decode_sym(br, dc[c.td]);
+              if (s < 0) return false;
+              int diff = s ? extend(br.bits(s), s) : 0;
+              c.pred += diff;
+              memset(coef, 0, sizeof(coef));
+              coef[0] = (float)(c.pred * qt[0]);
+              for (int k = 1; k < 64;) {
+                int rs = decode_sym(br, ac[c.ta]);
+                if (rs < 0) return false;
+                int r = rs >> 4, sz = rs & 15;
+                if (sz == 0) {
+                  if (r == 15) { k += 16; continue; }
+                  break;
+                }
+                k += r;
+                if (k > 63) return false;
+                coef[ZIGZAG[k]] = (float)(extend(br.bits(sz), sz) * qt[ZIGZAG[k]]);
+                k++;
+              }
+              int gx = mx * c.h + bx, gy = my * c.v + by;
+              if (dc_only) {
+                c.plane[(size_t)gy * c.bw + gx] = coef[0] / 8.0f + 128.0f;
+              } else {
+                idct8x8(coef, pix);
+                size_t stride = (size_t)c.bw * 8;
+                for (int y = 0; y < 8; y++)
+                  for (int x = 0; x < 8; x++)
+                    c.plane[(size_t)(gy * 8 + y) * stride + gx * 8 + x] = pix[y * 8 + x] + 128.0f;
+              }
+            }
+          }
+        }
+      }
+    }
+    return true;
+  }
+
+  // campione della componente nel punto (x, y) della griglia a piena risoluzione / div
+  float sample(const Comp& c, int x, int y, int unit) const {
+    int cx = x * c.h / hmax / unit, cy = y * c.v / vmax / unit;
+    int pw = c.bw * (unit == 8 ? 1 : 8);
+    return c.plane[(size_t)cy * pw + cx];
+  }
+};
+
+}  // namespace
+
+int sim_jpeg_quality_from_sensor(int q) {
+  if (q < 0) q = 0;
+  if (q > 63) q = 63;
+  int ijg = 100 - q * 13 / 10;
+  return ijg < 5 ? 5 : ijg;
+}
+
+bool sim_jpeg_encode(const uint8_t* rgb, int w, int h, int quality, std::vector<uint8_t>& out) {
+  if (!rgb || w <= 0 || h <= 0 || w > 65535 || h > 65535) return false;
+  static HuffEnc dcl, acl, dcc, acc;
+  static bool built = false;
+  if (!built) {
+    dcl.build(DC_LUMA_BITS, DC_LUMA_VAL);
+    acl.build(AC_LUMA_BITS, AC_LUMA_VAL);
+    dcc.build(DC_CHROMA_BITS, DC_CHROMA_VAL);
+    acc.build(AC_CHROMA_BITS, AC_CHROMA_VAL);
+    built = true;
+  }
+  uint8_t ql[64], qc[64];
+  scale_qtable(STD_LUMA_Q, quality, ql);
+  scale_qtable(STD_CHROMA_Q, quality, qc);
+
+  out.clear();
+  out.reserve((size_t)w * h / 4 + 1024);
+  const uint8_t head[] = {0xFF, 0xD8, 0xFF, 0xE0, 0, 16, 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0};
+  out.insert(out.end(), head, head + sizeof(head));
+  for (int t = 0; t < 2; t++) {
+    out.push_back(0xFF); out.push_back(0xDB);
+    put16(out, 67);
+    out.push_back((uint8_t)t);
+    const uint8_t* qt = t ? qc : ql;
+    for (int i = 0; i < 64; i++) out.push_back(qt[ZIGZAG[i]]);
+  }
+  const uint8_t sof[] = {0xFF, 0xC0, 0, 17, 8, (uint8_t)(h >> 8), (uint8_t)h, (uint8_t)(w >> 8), (uint8_t)w, 3,
+                         1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1};
+  out.insert(out.end(), sof, sof + sizeof(sof));
+  put_dht(out, 0x00, DC_LUMA_BITS, DC_LUMA_VAL);
+  put_dht(out, 0x10, AC_LUMA_BITS, AC_LUMA_VAL);
+  put_dht(out, 0x01, DC_CHROMA_BITS, DC_CHROMA_VAL);
+  put_dht(out, 0x11, AC_CHROMA_BITS, AC_CHROMA_VAL);
+  const uint8_t sos[] = {0xFF, 0xDA, 0, 12, 3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0};
+  out.insert(out.end(), sos, sos + sizeof(sos));
+
+  BitWriter bw(out);
+  int py = 0, pcb = 0, pcr = 0;
+  float Y[4][64], Cb[64], Cr[64];
+  for (int my = 0; my < h; my += 16) {
+    for (int mx = 0; mx < w; mx += 16) {
+      memset(Cb, 0, sizeof(Cb));
+      memset(Cr, 0, sizeof(Cr));
+      for (int y = 0; y < 16; y++) {
+        int sy = my + y < h ? my + y : h - 1;
+        for (int x = 0; x < 16; x++) {
+          int sx = mx + x < w ? mx + x : w - 1;
+          const uint8_t* p = rgb + ((size_t)sy * w + sx) * 3;
+          float r = p[0], g = p[1], b = p[2];
+          int blk = (y >> 3) * 2 + (x >> 3);
+          Y[blk][(y & 7) * 8 + (x & 7)] = 0.299f * r + 0.587f * g + 0.114f * b;
+          int ci = (y >> 1) * 8 + (x >> 1);
+          Cb[ci] += (-0.168736f * r - 0.331264f * g + 0.5f * b + 128.0f) * 0.25f;
+          Cr[ci] += (0.5f * r - 0.418688f * g - 0.081312f * b + 128.0f) * 0.25f;
+        }
+      }
+      for (int b = 0; b < 4; b++) encode_block(bw, Y[b], ql, py, dcl, acl);
+      encode_block(bw, Cb, qc, pcb, dcc, acc);
+      encode_block(bw, Cr, qc, pcr, dcc, acc);
+    }
+  }
+  bw.flush();
+  out.push_back(0xFF);
+  out.push_back(0xD9);
+  return true;
+}
+
+bool sim_jpeg_size(const uint8_t* src, size_t len, int* w, int* h) {
+  Decoder d;
+  if (!src || !d.parse(src, len, true)) return false;
+  if (w) *w = d.width;
+  if (h) *h = d.height;
+  return true;
+}
+
+bool sim_jpeg_decode(const uint8_t* src, size_t len, int shift, std::vector<uint8_t>& rgb, int* ow, int* oh) {
+  if (!src || shift < 0 || shift > 3) return false;
+  Decoder d;
+  if (!d.parse(src, len, false)) return false;
+  bool dc_only = shift == 3;
+  if (!d.decode(dc_only)) return false;
+
+  int div = 1 << shift;
+  int w = d.width / div, h = d.height / div;
+  if (w <= 0 || h <= 0) return false;
+  rgb.assign((size_t)w * h * 3, 0);
+  int unit = dc_only ? 8 : 1;
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      // media del riquadro div x div (con DC il campione è già la media del blocco)
+      float acc[3] = {0, 0, 0};
+      int n = dc_only ? 1 : div * div;
+      for (int sy = 0; sy < (dc_only ? 1 : div); sy++) {
+        for (int sx = 0; sx < (dc_only ? 1 : div); sx++) {
+          int fx = x * div + sx, fy = y * div + sy;
+          for (size_t c = 0; c < d.comps.size(); c++) acc[c] += d.sample(d.comps[c], fx, fy, unit);
+        }
+      }
+      uint8_t* o = &rgb[((size_t)y * w + x) * 3];
+      float Yv = acc[0] / n;
+      if (d.comps.size() == 1) {
+        o[0] = o[1] = o[2] = clamp8(Yv);
+      } else {
+        float cb = acc[1] / n - 128.0f, cr = acc[2] / n - 128.0f;
+        o[0] = clamp8(Yv + 1.402f * cr);
+        o[1] = clamp8(Yv - 0.344136f * cb - 0.714136f * cr);
+        o[2] = clamp8(Yv + 1.772f * cb);
+      }
+    }
+  }
+  if (ow) *ow = w;
+  if (oh) *oh = h;
+  return true;
+}
+
+// ---------------- img_converters.h ----------------
+bool jpg2rgb565(const uint8_t* src, size_t src_len, uint8_t* out, jpg_scale_t scale) {
+  std::vector<uint8_t> rgb;
+  int w = 0, h = 0;
+  if (!out || !sim_jpeg_decode(src, src_len, (int)scale, rgb, &w, &h)) return false;
+  // RGB565 big-endian, come il decoder di esp32-camera
+  for (size_t i = 0; i < (size_t)w * h; i++) {
+    uint16_t c = (uint16_t)(((rgb[3 * i] & 0xF8) << 8) | ((rgb[3 * i + 1] & 0xFC) << 3) | (rgb[3 * i + 2] >> 3));
+    out[2 * i] = (uint8_t)(c >> 8);
+    out[2 * i + 1] = (uint8_t)c;
+  }
+  return true;
+}
+
+bool fmt2jpg(uint8_t* src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format,
+             uint8_t quality, uint8_t** out, size_t* out_len) {
+  if (!src || !out || !out_len) return false;
+  size_t n = (size_t)width * height;
+  std::vector<uint8_t> rgb(n * 3);
+  switch (format) {
+    case PIXFORMAT_RGB565:
+      if (src_len < n * 2) return false;
+      for (size_t i = 0; i < n; i++) {
+        uint16_t c = (uint16_t)((src[2 * i] << 8) | src[2 * i + 1]);
+        rgb[3 * i]     = (uint8_t)(((c >> 11) & 0x1F) * 255 / 31);
+        rgb[3 * i + 1] = (uint8_t)(((c >> 5) & 0x3F) * 255 / 63);
+        rgb[3 * i + 2] = (uint8_t)((c & 0x1F) * 255 / 31);
+      }
+      break;
+    case PIXFORMAT_RGB888:
+      if (src_len < n * 3) return false;
+      memcpy(rgb.data(), src, n * 3);
+      break;
+    case PIXFORMAT_GRAYSCALE:
+      if (src_len < n) return false;
+      for (size_t i = 0; i < n; i++) rgb[3 * i] = rgb[3 * i + 1] = rgb[3 * i + 2] = src[i];
+      break;
+    default:
+      return false;
+  }
+  std::vector<uint8_t> jpg;
+  if (!sim_jpeg_encode(rgb.data(), width, height, quality, jpg)) return false;
+  *out = (uint8_t*)malloc(jpg.size());
+  if (!*out) return false;
+  memcpy(*out, jpg.data(), jpg.size());
+  *out_len = jpg.size();
+  return true;
+}
@@ -0,0 +1,325 @@
+// PubSubClient + broker MQTT in-process. Il broker tiene i retained, fa il
+// match dei filtri + e # e consegna al device un messaggio per mqtt.loop()
+// (come PubSubClient, che legge un pacchetto per giro). I limiti sono quelli
+// della libreria: publish() fallisce se header+topic+payload non stanno nel
+// buffer di setBufferSize(), beginPublish() invece scrive in streaming.
+#include "PubSubClient.h"
+#include "esp_heap_caps.h"
+
+#include "sim.h"
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+const size_t MQTT_MAX_HEADER_SIZE = 5;
+const uint16_t DEFAULT_BUFFER = 256;
+
+struct Msg {
+  std::string topic;
+  std::string payload;
+  bool        retained;
+};
+
+struct Client {
+  bool        connected = false;
+  std::vector<std::string> subs;
+  std::deque<Msg> inbox;
+  std::string will_topic, will_msg;
+  bool        will_retain = false;
+};
+
+struct TestSub {
+  std::string   filter;
+  sim_mqtt_cb_t cb;
+};
+
+std::recursive_mutex s_m;
+std::map<int, Client>               s_clients;
+std::map<std::string, std::string>  s_retained;
+std::map<int, TestSub>              s_test_subs;
+int  s_next_client = 1;
+int  s_next_sub = 1;
+bool s_up = true;
+sim_broker_stats_t s_stats = {};
+
+std::vector<std::string> levels(const std::string& s) {
+  std::vector<std::string> out;
+  size_t p = 0;
+  for (;;) {
+    size_t e = s.find('/', p);
+    out.push_back(s.substr(p, e == std::string::npos ? std::string::npos : e - p));
+    if (e == std::string::npos) return out;
+    p = e + 1;
+  }
+}
+
+bool topic_match(const std::string& filter, const std::string& topic) {
+  std::vector<std::string> f = levels(filter), t = levels(topic);
+  for (size_t i = 0; i < f.size(); i++) {
+    if (f[i] == "#") return true;          // anche il livello padre ("a/#" accetta "a")
+    if (i >= t.size()) return false;
+    if (f[i] != "+" && f[i] != t[i]) return false;
+  }
+  return f.size() == t.size();
+}
+
+// instrada un messaggio; i callback di test girano fuori dal lock
+void route(const Msg& m) {
+  std::vector<sim_mqtt_cb_t> cbs;
+  {
+    std::lock_guard<std::recursive_mutex> lk(s_m);
+    if (m.retained) {
+      if (m.payload.empty()) s_retained.erase(m.topic);
+      else s_retained[m.topic] = m.payload;
+    }
+    for (auto& kv : s_clients) {
+      Client& c = kv.second;
+      if (!c.connected) continue;
+      for (const std::string& f : c.subs) {
+        if (topic_match(f, m.topic)) {
+          // consegna live: flag retain azzerato come da MQTT 3.1.1
+          c.inbox.push_back(Msg{m.topic, m.payload, false});
+          break;
+        }
+      }
+    }
+    for (auto& kv : s_test_subs) {
+      if (topic_match(kv.second.filter, m.topic)) cbs.push_back(kv.second.cb);
+    }
+  }
+  for (auto& cb : cbs) cb(m.topic, m.payload, false);
+}
+
+// sessione caduta senza DISCONNECT: il broker pubblica il will
+void drop_locked(int id, std::vector<Msg>* wills) {
+  auto it = s_clients.find(id);
+  if (it == s_clients.end() || !it->second.connected) return;
+  Client& c = it->second;
+  c.connected = false;
+  c.subs.clear();
+  c.inbox.clear();
+  s_stats.drops++;
+  if (!c.will_topic.empty()) wills->push_back(Msg{c.will_topic, c.will_msg, c.will_retain});
+}
+
+bool device_publish(int id, const char* topic, const uint8_t* p, size_t len, bool retained) {
+  {
+    std::lock_guard<std::recursive_mutex> lk(s_m);
+    auto it = s_clients.find(id);
+    if (it == s_clients.end() || !it->second.connected) return false;
+    s_stats.publishes++;
+    s_stats.bytes += len;
+  }
+  route(Msg{topic, std::string((const char*)p, len), retained});
+  return true;
+}
+
+}  // namespace
+
+PubSubClient::PubSubClient(WiFiClient&) { setBufferSize(DEFAULT_BUFFER); }
+
+PubSubClient::~PubSubClient() { heap_caps_free(buf_); }
+
+PubSubClient& PubSubClient::setServer(const char*, uint16_t) { return *this; }
+
+PubSubClient& PubSubClient::setCallback(MQTT_CALLBACK_SIGNATURE) {
+  cb_ = callback;
+  return *this;
+}
+
+PubSubClient& PubSubClient::setKeepAlive(uint16_t) { return *this; }
+
+// il buffer sta nell'heap del device: conta nel picco di memoria
+bool PubSubClient::setBufferSize(uint16_t size) {
+  if (!size) return false;
+  uint8_t* nb = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_8BIT);
+  if (!nb) return false;
+  heap_caps_free(buf_);
+  buf_ = nb;
+  buf_size_ = size;
+  return true;
+}
+
+bool PubSubClient::connect(const char*, const char*, const char*, const char* will_topic, uint8_t,
+                           bool will_retain, const char* will_msg) {
+  std::vector<Msg> wills;
+  bool ok;
+  {
+    std::lock_guard<std::recursive_mutex> lk(s_m);
+    if (id_ >= 0) drop_locked(id_, &wills);
+    ok = s_up && WiFi.isConnected();
+    if (ok) {
+      if (id_ < 0) id_ = s_next_client++;
+      Client& c = s_clients[id_];
+      c = Client();
+      c.connected = true;
+      c.will_topic = will_topic ? will_topic : "";
+      c.will_msg = will_msg ? will_msg : "";
+      c.will_retain = will_retain;
+      s_stats.connects++;
+    }
+  }
+  for (const Msg& m : wills) route(m);
+  state_ = ok ? MQTT_CONNECTED : MQTT_CONNECT_FAILED;
+  return ok;
+}
+
+bool PubSubClient::connected() {
+  std::vector<Msg> wills;
+  bool c;
+  {
+    std::lock_guard<std::recursive_mutex> lk(s_m);
+    if (id_ < 0) return false;
+    // Wi-Fi giù: il TCP cade e il broker se ne accorge
+    if (!WiFi.isConnected()) drop_locked(id_, &wills);
+    c = s_clients[id_].connected;
+  }
+  for (const Msg& m : wills) route(m);
+  if (!c && state_ == MQTT_CONNECTED) state_ = MQTT_CONNECTION_LOST;
+  return c;
+}
+
+int PubSubClient::state() {
+  connected();
+  return state_;
+}
+
+bool PubSubClient::loop() {
+  if (!connected()) return false;
+  Msg m;
+  {
+    std::lock_guard<std::recursive_mutex> lk(s_m);
+    Client& c = s_clients[id_];
+    if (c.inbox.empty()) return true;
+    m = c.inbox.front();
+    c.inbox.pop_front();
+  }
+  // pacchetto più grande del buffer: PubSubClient lo scarta
+  if (MQTT_MAX_HEADER_SIZE + 2 + m.topic.size() + m.payload.size() > buf_size_ || !cb_) return true;
+  // topic e payload stanno nello stesso buffer della libreria
+  std::string t = m.topic;
+  memcpy(buf_, m.payload.data(), m.payload.size());
+  cb_(&t[0], buf_, (unsigned)m.payload.size());
+  return true;
+}
+
+bool PubSubClient::publish(const char* topic, const char* payload, bool retained) {
+  return publish(topic, (const uint8_t*)payload, payload ? (unsigned)strlen(payload) : 0, retained);
+}
+
+bool PubSubClient::publish(const char* topic, const char* payload) { return publish(topic, payload, false); }
+
+bool PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int len, bool retained) {
+  if (!topic || !connected()) return false;
+  if (MQTT_MAX_HEADER_SIZE + 2 + strlen(topic) + len > buf_size_) {
+    std::lock_guard<std::recursive_mutex> lk(s_m);
+    s_stats.rejected++;
+    return false;
+  }
+  return device_publish(id_, topic, payload, len, retained);
+}
+
+bool PubSubClient::subscribe(const char* filter) {
+  if (!filter || !connected()) return false;
+  std::lock_guard<std::recursive_mutex> lk(s_m);
+  Client& c = s_clients[id_];
+  c.subs.push_back(filter);
+  for (auto& kv : s_retained) {
+    if (topic_match(filter, kv.first)) c.inbox.push_back(Msg{kv.first, kv.second, true});
+  }
+  return true;
+}
+
+void PubSubClient::disconnect() {
+  std::lock_guard<std::recursive_mutex> lk(s_m);
+  if (id_ >= 0) {
+    Client& c = s_clients[id_];
+    c.connected = false;   // DISCONNECT pulito: niente will
+    c.subs.clear();
+    c.inbox.clear();
+  }
+  state_ = MQTT_DISCONNECTED;
+}
+
+bool PubSubClient::beginPublish(const char* topic, unsigned int len, bool retained) {
+  if (!topic || !connected()) return false;
+  stream_topic_ = topic;
+  stream_.clear();
+  stream_len_ = len;
+  stream_retained_ = retained;
+  return true;
+}
+
+size_t PubSubClient::write(const uint8_t* p, size_t n) {
+  if (stream_topic_.empty()) return 0;
+  stream_.append((const char*)p, n);
+  return n;
+}
+
+int PubSubClient::endPublish() {
+  if (stream_topic_.empty()) return 0;
+  std::string topic;
+  topic.swap(stream_topic_);
+  if (stream_.size() != stream_len_) return 0;   // lunghezza annunciata nell'header
+  return device_publish(id_, topic.c_str(), (const uint8_t*)stream_.data(), stream_.size(), stream_retained_) ? 1 : 0;
+}
+
+// ---- lato test ----
+int sim_broker_subscribe(const char* filter, sim_mqtt_cb_t cb) {
+  std::vector<Msg> retained;
+  int id;
+  {
+    std::lock_guard<std::recursive_mutex> lk(s_m);
+    id = s_next_sub++;
+    s_test_subs[id] = TestSub{filter, cb};
+    for (auto& kv : s_retained) {
+      if (topic_match(filter, kv.first)) retained.push_back(Msg{kv.first, kv.second, true});
+    }
+  }
+  for (const Msg& m : retained) cb(m.topic, m.payload, true);
+  return id;
+}
+
+void sim_broker_unsubscribe(int id) {
+  std::lock_guard<std::recursive_mutex> lk(s_m);
+  s_test_subs.erase(id);
+}
+
+void sim_broker_publish(const char* topic, const std::string& payload, bool retained) {
+  route(Msg{topic, payload, retained});
+}
+
+bool sim_broker_retained(const char* topic, std::string* out) {
+  std::lock_guard<std::recursive_mutex> lk(s_m);
+  auto it = s_retained.find(topic);
+  if (it == s_retained.end()) return false;
+  if (out) *out = it->second;
+  return true;
+}
+
+void sim_broker_drop_all() {
+  std::vector<Msg> wills;
+  {
+    std::lock_guard<std::recursive_mutex> lk(s_m);
+    for (auto& kv : s_clients) drop_locked(kv.first, &wills);
+  }
+  for (const Msg& m : wills) route(m);
+}
+
+void sim_broker_set_up(bool up) {
+  std::lock_guard<std::recursive_mutex> lk(s_m);
+  s_up = up;
+}
+
+void sim_broker_get_stats(sim_broker_stats_t* out) {
+  if (!out) return;
+  std::lock_guard<std::recursive_mutex> lk(s_m);
+  *out = s_stats;
+  out->connected = false;
+  for (auto& kv : s_clients) out->connected |= kv.second.connected;
+}
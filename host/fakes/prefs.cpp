@@ -0,0 +1,102 @@
+// NVS in memoria: namespace -> chiave -> byte. Persiste per tutto il processo.
+#include "Preferences.h"
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+typedef std::map<std::string, std::vector<uint8_t>> Ns;
+std::mutex s_m;
+std::map<std::string, Ns>& store() {
+  static std::map<std::string, Ns> s;
+  return s;
+}
+
+Ns* ns_of(const std::string& name) { return &store()[name]; }
+
+template <class T>
+size_t put(const std::string& ns, bool ro, const char* key, const T& v) {
+  if (ns.empty() || ro || !key) return 0;
+  std::lock_guard<std::mutex> lk(s_m);
+  const uint8_t* p = (const uint8_t*)&v;
+  (*ns_of(ns))[key].assign(p, p + sizeof(T));
+  return sizeof(T);
+}
+
+template <class T>
+T get(const std::string& ns, const char* key, T def) {
+  if (ns.empty() || !key) return def;
+  std::lock_guard<std::mutex> lk(s_m);
+  Ns* n = ns_of(ns);
+  auto it = n->find(key);
+  if (it == n->end() || it->second.size() != sizeof(T)) return def;
+  T v;
+  memcpy(&v, it->second.data(), sizeof(T));
+  return v;
+}
+}  // namespace
+
+bool Preferences::begin(const char* name, bool ro) {
+  if (!name) return false;
+  ns_ = name;
+  ro_ = ro;
+  return true;
+}
+
+void Preferences::end() {
+  ns_.clear();
+  ro_ = true;
+}
+
+size_t Preferences::putInt(const char* k, int32_t v) { return put(ns_, ro_, k, v); }
+int32_t Preferences::getInt(const char* k, int32_t d) { return get(ns_, k, d); }
+size_t Preferences::putUInt(const char* k, uint32_t v) { return put(ns_, ro_, k, v); }
+uint32_t Preferences::getUInt(const char* k, uint32_t d) { return get(ns_, k, d); }
+size_t Preferences::putUChar(const char* k, uint8_t v) { return put(ns_, ro_, k, v); }
+uint8_t Preferences::getUChar(const char* k, uint8_t d) { return get(ns_, k, d); }
+
+size_t Preferences::putBytes(const char* k, const void* v, size_t n) {
+  if (ns_.empty() || ro_ || !k || (!v && n)) return 0;
+  std::lock_guard<std::mutex> lk(s_m);
+  const uint8_t* p = (const uint8_t*)v;
+  (*ns_of(ns_))[k].assign(p, p + n);
+  return n;
+}
+
+size_t Preferences::getBytes(const char* k, void* out, size_t n) {
+  if (ns_.empty() || !k) return 0;
+  std::lock_guard<std::mutex> lk(s_m);
+  Ns* ns = ns_of(ns_);
+  auto it = ns->find(k);
+  if (it == ns->end() || it->second.size() > n) return 0;
+  memcpy(out, it->second.data(), it->second.size());
+  return it->second.size();
+}
+
+size_t Preferences::putString(const char* k, const char* v) {
+  return putBytes(k, v ? v : "", v ? strlen(v) + 1 : 1);
+}
+
+String Preferences::getString(const char* k, const String& d) {
+  if (ns_.empty() || !k) return d;
+  std::lock_guard<std::mutex> lk(s_m);
+  Ns* ns = ns_of(ns_);
+  auto it = ns->find(k);
+  if (it == ns->end() || it->second.empty()) return d;
+  return String((const char*)it->second.data());
+}
+
+bool Preferences::remove(const char* k) {
+  if (ns_.empty() || ro_ || !k) return false;
+  std::lock_guard<std::mutex> lk(s_m);
+  return ns_of(ns_)->erase(k) > 0;
+}
+
+bool Preferences::isKey(const char* k) {
+  if (ns_.empty() || !k) return false;
+  std::lock_guard<std::mutex> lk(s_m);
+  Ns* ns = ns_of(ns_);
+  return ns->find(k) != ns->end();
+}
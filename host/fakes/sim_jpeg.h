@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Codec JPEG baseline del simulatore (camera, img_converters).
+// Encoder YCbCr 4:2:0 con le tabelle standard (Annex K); decoder baseline
+// Huffman con qualsiasi campionamento fino a 2x2, restart interval e scala
+// 1/1, 1/2, 1/4, 1/8 (1/8 = solo coefficienti DC, come tjpgd).
+
+// quality 1..100 (scala IJG)
+bool sim_jpeg_encode(const uint8_t* rgb888, int w, int h, int quality, std::vector<uint8_t>& out);
+
+// Dimensioni dal SOF
+bool sim_jpeg_size(const uint8_t* src, size_t len, int* w, int* h);
+
+// RGB888 di (w >> shift) x (h >> shift), shift 0..3
+bool sim_jpeg_decode(const uint8_t* src, size_t len, int shift, std::vector<uint8_t>& rgb888, int* ow, int* oh);
+
+// Qualità sensore esp32-camera (10..63, più basso = meglio) in scala IJG
+int  sim_jpeg_quality_from_sensor(int q);
@@ -0,0 +1,94 @@
+// Wi-Fi simulato: l'associazione riesce sempre dopo JOIN_MS, IP di loopback
+// (i client di test si collegano a 127.0.0.1). Modalità power-save e
+// listen interval registrati per gli scenari.
+#include "WiFi.h"
+#include "esp_wifi.h"
+
+#include <mutex>
+
+namespace {
+const uint32_t JOIN_MS = 30;
+std::mutex s_m;
+bool       s_begun = false;
+uint32_t   s_begin_ms = 0;
+int32_t    s_channel = 6;
+uint8_t    s_bssid[6] = {0x02, 0xB1, 0xDC, 0xA7, 0x00, 0x01};
+wifi_ps_type_t s_ps = WIFI_PS_MIN_MODEM;
+wifi_config_t  s_cfg = {};
+}  // namespace
+
+WiFiClass WiFi;
+
+bool WiFiClass::mode(int) { return true; }
+
+wl_status_t WiFiClass::begin(const char*, const char*, int32_t channel, const uint8_t*, bool) {
+  std::lock_guard<std::mutex> lk(s_m);
+  s_begun = true;
+  s_begin_ms = millis();
+  if (channel) s_channel = channel;
+  return WL_DISCONNECTED;
+}
+
+bool WiFiClass::config(IPAddress, IPAddress, IPAddress, IPAddress, IPAddress) { return true; }
+
+wl_status_t WiFiClass::status() { return isConnected() ? WL_CONNECTED : WL_DISCONNECTED; }
+
+bool WiFiClass::isConnected() {
+  std::lock_guard<std::mutex> lk(s_m);
+  return s_begun && millis() - s_begin_ms >= JOIN_MS;
+}
+
+IPAddress WiFiClass::localIP() { return isConnected() ? IPAddress(127, 0, 0, 1) : IPAddress(); }
+int8_t WiFiClass::RSSI() { return isConnected() ? -58 : 0; }
+int32_t WiFiClass::channel() { return s_channel; }
+uint8_t* WiFiClass::BSSID() { return isConnected() ? s_bssid : nullptr; }
+String WiFiClass::SSID() { return String("birdcam-sim"); }
+String WiFiClass::macAddress() { return String("11:22:33:44:55:66"); }
+
+bool WiFiClass::setSleep(bool on) { return setSleep(on ? WIFI_PS_MIN_MODEM : WIFI_PS_NONE); }
+bool WiFiClass::setSleep(wifi_ps_type_t ps) { return esp_wifi_set_ps(ps) == ESP_OK; }
+bool WiFiClass::setAutoReconnect(bool) { return true; }
+
+bool WiFiClass::disconnect(bool) {
+  std::lock_guard<std::mutex> lk(s_m);
+  s_begun = false;
+  return true;
+}
+
+bool WiFiClass::reconnect() {
+  std::lock_guard<std::mutex> lk(s_m);
+  s_begun = true;
+  s_begin_ms = millis();
+  return true;
+}
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t ps) {
+  std::lock_guard<std::mutex> lk(s_m);
+  s_ps = ps;
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_ps(wifi_ps_type_t* ps) {
+  if (!ps) return ESP_ERR_INVALID_ARG;
+  std::lock_guard<std::mutex> lk(s_m);
+  *ps = s_ps;
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_config(wifi_interface_t, wifi_config_t* c) {
+  if (!c) return ESP_ERR_INVALID_ARG;
+  std::lock_guard<std::mutex> lk(s_m);
+  *c = s_cfg;
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t, wifi_config_t* c) {
+  if (!c) return ESP_ERR_INVALID_ARG;
+  std::lock_guard<std::mutex> lk(s_m);
+  s_cfg = *c;
+  return ESP_OK;
+}
+
+// WiFiClient: il trasporto MQTT è il broker in-process (mqtt.cpp)
+int WiFiClient::connect(const char*, uint16_t) { return WiFi.isConnected() ? 1 : 0; }
+bool WiFiClient::connected() { return WiFi.isConnected(); }
@@ -0,0 +1,470 @@
+// Scenari di carico sul firmware simulato. Ogni scenario avvia il firmware
+// nel processo, lo carica con client veri via socket (e col broker/PIR
+// simulati), stampa le metriche in JSON e le confronta con la baseline:
+//   birdcam_load <scenario> [--baseline FILE] [--update-baseline] [--replay DIR]
+// Exit 0 = in linea con la baseline, 1 = regressione, 2 = errore di setup.
+#include "client.h"
+#include "report.h"
+#include "sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double ms_since(Clock::time_point t0) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+void sleep_ms(int ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+const int MJPEG_CLIENTS = 4;       // MAX_STREAM_CLIENTS in app_httpd.cpp
+const int MJPEG_FPS = 5;
+const int MJPEG_SECONDS = 6;
+
+const int CHURN_STEADY = 2;        // stream che restano aperti
+const int CHURN_THREADS = 2;       // client che aprono, leggono 2 frame e chiudono
+const int CHURN_SECONDS = 8;
+
+const int SNAP_THREADS = 8;
+const int SNAP_SECONDS = 5;
+
+const int PIR_SECONDS = 10;
+const int PIR_PERIOD_MS = 700;
+const int PIR_HIGH_MS = 120;
+
+const int MQTT_CYCLES = 4;
+const int MQTT_DOWN_MS = 2000;
+
+// ---------------- N client MJPEG concorrenti ----------------
+// Ognuno chiede 5 fps (il default): 20 fps in tutto, sotto i 25 del sensore,
+// quindi nessun client deve restare indietro. Uno oltre MAX_STREAM_CLIENTS va rifiutato.
+void scenario_mjpeg_clients(Report* r) {
+  std::vector<Samples> gaps(MJPEG_CLIENTS);
+  std::vector<int> frames(MJPEG_CLIENTS, 0);
+  std::atomic<int> open_ok{0}, errors{0};
+  std::atomic<bool> stop{false};
+  std::vector<std::thread> th;
+  char path[48];
+  snprintf(path, sizeof(path), "/mjpeg?fps=%d", MJPEG_FPS);
+
+  for (int i = 0; i < MJPEG_CLIENTS; i++) {
+    th.emplace_back([&, i] {
+      MjpegReader rd;
+      if (!rd.open(sim_http_port(), path)) {
+        errors++;
+        return;
+      }
+      open_ok++;
+      std::string jpg;
+      Clock::time_point last = Clock::now();
+      bool first = true;
+      while (!stop && rd.next(&jpg)) {
+        if (jpg.size() < 4 || (uint8_t)jpg[0] != 0xFF || (uint8_t)jpg[1] != 0xD8) errors++;
+        if (!first) gaps[i].add(ms_since(last));
+        first = false;
+        last = Clock::now();
+        frames[i]++;
+      }
+      if (!stop) errors++;
+    });
+  }
+  while (open_ok + errors < MJPEG_CLIENTS) sleep_ms(10);
+
+  MjpegReader extra;
+  bool extra_refused = !extra.open(sim_http_port(), path) && extra.status() >= 500;
+  extra.close();
+
+  Clock::time_point t0 = Clock::now();
+  sleep_ms(MJPEG_SECONDS * 1000);
+  stop = true;
+  double secs = ms_since(t0) / 1000.0;
+  for (auto& t : th) t.join();
+
+  Samples gap;
+  int total = 0, min_frames = frames[0];
+  for (int i = 0; i < MJPEG_CLIENTS; i++) {
+    gap.add(gaps[i]);
+    total += frames[i];
+    if (frames[i] < min_frames) min_frames = frames[i];
+  }
+  r->add("fps_total", total / secs, "higher", 0.2, 0, "fps");
+  r->add("fps_min_client", min_frames / secs, "higher", 0.3, 0, "fps");
+  r->add_latency("frame_gap", gap, 0.5, 20);
+  r->add("extra_client_refused", extra_refused ? 1 : 0, "higher", 0, 0, "bool");
+  r->add("errors", errors.load(), "lower", 0, 0, "n");
+  r->add_peak_memory(0.15);
+}
+
+// ---------------- client MJPEG che entrano ed escono ----------------
+// Due stream fissi mentre altri due client aprono e chiudono /mjpeg in
+// continuazione: chi esce non deve fermare gli altri, e con uno stream
+// aperto il loop non pubblica lo stream MQTT (riprende quando chiudono).
+void scenario_mjpeg_churn(Report* r) {
+  std::atomic<int> mqtt_frames{0};
+  int sub = sim_broker_subscribe(SIM_BASE_TOPIC "/cam/stream", [&](const std::string&, const std::string&, bool) {
+    mqtt_frames++;
+  });
+
+  std::vector<Samples> gaps(CHURN_STEADY);
+  std::vector<int> frames(CHURN_STEADY, 0);
+  std::atomic<int> steady_open{0}, steady_dropped{0}, errors{0};
+  std::atomic<int> opens{0}, busy{0};
+  std::atomic<bool> stop{false};
+  std::vector<std::thread> th;
+  for (int i = 0; i < CHURN_STEADY; i++) {
+    th.emplace_back([&, i] {
+      MjpegReader rd;
+      if (!rd.open(sim_http_port(), "/mjpeg?fps=5")) {
+        errors++;
+        return;
+      }
+      steady_open++;
+      std::string jpg;
+      Clock::time_point last = Clock::now();
+      bool first = true;
+      while (!stop && rd.next(&jpg)) {
+        if (!first) gaps[i].add(ms_since(last));
+        first = false;
+        last = Clock::now();
+        frames[i]++;
+      }
+      if (!stop) steady_dropped++;
+    });
+  }
+  while (steady_open + errors < CHURN_STEADY) sleep_ms(10);
+
+  Clock::time_point t0 = Clock::now();
+  for (int i = 0; i < CHURN_THREADS; i++) {
+    th.emplace_back([&] {
+      while (!stop) {
+        MjpegReader rd;
+        if (!rd.open(sim_http_port(), "/mjpeg?fps=5")) {
+          // slot o worker non ancora liberati dal client precedente
+          if (rd.status() >= 500) busy++;
+          else errors++;
+          sleep_ms(100);
+          continue;
+        }
+        opens++;
+        std::string jpg;
+        for (int k = 0; k < 2 && rd.next(&jpg); k++) {}
+      }
+    });
+  }
+  sleep_ms(1500);                  // un eventuale invio già partito
+  int mqtt_before = mqtt_frames;
+  sleep_ms(CHURN_SECONDS * 1000 - 1500);
+  int mqtt_during = mqtt_frames - mqtt_before;
+  stop = true;
+  double secs = ms_since(t0) / 1000.0;
+  for (auto& t : th) t.join();
+
+  // tutti chiusi: lo stream MQTT (1 al secondo) riparte
+  int mqtt_after0 = mqtt_frames;
+  for (int k = 0; k < 50 && mqtt_frames == mqtt_after0; k++) sleep_ms(100);
+  bool resumed = mqtt_frames > mqtt_after0;
+  sim_broker_unsubscribe(sub);
+
+  Samples gap;
+  int min_frames = frames[0];
+  for (int i = 0; i < CHURN_STEADY; i++) {
+    gap.add(gaps[i]);
+    if (frames[i] < min_frames) min_frames = frames[i];
+  }
+  r->add("steady_fps_min", min_frames / secs, "higher", 0.3, 0, "fps");
+  r->add_latency("steady_gap", gap, 0.5, 20);
+  r->add("steady_dropped", steady_dropped.load(), "lower", 0, 0, "n");
+  r->add("churn_opens_per_s", opens / secs, "higher", 0.5, 0, "1/s");
+  r->add("churn_busy", busy.load(), "lower", 1.0, 20, "n");
+  r->add("errors", errors.load(), "lower", 0, 0, "n");
+  r->add("mqtt_stream_during", mqtt_during, "lower", 0, 0, "n");
+  r->add("mqtt_stream_resumed", resumed ? 1 : 0, "higher", 0, 0, "bool");
+  r->add_peak_memory(0.15);
+}
+
+// ---------------- tempesta di /snapshot ----------------
+void scenario_snapshot_storm(Report* r) {
+  std::vector<Samples> lat(SNAP_THREADS);
+  std::atomic<int> ok{0}, errors{0};
+  std::atomic<bool> stop{false};
+  std::vector<std::thread> th;
+  Clock::time_point t0 = Clock::now();
+  for (int i = 0; i < SNAP_THREADS; i++) {
+    th.emplace_back([&, i] {
+      while (!stop) {
+        http_resp_t resp;
+        Clock::time_point t = Clock::now();
+        bool got = http_get(sim_http_port(), "/snapshot", &resp);
+        double ms = ms_since(t);
+        if (got && resp.status == 200 && resp.body.size() > 4 && (uint8_t)resp.body[0] == 0xFF) {
+          ok++;
+          lat[i].add(ms);
+        } else {
+          errors++;
+        }
+      }
+    });
+  }
+  sleep_ms(SNAP_SECONDS * 1000);
+  stop = true;
+  for (auto& t : th) t.join();
+  double secs = ms_since(t0) / 1000.0;
+
+  Samples all;
+  for (auto& s : lat) all.add(s);
+  r->add("snapshots_per_s", ok / secs, "higher", 0.5, 0, "req/s");
+  r->add_latency("snapshot", all, 0.5, 25);
+  r->add("errors", errors.load(), "lower", 0, 0, "n");
+  r->add_peak_memory(0.15);
+}
+
+// ---------------- PIR a raffica durante i download della galleria ----------------
+// Due client scaricano /archive.tar e /archive.zip in loop mentre il PIR
+// scatta ogni 700 ms: misura PIR -> "<base>/pir ON" e le catture perse.
+void scenario_pir_gallery(Report* r) {
+  std::mutex m;
+  std::vector<Clock::time_point> pulses;
+  size_t matched = 0;
+  Samples notify;
+  int sub = sim_broker_subscribe(SIM_BASE_TOPIC "/pir", [&](const std::string&, const std::string& p, bool) {
+    if (p != "ON") return;
+    std::lock_guard<std::mutex> lk(m);
+    // un ON può coprire più impulsi ravvicinati: vale il più vecchio non servito
+    if (matched < pulses.size()) notify.add(ms_since(pulses[matched]));
+    matched = pulses.size();
+  });
+
+  std::vector<Samples> dl(2);
+  std::atomic<int> dl_errors{0}, dl_busy{0};
+  std::atomic<uint64_t> dl_bytes{0};
+  std::atomic<bool> stop{false};
+  std::vector<std::thread> th;
+  static const char* PATHS[2] = {"/archive.tar", "/archive.zip"};
+  for (int i = 0; i < 2; i++) {
+    th.emplace_back([&, i] {
+      while (!stop) {
+        http_resp_t resp;
+        Clock::time_point t = Clock::now();
+        if (http_get(sim_http_port(), PATHS[i], &resp, 20000) && resp.status == 200) {
+          dl[i].add(ms_since(t));
+          dl_bytes += resp.body.size();
+        } else if (resp.status == 503) {
+          // tutti i worker async occupati: il client riprova (Retry-After ridotto)
+          dl_busy++;
+          sleep_ms(50);
+        } else {
+          dl_errors++;
+          sleep_ms(50);
+        }
+      }
+    });
+  }
+
+  http_resp_t before;
+  http_get(sim_http_port(), "/photo", &before);
+
+  Clock::time_point t0 = Clock::now();
+  int n_pulses = 0;
+  while (ms_since(t0) < PIR_SECONDS * 1000) {
+    {
+      std::lock_guard<std::mutex> lk(m);
+      pulses.push_back(Clock::now());
+    }
+    sim_set_pir(true);
+    n_pulses++;
+    sleep_ms(PIR_HIGH_MS);
+    sim_set_pir(false);
+    sleep_ms(PIR_PERIOD_MS - PIR_HIGH_MS);
+  }
+  sleep_ms(1000);
+  stop = true;
+  for (auto& t : th) t.join();
+  double secs = ms_since(t0) / 1000.0;
+  sim_broker_unsubscribe(sub);
+
+  // catture archiviate durante lo scenario: id dell'ultima su /photo
+  http_resp_t after;
+  http_get(sim_http_port(), "/photo", &after);
+  auto newest = [](const http_resp_t& h) {
+    size_t p = h.body.find("SNAPSHOT #");
+    return p == std::string::npos ? 0L : atol(h.body.c_str() + p + 10);
+  };
+  long captures = newest(after) - newest(before);
+
+  Samples dls;
+  dls.add(dl[0]);
+  dls.add(dl[1]);
+  std::lock_guard<std::mutex> lk(m);
+  r->add_latency("pir_notify", notify, 0.5, 60);
+  r->add("capture_ratio", n_pulses ? (double)captures / n_pulses : 0, "higher", 0.15, 0, "ratio");
+  r->add("download_mb_per_s", dl_bytes / secs / (1024.0 * 1024.0), "higher", 0.35, 0, "MB/s");
+  r->add_latency("download", dls, 0.75, 50);
+  r->add("download_busy_503", dl_busy.load(), "lower", 1.0, 40, "n");
+  r->add("download_errors", dl_errors.load(), "lower", 0, 0, "n");
+  r->add_peak_memory(0.15);
+}
+
+// ---------------- tempesta di riconnessioni MQTT ----------------
+// Il broker chiude la sessione a intervalli casuali (e una volta resta giù
+// per 2 s): tempo fino a "online" di nuovo, comandi dopo la riconnessione,
+// memoria interna che non cresce.
+void scenario_mqtt_reconnect(Report* r) {
+  std::mutex m;
+  std::vector<std::string> status;   // payload su <base>/status in ordine
+  std::string ctrl_state;
+  int s1 = sim_broker_subscribe(SIM_BASE_TOPIC "/status", [&](const std::string&, const std::string& p, bool) {
+    std::lock_guard<std::mutex> lk(m);
+    status.push_back(p);
+  });
+  int s2 = sim_broker_subscribe(SIM_BASE_TOPIC "/ctrl/brightness", [&](const std::string&, const std::string& p, bool) {
+    std::lock_guard<std::mutex> lk(m);
+    ctrl_state = p;
+  });
+  auto wait_for = [&](std::function<bool()> pred, int timeout_ms) {
+    Clock::time_point t = Clock::now();
+    while (ms_since(t) < timeout_ms) {
+      {
+        std::lock_guard<std::mutex> lk(m);
+        if (pred()) return true;
+      }
+      sleep_ms(5);
+    }
+    return false;
+  };
+
+  size_t internal_before = sim_heap_used(SIM_POOL_INTERNAL);
+  std::mt19937 rng(38);
+  Samples reconnect, command;
+  int failures = 0, wills = 0;
+  for (int c = 0; c < MQTT_CYCLES + 1; c++) {
+    sleep_ms(200 + (int)(rng() % 1300));
+    size_t mark;
+    {
+      std::lock_guard<std::mutex> lk(m);
+      mark = status.size();
+    }
+    bool down = c == MQTT_CYCLES;   // ultimo giro: broker giù per un po'
+    if (down) sim_broker_set_up(false);
+    Clock::time_point t0 = Clock::now();
+    sim_broker_drop_all();
+    if (down) {
+      sleep_ms(MQTT_DOWN_MS);
+      sim_broker_set_up(true);
+    }
+    // will "offline" poi di nuovo "online"
+    bool back = wait_for([&] {
+      bool off = false;
+      for (size_t i = mark; i < status.size(); i++) {
+        if (status[i] == "offline") off = true;
+        else if (off && status[i] == "online") return true;
+      }
+      return false;
+    }, 12000);
+    if (!back) {
+      failures++;
+      continue;
+    }
+    reconnect.add(ms_since(t0));
+    wills++;
+
+    // un comando dopo la riconnessione deve tornare come stato retained
+    // brightness -2..2: a giri alterni, diverso dallo stato appena ripubblicato
+    const char* val = c % 2 ? "1" : "-1";
+    Clock::time_point tc = Clock::now();
+    sim_broker_publish(SIM_BASE_TOPIC "/ctrl/brightness/set", val, false);
+    if (wait_for([&] { return ctrl_state == val; }, 3000)) command.add(ms_since(tc));
+    else failures++;
+  }
+  sim_broker_unsubscribe(s1);
+  sim_broker_unsubscribe(s2);
+  double growth_kb = ((double)sim_heap_used(SIM_POOL_INTERNAL) - (double)internal_before) / 1024.0;
+
+  // il retry del firmware è ogni 5 s: la latenza di riconnessione lo segue
+  r->add_latency("reconnect", reconnect, 0.25, 300);
+  r->add_latency("command", command, 0.5, 100);
+  r->add("wills_seen", wills, "higher", 0, 0, "n");
+  r->add("failures", failures, "lower", 0, 0, "n");
+  r->add("internal_growth_kb", growth_kb, "lower", 0, 4, "KB");
+  r->add_peak_memory(0.15);
+}
+
+struct Scenario {
+  const char* name;
+  void (*run)(Report*);
+};
+
+const Scenario SCENARIOS[] = {
+  {"mjpeg_clients",  scenario_mjpeg_clients},
+  {"mjpeg_churn",    scenario_mjpeg_churn},
+  {"snapshot_storm", scenario_snapshot_storm},
+  {"pir_gallery",    scenario_pir_gallery},
+  {"mqtt_reconnect", scenario_mqtt_reconnect},
+};
+
+void usage() {
+  fprintf(stderr, "usage: birdcam_load <scenario> [--baseline FILE] [--update-baseline] [--replay DIR]\nscenari:");
+  for (const Scenario& s : SCENARIOS) fprintf(stderr, " %s", s.name);
+  fprintf(stderr, "\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    usage();
+    return 2;
+  }
+  const Scenario* sc = nullptr;
+  for (const Scenario& s : SCENARIOS) if (!strcmp(argv[1], s.name)) sc = &s;
+  if (!sc) {
+    usage();
+    return 2;
+  }
+  std::string baseline;
+  bool update = false;
+  for (int i = 2; i < argc; i++) {
+    if (!strcmp(argv[i], "--baseline") && i + 1 < argc) baseline = argv[++i];
+    else if (!strcmp(argv[i], "--update-baseline")) update = true;
+    else if (!strcmp(argv[i], "--replay") && i + 1 < argc) {
+      if (!sim_camera_replay(argv[++i], 0)) {
+        fprintf(stderr, "nessun JPEG baseline in %s\n", argv[i]);
+        return 2;
+      }
+    } else {
+      usage();
+      return 2;
+    }
+  }
+
+  sim_set_http_port(0);
+  if (!sim_boot_online(10000)) {
+    fprintf(stderr, "%s: il firmware non è online\n", sc->name);
+    sim_exit(2);
+  }
+  sleep_ms(500);   // primi publish retained e prima cattura fuori dalla misura
+  sim_heap_reset_peak();
+
+  Report rep(sc->name);
+  sc->run(&rep);
+  rep.print();
+
+  int rc = 0;
+  if (!baseline.empty()) {
+    if (update) rc = rep.write(baseline) ? 0 : 2;
+    else rc = rep.check(baseline) ? 1 : 0;
+  }
+  // i task del firmware non terminano: niente distruttori statici
+  sim_exit(rc);
+}
@@ -0,0 +1,230 @@
+#include "client.h"
+#include "sim.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+int64_t now_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+bool wait_readable(int fd, int timeout_ms) {
+  pollfd p = {fd, POLLIN, 0};
+  return poll(&p, 1, timeout_ms) > 0;
+}
+
+bool send_all(int fd, const std::string& s) {
+  size_t off = 0;
+  while (off < s.size()) {
+    ssize_t n = send(fd, s.data() + off, s.size() - off, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    off += (size_t)n;
+  }
+  return true;
+}
+
+// da "raw" toglie il chunked in "out"; false se servono altri byte
+bool dechunk_step(std::string& raw, std::string& out, bool* done) {
+  size_t crlf = raw.find("\r\n");
+  if (crlf == std::string::npos) return false;
+  size_t len = strtoul(raw.c_str(), nullptr, 16);
+  if (len == 0) {
+    if (raw.size() < crlf + 4) return false;
+    raw.erase(0, crlf + 4);
+    *done = true;
+    return true;
+  }
+  if (raw.size() < crlf + 2 + len + 2) return false;
+  out.append(raw, crlf + 2, len);
+  raw.erase(0, crlf + 2 + len + 2);
+  return true;
+}
+
+}  // namespace
+
+bool sim_boot_online(int timeout_ms) {
+  sim_boot();
+  int64_t deadline = now_ms() + timeout_ms;
+  while (now_ms() < deadline) {
+    sim_broker_stats_t st;
+    sim_broker_get_stats(&st);
+    if (st.connected && sim_http_port()) return true;
+    usleep(20000);
+  }
+  return false;
+}
+
+int sim_tcp_connect(uint16_t port, int timeout_ms) {
+  int64_t deadline = now_ms() + timeout_ms;
+  for (;;) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in a = {};
+    a.sin_family = AF_INET;
+    a.sin_port = htons(port);
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr*)&a, sizeof(a)) == 0) {
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      return fd;
+    }
+    close(fd);
+    if (now_ms() >= deadline) return -1;
+    usleep(10000);
+  }
+}
+
+void sim_sock_set_rcvbuf(int fd, int bytes) { setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes)); }
+
+std::string http_header(const http_resp_t& r, const char* name) {
+  size_t nl = strlen(name);
+  size_t pos = 0;
+  while ((pos = r.headers.find("\r\n", pos)) != std::string::npos) {
+    pos += 2;
+    if (r.headers.size() > pos + nl && r.headers[pos + nl] == ':' &&
+        strncasecmp(r.headers.c_str() + pos, name, nl) == 0) {
+      size_t v = pos + nl + 1;
+      while (v < r.headers.size() && r.headers[v] == ' ') v++;
+      size_t e = r.headers.find("\r\n", v);
+      return r.headers.substr(v, e == std::string::npos ? std::string::npos : e - v);
+    }
+  }
+  return std::string();
+}
+
+bool http_get(uint16_t port, const std::string& path, http_resp_t* out, int timeout_ms) {
+  out->status = 0;
+  out->headers.clear();
+  out->body.clear();
+  int64_t deadline = now_ms() + timeout_ms;
+  int fd = sim_tcp_connect(port, timeout_ms);
+  if (fd < 0) return false;
+  std::string req = "GET " + path + " HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n";
+  std::string raw;
+  bool ok = send_all(fd, req);
+  char buf[16384];
+  size_t hdr_end = std::string::npos;
+  bool chunked = false, done = false;
+  size_t clen = 0;
+  bool has_clen = false;
+  while (ok && !done) {
+    int left = (int)(deadline - now_ms());
+    if (left <= 0 || !wait_readable(fd, left)) {
+      ok = false;
+      break;
+    }
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      // fine connessione: valida solo se il corpo non aveva una lunghezza
+      done = hdr_end != std::string::npos && !chunked && !has_clen;
+      ok = done;
+      break;
+    }
+    raw.append(buf, (size_t)n);
+    if (hdr_end == std::string::npos) {
+      hdr_end = raw.find("\r\n\r\n");
+      if (hdr_end == std::string::npos) continue;
+      out->headers = raw.substr(0, hdr_end);
+      raw.erase(0, hdr_end + 4);
+      out->status = atoi(out->headers.c_str() + 9);
+      chunked = strcasecmp(http_header(*out, "Transfer-Encoding").c_str(), "chunked") == 0;
+      std::string cl = http_header(*out, "Content-Length");
+      has_clen = !cl.empty();
+      clen = strtoul(cl.c_str(), nullptr, 10);
+    }
+    if (chunked) {
+      while (!done && dechunk_step(raw, out->body, &done)) {}
+    } else {
+      out->body += raw;
+      raw.clear();
+      if (has_clen && out->body.size() >= clen) done = true;
+    }
+  }
+  close(fd);
+  if (!ok) out->status = out->status ? out->status : 0;
+  return ok;
+}
+
+MjpegReader::~MjpegReader() { close(); }
+
+void MjpegReader::close() {
+  if (fd_ >= 0) ::close(fd_);
+  fd_ = -1;
+}
+
+bool MjpegReader::fill(int timeout_ms) {
+  if (eof_ || !wait_readable(fd_, timeout_ms)) return false;
+  char buf[16384];
+  // limitato: una fetta ogni 50 ms, il resto resta nel buffer del kernel
+  size_t want = rate_ > 0 ? std::min(sizeof(buf), (size_t)std::max(1, rate_ / 20)) : sizeof(buf);
+  ssize_t n = recv(fd_, buf, want, 0);
+  if (n <= 0) {
+    eof_ = true;
+    return false;
+  }
+  raw_.append(buf, (size_t)n);
+  if (rate_ > 0) usleep(50000);
+  return true;
+}
+
+bool MjpegReader::open(uint16_t port, const std::string& path, int timeout_ms) {
+  int64_t deadline = now_ms() + timeout_ms;
+  fd_ = sim_tcp_connect(port, timeout_ms);
+  if (fd_ < 0) return false;
+  if (!send_all(fd_, "GET " + path + " HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n")) return false;
+  size_t e;
+  while ((e = raw_.find("\r\n\r\n")) == std::string::npos) {
+    int left = (int)(deadline - now_ms());
+    if (left <= 0 || !fill(left)) return false;
+  }
+  status_ = atoi(raw_.c_str() + 9);
+  raw_.erase(0, e + 4);
+  return status_ == 200;
+}
+
+bool MjpegReader::dechunk(int timeout_ms, size_t need) {
+  int64_t deadline = now_ms() + timeout_ms;
+  bool done = false;
+  while (body_.size() < need) {
+    while (!done && dechunk_step(raw_, body_, &done)) {}
+    if (done) return body_.size() >= need;
+    if (body_.size() >= need) break;
+    int left = (int)(deadline - now_ms());
+    if (left <= 0 || !fill(left)) return false;
+  }
+  return true;
+}
+
+bool MjpegReader::next(std::string* jpeg, int timeout_ms) {
+  int64_t deadline = now_ms() + timeout_ms;
+  // "\r\n--boundary\r\nContent-Type: ...\r\nContent-Length: N\r\n\r\n" + N byte
+  size_t he;
+  while ((he = body_.find("\r\n\r\n", 2)) == std::string::npos) {
+    int left = (int)(deadline - now_ms());
+    if (left <= 0 || !dechunk(left, body_.size() + 1)) return false;
+  }
+  size_t cl = body_.find("Content-Length:");
+  if (cl == std::string::npos || cl > he) return false;
+  size_t len = strtoul(body_.c_str() + cl + 15, nullptr, 10);
+  size_t start = he + 4;
+  int left = (int)(deadline - now_ms());
+  if (left <= 0 || !dechunk(left, start + len)) return false;
+  if (jpeg) jpeg->assign(body_, start, len);
+  body_.erase(0, start + len);
+  return true;
+}
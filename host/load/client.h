@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+// Client HTTP minimi per gli scenari e i test (solo 127.0.0.1, bloccanti).
+
+// ESP.getEfuseMac() simulato -> id del device e topic base
+#define SIM_BASE_TOPIC "birdcam/665544332211"
+
+// sim_boot() e attesa di httpd + MQTT; false se non arriva entro timeout
+bool sim_boot_online(int timeout_ms);
+
+int  sim_tcp_connect(uint16_t port, int timeout_ms);
+void sim_sock_set_rcvbuf(int fd, int bytes);
+
+struct http_resp_t {
+  int         status;       // 0 = errore di trasporto
+  std::string headers;      // riga di stato + header, senza la riga vuota
+  std::string body;         // già decodificato se chunked
+};
+
+// GET (Connection: close) con corpo letto fino alla fine
+bool http_get(uint16_t port, const std::string& path, http_resp_t* out, int timeout_ms = 10000);
+std::string http_header(const http_resp_t& r, const char* name);
+
+// Lettore di /mjpeg: decodifica il chunked e separa le parti multipart
+class MjpegReader {
+ public:
+  ~MjpegReader();
+  // false se la risposta non è 200 (status() dice quale)
+  bool open(uint16_t port, const std::string& path, int timeout_ms = 5000);
+  // prossimo JPEG; false a fine stream o timeout
+  bool next(std::string* jpeg, int timeout_ms = 5000);
+  // lettore lento: al massimo bytes_per_s dal socket (0 = senza limite)
+  void throttle(int bytes_per_s) { rate_ = bytes_per_s; }
+  int  status() const { return status_; }
+  int  fd() const { return fd_; }
+  void close();
+
+ private:
+  bool fill(int timeout_ms);          // legge dal socket in raw_
+  bool dechunk(int timeout_ms, size_t need);
+
+  int         fd_ = -1;
+  int         status_ = 0;
+  std::string raw_;                   // byte dal socket
+  std::string body_;                  // corpo de-chunked
+  bool        eof_ = false;
+  int         rate_ = 0;
+};
@@ -0,0 +1,160 @@
+#include "report.h"
+#include "sim.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+double Samples::pct(double p) const {
+  if (v_.empty()) return 0;
+  std::vector<double> s(v_);
+  std::sort(s.begin(), s.end());
+  // nearest-rank
+  size_t k = (size_t)ceil(p / 100.0 * (double)s.size());
+  return s[k ? k - 1 : 0];
+}
+
+double Samples::max() const { return v_.empty() ? 0 : *std::max_element(v_.begin(), v_.end()); }
+
+void Report::add(const char* name, double value, const char* better, double tolerance, double slack, const char* unit) {
+  m_.push_back(Metric{name, better, unit, value, tolerance, slack});
+}
+
+void Report::add_latency(const char* name, const Samples& s, double tolerance, double slack) {
+  static const double P[] = {50, 95, 99};
+  for (double p : P) {
+    char n[64];
+    snprintf(n, sizeof(n), "%s_p%d", name, (int)p);
+    add(n, s.pct(p), "lower", tolerance, slack, "ms");
+  }
+}
+
+void Report::add_peak_memory(double tolerance) {
+  add("peak_internal_kb", sim_heap_peak(SIM_POOL_INTERNAL) / 1024.0, "lower", tolerance, 8, "KB");
+  add("peak_psram_kb", sim_heap_peak(SIM_POOL_PSRAM) / 1024.0, "lower", tolerance, 64, "KB");
+}
+
+void Report::print() const {
+  printf("{\n  \"scenario\": \"%s\",\n  \"metrics\": {\n", scenario_.c_str());
+  for (size_t i = 0; i < m_.size(); i++) {
+    printf("    \"%s\": %.2f%s\n", m_[i].name.c_str(), m_[i].value, i + 1 < m_.size() ? "," : "");
+  }
+  printf("  }\n}\n");
+}
+
+// ---- baseline: JSON piatto {"metrics": {"nome": {"value":..,"better":..,..}}} ----
+namespace {
+
+struct Parser {
+  const char* p;
+  void ws() { while (*p && strchr(" \t\r\n", *p)) p++; }
+  bool eat(char c) {
+    ws();
+    if (*p != c) return false;
+    p++;
+    return true;
+  }
+  bool str(std::string* out) {
+    if (!eat('"')) return false;
+    out->clear();
+    while (*p && *p != '"') out->push_back(*p++);
+    return eat('"');
+  }
+  // valore scalare come testo (numero o stringa)
+  bool scalar(std::string* out) {
+    ws();
+    if (*p == '"') return str(out);
+    const char* s = p;
+    while (*p && !strchr(",}] \t\r\n", *p)) p++;
+    out->assign(s, p);
+    return p > s;
+  }
+  typedef std::map<std::string, std::string> Obj;
+  bool obj(Obj* out) {
+    if (!eat('{')) return false;
+    if (eat('}')) return true;
+    do {
+      std::string k, v;
+      if (!str(&k) || !eat(':') || !scalar(&v)) return false;
+      (*out)[k] = v;
+    } while (eat(','));
+    return eat('}');
+  }
+};
+
+bool load_baseline(const std::string& path, std::map<std::string, std::map<std::string, std::string>>* out) {
+  std::ifstream f(path);
+  if (!f) return false;
+  std::stringstream ss;
+  ss << f.rdbuf();
+  std::string text = ss.str();
+  Parser ps{text.c_str()};
+  if (!ps.eat('{')) return false;
+  do {
+    std::string k;
+    if (!ps.str(&k) || !ps.eat(':')) return false;
+    if (k == "metrics") {
+      if (!ps.eat('{')) return false;
+      if (ps.eat('}')) continue;
+      do {
+        std::string name;
+        Parser::Obj o;
+        if (!ps.str(&name) || !ps.eat(':') || !ps.obj(&o)) return false;
+        (*out)[name] = o;
+      } while (ps.eat(','));
+      if (!ps.eat('}')) return false;
+    } else {
+      std::string v;
+      if (!ps.scalar(&v)) return false;
+    }
+  } while (ps.eat(','));
+  return ps.eat('}');
+}
+
+}  // namespace
+
+int Report::check(const std::string& path) const {
+  std::map<std::string, std::map<std::string, std::string>> base;
+  if (!load_baseline(path, &base)) {
+    fprintf(stderr, "baseline %s non leggibile\n", path.c_str());
+    return 1;
+  }
+  int fails = 0;
+  for (const Metric& m : m_) {
+    auto it = base.find(m.name);
+    if (it == base.end()) {
+      fprintf(stderr, "FAIL %-26s manca nella baseline\n", m.name.c_str());
+      fails++;
+      continue;
+    }
+    double bv = atof(it->second["value"].c_str());
+    double tol = it->second.count("tolerance") ? atof(it->second["tolerance"].c_str()) : m.tolerance;
+    double slack = it->second.count("slack") ? atof(it->second["slack"].c_str()) : m.slack;
+    bool higher = it->second["better"] == "higher";
+    double limit = higher ? bv * (1 - tol) - slack : bv * (1 + tol) + slack;
+    bool bad = higher ? m.value < limit : m.value > limit;
+    fprintf(stderr, "%s %-26s %10.2f %-4s baseline %10.2f limite %10.2f\n", bad ? "FAIL" : "ok  ", m.name.c_str(),
+            m.value, m.unit.c_str(), bv, limit);
+    if (bad) fails++;
+  }
+  return fails;
+}
+
+bool Report::write(const std::string& path) const {
+  FILE* f = fopen(path.c_str(), "w");
+  if (!f) return false;
+  fprintf(f, "{\n  \"scenario\": \"%s\",\n  \"metrics\": {\n", scenario_.c_str());
+  for (size_t i = 0; i < m_.size(); i++) {
+    const Metric& m = m_[i];
+    fprintf(f, "    \"%s\": { \"value\": %.2f, \"unit\": \"%s\", \"better\": \"%s\", \"tolerance\": %.2f, \"slack\": %.2f }%s\n",
+            m.name.c_str(), m.value, m.unit.c_str(), m.better.c_str(), m.tolerance, m.slack,
+            i + 1 < m_.size() ? "," : "");
+  }
+  fprintf(f, "  }\n}\n");
+  return fclose(f) == 0;
+}
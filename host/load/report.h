@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// Metriche di uno scenario e confronto con la baseline salvata
+// (host/baselines/<scenario>.json). Una metrica peggiora se esce da
+// value*(1±tolerance) ± slack nella direzione "better".
+
+class Samples {
+ public:
+  void   add(double v) { v_.push_back(v); }
+  void   add(const Samples& o) { v_.insert(v_.end(), o.v_.begin(), o.v_.end()); }
+  size_t count() const { return v_.size(); }
+  double pct(double p) const;    // percentile (0..100), 0 se vuoto
+  double max() const;
+
+ private:
+  std::vector<double> v_;
+};
+
+class Report {
+ public:
+  explicit Report(const char* scenario) : scenario_(scenario) {}
+  // better: "higher" o "lower"
+  void add(const char* name, double value, const char* better, double tolerance, double slack, const char* unit);
+  // latenze p50/p95/p99 in ms (name_p50, ...)
+  void add_latency(const char* name, const Samples& s, double tolerance, double slack);
+  // picco heap interna/PSRAM dall'ultimo sim_heap_reset_peak()
+  void add_peak_memory(double tolerance);
+
+  void print() const;
+  // 0 = nessuna regressione; metriche mancanti nella baseline = errore
+  int  check(const std::string& baseline_path) const;
+  bool write(const std::string& baseline_path) const;
+
+ private:
+  struct Metric {
+    std::string name, better, unit;
+    double      value, tolerance, slack;
+  };
+  std::string         scenario_;
+  std::vector<Metric> m_;
+};
@@ -0,0 +1,4 @@
+// Lo sketch come unità C++: arduino-cli lo compila allo stesso modo dopo
+// aver generato i prototipi, che qui non servono (funzioni definite prima
+// dell'uso o dichiarate in testa).
+#include "../../BirdCam.ino"
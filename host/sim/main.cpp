@@ -0,0 +1,53 @@
+// birdcam_sim: il firmware sul PC, per provarlo a mano con browser, VLC o
+// ffplay. I comandi su stdin pilotano PIR e alimentazione.
+#include "sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+static void usage() {
+  fprintf(stderr,
+          "usage: birdcam_sim [--port N] [--rtsp-port N] [--replay DIR] [--fps N]\n"
+          "stdin: pir 0|1, vbus 0|1, batt <mV>, drop (broker), quit\n");
+}
+
+int main(int argc, char** argv) {
+  uint16_t port = 8080;
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!strcmp(a, "--port") && v) { port = (uint16_t)atoi(v); i++; }
+    else if (!strcmp(a, "--rtsp-port") && v) { sim_set_rtsp_port((uint16_t)atoi(v)); i++; }
+    else if (!strcmp(a, "--fps") && v) { sim_camera_set_fps(atoi(v)); i++; }
+    else if (!strcmp(a, "--replay") && v) {
+      if (!sim_camera_replay(v, 0)) {
+        fprintf(stderr, "birdcam_sim: nessun JPEG baseline in %s\n", v);
+        return 2;
+      }
+      i++;
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  sim_set_http_port(port);
+  sim_boot();
+  fprintf(stderr, "birdcam_sim: http://127.0.0.1:%u/  rtsp://127.0.0.1:%u/mjpeg\n", sim_http_port(), sim_rtsp_port());
+
+  char line[128];
+  while (fgets(line, sizeof(line), stdin)) {
+    char cmd[16] = "";
+    int arg = 0;
+    if (sscanf(line, "%15s %d", cmd, &arg) < 1) continue;
+    std::string c = cmd;
+    if (c == "pir") sim_set_pir(arg != 0);
+    else if (c == "vbus") sim_set_vbus(arg != 0);
+    else if (c == "batt") sim_set_batt_mv((uint16_t)arg);
+    else if (c == "drop") sim_broker_drop_all();
+    else if (c == "quit") break;
+    else usage();
+  }
+  sim_exit(0);
+}
@@ -0,0 +1,75 @@
+// Avvio del firmware simulato: setup() sul thread chiamante, poi loop()
+// sul task "loopTask" come fa il core Arduino-ESP32.
+#include "Arduino.h"
+#include "lwip/sockets.h"
+
+#include "sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+
+void setup();
+void loop();
+
+namespace {
+
+std::atomic<uint16_t> s_rtsp_port{0};
+std::atomic<uint16_t> s_rtsp_udp_base{0};
+
+// porta libera chiesta al kernel (bind su 0); type = SOCK_STREAM / SOCK_DGRAM
+uint16_t free_port(int type, bool pair) {
+  for (int tries = 0; tries < 64; tries++) {
+    int fd = socket(AF_INET, type, 0);
+    struct sockaddr_in a = {};
+    a.sin_family = AF_INET;
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t al = sizeof(a);
+    if (fd < 0 || bind(fd, (struct sockaddr*)&a, sizeof(a)) != 0 || getsockname(fd, (struct sockaddr*)&a, &al) != 0) {
+      if (fd >= 0) close(fd);
+      continue;
+    }
+    close(fd);
+    uint16_t p = ntohs(a.sin_port);
+    // RTP pari, RTCP dispari (RFC 3550), con margine per tutte le sessioni
+    if (!pair || (p % 2 == 0 && p < 65000)) return p;
+  }
+  return 0;
+}
+
+void loop_task(void*) {
+  for (;;) loop();
+}
+
+}  // namespace
+
+void sim_set_rtsp_port(uint16_t port) { s_rtsp_port = port; }
+
+uint16_t sim_rtsp_port() {
+  uint16_t p = s_rtsp_port.load();
+  if (!p) {
+    p = free_port(SOCK_STREAM, false);
+    s_rtsp_port = p;
+  }
+  return p;
+}
+
+uint16_t sim_rtsp_udp_base_port() {
+  uint16_t p = s_rtsp_udp_base.load();
+  if (!p) {
+    p = free_port(SOCK_DGRAM, true);
+    s_rtsp_udp_base = p;
+  }
+  return p;
+}
+
+void sim_boot() {
+  setup();
+  xTaskCreatePinnedToCore(loop_task, "loopTask", 8192, nullptr, 1, nullptr, 1);
+}
+
+void sim_exit(int code) {
+  fflush(stdout);
+  fflush(stderr);
+  _Exit(code);
+}
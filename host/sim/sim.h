@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <string>
+
+// Controllo del firmware simulato (host/): BirdCam.ino + app_httpd.cpp +
+// moduli birdcam_* compilati sui fake di host/fakes. Tutto in-process:
+// i client di host/load parlano con l'httpd vero via socket, il resto
+// (PIR, VBUS, broker MQTT, memoria) passa da qui.
+
+// ---- avvio ----
+// setup() sul thread chiamante, poi loop() su un task "loopTask"
+void sim_boot();
+// uscita senza distruttori: i task del firmware non terminano mai
+[[noreturn]] void sim_exit(int code);
+
+// ---- porte (0 = effimera, vedi sim_http_port() dopo httpd_start) ----
+void     sim_set_http_port(uint16_t port);
+uint16_t sim_http_port();
+void     sim_set_rtsp_port(uint16_t port);
+uint16_t sim_rtsp_port();
+
+// ---- pin e PMU ----
+void     sim_set_pir(bool high);
+uint32_t sim_pir_isr_calls();          // chiamate all'ISR (fronti e livelli)
+void     sim_set_vbus(bool present);
+void     sim_set_batt_mv(uint16_t mv);
+bool     sim_in_light_sleep();
+uint32_t sim_light_sleeps();
+bool     sim_deep_slept();
+
+// ---- camera ----
+// JPEG da una cartella riprodotti in ordine a fps fissi (ridimensionati e
+// ricompressi sulla modalità richiesta), altrimenti scena sintetica
+bool     sim_camera_replay(const char* dir, int fps);
+void     sim_camera_set_fps(int fps);
+struct sim_camera_stats_t {
+  uint32_t frames;       // frame consegnati
+  uint32_t stale;        // GRAB_WHEN_EMPTY: frame più vecchio di un periodo
+  uint32_t overflow;     // JPEG più grande del buffer (scartato)
+  uint32_t inits;        // esp_camera_init
+};
+void     sim_camera_get_stats(sim_camera_stats_t* out);
+
+// ---- heap (budget ESP32-S3: PSRAM 8 MB, interna 320 KB) ----
+enum sim_pool_t { SIM_POOL_INTERNAL = 0, SIM_POOL_PSRAM = 1 };
+size_t   sim_heap_used(int pool);
+size_t   sim_heap_peak(int pool);
+void     sim_heap_reset_peak();
+
+// ---- broker MQTT in-process ----
+typedef std::function<void(const std::string& topic, const std::string& payload, bool retained)> sim_mqtt_cb_t;
+// sottoscrizione "di test" (filtri + e #); il callback gira sul thread che pubblica
+int      sim_broker_subscribe(const char* filter, sim_mqtt_cb_t cb);
+void     sim_broker_unsubscribe(int id);
+// comando verso il device (consegnato al prossimo mqtt.loop())
+void     sim_broker_publish(const char* topic, const std::string& payload, bool retained);
+bool     sim_broker_retained(const char* topic, std::string* out);
+// chiude tutte le sessioni del device (will pubblicato); up = false rifiuta i connect
+void     sim_broker_drop_all();
+void     sim_broker_set_up(bool up);
+struct sim_broker_stats_t {
+  uint32_t connects;
+  uint32_t drops;
+  uint32_t publishes;    // dal device
+  uint64_t bytes;
+  uint32_t rejected;     // publish oltre setBufferSize()
+  bool     connected;
+};
+void     sim_broker_get_stats(sim_broker_stats_t* out);
+
+// ---- log del firmware (Serial) su stderr se BIRDCAM_SIM_SERIAL=1 ----
+uint32_t sim_serial_lines();
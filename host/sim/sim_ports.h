@@ -0,0 +1,12 @@
+#pragma once
+
+// Incluso davanti a ogni sorgente del firmware (-include): le porte fisse
+// del device diventano quelle scelte dalla simulazione, così più istanze
+// e i test possono girare senza privilegi e senza collisioni.
+#include <stdint.h>
+
+uint16_t sim_rtsp_port();
+uint16_t sim_rtsp_udp_base_port();
+
+#define RTSP_PORT          sim_rtsp_port()
+#define RTSP_UDP_BASE_PORT sim_rtsp_udp_base_port()
@@ -0,0 +1,142 @@
+#pragma once
+
+// Lettori indipendenti di tar (ustar) e zip (stored) per i test: fanno i
+// controlli di "tar -t" e "unzip -t" (checksum degli header, struttura,
+// directory centrale coerente con gli header locali, CRC-32 dei dati)
+// senza usare birdcam_export.
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+struct arch_entry_t {
+  std::string name;
+  uint32_t    mtime;      // tar: secondi; zip: data/ora DOS (data << 16 | ora)
+  std::string data;
+};
+
+inline uint32_t arch_crc32(const std::string& s) {
+  uint32_t c = 0xFFFFFFFFu;
+  for (unsigned char b : s) {
+    c ^= b;
+    for (int k = 0; k < 8; k++) c = (c >> 1) ^ (0xEDB88320u & (0u - (c & 1)));
+  }
+  return ~c;
+}
+
+inline uint32_t arch_octal(const char* p, size_t n, bool* ok) {
+  uint32_t v = 0;
+  size_t i = 0;
+  while (i < n && p[i] == ' ') i++;
+  size_t digits = 0;
+  for (; i < n && p[i] >= '0' && p[i] <= '7'; i++, digits++) v = v * 8 + (uint32_t)(p[i] - '0');
+  // il campo finisce con NUL o spazio
+  if (!digits || (i < n && p[i] != 0 && p[i] != ' ')) *ok = false;
+  return v;
+}
+
+// false con *err se l'archivio non è valido
+inline bool tar_list(const std::string& t, std::vector<arch_entry_t>* out, std::string* err) {
+  size_t p = 0;
+  for (;;) {
+    if (p + 512 > t.size()) { *err = "tar troncato (manca la fine archivio)"; return false; }
+    const char* h = t.data() + p;
+    bool zero = true;
+    for (int i = 0; i < 512; i++) if (h[i]) { zero = false; break; }
+    if (zero) {
+      // fine: un secondo blocco vuoto e poi niente
+      if (p + 1024 != t.size()) { *err = "fine archivio non valida"; return false; }
+      for (size_t i = p + 512; i < p + 1024; i++) if (t[i]) { *err = "secondo blocco finale non vuoto"; return false; }
+      return true;
+    }
+    bool ok = true;
+    uint32_t want = arch_octal(h + 148, 8, &ok);
+    uint32_t sum = 0;
+    for (int i = 0; i < 512; i++) sum += (i >= 148 && i < 156) ? ' ' : (unsigned char)h[i];
+    if (!ok || sum != want) { *err = "checksum header errato a " + std::to_string(p); return false; }
+    if (memcmp(h + 257, "ustar\0" "00", 8) != 0) { *err = "magic ustar mancante"; return false; }
+    if (h[156] != '0' && h[156] != 0) { *err = "tipo non regolare"; return false; }
+    arch_entry_t e;
+    e.name.assign(h, strnlen(h, 100));
+    uint32_t size = arch_octal(h + 124, 12, &ok);
+    e.mtime = arch_octal(h + 136, 12, &ok);
+    if (!ok || e.name.empty()) { *err = "campi header non validi"; return false; }
+    p += 512;
+    size_t padded = (size + 511) / 512 * 512;
+    if (p + padded > t.size()) { *err = "dati troncati: " + e.name; return false; }
+    e.data = t.substr(p, size);
+    for (size_t i = p + size; i < p + padded; i++) if (t[i]) { *err = "padding non nullo: " + e.name; return false; }
+    p += padded;
+    out->push_back(e);
+  }
+}
+
+inline uint16_t arch_u16(const std::string& s, size_t at) {
+  return (uint16_t)((unsigned char)s[at] | (unsigned char)s[at + 1] << 8);
+}
+inline uint32_t arch_u32(const std::string& s, size_t at) {
+  return (uint32_t)arch_u16(s, at) | (uint32_t)arch_u16(s, at + 2) << 16;
+}
+
+inline bool zip_test(const std::string& z, std::vector<arch_entry_t>* out, std::string* err) {
+  // fine directory centrale: senza commento sta negli ultimi 22 byte
+  if (z.size() < 22) { *err = "zip troppo corto"; return false; }
+  size_t eocd = z.size() - 22;
+  if (arch_u32(z, eocd) != 0x06054b50) { *err = "EOCD mancante"; return false; }
+  uint16_t n = arch_u16(z, eocd + 10);
+  uint32_t cd_size = arch_u32(z, eocd + 12), cd_off = arch_u32(z, eocd + 16);
+  if (arch_u16(z, eocd + 4) || arch_u16(z, eocd + 6) || arch_u16(z, eocd + 8) != n || arch_u16(z, eocd + 20)) {
+    *err = "EOCD multi-disco o con commento"; return false;
+  }
+  if ((size_t)cd_off + cd_size != eocd) { *err = "directory centrale fuori posto"; return false; }
+
+  size_t c = cd_off;
+  size_t next_local = 0;      // gli header locali devono coprire [0, cd_off) in ordine
+  for (uint16_t i = 0; i < n; i++) {
+    if (c + 46 > eocd || arch_u32(z, c) != 0x02014b50) { *err = "voce centrale non valida"; return false; }
+    uint16_t flags = arch_u16(z, c + 8), method = arch_u16(z, c + 10);
+    uint32_t dosdt = (uint32_t)arch_u16(z, c + 14) << 16 | arch_u16(z, c + 12);
+    uint32_t crc = arch_u32(z, c + 16), csize = arch_u32(z, c + 20), usize = arch_u32(z, c + 24);
+    uint16_t nlen = arch_u16(z, c + 28), xlen = arch_u16(z, c + 30), clen = arch_u16(z, c + 32);
+    uint32_t loff = arch_u32(z, c + 42);
+    if (c + 46 + nlen + xlen + clen > eocd) { *err = "voce centrale troncata"; return false; }
+    std::string name = z.substr(c + 46, nlen);
+    if (method != 0 || csize != usize || (flags & 0x08)) { *err = "non stored: " + name; return false; }
+    if (arch_u16(z, c + 6) > 20) { *err = "versione richiesta troppo alta"; return false; }
+
+    if (loff != next_local || loff + 30 > cd_off || arch_u32(z, loff) != 0x04034b50) {
+      *err = "header locale non valido: " + name; return false;
+    }
+    uint16_t lnlen = arch_u16(z, loff + 26), lxlen = arch_u16(z, loff + 28);
+    if (arch_u16(z, loff + 8) != method || arch_u32(z, loff + 14) != crc || arch_u32(z, loff + 18) != csize ||
+        arch_u32(z, loff + 22) != usize || z.compare(loff + 30, lnlen, name) != 0 ||
+        ((uint32_t)arch_u16(z, loff + 12) << 16 | arch_u16(z, loff + 10)) != dosdt) {
+      *err = "header locale diverso dalla directory: " + name; return false;
+    }
+    size_t data = loff + 30 + lnlen + lxlen;
+    if (data + usize > cd_off) { *err = "dati troncati: " + name; return false; }
+    arch_entry_t e;
+    e.name = name;
+    e.mtime = dosdt;
+    e.data = z.substr(data, usize);
+    if (arch_crc32(e.data) != crc) { *err = "CRC errato: " + name; return false; }
+    out->push_back(e);
+    next_local = data + usize;
+    c += 46 + nlen + xlen + clen;
+  }
+  if (c != eocd || next_local != cd_off) { *err = "byte non coperti dalla directory"; return false; }
+  return true;
+}
+
+// data/ora DOS attese per un timestamp (ora locale, 1980-01-01 se non valido)
+inline uint32_t arch_dos_time(time_t t) {
+  if (t <= 0) return (uint32_t)((1 << 5) | 1) << 16;
+  struct tm tm;
+  localtime_r(&t, &tm);
+  uint32_t d = (uint32_t)((tm.tm_year + 1900 - 1980) << 9 | (tm.tm_mon + 1) << 5 | tm.tm_mday);
+  uint32_t h = (uint32_t)(tm.tm_hour << 11 | tm.tm_min << 5 | tm.tm_sec / 2);
+  return d << 16 | h;
+}
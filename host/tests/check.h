@@ -0,0 +1,35 @@
+#pragma once
+
+// Asserzioni minime per i test host: un fallimento stampa file:riga e il
+// test continua; check_result() dà l'exit code: 0 solo se non ne è
+// fallita nessuna.
+#include <stdio.h>
+
+inline int& check_failures() {
+  static int n = 0;
+  return n;
+}
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: CHECK(%s) fallito\n", __FILE__, __LINE__, #cond); \
+      check_failures()++;                                                      \
+    }                                                                          \
+  } while (0)
+
+#define CHECK_EQ(a, b)                                                         \
+  do {                                                                         \
+    long long va_ = (long long)(a), vb_ = (long long)(b);                      \
+    if (va_ != vb_) {                                                          \
+      fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s): %lld != %lld\n", __FILE__,     \
+              __LINE__, #a, #b, va_, vb_);                                     \
+      check_failures()++;                                                      \
+    }                                                                          \
+  } while (0)
+
+inline int check_result(const char* name) {
+  if (check_failures()) fprintf(stderr, "%s: %d controlli falliti\n", name, check_failures());
+  else printf("%s: ok\n", name);
+  return check_failures() ? 1 : 0;
+}
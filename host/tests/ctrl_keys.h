@@ -0,0 +1,52 @@
+#pragma once
+
+// I 34 comandi MQTT di CTRL_TABLE (BirdCam.ino) come li vede un client:
+// chiave, tipo e limiti attesi. Se la tabella cambia, va aggiornato qui
+// (test_ctrl_router controlla che il device pubblichi esattamente queste).
+#include "birdcam_ctrl.h"
+
+struct ctrl_key_t {
+  const char* key;
+  uint8_t     kind;
+  int32_t     min;
+  int32_t     max;
+};
+
+static const ctrl_key_t CTRL_KEYS[] = {
+  {"framesize",            CTRL_FRAMESIZE, 0,   0},
+  {"quality",              CTRL_INT,       10,  63},
+  {"img_mode",             CTRL_INT,       0,   5},
+  {"brightness",           CTRL_INT,       -2,  2},
+  {"contrast",             CTRL_INT,       -2,  2},
+  {"saturation",           CTRL_INT,       -2,  2},
+  {"sharpness",            CTRL_INT,       -2,  2},
+  {"gain_ctrl",            CTRL_BOOL,      0,   1},
+  {"exposure_ctrl",        CTRL_BOOL,      0,   1},
+  {"awb",                  CTRL_BOOL,      0,   1},
+  {"agc_gain",             CTRL_INT,       0,   30},
+  {"aec_value",            CTRL_INT,       0,   1200},
+  {"archive_keep",         CTRL_INT,       1,   20},
+  {"snapshot_max_age_ms",  CTRL_INT,       0,   10000},
+  {"light_sleep_idle_s",   CTRL_INT,       0,   3600},
+  {"deep_sleep",           CTRL_BOOL,      0,   1},
+  {"deep_sleep_idle_s",    CTRL_INT,       60,  86400},
+  {"timelapse_interval_s", CTRL_INT,       0,   3600},
+  {"timelapse_framesize",  CTRL_FRAMESIZE, 0,   0},
+  {"timelapse_keep",       CTRL_INT,       1,   1440},
+  {"roi_x",                CTRL_INT,       0,   100},
+  {"roi_y",                CTRL_INT,       0,   100},
+  {"roi_w",                CTRL_INT,       10,  100},
+  {"roi_stream",           CTRL_BIT,       0,   1},
+  {"roi_snapshot",         CTRL_BIT,       0,   1},
+  {"roi_archive",          CTRL_BIT,       0,   1},
+  {"roi_mqtt",             CTRL_BIT,       0,   1},
+  {"roi_timelapse",        CTRL_BIT,       0,   1},
+  {"scene_threshold",      CTRL_INT,       0,   100},
+  {"scene_keyframe_s",     CTRL_INT,       10,  3600},
+  {"static_ip",            CTRL_IPV4,      0,   0},
+  {"gateway",              CTRL_IPV4,      0,   0},
+  {"subnet",               CTRL_IPV4,      0,   0},
+  {"dns",                  CTRL_IPV4,      0,   0},
+};
+
+static const int CTRL_KEY_COUNT = (int)(sizeof(CTRL_KEYS) / sizeof(CTRL_KEYS[0]));
@@ -0,0 +1,41 @@
+// bc_apply_settings() con una risoluzione che richiede la re-init a caldo:
+// la camera riparte già con la qualità nuova, non con quella di prima.
+#include "check.h"
+#include "client.h"
+#include "sim.h"
+
+#include "birdcam_cam.h"
+#include "birdcam_settings.h"
+#include "esp_camera.h"
+
+int main() {
+  sim_set_http_port(0);
+  if (!sim_boot_online(10000)) {
+    fprintf(stderr, "firmware non online\n");
+    sim_exit(2);
+  }
+
+  // la prima risoluzione che non sta nei buffer attuali
+  framesize_t fs = FRAMESIZE_INVALID;
+  for (framesize_t f : {FRAMESIZE_VGA, FRAMESIZE_SVGA, FRAMESIZE_XGA, FRAMESIZE_HD, FRAMESIZE_SXGA, FRAMESIZE_UXGA}) {
+    if (!cam_arb_fits(f)) { fs = f; break; }
+  }
+  CHECK(fs != FRAMESIZE_INVALID);
+  int q = bc_get_jpeg_quality() == 20 ? 21 : 20;
+
+  sim_camera_stats_t before, after;
+  sim_camera_get_stats(&before);
+  CHECK_EQ(bc_apply_settings(fs, q, 3), 0);
+  sim_camera_get_stats(&after);
+  printf("re-init a %s, q %d: %u init\n", cam_framesize_name(fs), q, after.inits - before.inits);
+  CHECK_EQ(after.inits - before.inits, 1);
+  CHECK(cam_arb_fits(fs));
+  CHECK_EQ(bc_get_framesize(), fs);
+  CHECK_EQ(bc_get_jpeg_quality(), q);
+  CHECK_EQ(bc_get_img_mode(), 3);
+  sensor_t* s = esp_camera_sensor_get();
+  CHECK(s != nullptr);
+  if (s) CHECK_EQ(s->status.quality, q);
+
+  sim_exit(check_result("test_apply_settings"));
+}
@@ -0,0 +1,60 @@
+// /archive.tar e /archive.zip dal firmware simulato dopo alcune catture PIR:
+// entrambi passano i controlli di archive_check.h e contengono gli stessi
+// JPEG, con gli stessi nomi, nello stesso ordine.
+#include "check.h"
+#include "archive_check.h"
+#include "client.h"
+#include "sim.h"
+
+#include <chrono>
+#include <thread>
+
+namespace {
+
+const int CAPTURES = 3;
+
+void sleep_ms(int ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+}  // namespace
+
+int main() {
+  sim_set_http_port(0);
+  if (!sim_boot_online(10000)) {
+    fprintf(stderr, "firmware non online\n");
+    sim_exit(2);
+  }
+
+  for (int i = 0; i < CAPTURES; i++) {
+    sim_set_pir(true);
+    sleep_ms(200);
+    sim_set_pir(false);
+    sleep_ms(1500);
+  }
+
+  http_resp_t tar, zip;
+  CHECK(http_get(sim_http_port(), "/archive.tar", &tar) && tar.status == 200);
+  CHECK(http_get(sim_http_port(), "/archive.zip", &zip) && zip.status == 200);
+  CHECK(http_header(tar, "Content-Type") == "application/x-tar");
+  CHECK(http_header(zip, "Content-Type") == "application/zip");
+
+  std::vector<arch_entry_t> t, z;
+  std::string err;
+  bool tok = tar_list(tar.body, &t, &err);
+  if (!tok) fprintf(stderr, "tar: %s\n", err.c_str());
+  bool zok = zip_test(zip.body, &z, &err);
+  if (!zok) fprintf(stderr, "zip: %s\n", err.c_str());
+  CHECK(tok && zok);
+  printf("tar: %zu file (%zu B), zip: %zu file (%zu B)\n", t.size(), tar.body.size(), z.size(), zip.body.size());
+
+  CHECK(t.size() >= (size_t)CAPTURES);
+  CHECK_EQ(t.size(), z.size());
+  for (size_t i = 0; i < t.size() && i < z.size(); i++) {
+    CHECK(t[i].name == z[i].name);
+    CHECK(t[i].data == z[i].data);
+    const std::string& j = t[i].data;
+    CHECK(j.size() > 4 && (uint8_t)j[0] == 0xFF && (uint8_t)j[1] == 0xD8);
+    CHECK(t[i].name.size() > 4 && t[i].name.compare(t[i].name.size() - 4, 4, ".jpg") == 0);
+  }
+
+  sim_exit(check_result("test_archive_http"));
+}
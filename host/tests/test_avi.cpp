@@ -0,0 +1,201 @@
+// Round-trip MJPEG-AVI: file costruito con birdcam_avi come fa
+// /timelapse.avi, poi riletto con un parser RIFF indipendente: ogni chunk
+// sta nel genitore, header coerenti, frame e idx1 identici a quelli scritti.
+#include "check.h"
+#include "birdcam_avi.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::vector<uint8_t> Bytes;
+
+uint32_t rd32(const Bytes& b, size_t at) {
+  return (uint32_t)b[at] | (uint32_t)b[at + 1] << 8 | (uint32_t)b[at + 2] << 16 | (uint32_t)b[at + 3] << 24;
+}
+uint16_t rd16(const Bytes& b, size_t at) { return (uint16_t)(b[at] | b[at + 1] << 8); }
+std::string cc(const Bytes& b, size_t at) { return std::string((const char*)&b[at], 4); }
+
+Bytes build(const std::vector<Bytes>& frames, uint16_t w, uint16_t h, uint32_t fps) {
+  avi_info_t info = {};
+  info.width = w;
+  info.height = h;
+  info.fps = fps;
+  for (const Bytes& f : frames) {
+    uint32_t len = (uint32_t)f.size();
+    info.frames++;
+    info.frames_bytes += len;
+    if (len & 1) info.odd_frames++;
+    if (len > info.max_frame_len) info.max_frame_len = len;
+  }
+  Bytes out(AVI_HEADER_LEN);
+  avi_write_header(out.data(), &info);
+  for (const Bytes& f : frames) {
+    uint8_t ch[AVI_CHUNK_HDR_LEN];
+    avi_write_chunk_header(ch, (uint32_t)f.size());
+    out.insert(out.end(), ch, ch + sizeof(ch));
+    out.insert(out.end(), f.begin(), f.end());
+    if (f.size() & 1) out.push_back(0);
+  }
+  uint8_t ih[AVI_CHUNK_HDR_LEN];
+  avi_write_index_header(ih, info.frames);
+  out.insert(out.end(), ih, ih + sizeof(ih));
+  uint32_t off = 4;
+  for (const Bytes& f : frames) {
+    uint8_t e[AVI_INDEX_ENTRY_LEN];
+    uint32_t len = (uint32_t)f.size();
+    avi_write_index_entry(e, off, len);
+    out.insert(out.end(), e, e + sizeof(e));
+    off += AVI_CHUNK_HDR_LEN + len + (len & 1);
+  }
+  CHECK_EQ(out.size(), avi_total_len(&info));
+  return out;
+}
+
+struct Chunk {
+  std::string id;      // fourcc, o "LIST:xxxx"
+  size_t      data;    // primo byte dei dati (dopo l'eventuale tipo LIST)
+  uint32_t    len;     // lunghezza dei dati
+};
+
+// Figli di [begin, end): ogni chunk (più il padding pari) deve starci dentro
+bool walk(const Bytes& b, size_t begin, size_t end, std::vector<Chunk>* out) {
+  size_t p = begin;
+  while (p < end) {
+    if (end - p < 8) return false;
+    std::string id = cc(b, p);
+    uint32_t len = rd32(b, p + 4);
+    if (len > end - p - 8) return false;
+    Chunk c = {id, p + 8, len};
+    if (id == "LIST") {
+      if (len < 4) return false;
+      c.id = "LIST:" + cc(b, p + 8);
+      c.data = p + 12;
+      c.len = len - 4;
+    }
+    out->push_back(c);
+    p += 8 + len + (len & 1);
+  }
+  return p == end;
+}
+
+const Chunk* find(const std::vector<Chunk>& v, const std::string& id) {
+  for (const Chunk& c : v) if (c.id == id) return &c;
+  return nullptr;
+}
+
+void check_roundtrip(const std::vector<Bytes>& frames, uint16_t w, uint16_t h, uint32_t fps) {
+  Bytes avi = build(frames, w, h, fps);
+  uint32_t eff_fps = fps ? fps : 1;
+
+  CHECK(cc(avi, 0) == "RIFF");
+  CHECK_EQ(rd32(avi, 4), avi.size() - 8);
+  CHECK(cc(avi, 8) == "AVI ");
+
+  std::vector<Chunk> top;
+  if (!walk(avi, 12, avi.size(), &top)) {
+    CHECK(!"RIFF non valido");
+    return;
+  }
+  CHECK_EQ(top.size(), 3);
+  const Chunk* hdrl = find(top, "LIST:hdrl");
+  const Chunk* movi = find(top, "LIST:movi");
+  const Chunk* idx1 = find(top, "idx1");
+  CHECK(hdrl && movi && idx1);
+  if (!hdrl || !movi || !idx1) return;
+  CHECK_EQ(movi->data, AVI_HEADER_LEN);
+
+  std::vector<Chunk> hc;
+  CHECK(walk(avi, hdrl->data, hdrl->data + hdrl->len, &hc));
+  const Chunk* avih = find(hc, "avih");
+  const Chunk* strl = find(hc, "LIST:strl");
+  CHECK(avih && strl);
+  if (!avih || !strl) return;
+  uint32_t max_len = 0;
+  for (const Bytes& f : frames) if (f.size() > max_len) max_len = (uint32_t)f.size();
+  CHECK_EQ(avih->len, 56);
+  CHECK_EQ(rd32(avi, avih->data + 0), 1000000 / eff_fps);
+  CHECK_EQ(rd32(avi, avih->data + 12) & 0x10, 0x10);          // AVIF_HASINDEX
+  CHECK_EQ(rd32(avi, avih->data + 16), frames.size());
+  CHECK_EQ(rd32(avi, avih->data + 24), 1);                    // stream
+  CHECK_EQ(rd32(avi, avih->data + 28), max_len);
+  CHECK_EQ(rd32(avi, avih->data + 32), w);
+  CHECK_EQ(rd32(avi, avih->data + 36), h);
+
+  std::vector<Chunk> sc;
+  CHECK(walk(avi, strl->data, strl->data + strl->len, &sc));
+  const Chunk* strh = find(sc, "strh");
+  const Chunk* strf = find(sc, "strf");
+  CHECK(strh && strf);
+  if (!strh || !strf) return;
+  CHECK(cc(avi, strh->data) == "vids");
+  CHECK(cc(avi, strh->data + 4) == "MJPG");
+  CHECK_EQ(rd32(avi, strh->data + 20), 1);                    // dwScale
+  CHECK_EQ(rd32(avi, strh->data + 24), eff_fps);              // dwRate
+  CHECK_EQ(rd32(avi, strh->data + 32), frames.size());        // dwLength
+  CHECK_EQ(rd16(avi, strh->data + 52), w);
+  CHECK_EQ(rd16(avi, strh->data + 54), h);
+  CHECK_EQ(rd32(avi, strf->data + 4), w);
+  CHECK_EQ(rd32(avi, strf->data + 8), h);
+  CHECK(cc(avi, strf->data + 16) == "MJPG");
+
+  // movi: i frame tornano identici, nell'ordine
+  std::vector<Chunk> mc;
+  CHECK(walk(avi, movi->data, movi->data + movi->len, &mc));
+  CHECK_EQ(mc.size(), frames.size());
+  for (size_t i = 0; i < mc.size() && i < frames.size(); i++) {
+    CHECK(mc[i].id == "00dc");
+    CHECK_EQ(mc[i].len, frames[i].size());
+    CHECK(memcmp(&avi[mc[i].data], frames[i].data(), frames[i].size()) == 0);
+    if (frames[i].size() & 1) CHECK_EQ(avi[mc[i].data + mc[i].len], 0);
+  }
+
+  // idx1: offset rispetto al fourcc 'movi' -> header del chunk giusto
+  CHECK_EQ(idx1->len, frames.size() * AVI_INDEX_ENTRY_LEN);
+  size_t movi_fourcc = movi->data - 4;
+  for (size_t i = 0; i < frames.size() && i < mc.size(); i++) {
+    size_t e = idx1->data + i * AVI_INDEX_ENTRY_LEN;
+    CHECK(cc(avi, e) == "00dc");
+    CHECK_EQ(rd32(avi, e + 4) & 0x10, 0x10);                  // AVIIF_KEYFRAME
+    CHECK_EQ(movi_fourcc + rd32(avi, e + 8), mc[i].data - 8);
+    CHECK_EQ(rd32(avi, e + 12), frames[i].size());
+  }
+}
+
+Bytes fake_jpeg(std::mt19937& rng, size_t len) {
+  Bytes b(len);
+  for (auto& x : b) x = (uint8_t)rng();
+  if (len >= 4) {
+    b[0] = 0xFF; b[1] = 0xD8; b[len - 2] = 0xFF; b[len - 1] = 0xD9;
+  }
+  return b;
+}
+
+}  // namespace
+
+int main() {
+  std::mt19937 rng(31);
+
+  // un frame pari, uno dispari
+  check_roundtrip({fake_jpeg(rng, 1000)}, 640, 480, 10);
+  check_roundtrip({fake_jpeg(rng, 1001)}, 640, 480, 10);
+
+  // lunghezze casuali (metà dispari), più di 32 voci di indice
+  for (int round = 0; round < 20; round++) {
+    std::vector<Bytes> frames;
+    int n = 1 + (int)(rng() % 80);
+    for (int i = 0; i < n; i++) frames.push_back(fake_jpeg(rng, 4 + rng() % 9000));
+    uint32_t fps = rng() % 31;                                // 0 -> 1
+    check_roundtrip(frames, (uint16_t)(160 + rng() % 1440), (uint16_t)(120 + rng() % 1080), fps);
+  }
+
+  // nessun frame: file valido con movi e idx1 vuoti
+  check_roundtrip({}, 320, 240, 5);
+
+  return check_result("test_avi");
+}
@@ -0,0 +1,50 @@
+// Arbitro camera: cam_arb_fits() confronta i pixel, non l'indice dell'enum
+// (P_HD 720x1280 viene dopo FHD 1920x1080), e cam_framesize_from_str()
+// accetta solo le risoluzioni della lista 96x96..uxga.
+#include "check.h"
+#include "birdcam_cam.h"
+
+int main() {
+  cam_arb_init(FRAMESIZE_QVGA, 1, FRAMESIZE_QVGA, 12);
+  CHECK(cam_arb_fits(FRAMESIZE_QVGA));
+  CHECK(cam_arb_fits(FRAMESIZE_240X240));
+  CHECK(!cam_arb_fits(FRAMESIZE_CIF));
+  CHECK(!cam_arb_fits(FRAMESIZE_INVALID));
+  CHECK(!cam_arb_fits((framesize_t)-1));
+
+  // buffer per P_HD: FHD ha un indice più basso ma il doppio dei pixel
+  cam_arb_init(FRAMESIZE_P_HD, 1, FRAMESIZE_P_HD, 12);
+  CHECK(!cam_arb_fits(FRAMESIZE_FHD));
+  CHECK(!cam_arb_fits(FRAMESIZE_UXGA));
+  CHECK(cam_arb_fits(FRAMESIZE_HD));         // stessi pixel, altro formato
+  cam_arb_init(FRAMESIZE_FHD, 1, FRAMESIZE_FHD, 12);
+  CHECK(cam_arb_fits(FRAMESIZE_P_HD));
+  CHECK(cam_arb_fits(FRAMESIZE_UXGA));
+
+  CHECK_EQ(cam_fs_area(FRAMESIZE_VGA), 640 * 480);
+  CHECK_EQ(cam_fs_area(FRAMESIZE_INVALID), 0);
+  CHECK_EQ(cam_fb_bytes(FRAMESIZE_INVALID), 0);
+
+  CHECK_EQ(cam_framesize_from_str("vga", FRAMESIZE_QVGA), FRAMESIZE_VGA);
+  CHECK_EQ(cam_framesize_from_str("UXGA", FRAMESIZE_QVGA), FRAMESIZE_UXGA);
+  CHECK_EQ(cam_framesize_from_str("240x240", FRAMESIZE_QVGA), FRAMESIZE_240X240);
+  CHECK_EQ(cam_framesize_from_str("0", FRAMESIZE_QVGA), FRAMESIZE_96X96);
+  CHECK_EQ(cam_framesize_from_str("13", FRAMESIZE_QVGA), FRAMESIZE_UXGA);
+  // oltre uxga o fuori enum: default
+  CHECK_EQ(cam_framesize_from_str("14", FRAMESIZE_QVGA), FRAMESIZE_QVGA);
+  CHECK_EQ(cam_framesize_from_str("15", FRAMESIZE_QVGA), FRAMESIZE_QVGA);
+  CHECK_EQ(cam_framesize_from_str("99", FRAMESIZE_QVGA), FRAMESIZE_QVGA);
+  CHECK_EQ(cam_framesize_from_str("fhd", FRAMESIZE_QVGA), FRAMESIZE_QVGA);
+  CHECK_EQ(cam_framesize_from_str("", FRAMESIZE_QVGA), FRAMESIZE_QVGA);
+  CHECK_EQ(cam_framesize_from_str(nullptr, FRAMESIZE_QVGA), FRAMESIZE_QVGA);
+
+  // discesa per area, non per indice dell'enum
+  CHECK_EQ(cam_fs_next_smaller(FRAMESIZE_QVGA), FRAMESIZE_240X240);
+  CHECK_EQ(cam_fs_next_smaller(FRAMESIZE_240X240), FRAMESIZE_HQVGA);
+  CHECK_EQ(cam_fs_next_smaller(FRAMESIZE_UXGA), FRAMESIZE_SXGA);
+  CHECK_EQ(cam_fs_next_smaller(FRAMESIZE_FHD), FRAMESIZE_UXGA);
+  CHECK_EQ(cam_fs_next_smaller(FRAMESIZE_P_HD), FRAMESIZE_XGA);   // stessi pixel di hd
+  CHECK_EQ(cam_fs_next_smaller(FRAMESIZE_96X96), FRAMESIZE_INVALID);
+
+  return check_result("test_cam_arb");
+}
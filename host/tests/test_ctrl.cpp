@@ -0,0 +1,182 @@
+// birdcam_ctrl sui 34 comandi di CTRL_TABLE: instradamento di ogni chiave e
+// dei topic che non sono comandi, limiti di ctrl_parse, IPv4 andata e ritorno.
+#include "check.h"
+#include "ctrl_keys.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <random>
+#include <string>
+
+namespace {
+
+const char* BASE = "birdcam/665544332211";
+
+std::string topic(const char* key, const char* tail = "/set") {
+  return std::string(BASE) + "/ctrl/" + key + tail;
+}
+
+int32_t parsed(const ctrl_cmd_t* c, const char* msg, bool* ok) {
+  int32_t v = 0x5A5A5A5A;
+  *ok = ctrl_parse(c, msg, &v);
+  return v;
+}
+
+}  // namespace
+
+int main() {
+  static int      ints[CTRL_KEY_COUNT];
+  static uint32_t ips[CTRL_KEY_COUNT];
+  ctrl_cmd_t cmds[CTRL_KEY_COUNT];
+  for (int i = 0; i < CTRL_KEY_COUNT; i++) {
+    const ctrl_key_t& k = CTRL_KEYS[i];
+    cmds[i] = ctrl_cmd_t{k.key, k.kind, (uint16_t)(1u << (i % 9)), k.min, k.max,
+                         k.kind == CTRL_IPV4 ? (const void*)&ips[i] : (const void*)&ints[i]};
+    if (k.kind == CTRL_BIT) cmds[i].min = 1 << (i % 5);   // come CTRL_TABLE: maschera in min
+    if (k.kind == CTRL_FRAMESIZE) cmds[i].max = 13;
+  }
+
+  ctrl_router_t r;
+  CHECK(ctrl_router_init(&r, cmds, CTRL_KEY_COUNT, BASE));
+  CHECK(r.prefix_len == strlen(BASE) + 6);
+
+  // ---- ogni chiave al suo id ----
+  for (int i = 0; i < CTRL_KEY_COUNT; i++) {
+    int id = ctrl_route(&r, topic(CTRL_KEYS[i].key).c_str());
+    if (id != i) fprintf(stderr, "route %s: %d invece di %d\n", CTRL_KEYS[i].key, id, i);
+    CHECK_EQ(id, i);
+  }
+
+  // ---- topic che non sono comandi ----
+  const char* not_cmds[] = {
+    "birdcam/665544332211/ctrl/quality",
+    "birdcam/665544332211/ctrl/quality/",
+    "birdcam/665544332211/ctrl/quality/get",
+    "birdcam/665544332211/ctrl/quality/set/x",
+    "birdcam/665544332211/ctrl/quality/sets",
+    "birdcam/665544332211/ctrl//set",
+    "birdcam/665544332211/ctrl/qualit/set",
+    "birdcam/665544332211/ctrl/qualityx/set",
+    "birdcam/665544332211/ctrl/Quality/set",
+    "birdcam/665544332211/ctrl/roi/set",
+    "birdcam/665544332211/ctrl/roi_x/y/set",
+    "birdcam/66554433221/ctrl/quality/set",
+    "birdcam/665544332211x/ctrl/quality/set",
+    "birdcam/665544332211/ctl/quality/set",
+    "birdcam/665544332211/ctrl",
+    "",
+  };
+  for (const char* t : not_cmds) {
+    int id = ctrl_route(&r, t);
+    if (id != -1) fprintf(stderr, "route \"%s\": %d invece di -1\n", t, id);
+    CHECK_EQ(id, -1);
+  }
+  CHECK_EQ(ctrl_route(&r, nullptr), -1);
+  CHECK_EQ(ctrl_route(nullptr, topic("quality").c_str()), -1);
+
+  // prefisso oltre CTRL_PREFIX_MAX, tabella che non sta nell'indice
+  std::string long_base(CTRL_PREFIX_MAX, 'b');
+  ctrl_router_t r2;
+  CHECK(!ctrl_router_init(&r2, cmds, CTRL_KEY_COUNT, long_base.c_str()));
+  CHECK(!ctrl_router_init(&r2, cmds, CTRL_INDEX_SLOTS / 2 + 1, BASE));
+  CHECK(!ctrl_router_init(&r2, cmds, 0, BASE));
+
+  // ---- limiti di ctrl_parse ----
+  for (int i = 0; i < CTRL_KEY_COUNT; i++) {
+    const ctrl_cmd_t* c = &cmds[i];
+    bool ok;
+    int32_t v;
+    switch (c->kind) {
+      case CTRL_INT:
+      case CTRL_FRAMESIZE: {
+        char m[24];
+        v = parsed(c, std::to_string((long long)c->min - 1).c_str(), &ok);
+        CHECK(ok);
+        CHECK_EQ(v, c->min);
+        v = parsed(c, std::to_string((long long)c->max + 1).c_str(), &ok);
+        CHECK(ok);
+        CHECK_EQ(v, c->max);
+        snprintf(m, sizeof(m), "%ld", (long)c->min);
+        CHECK_EQ(parsed(c, m, &ok), c->min);
+        snprintf(m, sizeof(m), "%ld", (long)c->max);
+        CHECK_EQ(parsed(c, m, &ok), c->max);
+        CHECK_EQ(parsed(c, "99999999999999999999", &ok), c->max);
+        CHECK_EQ(parsed(c, "-99999999999999999999", &ok), c->min);
+        parsed(c, "", &ok);
+        CHECK(!ok);
+        parsed(c, "abc", &ok);
+        CHECK(!ok);
+        parsed(c, "ON", &ok);
+        CHECK(!ok);
+        break;
+      }
+      case CTRL_BOOL:
+      case CTRL_BIT: {
+        const char* on[] = {"ON", "on", "1", "true", "TRUE"};
+        const char* off[] = {"OFF", "off", "0", "false", "False"};
+        for (const char* m : on) { CHECK_EQ(parsed(c, m, &ok), 1); CHECK(ok); }
+        for (const char* m : off) { CHECK_EQ(parsed(c, m, &ok), 0); CHECK(ok); }
+        const char* bad[] = {"", "2", "-1", "yes", "ONN", " on"};
+        for (const char* m : bad) { parsed(c, m, &ok); CHECK(!ok); }
+        break;
+      }
+      case CTRL_IPV4: {
+        const char* bad[] = {"256.0.0.1", "1.2.3", "1.2.3.4.5", "1.2.3.4 ", "a.b.c.d", "-1.2.3.4", "1..2.3", "1.2.3.999"};
+        for (const char* m : bad) {
+          parsed(c, m, &ok);
+          if (ok) fprintf(stderr, "ipv4 \"%s\" accettato\n", m);
+          CHECK(!ok);
+        }
+        CHECK_EQ(parsed(c, "", &ok), 0);
+        CHECK(ok);
+        // ordine di IPAddress: primo ottetto nel byte basso
+        CHECK_EQ((uint32_t)parsed(c, "192.168.1.2", &ok), 0x0201A8C0u);
+        CHECK_EQ((uint32_t)parsed(c, "255.255.255.255", &ok), 0xFFFFFFFFu);
+        break;
+      }
+    }
+    CHECK(!ctrl_parse(c, nullptr, &v));
+  }
+
+  // ---- IPv4: valore -> "a.b.c.d" -> valore ----
+  const ctrl_cmd_t* ipc = &cmds[CTRL_KEY_COUNT - 1];
+  CHECK_EQ(ipc->kind, CTRL_IPV4);
+  std::mt19937 rng(31);
+  char buf[24];
+  const uint32_t edges[] = {1u, 0xFF000000u, 0x00FF0000u, 0xFFFFFFFFu};
+  for (int n = 0; n < 20000; n++) {
+    uint32_t ip = n < 4 ? edges[n] : (uint32_t)rng();
+    if (!ip) continue;
+    size_t len = ctrl_format(ipc, (int32_t)ip, buf, sizeof(buf));
+    CHECK_EQ(len, strlen(buf));
+    bool ok;
+    uint32_t back = (uint32_t)parsed(ipc, buf, &ok);
+    if (!ok || back != ip) {
+      fprintf(stderr, "ipv4 %08x -> \"%s\" -> %08x\n", ip, buf, back);
+      CHECK(false);
+      break;
+    }
+  }
+  CHECK_EQ(ctrl_format(ipc, 0, buf, sizeof(buf)), 0);
+  CHECK_EQ(buf[0], 0);
+  CHECK_EQ(ctrl_format(ipc, (int32_t)0x0201A8C0u, buf, 8), 7);   // troncato, sempre terminato
+  CHECK(!strcmp(buf, "192.168"));
+
+  // ---- valore corrente e payload di stato ----
+  ctrl_cmd_t* bit = nullptr;
+  for (ctrl_cmd_t& c : cmds) if (c.kind == CTRL_BIT) { bit = &c; break; }
+  int* bits = (int*)bit->var;
+  *bits = 0x7F & ~bit->min;
+  CHECK_EQ(ctrl_current(bit), 0);
+  *bits = bit->min;
+  CHECK_EQ(ctrl_current(bit), 1);
+  CHECK_EQ(ctrl_format(bit, 1, buf, sizeof(buf)), 2);
+  CHECK(!strcmp(buf, "ON"));
+  ips[CTRL_KEY_COUNT - 1] = 0x0100000Au;
+  CHECK_EQ(ctrl_current(ipc), 0x0100000A);
+  ctrl_format(&cmds[1], -2, buf, sizeof(buf));
+  CHECK(!strcmp(buf, "-2"));
+
+  return check_result("test_ctrl");
+}
@@ -0,0 +1,159 @@
+// Comandi MQTT sul firmware: il device pubblica lo stato di esattamente le 34
+// chiavi di ctrl_keys.h, ogni "<key>/set" fuori limite torna limitato nello
+// stato retained, i payload non validi e i topic sconosciuti non cambiano nulla.
+#include "check.h"
+#include "client.h"
+#include "ctrl_keys.h"
+#include "sim.h"
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+namespace {
+
+const std::string CTRL = SIM_BASE_TOPIC "/ctrl/";
+
+struct State {
+  int         publishes = 0;
+  std::string value;
+};
+
+std::mutex s_m;
+std::map<std::string, State> s_state;
+
+void sleep_ms(int ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+int publishes(const std::string& key) {
+  std::lock_guard<std::mutex> lk(s_m);
+  return s_state[key].publishes;
+}
+
+std::string value(const std::string& key) {
+  std::lock_guard<std::mutex> lk(s_m);
+  return s_state[key].value;
+}
+
+// comando e attesa del nuovo stato; "<timeout>" se non arriva
+std::string set(const std::string& key, const std::string& payload) {
+  int before = publishes(key);
+  sim_broker_publish((CTRL + key + "/set").c_str(), payload, false);
+  for (int t = 0; t < 3000; t += 10) {
+    if (publishes(key) > before) return value(key);
+    sleep_ms(10);
+  }
+  fprintf(stderr, "%s=%s: nessuno stato\n", key.c_str(), payload.c_str());
+  return "<timeout>";
+}
+
+void expect(const std::string& key, const std::string& payload, const std::string& want) {
+  std::string got = set(key, payload);
+  if (got != want) {
+    fprintf(stderr, "%s=\"%s\": stato \"%s\", atteso \"%s\"\n", key.c_str(), payload.c_str(), got.c_str(), want.c_str());
+    check_failures()++;
+  }
+}
+
+}  // namespace
+
+int main() {
+  sim_set_http_port(0);
+  int sub = sim_broker_subscribe((CTRL + "+").c_str(), [](const std::string& t, const std::string& p, bool) {
+    std::lock_guard<std::mutex> lk(s_m);
+    State& s = s_state[t.substr(CTRL.size())];
+    s.publishes++;
+    s.value = p;
+  });
+  if (!sim_boot_online(10000)) {
+    fprintf(stderr, "firmware non online\n");
+    sim_exit(2);
+  }
+  for (int t = 0; t < 3000 && publishes("dns") == 0; t += 10) sleep_ms(10);
+
+  // ---- stato retained di esattamente le chiavi attese ----
+  std::set<std::string> keys, published;
+  for (const ctrl_key_t& k : CTRL_KEYS) keys.insert(k.key);
+  {
+    std::lock_guard<std::mutex> lk(s_m);
+    for (auto& kv : s_state) published.insert(kv.first);
+  }
+  CHECK_EQ(keys.size(), 34);
+  for (const std::string& k : keys) if (!published.count(k)) fprintf(stderr, "nessuno stato per %s\n", k.c_str());
+  for (const std::string& k : published) if (!keys.count(k)) fprintf(stderr, "chiave in più: %s\n", k.c_str());
+  CHECK(keys == published);
+
+  std::map<std::string, std::string> initial;
+  for (const std::string& k : keys) initial[k] = value(k);
+
+  // ---- payload non validi e topic sconosciuti: nessuno stato cambia ----
+  std::map<std::string, int> before;
+  for (const std::string& k : keys) before[k] = publishes(k);
+  for (const ctrl_key_t& k : CTRL_KEYS) {
+    const char* bad = k.kind == CTRL_IPV4 ? "1.2.3.256" : k.kind == CTRL_FRAMESIZE ? "bogus" : k.kind == CTRL_INT ? "abc" : "maybe";
+    sim_broker_publish((CTRL + k.key + "/set").c_str(), bad, false);
+  }
+  sim_broker_publish((CTRL + "framesize/set").c_str(), "99", false);   // numero fuori da FS_NAMES
+  sim_broker_publish((CTRL + "nope/set").c_str(), "1", false);
+  sim_broker_publish((CTRL + "quality/set/x").c_str(), "20", false);
+  // in coda, un comando valido: quando il suo stato arriva, gli altri sono passati
+  CHECK(set("snapshot_max_age_ms", initial["snapshot_max_age_ms"]) == initial["snapshot_max_age_ms"]);
+  for (const std::string& k : keys) {
+    if (k == "snapshot_max_age_ms") continue;
+    if (publishes(k) != before[k]) fprintf(stderr, "%s ripubblicato dopo un comando non valido\n", k.c_str());
+    CHECK_EQ(publishes(k), before[k]);
+  }
+
+  // ---- ogni chiave: limiti e formati ----
+  for (const ctrl_key_t& k : CTRL_KEYS) {
+    std::string key = k.key;
+    switch (k.kind) {
+      case CTRL_INT: {
+        // roi_x: il setter tiene la finestra nel campo (x <= 100 - w)
+        int hi = key == "roi_x" ? 100 - atoi(value("roi_w").c_str()) : k.max;
+        expect(key, std::to_string((long long)k.max + 1000), std::to_string(hi));
+        expect(key, std::to_string((long long)k.min - 1000), std::to_string(k.min));
+        expect(key, std::to_string(k.min), std::to_string(k.min));
+        break;
+      }
+      case CTRL_BOOL:
+      case CTRL_BIT:
+        expect(key, "on", "ON");
+        expect(key, "0", "OFF");
+        expect(key, "true", "ON");
+        expect(key, "OFF", "OFF");
+        break;
+      case CTRL_FRAMESIZE:
+        expect(key, "QVGA", "qvga");
+        expect(key, "8", "vga");
+        expect(key, "qqvga", "qqvga");
+        break;
+      case CTRL_IPV4:
+        break;   // sotto, in ordine
+    }
+    expect(key, initial[key], initial[key]);
+  }
+
+  // i bit ROI sono indipendenti
+  expect("roi_stream", "ON", "ON");
+  expect("roi_snapshot", "ON", "ON");
+  expect("roi_stream", "OFF", "OFF");
+  CHECK(value("roi_snapshot") == "ON");
+  expect("roi_snapshot", initial["roi_snapshot"], initial["roi_snapshot"]);
+  expect("roi_stream", initial["roi_stream"], initial["roi_stream"]);
+
+  // ---- IPv4: andata e ritorno; l'IP statico vale solo con gateway e subnet ----
+  expect("static_ip", "192.168.1.50", "");
+  expect("gateway", "192.168.1.1", "192.168.1.1");
+  expect("subnet", "255.255.255.0", "255.255.255.0");
+  expect("dns", "1.1.1.1", "1.1.1.1");
+  expect("static_ip", "192.168.1.50", "192.168.1.50");
+  expect("static_ip", "10.0.255.254", "10.0.255.254");
+  expect("static_ip", "", "");   // DHCP
+  for (const char* k : {"gateway", "subnet", "dns", "static_ip"}) expect(k, initial[k], initial[k]);
+
+  sim_broker_unsubscribe(sub);
+  sim_exit(check_result("test_ctrl_mqtt"));
+}
@@ -0,0 +1,230 @@
+// Indice eventi PIR: paginazione con il cursore (nessun evento perso o
+// ripetuto), evento aperto che ricompare, anello pieno che gira più volte,
+// millis() che riparte da 0, ev_format_json su buffer troppo piccoli.
+#include "check.h"
+#include "birdcam_events.h"
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Eventi "a raffica": burst catture consecutive, poi una pausa oltre EV_GAP_MS
+struct Feed {
+  ev_index_t x;
+  uint32_t   next_id = 1;
+  uint32_t   now_ms = 1000;
+  Feed() { ev_init(&x); }
+  uint32_t event(int burst) {
+    now_ms += EV_GAP_MS + 1;
+    uint32_t first = next_id;
+    for (int i = 0; i < burst; i++) {
+      ev_add_capture(&x, next_id++, 0, now_ms, nullptr);
+      now_ms += 2000;
+    }
+    return first;
+  }
+};
+
+// tutte le pagine da since in poi: ids degli eventi in ordine
+std::vector<uint32_t> drain(const Feed& f, uint32_t* since, int page) {
+  std::vector<uint32_t> ids;
+  ev_event_t out[EV_MAX];
+  for (int guard = 0; guard < 100; guard++) {
+    int n = ev_since(&f.x, *since, f.now_ms, out, page);
+    if (n == 0) break;
+    for (int i = 0; i < n; i++) {
+      if (i > 0) CHECK(out[i].id > out[i - 1].last_id);   // dal più vecchio
+      ids.push_back(out[i].id);
+    }
+    *since = out[n - 1].last_id;
+  }
+  return ids;
+}
+
+}  // namespace
+
+int main() {
+  // ---- raggruppamento ----
+  {
+    Feed f;
+    uint32_t a = f.event(3);
+    CHECK_EQ(f.x.count, 1);
+    CHECK_EQ(f.x.ev[f.x.head].id, a);
+    CHECK_EQ(f.x.ev[f.x.head].last_id, a + 2);
+    CHECK_EQ(f.x.ev[f.x.head].end_ms - f.x.ev[f.x.head].start_ms, 4000);
+    // id non consecutivo (cattura scartata): evento nuovo anche entro 30 s
+    ev_add_capture(&f.x, f.next_id + 1, 0, f.now_ms, nullptr);
+    CHECK_EQ(f.x.count, 2);
+    CHECK(ev_add_capture(&f.x, 0, 0, f.now_ms, nullptr) == nullptr);
+    CHECK_EQ(f.x.count, 2);
+
+    // millis() che riparte da 0 a metà evento
+    Feed w;
+    w.now_ms = 0xFFFFFFFFu - 1000 - EV_GAP_MS;
+    w.event(2);                                  // seconda cattura dopo il giro
+    CHECK(w.now_ms < 10000);
+    CHECK_EQ(w.x.count, 1);
+    CHECK_EQ(w.x.ev[w.x.head].end_ms - w.x.ev[w.x.head].start_ms, 2000);
+  }
+
+  // ---- punteggio di movimento ----
+  {
+    ev_index_t x;
+    ev_init(&x);
+    uint8_t s0[SCENE_CELLS], s1[SCENE_CELLS];
+    memset(s0, 100, sizeof(s0));
+    memcpy(s1, s0, sizeof(s1));
+    for (int i = 0; i < SCENE_CELLS / 2; i++) s1[i] = 200;
+    ev_add_capture(&x, 1, 0, 1000, s0);
+    CHECK_EQ(x.ev[x.head].score, 0);
+    ev_add_capture(&x, 2, 0, 2000, s1);
+    int big = x.ev[x.head].score;
+    CHECK(big >= 40);
+    ev_add_capture(&x, 3, 0, 3000, s1);           // il massimo resta
+    CHECK_EQ(x.ev[x.head].score, big);
+    ev_add_capture(&x, 4, 0, 4000, nullptr);      // decodifica fallita: nessun confronto dopo
+    ev_add_capture(&x, 5, 0, 5000 + EV_GAP_MS + 1, s0);
+    CHECK_EQ(x.count, 2);
+    CHECK_EQ(x.ev[x.head].score, 0);
+  }
+
+  // ---- paginazione con il cursore ----
+  {
+    Feed f;
+    std::vector<uint32_t> all;
+    for (int i = 0; i < 10; i++) all.push_back(f.event(1 + i % 4));
+    for (int page = 1; page <= 12; page++) {
+      uint32_t since = 0;
+      std::vector<uint32_t> got = drain(f, &since, page);
+      if (got != all) fprintf(stderr, "pagina da %d: %zu eventi su %zu\n", page, got.size(), all.size());
+      CHECK(got == all);
+      CHECK_EQ(since, f.next_id - 1);
+    }
+    // cursore a metà di un evento: l'evento torna, con tutte le sue catture
+    ev_event_t out[EV_MAX];
+    uint32_t mid = all[6] + 1;                    // evento 6: 3 catture
+    int n = ev_since(&f.x, mid, f.now_ms, out, EV_MAX);
+    CHECK_EQ(n, 4);
+    CHECK_EQ(out[0].id, all[6]);
+
+    // cursore fermo sull'ultimo: niente; l'evento aperto ricompare se cresce
+    uint32_t since = f.next_id - 1;
+    CHECK_EQ(ev_since(&f.x, since, f.now_ms, out, EV_MAX), 0);
+    f.now_ms += 1000;
+    ev_add_capture(&f.x, f.next_id++, 0, f.now_ms, nullptr);
+    n = ev_since(&f.x, since, f.now_ms, out, EV_MAX);
+    CHECK_EQ(n, 1);
+    CHECK_EQ(out[0].id, all.back());
+    CHECK_EQ(out[0].last_id, f.next_id - 1);
+    CHECK(out[0].open);
+    n = ev_since(&f.x, since, f.now_ms + EV_GAP_MS + 1, out, EV_MAX);
+    CHECK_EQ(n, 1);
+    CHECK(!out[0].open);                          // chiuso per tempo, non per nuove catture
+    // solo l'ultimo evento può essere aperto
+    n = ev_since(&f.x, 0, f.now_ms, out, EV_MAX);
+    for (int i = 0; i + 1 < n; i++) CHECK(!out[i].open);
+  }
+
+  // ---- anello: più di EV_MAX eventi, head che gira tre volte ----
+  {
+    Feed f;
+    std::vector<uint32_t> all;
+    for (int i = 0; i < 3 * EV_MAX + 5; i++) all.push_back(f.event(1 + i % 3));
+    CHECK_EQ(f.x.count, EV_MAX);
+    std::vector<uint32_t> kept(all.end() - EV_MAX, all.end());
+    for (int page : {1, 5, 7, EV_MAX, EV_MAX + 3}) {
+      uint32_t since = 0;                         // cursore più vecchio dell'anello
+      std::vector<uint32_t> got = drain(f, &since, page);
+      CHECK(got == kept);
+    }
+    // cursore a cavallo: solo quelli dopo, nessun duplicato
+    uint32_t since = kept[EV_MAX - 4] - 1;
+    CHECK((drain(f, &since, 2) == std::vector<uint32_t>(kept.end() - 4, kept.end())));
+
+    // giro a metà della paginazione: i nuovi arrivano in coda, i caduti si perdono
+    Feed g;
+    std::vector<uint32_t> first;
+    for (int i = 0; i < EV_MAX; i++) first.push_back(g.event(1));
+    ev_event_t out[4];
+    int n = ev_since(&g.x, 0, g.now_ms, out, 4);
+    CHECK_EQ(n, 4);
+    uint32_t cur = out[3].last_id;
+    std::vector<uint32_t> more;
+    for (int i = 0; i < 6; i++) more.push_back(g.event(2));
+    // i 6 nuovi sovrascrivono i primi 6: letti i primi 4, si perdono il 5° e il 6°
+    std::vector<uint32_t> rest = drain(g, &cur, 5);
+    CHECK_EQ(rest.size(), EV_MAX);
+    CHECK_EQ(rest.front(), first[6]);
+    CHECK(std::vector<uint32_t>(rest.end() - 6, rest.end()) == more);
+    for (size_t i = 1; i < rest.size(); i++) CHECK(rest[i] > rest[i - 1]);
+  }
+
+  // ---- ora sincronizzata dopo gli eventi ----
+  {
+    Feed f;
+    f.event(2);
+    uint32_t end_ms = f.x.ev[f.x.head].end_ms, start_ms = f.x.ev[f.x.head].start_ms;
+    time_t now = 1760000000;
+    uint32_t now_ms = end_ms + 5000;
+    ev_time_synced(&f.x, now, now_ms);
+    CHECK_EQ(f.x.ev[f.x.head].end_ts, now - 5);
+    CHECK_EQ(f.x.ev[f.x.head].start_ts, now - (time_t)((now_ms - start_ms) / 1000));
+    ev_time_synced(&f.x, now + 100, now_ms + 100000);   // già sincronizzati: invariati
+    CHECK_EQ(f.x.ev[f.x.head].end_ts, now - 5);
+  }
+
+  // ---- ev_format_json ----
+  {
+    ev_event_t e = {};
+    e.id = 100;
+    e.last_id = 149;
+    e.start_ts = 1760000000;
+    e.end_ts = 1760000049;
+    e.start_ms = 5000;
+    e.end_ms = 54000;
+    e.score = 37;
+    e.open = true;
+    char buf[512];
+    size_t len = ev_format_json(&e, 0, buf, sizeof(buf));
+    CHECK(std::string(buf, len) ==
+          "{\"event\":100,\"first\":100,\"last\":149,\"captures\":50,\"start\":1760000000,"
+          "\"end\":1760000049,\"duration_ms\":49000,\"score\":37,\"open\":true}");
+
+    // "new": al più gli ultimi EV_JSON_MAX_NEW, e non prima dell'evento
+    std::string tail20;
+    for (uint32_t id = 130; id <= 149; id++) tail20 += (id == 130 ? "" : ",") + std::to_string(id);
+    len = ev_format_json(&e, 1, buf, sizeof(buf));
+    CHECK(std::string(buf).find(",\"new\":[" + tail20 + "]}") != std::string::npos);
+    CHECK_EQ(len, strlen(buf));
+    len = ev_format_json(&e, 147, buf, sizeof(buf));
+    CHECK(std::string(buf).find(",\"new\":[147,148,149]}") != std::string::npos);
+    len = ev_format_json(&e, 150, buf, sizeof(buf));
+    CHECK(std::string(buf).find(",\"new\":[]}") != std::string::npos);
+
+    // ogni capacità: o l'oggetto intero o 0, mai un byte oltre cap
+    for (uint32_t nf : {0u, 1u, 148u}) {
+      std::string full(buf, ev_format_json(&e, nf, buf, sizeof(buf)));
+      for (size_t cap = 0; cap <= full.size() + 2; cap++) {
+        char b[512];
+        memset(b, '#', sizeof(b));
+        size_t n = ev_format_json(&e, nf, b, cap);
+        if (cap > full.size()) {
+          CHECK_EQ(n, full.size());
+          CHECK(std::string(b, n) == full);
+          CHECK_EQ(b[n], 0);
+        } else {
+          if (n != 0) fprintf(stderr, "cap %zu: %zu invece di 0\n", cap, n);
+          CHECK_EQ(n, 0);
+        }
+        for (size_t i = cap; i < sizeof(b); i++) {
+          if (b[i] != '#') { fprintf(stderr, "cap %zu: scritto b[%zu]\n", cap, i); CHECK(false); break; }
+        }
+      }
+    }
+    CHECK_EQ(ev_format_json(nullptr, 0, buf, sizeof(buf)), 0);
+  }
+
+  return check_result("test_events");
+}
@@ -0,0 +1,142 @@
+// Round-trip tar/zip: archivi costruiti con birdcam_export come fanno
+// /archive.tar e /archive.zip, riletti con archive_check.h (controlli di
+// tar -t / unzip -t, CRC-32 ricalcolato sui dati).
+#include "check.h"
+#include "archive_check.h"
+#include "birdcam_export.h"
+
+#include <random>
+
+namespace {
+
+struct File {
+  uint32_t    id;
+  time_t      ts;
+  std::string data;
+};
+
+std::string build_tar(const std::vector<File>& files) {
+  std::string out;
+  uint8_t hdr[TAR_BLOCK];
+  char name[40];
+  for (const File& f : files) {
+    export_snap_name(name, sizeof(name), f.id, f.ts);
+    tar_write_header(hdr, name, (uint32_t)f.data.size(), f.ts);
+    out.append((const char*)hdr, TAR_BLOCK);
+    out += f.data;
+    out.append(tar_pad_len((uint32_t)f.data.size()), '\0');
+  }
+  out.append(2 * TAR_BLOCK, '\0');
+  return out;
+}
+
+std::string build_zip(const std::vector<File>& files) {
+  std::string out;
+  uint8_t hdr[ZIP_CENTRAL_LEN + 40];
+  char name[40];
+  std::vector<uint32_t> offsets;
+  for (const File& f : files) {
+    export_snap_name(name, sizeof(name), f.id, f.ts);
+    uint32_t crc = bc_crc32(0, (const uint8_t*)f.data.data(), f.data.size());
+    offsets.push_back((uint32_t)out.size());
+    out.append((const char*)hdr, zip_write_local(hdr, name, (uint32_t)f.data.size(), crc, f.ts));
+    out += f.data;
+  }
+  uint32_t cd_off = (uint32_t)out.size();
+  for (size_t i = 0; i < files.size(); i++) {
+    const File& f = files[i];
+    export_snap_name(name, sizeof(name), f.id, f.ts);
+    uint32_t crc = bc_crc32(0, (const uint8_t*)f.data.data(), f.data.size());
+    out.append((const char*)hdr, zip_write_central(hdr, name, (uint32_t)f.data.size(), crc, f.ts, offsets[i]));
+  }
+  out.append((const char*)hdr, zip_write_end(hdr, (uint16_t)files.size(), (uint32_t)out.size() - cd_off, cd_off));
+  return out;
+}
+
+void check_roundtrip(const std::vector<File>& files) {
+  char name[40];
+  std::vector<arch_entry_t> t, z;
+  std::string err;
+  bool tok = tar_list(build_tar(files), &t, &err);
+  if (!tok) fprintf(stderr, "tar: %s\n", err.c_str());
+  CHECK(tok);
+  bool zok = zip_test(build_zip(files), &z, &err);
+  if (!zok) fprintf(stderr, "zip: %s\n", err.c_str());
+  CHECK(zok);
+  CHECK_EQ(t.size(), files.size());
+  CHECK_EQ(z.size(), files.size());
+  for (size_t i = 0; i < files.size() && i < t.size() && i < z.size(); i++) {
+    export_snap_name(name, sizeof(name), files[i].id, files[i].ts);
+    CHECK(t[i].name == name);
+    CHECK(z[i].name == name);
+    CHECK(t[i].data == files[i].data);
+    CHECK(z[i].data == files[i].data);
+    CHECK_EQ(t[i].mtime, files[i].ts > 0 ? (uint32_t)files[i].ts : 0);
+    CHECK_EQ(z[i].mtime, arch_dos_time(files[i].ts));
+  }
+}
+
+void test_crc32() {
+  const char* v = "123456789";
+  CHECK_EQ(bc_crc32(0, (const uint8_t*)v, 9), 0xCBF43926u);
+  CHECK_EQ(bc_crc32(0, nullptr, 0), 0);
+  // concatenabile: crc(a+b) = crc(crc(a), b)
+  uint32_t c = bc_crc32(0, (const uint8_t*)v, 4);
+  CHECK_EQ(bc_crc32(c, (const uint8_t*)v + 4, 5), 0xCBF43926u);
+  std::mt19937 rng(32);
+  std::string s(10000, '\0');
+  for (auto& ch : s) ch = (char)rng();
+  CHECK_EQ(bc_crc32(0, (const uint8_t*)s.data(), s.size()), arch_crc32(s));
+}
+
+void test_tar_pad() {
+  CHECK_EQ(tar_pad_len(0), 0);
+  CHECK_EQ(tar_pad_len(1), 511);
+  CHECK_EQ(tar_pad_len(511), 1);
+  CHECK_EQ(tar_pad_len(512), 0);
+  CHECK_EQ(tar_pad_len(513), 511);
+}
+
+// un header corrotto deve essere rifiutato dal lettore (il test vede gli errori)
+void test_reader_rejects() {
+  std::vector<File> files = {{1, 1760000000, std::string(700, 'x')}};
+  std::string tar = build_tar(files), zip = build_zip(files);
+  std::vector<arch_entry_t> out;
+  std::string err;
+  std::string bad = tar;
+  bad[10] ^= 1;
+  CHECK(!tar_list(bad, &out, &err));
+  CHECK(!tar_list(tar.substr(0, tar.size() - 512), &out, &err));
+  bad = zip;
+  bad[30 + 22 + 5] ^= 1;                    // un byte dei dati: CRC
+  CHECK(!zip_test(bad, &out, &err));
+  CHECK(err.find("CRC") != std::string::npos);
+}
+
+}  // namespace
+
+int main() {
+  setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
+  tzset();
+  test_crc32();
+  test_tar_pad();
+  test_reader_rejects();
+
+  check_roundtrip({});
+  std::mt19937 rng(32);
+  for (int round = 0; round < 20; round++) {
+    std::vector<File> files;
+    int n = (int)(rng() % 21);              // fino a 20, come export_pin
+    for (int i = 0; i < n; i++) {
+      File f;
+      f.id = rng() % 100000;
+      f.ts = (i % 5 == 0) ? 0 : (time_t)(1700000000 + rng() % 100000000);
+      size_t len = rng() % 4 == 0 ? 512 * (rng() % 4) : rng() % 20000;   // anche multipli esatti e 0
+      f.data.resize(len);
+      for (auto& ch : f.data) ch = (char)rng();
+      files.push_back(f);
+    }
+    check_roundtrip(files);
+  }
+  return check_result("test_export");
+}
@@ -0,0 +1,170 @@
+// Kernel SWAR contro i riferimenti scalari, bit per bit: dimensioni casuali,
+// buffer con tutti i disallineamenti 0..3 (anche fra sorgente e destinazione),
+// luma sul posto, griglie con più celle che pixel, delta 0 e 255.
+#include "check.h"
+#include "birdcam_kernels.h"
+
+#include <stdarg.h>
+#include <string.h>
+#include <random>
+#include <vector>
+
+namespace {
+
+std::mt19937 rng(41);
+
+int rnd(int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); }
+
+// n byte a offset off da un indirizzo allineato a 16
+struct Buf {
+  std::vector<uint8_t> mem;
+  uint8_t* p;
+  Buf(size_t n, int off) : mem(n + 32) {
+    uintptr_t a = ((uintptr_t)mem.data() + 15) & ~(uintptr_t)15;
+    p = (uint8_t*)a + off;
+  }
+};
+
+void fill(uint8_t* p, size_t n) {
+  for (size_t i = 0; i < n; i++) p[i] = (uint8_t)rng();
+}
+
+// scena con zone uniformi (istogramma con picchi) e rumore
+void fill_scene(uint8_t* p, size_t n) {
+  uint8_t v = (uint8_t)rng();
+  for (size_t i = 0; i < n; i++) {
+    if ((rng() & 63) == 0) v = (uint8_t)rng();
+    p[i] = (rng() & 7) ? v : (uint8_t)rng();
+  }
+}
+
+int fails = 0;
+
+// kernel e caso che ha dato un risultato diverso dal riferimento
+__attribute__((format(printf, 2, 3)))
+void report(const char* k, const char* fmt, ...) {
+  if (fails++ < 10) {
+    char what[96];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(what, sizeof(what), fmt, ap);
+    va_end(ap);
+    fprintf(stderr, "%s diverso: %s\n", k, what);
+  }
+  check_failures()++;
+}
+
+uint32_t fake_cycles() {
+  static uint32_t t = 0;
+  return t += 1000;
+}
+
+}  // namespace
+
+int main() {
+  // ---- luma: n casuale, sorgente e destinazione disallineate ----
+  for (int it = 0; it < 400; it++) {
+    size_t n = (size_t)(it < 40 ? it : rnd(0, 5000));
+    int so = rnd(0, 3), yo = rnd(0, 3);
+    Buf src(n * 2, so), a(n, yo), b(n, yo);
+    fill(src.p, n * 2);
+    kern_luma_ref(src.p, n, a.p);
+    kern_luma(src.p, n, b.p);
+    if (memcmp(a.p, b.p, n)) report("luma", "n=%d src+%d y+%d", (int)n, so, yo);
+  }
+
+  // ---- luma sul posto (y == rgb565, come in birdcam_scene) ----
+  for (int it = 0; it < 200; it++) {
+    size_t n = (size_t)rnd(0, 3000);
+    int off = rnd(0, 3);
+    Buf ref(n * 2, off), in(n * 2, off);
+    fill(in.p, n * 2);
+    memcpy(ref.p, in.p, n * 2);
+    kern_luma_ref(ref.p, n, ref.p);
+    kern_luma(in.p, n, in.p);
+    if (memcmp(ref.p, in.p, n)) report("luma in-place", "n=%d +%d", (int)n, off);
+  }
+
+  // ---- griglia: w, h, gw, gh casuali (anche gw > w e gw > KERN_GRID_MAX_W) ----
+  for (int it = 0; it < 300; it++) {
+    int w = rnd(1, it < 150 ? 40 : 700), h = rnd(1, it < 150 ? 40 : 300);
+    int gw = rnd(1, KERN_GRID_MAX_W + 4), gh = rnd(1, 24);
+    int off = rnd(0, 3);
+    Buf src((size_t)w * h * 2, off);
+    fill(src.p, (size_t)w * h * 2);
+    std::vector<uint8_t> a((size_t)gw * gh, 0xAA), b((size_t)gw * gh, 0x55);
+    kern_luma_grid_ref(src.p, w, h, gw, gh, a.data());
+    kern_luma_grid(src.p, w, h, gw, gh, b.data());
+    if (a != b) report("luma_grid", "%dx%d griglia %dx%d +%d", w, h, gw, gh, off);
+  }
+
+  // ---- diff: a e b disallineati in modo indipendente, delta ai bordi ----
+  for (int it = 0; it < 600; it++) {
+    size_t n = (size_t)(it < 64 ? it : rnd(0, 70000));   // oltre le 16384 parole per blocco
+    int ao = rnd(0, 3), bo = rnd(0, 3);
+    Buf a(n, ao), b(n, bo);
+    fill_scene(a.p, n);
+    for (size_t i = 0; i < n; i++) b.p[i] = (rng() & 1) ? a.p[i] : (uint8_t)(a.p[i] + rnd(-40, 40));
+    if (it % 7 == 0) for (size_t i = 0; i < n; i++) b.p[i] = (uint8_t)~a.p[i];   // |a-b| fino a 255
+    int delta = it % 5 == 0 ? 0 : it % 5 == 1 ? 255 : rnd(0, 255);
+    uint32_t r = kern_diff_count_ref(a.p, b.p, n, (uint8_t)delta);
+    uint32_t f = kern_diff_count(a.p, b.p, n, (uint8_t)delta);
+    if (r != f) report("diff_count", "n=%d a+%d b+%d delta=%d", (int)n, ao, bo, delta);
+  }
+
+  // ---- istogramma ----
+  for (int it = 0; it < 300; it++) {
+    size_t n = (size_t)(it < 32 ? it : rnd(0, 100000));
+    int off = rnd(0, 3);
+    Buf y(n, off);
+    if (it & 1) fill_scene(y.p, n);
+    else fill(y.p, n);
+    uint32_t a[256], b[256];
+    memset(b, 0xFF, sizeof(b));   // deve azzerarlo il kernel
+    kern_histogram_ref(y.p, n, a);
+    kern_histogram(y.p, n, b);
+    if (memcmp(a, b, sizeof(a))) report("histogram", "n=%d +%d", (int)n, off);
+  }
+  {
+    // un solo livello per tutto il frame (dipendenza fra incrementi)
+    Buf y(640 * 480, 1);
+    memset(y.p, 77, 640 * 480);
+    uint32_t a[256];
+    kern_histogram(y.p, 640 * 480, a);
+    CHECK_EQ(a[77], 640 * 480);
+  }
+
+  // ---- rotate90: w, h casuali, tile parziali, src/dst pari e dispari ----
+  for (int it = 0; it < 300; it++) {
+    int w = rnd(1, 90), h = rnd(1, 90);
+    int so = rnd(0, 3), doff = rnd(0, 3);
+    bool cw = it & 1;
+    size_t bytes = (size_t)w * h * 2;
+    Buf src(bytes, so), a(bytes, doff), b(bytes, doff);
+    fill(src.p, bytes);
+    kern_rotate90_ref(src.p, w, h, a.p, cw);
+    kern_rotate90(src.p, w, h, b.p, cw);
+    if (memcmp(a.p, b.p, bytes)) report(cw ? "rotate90 cw" : "rotate90 ccw", "%dx%d src+%d dst+%d", w, h, so, doff);
+  }
+  {
+    // orario poi antiorario = identità
+    int w = 37, h = 23;
+    Buf src((size_t)w * h * 2, 0), r((size_t)w * h * 2, 0), back((size_t)w * h * 2, 0);
+    fill(src.p, (size_t)w * h * 2);
+    kern_rotate90(src.p, w, h, r.p, true);
+    kern_rotate90(r.p, h, w, back.p, false);
+    CHECK(memcmp(src.p, back.p, (size_t)w * h * 2) == 0);
+  }
+
+  // ---- self-check del firmware (/api/kernels) ----
+  kern_bench_t kb[KERN_BENCH_COUNT];
+  int n = kern_bench(fake_cycles, 97, 61, kb, KERN_BENCH_COUNT);
+  CHECK_EQ(n, KERN_BENCH_COUNT);
+  for (int i = 0; i < n; i++) {
+    if (!kb[i].exact) fprintf(stderr, "kern_bench %s non esatto\n", kb[i].name);
+    CHECK(kb[i].exact);
+  }
+  CHECK_EQ(kern_bench(fake_cycles, 8, 8, kb, KERN_BENCH_COUNT), 0);
+
+  return check_result("test_kernels");
+}
@@ -0,0 +1,131 @@
+// mjpeg_handler con un client lento (socket strozzato) accanto a uno veloce:
+// - il lento riceve solo JPEG interi e gli slot persi sono contati come
+//   skipped, non accodati (inviati ~ ricevuti, a meno di ciò che sta nei buffer)
+// - il veloce tiene i suoi fps
+// - un lettore fermo non blocca l'httpd e alla chiusura libera lo slot
+#include "check.h"
+#include "client.h"
+#include "sim.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace {
+
+const int FAST_FPS = 10;
+const int SLOW_FPS = 12;             // distinto per riconoscerlo in /api/streams
+const int SLOW_RATE = 4000;          // byte/s: ~1-2 frame QVGA al secondo
+const int SLOW_RCVBUF = 4096;
+const int LWIP_SND_BUF = 5760;       // come il fake httpd (Linux raddoppia entrambi)
+const int RUN_MS = 5000;
+
+void sleep_ms(int ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+bool is_jpeg(const std::string& j) {
+  return j.size() > 4 && (uint8_t)j[0] == 0xFF && (uint8_t)j[1] == 0xD8 &&
+         (uint8_t)j[j.size() - 2] == 0xFF && (uint8_t)j[j.size() - 1] == 0xD9;
+}
+
+// campo numerico "key":N dell'oggetto di /api/streams con "fps":fps
+long stream_field(int fps, const char* key) {
+  http_resp_t r;
+  if (!http_get(sim_http_port(), "/api/streams", &r) || r.status != 200) return -1;
+  char tag[24];
+  snprintf(tag, sizeof(tag), "\"fps\":%d,", fps);
+  size_t at = r.body.find(tag);
+  if (at == std::string::npos) return -1;
+  size_t end = r.body.find('}', at);
+  std::string k = std::string("\"") + key + "\":";
+  size_t f = r.body.find(k, at);
+  if (f == std::string::npos || f > end) return -1;
+  return strtol(r.body.c_str() + f + k.size(), nullptr, 10);
+}
+
+}  // namespace
+
+int main() {
+  sim_set_http_port(0);
+  if (!sim_boot_online(10000)) {
+    fprintf(stderr, "firmware non online\n");
+    sim_exit(2);
+  }
+
+  std::atomic<bool> stop{false};
+  std::atomic<int> fast_frames{0}, fast_bad{0};
+  std::thread fast([&] {
+    MjpegReader rd;
+    char path[32];
+    snprintf(path, sizeof(path), "/mjpeg?fps=%d", FAST_FPS);
+    if (!rd.open(sim_http_port(), path)) {
+      fast_bad++;
+      return;
+    }
+    std::string jpg;
+    while (!stop && rd.next(&jpg)) {
+      if (!is_jpeg(jpg)) fast_bad++;
+      fast_frames++;
+    }
+  });
+
+  MjpegReader slow;
+  char path[32];
+  snprintf(path, sizeof(path), "/mjpeg?fps=%d", SLOW_FPS);
+  int fd_ok = slow.open(sim_http_port(), path);
+  CHECK(fd_ok);
+  sim_sock_set_rcvbuf(slow.fd(), SLOW_RCVBUF);
+  slow.throttle(SLOW_RATE);
+
+  // fase 1: lettura strozzata
+  int slow_frames = 0, slow_bad = 0;
+  size_t slow_bytes = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  std::string jpg;
+  while (std::chrono::steady_clock::now() - t0 < std::chrono::milliseconds(RUN_MS)) {
+    if (!slow.next(&jpg, 3000)) break;
+    if (!is_jpeg(jpg)) slow_bad++;
+    slow_frames++;
+    slow_bytes += jpg.size();
+  }
+  long sent = stream_field(SLOW_FPS, "sent");
+  long skipped = stream_field(SLOW_FPS, "skipped");
+  int fast_in_window = fast_frames;
+
+  printf("slow: %d frame (%zu B) ricevuti, sent=%ld skipped=%ld; fast: %d frame in %d ms\n",
+         slow_frames, slow_bytes, sent, skipped, fast_in_window, RUN_MS);
+  CHECK(slow_frames >= 1);
+  CHECK_EQ(slow_bad, 0);
+  // al ritmo richiesto sarebbero ~60 frame: la maggior parte saltati, non accodati
+  CHECK(skipped > sent);
+  // in volo solo ciò che sta nei buffer di invio + ricezione, più il frame in corso
+  CHECK(sent >= slow_frames);
+  size_t avg = slow_frames ? slow_bytes / slow_frames : 0;
+  CHECK((sent - slow_frames) * avg <= 2 * (LWIP_SND_BUF + SLOW_RCVBUF) + avg);
+  CHECK(fast_in_window >= FAST_FPS * RUN_MS / 1000 * 7 / 10);
+  CHECK_EQ(fast_bad, 0);
+
+  // fase 2: lettore fermo; l'httpd continua a rispondere e il veloce a ricevere
+  int fast_before = fast_frames;
+  auto s0 = std::chrono::steady_clock::now();
+  http_resp_t st;
+  CHECK(http_get(sim_http_port(), "/status", &st, 2000) && st.status == 200);
+  double status_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - s0).count();
+  sleep_ms(2000);
+  printf("stallo: /status in %.0f ms, fast +%d frame\n", status_ms, fast_frames - fast_before);
+  CHECK(status_ms < 1000);
+  CHECK(fast_frames - fast_before >= FAST_FPS);
+
+  // fase 3: il lento chiude; lo slot torna libero entro un paio di periodi
+  slow.close();
+  long left = 0;
+  for (int i = 0; i < 40 && (left = stream_field(SLOW_FPS, "sent")) >= 0; i++) sleep_ms(50);
+  CHECK_EQ(left, -1);
+
+  stop = true;
+  fast.join();
+  sim_exit(check_result("test_mjpeg_throttle"));
+}
@@ -0,0 +1,91 @@
+// Risveglio dal light sleep col PIR: gpio_wakeup_enable() mette il pin a
+// livello alto; dopo il risveglio deve tornare sul fronte di salita,
+// altrimenti l'ISR scatta in continuo finché il PIR resta alto.
+// Con il broker giù l'evento non pubblicato non deve impedire il sonno.
+#include "check.h"
+#include "client.h"
+#include "Preferences.h"
+#include "sim.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace {
+
+void sleep_ms(int ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+bool wait_for(bool (*pred)(), int timeout_ms) {
+  for (int t = 0; t < timeout_ms; t += 20) {
+    if (pred()) return true;
+    sleep_ms(20);
+  }
+  return pred();
+}
+
+}  // namespace
+
+int main() {
+  // light sleep dopo 1 s di idle, già in NVS al boot
+  Preferences prefs;
+  prefs.begin("birdcam", false);
+  prefs.putInt("pl", 1);
+  prefs.end();
+
+  sim_set_http_port(0);
+  if (!sim_boot_online(10000)) {
+    fprintf(stderr, "firmware non online\n");
+    sim_exit(2);
+  }
+
+  // in batteria
+  sim_set_vbus(false);
+  CHECK(wait_for(sim_in_light_sleep, 15000));
+  uint32_t sleeps = sim_light_sleeps();
+
+  // PIR alto per 1 s: sveglia, una cattura, nessuna raffica di ISR
+  uint32_t isr0 = sim_pir_isr_calls();
+  sim_set_pir(true);
+  CHECK(wait_for([] { return !sim_in_light_sleep(); }, 2000));
+  sleep_ms(1000);
+  uint32_t during_high = sim_pir_isr_calls() - isr0;
+  printf("PIR alto 1 s dopo il risveglio: %u chiamate all'ISR\n", during_high);
+  CHECK(during_high <= 1);
+  CHECK(!sim_in_light_sleep());   // PIR alto = attività
+
+  // secondo fronte da sveglio: esattamente un'ISR
+  sim_set_pir(false);
+  sleep_ms(100);
+  uint32_t isr1 = sim_pir_isr_calls();
+  sim_set_pir(true);
+  sleep_ms(300);
+  CHECK_EQ(sim_pir_isr_calls() - isr1, 1);
+  sim_set_pir(false);
+
+  // e torna a dormire
+  CHECK(wait_for([] { return sim_in_light_sleep(); }, 15000));
+  CHECK(sim_light_sleeps() > sleeps);
+
+  // broker giù: l'evento non pubblicato non deve tenere sveglio all'infinito
+  static std::atomic<int> events{0};
+  int sub = sim_broker_subscribe(SIM_BASE_TOPIC "/event", [](const std::string&, const std::string&, bool) { events++; });
+  sim_broker_set_up(false);
+  sleeps = sim_light_sleeps();
+  sim_set_pir(true);
+  CHECK(wait_for([] { return !sim_in_light_sleep(); }, 2000));
+  sleep_ms(300);
+  sim_set_pir(false);
+  CHECK(wait_for([] { return sim_in_light_sleep(); }, 40000));
+  CHECK(sim_light_sleeps() > sleeps);
+  CHECK_EQ(events.load(), 0);
+
+  // broker di nuovo su: al PIR successivo l'evento rimasto in coda esce
+  sim_broker_set_up(true);
+  sim_set_pir(true);
+  CHECK(wait_for([] { return events.load() > 0; }, 15000));
+  sim_set_pir(false);
+  sim_broker_unsubscribe(sub);
+
+  sim_exit(check_result("test_pir_wake"));
+}
@@ -0,0 +1,186 @@
+// pwr_update() su linee temporali di PIR/VBUS/batteria: stato atteso a ogni
+// passo, tempo per stato e contatore di transizioni; poi le tappe evento e
+// la stima di energia.
+#include "check.h"
+#include "birdcam_power.h"
+
+namespace {
+
+struct Step {
+  uint32_t    t_ms;
+  uint16_t    vbus_mv;
+  uint16_t    batt_mv;
+  bool        pir;
+  int         streams;
+  bool        upload;
+  uint32_t    http_ms;
+  pwr_state_t want;
+};
+
+const uint16_t VB = 5000;
+const uint16_t BAT = 3900;
+
+int run(pwr_sm_t* sm, const Step* steps, int n, const char* name) {
+  int bad = 0;
+  for (int i = 0; i < n; i++) {
+    const Step& s = steps[i];
+    pwr_inputs_t in = {};
+    in.now_ms = s.t_ms;
+    in.vbus_mv = s.vbus_mv;
+    in.batt_mv = s.batt_mv;
+    in.pir_active = s.pir;
+    in.stream_clients = s.streams;
+    in.upload_pending = s.upload;
+    in.last_http_ms = s.http_ms;
+    pwr_state_t got = pwr_update(sm, &in);
+    if (got != s.want) {
+      fprintf(stderr, "%s passo %d (t=%u): %s, atteso %s\n", name, i, (unsigned)s.t_ms,
+              pwr_state_name(got), pwr_state_name(s.want));
+      bad++;
+    }
+  }
+  CHECK_EQ(bad, 0);
+  return bad;
+}
+
+uint32_t time_total(const pwr_sm_t& sm) {
+  uint32_t t = 0;
+  for (int i = 0; i < PWR_STATE_COUNT; i++) t += sm.time_in_state_ms[i];
+  return t;
+}
+
+void test_light_sleep_timeline() {
+  pwr_config_t cfg;
+  pwr_default_config(&cfg);
+  cfg.light_idle_ms = 60000;
+  pwr_sm_t sm;
+  pwr_init(&sm, &cfg, 0);
+  const Step steps[] = {
+    {     0, VB,  BAT, false, 0, false,     0, PWR_FULL},
+    { 30000, VB,  BAT, false, 0, false,     0, PWR_FULL},          // VBUS: mai sleep
+    {120000, VB,  BAT, false, 0, false,     0, PWR_FULL},
+    {120100,  0,  BAT, false, 0, false,     0, PWR_LIGHT_SLEEP},   // staccato dopo 2 min idle
+    {121000,  0,  BAT, true,  0, false,     0, PWR_MODEM_SLEEP},   // PIR
+    {125000,  0,  BAT, false, 0, true,      0, PWR_MODEM_SLEEP},   // upload in coda
+    {130000,  0,  BAT, false, 0, false,     0, PWR_MODEM_SLEEP},
+    {184999,  0,  BAT, false, 0, false,     0, PWR_MODEM_SLEEP},   // quasi 60 s dall'upload
+    {185000,  0,  BAT, false, 0, false,     0, PWR_LIGHT_SLEEP},   // 60 s
+    {190500,  0,  BAT, false, 1, false,     0, PWR_MODEM_SLEEP},   // stream
+    {400000,  0,  BAT, false, 1, false,     0, PWR_MODEM_SLEEP},   // stream lungo: resta sveglio
+    {401000,  0,  BAT, false, 0, false,     0, PWR_MODEM_SLEEP},
+    {455000,  0,  BAT, false, 0, false, 450000, PWR_MODEM_SLEEP},  // richiesta web
+    {505000,  0,  BAT, false, 0, false, 450000, PWR_MODEM_SLEEP},
+    {510000,  0,  BAT, false, 0, false, 450000, PWR_LIGHT_SLEEP},  // 60 s dalla richiesta
+    {520000,  0,  BAT, true,  0, false, 450000, PWR_MODEM_SLEEP},
+    {900000,  0,  BAT, true,  0, false, 450000, PWR_MODEM_SLEEP},  // PIR fisso alto
+    {900100, VB,  BAT, false, 0, false, 450000, PWR_FULL},         // ricarica
+  };
+  run(&sm, steps, sizeof(steps) / sizeof(steps[0]), "light");
+  CHECK_EQ(sm.transitions, 7);
+  CHECK_EQ(time_total(sm), 900100);
+  CHECK_EQ(sm.time_in_state_ms[PWR_FULL], 120100);
+  CHECK_EQ(sm.time_in_state_ms[PWR_LIGHT_SLEEP], 900 + 5500 + 10000);
+  CHECK_EQ(sm.state, PWR_FULL);
+  CHECK_EQ(sm.state_since_ms, 900100);
+  CHECK_EQ(sm.batt_mv, BAT);
+}
+
+void test_deep_sleep_timeline() {
+  pwr_config_t cfg;
+  pwr_default_config(&cfg);
+  cfg.light_idle_ms = 60000;
+  cfg.deep_idle_ms = 900000;
+  pwr_sm_t sm;
+
+  // disabilitato: anche dopo ore solo light sleep, anche a batteria critica
+  pwr_init(&sm, &cfg, 0);
+  const Step off[] = {
+    {      0, 0, BAT,  false, 0, false, 0, PWR_MODEM_SLEEP},
+    {1000000, 0, BAT,  false, 0, false, 0, PWR_LIGHT_SLEEP},
+    {2000000, 0, 3100, false, 0, false, 0, PWR_LIGHT_SLEEP},
+  };
+  run(&sm, off, 3, "deep off");
+
+  cfg.deep_sleep_enabled = true;
+  pwr_init(&sm, &cfg, 0);
+  const Step on[] = {
+    {      0, 0, BAT,  false, 0, false, 0, PWR_MODEM_SLEEP},
+    {  60000, 0, BAT,  false, 0, false, 0, PWR_LIGHT_SLEEP},
+    { 899999, 0, BAT,  false, 0, false, 0, PWR_LIGHT_SLEEP},
+    { 900000, 0, BAT,  false, 0, false, 0, PWR_DEEP_SLEEP},
+  };
+  run(&sm, on, 4, "deep idle");
+
+  // batteria critica: subito deep, ma non con un evento in corso
+  pwr_init(&sm, &cfg, 0);
+  const Step crit[] = {
+    {   0, 0, 3250, true,  0, false, 0, PWR_MODEM_SLEEP},
+    { 500, 0, 3250, false, 0, true,  0, PWR_MODEM_SLEEP},
+    {1000, 0, 3250, false, 1, false, 0, PWR_DEEP_SLEEP},   // lo stream non basta a tenerlo sveglio
+    {1500, VB, 3250, false, 0, false, 0, PWR_FULL},        // VBUS vince sempre
+    {2000, 0, 0,    false, 0, false, 0, PWR_MODEM_SLEEP},  // batt 0 = lettura mancante, non critica
+  };
+  run(&sm, crit, 5, "critica");
+}
+
+// millis() riparte da 0 dopo ~49 giorni: idle e tempi restano giusti
+void test_millis_wrap() {
+  pwr_config_t cfg;
+  pwr_default_config(&cfg);
+  pwr_sm_t sm;
+  const uint32_t t0 = 0xFFFFFFFFu - 30000;
+  pwr_init(&sm, &cfg, t0);
+  const Step steps[] = {
+    {t0,           0, BAT, true,  0, false, 0, PWR_MODEM_SLEEP},
+    {t0 + 20000,   0, BAT, true,  0, false, 0, PWR_MODEM_SLEEP},
+    {t0 + 79999,   0, BAT, false, 0, false, 0, PWR_MODEM_SLEEP},
+    {t0 + 80000,   0, BAT, false, 0, false, 0, PWR_LIGHT_SLEEP},   // now_ms già ripartito da 0
+  };
+  run(&sm, steps, 4, "wrap");
+  CHECK_EQ(time_total(sm), 80000);
+}
+
+void test_event_energy() {
+  pwr_config_t cfg;
+  pwr_default_config(&cfg);
+  pwr_sm_t sm;
+  pwr_init(&sm, &cfg, 0);
+  pwr_inputs_t in = {};
+  in.now_ms = 1;
+  in.batt_mv = 4000;
+  pwr_update(&sm, &in);
+
+  const int64_t w = 5000000;
+  pwr_event_mark(&sm, PWR_STAGE_CAPTURE, w);   // prima del wake: ignorato
+  CHECK_EQ(sm.events, 0);
+  pwr_event_wake(&sm, w);
+  pwr_event_mark(&sm, PWR_STAGE_CAPTURE, w + 300000);
+  pwr_event_mark(&sm, PWR_STAGE_CAPTURE, w + 900000);   // già registrata
+  pwr_event_mark(&sm, PWR_STAGE_STORE, w + 500000);
+  pwr_event_mark(&sm, PWR_STAGE_UPLOAD, w + 1500000);
+  CHECK_EQ(sm.events, 1);
+  CHECK(sm.ev_last.valid);
+  CHECK_EQ(sm.ev_last.stage_us[PWR_STAGE_CAPTURE], 300000);
+  CHECK_EQ(sm.ev_last.stage_us[PWR_STAGE_STORE], 500000);
+  CHECK_EQ(sm.ev_last.stage_us[PWR_STAGE_UPLOAD], 1500000);
+  // 4000 mV * (160 mA * 0.5 s + 220 mA * 1.0 s) = 1.2 J
+  CHECK_EQ(sm.ev_last.energy_uj, (4000ULL * 160 * 500000 + 4000ULL * 220 * 1000000) / 1000000);
+
+  // store fallito: la tappa saltata prende il tempo dell'upload
+  pwr_event_wake(&sm, w);
+  pwr_event_mark(&sm, PWR_STAGE_CAPTURE, w + 200000);
+  pwr_event_mark(&sm, PWR_STAGE_UPLOAD, w + 700000);
+  CHECK_EQ(sm.events, 2);
+  CHECK_EQ(sm.ev_last.stage_us[PWR_STAGE_STORE], 700000);
+  CHECK_EQ(sm.ev_last.energy_uj, 4000ULL * 160 * 700000 / 1000000);
+}
+
+}  // namespace
+
+int main() {
+  test_light_sleep_timeline();
+  test_deep_sleep_timeline();
+  test_millis_wrap();
+  test_event_energy();
+  return check_result("test_power");
+}
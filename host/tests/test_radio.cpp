@@ -0,0 +1,247 @@
+// Politica radio: quando parte il burst degli upload in batteria (batch_max,
+// batch_ms, VBUS, stream, radio spenta, giro di millis()) e la carica per
+// modalità da cui radio_avg_ma() ricava la corrente media.
+#include "check.h"
+#include "birdcam_radio.h"
+
+namespace {
+
+// batteria, idle, MQTT su
+radio_inputs_t idle_at(uint32_t t) {
+  radio_inputs_t in = {};
+  in.now_ms = t;
+  in.mqtt_connected = true;
+  return in;
+}
+
+radio_inputs_t queued_at(uint32_t t, int n) {
+  radio_inputs_t in = idle_at(t);
+  in.uploads_queued = n;
+  return in;
+}
+
+}  // namespace
+
+int main() {
+  radio_config_t cfg;
+  radio_default_config(&cfg);
+  CHECK_EQ(cfg.batch_max, 4);
+  CHECK_EQ(cfg.batch_ms, 5000);
+
+  // ---- batch_ms: un upload aspetta al più batch_ms dal primo in coda ----
+  {
+    radio_policy_t p;
+    radio_init(&p, &cfg, 0);
+    radio_inputs_t in = idle_at(20000);
+    radio_update(&p, &in);
+    CHECK_EQ(p.mode, RADIO_PS_MAX_MODEM);
+
+    in = queued_at(30000, 1);
+    CHECK_EQ(radio_update(&p, &in), RADIO_PS_MIN_MODEM);   // attività, radio ancora in power save
+    CHECK(!p.flushing);
+    in = queued_at(33000, 2);                              // il secondo non sposta la scadenza
+    radio_update(&p, &in);
+    in = queued_at(34999, 2);
+    radio_update(&p, &in);
+    CHECK(!p.flushing);
+    in = queued_at(35000, 2);
+    CHECK_EQ(radio_update(&p, &in), RADIO_PS_NONE);
+    CHECK(p.flushing);
+    CHECK_EQ(p.bursts, 1);
+
+    // il burst resta aperto finché la coda non è vuota, anche se arrivano altri upload
+    in = queued_at(35100, 3);
+    radio_update(&p, &in);
+    CHECK(p.flushing);
+    CHECK_EQ(p.bursts, 1);
+    in = queued_at(35200, 0);
+    CHECK_EQ(radio_update(&p, &in), RADIO_PS_MIN_MODEM);
+    CHECK(!p.flushing);
+
+    // nuova coda: nuova finestra da batch_ms
+    in = queued_at(36000, 1);
+    radio_update(&p, &in);
+    in = queued_at(40999, 1);
+    radio_update(&p, &in);
+    CHECK(!p.flushing);
+    in = queued_at(41000, 1);
+    radio_update(&p, &in);
+    CHECK(p.flushing);
+    CHECK_EQ(p.bursts, 2);
+
+    // idle dopo l'ultima attività: max modem
+    in = idle_at(41100);
+    radio_update(&p, &in);
+    in = idle_at(41000 + cfg.idle_ms - 1);
+    CHECK_EQ(radio_update(&p, &in), RADIO_PS_MIN_MODEM);
+    in = idle_at(41000 + cfg.idle_ms);
+    CHECK_EQ(radio_update(&p, &in), RADIO_PS_MAX_MODEM);
+  }
+
+  // ---- batch_max: la coda piena parte subito ----
+  {
+    radio_policy_t p;
+    radio_init(&p, &cfg, 0);
+    for (int n = 1; n < cfg.batch_max; n++) {
+      radio_inputs_t in = queued_at(100u * n, n);
+      radio_update(&p, &in);
+      CHECK(!p.flushing);
+    }
+    radio_inputs_t in = queued_at(400, cfg.batch_max);
+    CHECK_EQ(radio_update(&p, &in), RADIO_PS_NONE);
+    CHECK(p.flushing);
+
+    radio_config_t one = cfg;
+    one.batch_max = 1;
+    radio_init(&p, &one, 0);
+    in = queued_at(10, 1);
+    radio_update(&p, &in);
+    CHECK(p.flushing);
+  }
+
+  // ---- VBUS e stream: nessuna attesa ----
+  {
+    radio_policy_t p;
+    radio_init(&p, &cfg, 0);
+    radio_inputs_t in = queued_at(1000, 1);
+    in.on_vbus = true;
+    CHECK_EQ(radio_update(&p, &in), RADIO_PS_NONE);
+    CHECK(p.flushing);
+
+    radio_init(&p, &cfg, 0);
+    in = queued_at(1000, 1);
+    in.stream_clients = 1;
+    radio_update(&p, &in);
+    CHECK(p.flushing);
+
+    // VBUS senza coda: PS_NONE ma nessun burst
+    radio_init(&p, &cfg, 0);
+    in = idle_at(60000);
+    in.on_vbus = true;
+    CHECK_EQ(radio_update(&p, &in), RADIO_PS_NONE);
+    CHECK(!p.flushing);
+    CHECK_EQ(p.bursts, 0);
+  }
+
+  // ---- radio spenta: la coda aspetta, parte al risveglio ----
+  {
+    radio_policy_t p;
+    radio_init(&p, &cfg, 0);
+    radio_inputs_t in = queued_at(1000, cfg.batch_max);
+    in.radio_off = true;
+    CHECK_EQ(radio_update(&p, &in), RADIO_OFF);
+    CHECK(!p.flushing);
+    in = queued_at(9000, cfg.batch_max + 1);
+    in.radio_off = true;
+    radio_update(&p, &in);
+    CHECK(!p.flushing);
+    in = queued_at(9100, cfg.batch_max + 1);
+    CHECK_EQ(radio_update(&p, &in), RADIO_PS_NONE);
+    CHECK(p.flushing);
+    CHECK_EQ(p.bursts, 1);
+  }
+
+  // ---- millis() che riparte da 0 durante l'attesa ----
+  {
+    radio_policy_t p;
+    radio_init(&p, &cfg, 0xFFFFF000u);
+    radio_inputs_t in = queued_at(0xFFFFF000u, 1);
+    radio_update(&p, &in);
+    in = queued_at(0xFFFFF000u + cfg.batch_ms - 1, 1);   // già oltre lo zero
+    radio_update(&p, &in);
+    CHECK(!p.flushing);
+    in = queued_at(0xFFFFF000u + cfg.batch_ms, 1);
+    radio_update(&p, &in);
+    CHECK(p.flushing);
+  }
+
+  // ---- carica per modalità ----
+  {
+    radio_policy_t p;
+    radio_init(&p, &cfg, 0);
+    radio_inputs_t in = idle_at(1000);
+    in.on_vbus = true;
+    radio_update(&p, &in);                 // 0..1000 in NONE
+    in = idle_at(2000);
+    radio_update(&p, &in);                 // 1000..2000 in NONE, poi MIN_MODEM
+    CHECK_EQ(p.mode, RADIO_PS_MIN_MODEM);
+    in = idle_at(12000);
+    radio_update(&p, &in);                 // 10 s in MIN_MODEM, poi MAX_MODEM
+    CHECK_EQ(p.mode, RADIO_PS_MAX_MODEM);
+    in = idle_at(22000);
+    radio_update(&p, &in);                 // 10 s in MAX_MODEM
+    in = idle_at(22000);
+    in.radio_off = true;
+    radio_update(&p, &in);
+    in = idle_at(52000);
+    in.radio_off = true;
+    radio_update(&p, &in);                 // 30 s spenta
+
+    CHECK_EQ(p.st[RADIO_PS_NONE].time_ms, 2000);
+    CHECK_EQ(p.st[RADIO_PS_NONE].charge_uas, 180u * 2000);
+    CHECK_EQ(p.st[RADIO_PS_MIN_MODEM].time_ms, 10000);
+    CHECK_EQ(p.st[RADIO_PS_MAX_MODEM].time_ms, 10000);
+    CHECK_EQ(p.st[RADIO_OFF].time_ms, 30000);
+    for (int m = 0; m < RADIO_MODE_COUNT; m++) CHECK_EQ(radio_avg_ma(&p, m), cfg.mode_ma[m]);
+    // media pesata sul tempo: (180*2 + 70*10 + 45*10 + 12*30) / 52
+    CHECK_EQ(radio_avg_ma(&p, RADIO_MODE_COUNT), (180 * 2 + 70 * 10 + 45 * 10 + 12 * 30) / 52);
+    CHECK_EQ(p.st[RADIO_PS_NONE].entries, 1);
+    CHECK_EQ(p.st[RADIO_OFF].entries, 1);
+    CHECK_EQ(p.transitions, 3);
+
+    // trasmissione: tx_ma per bytes*8/tx_kbps ms, sulla modalità corrente
+    radio_inputs_t on = idle_at(52000);
+    radio_update(&p, &on);                 // sveglia: MAX_MODEM (idle da 40 s)
+    CHECK_EQ(p.mode, RADIO_PS_MAX_MODEM);
+    radio_note_tx(&p, 500000);             // 1000 ms a 4000 kbps
+    CHECK_EQ(p.st[RADIO_PS_MAX_MODEM].tx_bytes, 500000);
+    CHECK_EQ(p.st[RADIO_PS_MAX_MODEM].charge_uas, 45u * 10000 + 40u * 1000);
+    CHECK_EQ(radio_avg_ma(&p, RADIO_PS_MAX_MODEM), 49);
+    radio_note_tx(&p, 0);
+    CHECK_EQ(p.st[RADIO_PS_MAX_MODEM].tx_bytes, 500000);
+
+    CHECK_EQ(radio_avg_ma(&p, -1), 0);
+    CHECK_EQ(radio_avg_ma(&p, RADIO_MODE_COUNT + 1), 0);
+    CHECK_EQ(radio_avg_ma(nullptr, 0), 0);
+    radio_policy_t fresh;
+    radio_init(&fresh, &cfg, 0);
+    CHECK_EQ(radio_avg_ma(&fresh, RADIO_MODE_COUNT), 0);   // nessun tempo ancora
+  }
+
+  // ---- 30 giorni a passi di 1 s: niente overflow ----
+  {
+    radio_policy_t p;
+    radio_init(&p, &cfg, 0);
+    radio_inputs_t in = idle_at(0);
+    in.on_vbus = true;
+    for (uint32_t t = 1000; t <= 30u * 86400 * 1000; t += 1000) {
+      in.now_ms = t;
+      radio_update(&p, &in);
+    }
+    CHECK_EQ(p.st[RADIO_PS_NONE].time_ms, 30u * 86400 * 1000);
+    CHECK_EQ(radio_avg_ma(&p, RADIO_MODE_COUNT), 180);
+    CHECK_EQ(p.st[RADIO_PS_NONE].mqtt_up_ms, 30u * 86400 * 1000 - 1000);   // connesso dal primo update
+  }
+
+  // ---- MQTT: tempo connesso e cadute ----
+  {
+    radio_policy_t p;
+    radio_init(&p, &cfg, 0);
+    radio_inputs_t in = idle_at(1000);     // connesso da qui
+    radio_update(&p, &in);
+    in = idle_at(4000);
+    radio_update(&p, &in);
+    in = idle_at(5000);
+    in.mqtt_connected = false;
+    radio_update(&p, &in);
+    in = idle_at(9000);
+    in.mqtt_connected = false;
+    radio_update(&p, &in);
+    uint32_t up = 0, drops = 0;
+    for (int m = 0; m < RADIO_MODE_COUNT; m++) { up += p.st[m].mqtt_up_ms; drops += p.st[m].mqtt_drops; }
+    CHECK_EQ(up, 4000);
+    CHECK_EQ(drops, 1);
+  }
+
+  return check_result("test_radio");
+}
@@ -0,0 +1,363 @@
+// Client RTSP minimo contro birdcam_rtsp: DESCRIBE/SETUP/PLAY/TEARDOWN,
+// RTP/JPEG (RFC 2435) interleaved e su UDP riassemblato in frame, RTCP SR,
+// limite di sessioni UDP (461 e ripiego su TCP) e di sessioni totali.
+#include "check.h"
+#include "client.h"
+#include "sim.h"
+
+#include "birdcam_cam.h"
+#include "birdcam_rtp.h"
+#include "birdcam_rtsp.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+int ms_since(Clock::time_point t) {
+  return (int)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - t).count();
+}
+
+bool wait_readable(int fd, int timeout_ms) {
+  struct pollfd p = {fd, POLLIN, 0};
+  return poll(&p, 1, timeout_ms) > 0;
+}
+
+struct RtspReply {
+  int         status = 0;
+  std::string headers;
+  std::string body;
+  std::string header(const char* name) const {
+    std::string key = std::string("\r\n") + name + ": ";
+    size_t p = headers.find(key);
+    if (p == std::string::npos) return "";
+    p += key.size();
+    return headers.substr(p, headers.find("\r\n", p) - p);
+  }
+};
+
+// Una connessione RTSP; i pacchetti '$' arrivati tra le risposte restano in rx
+class RtspConn {
+ public:
+  ~RtspConn() { close(); }
+  bool open(uint16_t port) {
+    fd_ = sim_tcp_connect(port, 2000);
+    return fd_ >= 0;
+  }
+  void close() {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+  }
+
+  bool request(const char* method, const std::string& url, const std::string& extra, RtspReply* out) {
+    char head[512];
+    snprintf(head, sizeof(head), "%s %s RTSP/1.0\r\nCSeq: %d\r\n%s%s\r\n", method, url.c_str(), ++cseq_,
+             session_.empty() ? "" : ("Session: " + session_ + "\r\n").c_str(), extra.c_str());
+    if (send(fd_, head, strlen(head), MSG_NOSIGNAL) != (ssize_t)strlen(head)) return false;
+    Clock::time_point t0 = Clock::now();
+    for (;;) {
+      skip_interleaved();
+      size_t end = rx_.find("\r\n\r\n");
+      if (!rx_.empty() && rx_[0] != '$' && end != std::string::npos) {
+        RtspReply r;
+        r.headers = rx_.substr(0, end + 2);
+        sscanf(r.headers.c_str(), "RTSP/1.0 %d", &r.status);
+        size_t cl = (size_t)atoi(r.header("Content-Length").c_str());
+        if (rx_.size() >= end + 4 + cl) {
+          r.body = rx_.substr(end + 4, cl);
+          rx_.erase(0, end + 4 + cl);
+          if (r.header("CSeq") != std::to_string(cseq_)) return false;
+          std::string s = r.header("Session");
+          if (!s.empty()) session_ = s.substr(0, s.find(';'));
+          *out = r;
+          return true;
+        }
+      }
+      if (ms_since(t0) > 3000 || !fill(3000)) return false;
+    }
+  }
+
+  // prossimo pacchetto interleaved; false a fine connessione o timeout
+  bool next_packet(int* channel, std::string* pkt, int timeout_ms) {
+    Clock::time_point t0 = Clock::now();
+    for (;;) {
+      if (rx_.size() >= 4 && rx_[0] == '$') {
+        size_t len = ((uint8_t)rx_[2] << 8) | (uint8_t)rx_[3];
+        if (rx_.size() >= 4 + len) {
+          *channel = (uint8_t)rx_[1];
+          *pkt = rx_.substr(4, len);
+          rx_.erase(0, 4 + len);
+          return true;
+        }
+      }
+      int left = timeout_ms - ms_since(t0);
+      if (left <= 0 || !fill(left)) return false;
+    }
+  }
+
+  // true se il server ha chiuso la connessione
+  bool closed_by_peer(int timeout_ms) {
+    if (!wait_readable(fd_, timeout_ms)) return false;
+    char c;
+    return recv(fd_, &c, 1, 0) <= 0;
+  }
+
+ private:
+  bool fill(int timeout_ms) {
+    if (!wait_readable(fd_, timeout_ms)) return false;
+    char buf[4096];
+    ssize_t n = recv(fd_, buf, sizeof(buf), 0);
+    if (n <= 0) return false;
+    rx_.append(buf, (size_t)n);
+    return true;
+  }
+  // scarta i pacchetti RTP/RTCP davanti a una risposta
+  void skip_interleaved() {
+    while (rx_.size() >= 4 && rx_[0] == '$') {
+      size_t len = ((uint8_t)rx_[2] << 8) | (uint8_t)rx_[3];
+      if (rx_.size() < 4 + len) return;
+      rx_.erase(0, 4 + len);
+    }
+  }
+
+  int         fd_ = -1;
+  int         cseq_ = 0;
+  std::string session_;
+  std::string rx_;
+};
+
+// Riassemblaggio RFC 2435: offset contigui, stesso timestamp, marker a fine frame
+struct JpegAssembler {
+  uint32_t ssrc = 0;
+  bool     have_seq = false;
+  uint16_t seq = 0;
+  uint32_t ts = 0;
+  size_t   next_off = 0;
+  bool     in_frame = false;
+  bool     have_last_ts = false;
+  uint32_t last_ts = 0;
+  int      frames = 0;
+  int      bad = 0;            // pacchetti fuori posto o malformati
+  int      lost = 0;           // buchi nella sequenza
+  int      width = 0, height = 0;
+
+  void add(const std::string& p) {
+    const uint8_t* b = (const uint8_t*)p.data();
+    if (p.size() < RTP_HDR_LEN + RTP_JPEG_HDR_LEN || (b[0] >> 6) != 2 || (b[1] & 0x7F) != RTP_PT_JPEG) {
+      bad++;
+      return;
+    }
+    bool marker = b[1] & 0x80;
+    uint16_t s = (uint16_t)((b[2] << 8) | b[3]);
+    uint32_t t = ((uint32_t)b[4] << 24) | ((uint32_t)b[5] << 16) | ((uint32_t)b[6] << 8) | b[7];
+    uint32_t src = ((uint32_t)b[8] << 24) | ((uint32_t)b[9] << 16) | ((uint32_t)b[10] << 8) | b[11];
+    if (ssrc && src != ssrc) bad++;
+    if (have_seq && s != (uint16_t)(seq + 1)) {
+      lost++;
+      in_frame = false;        // frame incompleto: si riparte dal prossimo offset 0
+    }
+    have_seq = true;
+    seq = s;
+
+    const uint8_t* j = b + RTP_HDR_LEN;
+    size_t off = ((size_t)j[1] << 16) | ((size_t)j[2] << 8) | j[3];
+    uint8_t type = j[4], q = j[5];
+    size_t hdr = RTP_HDR_LEN + RTP_JPEG_HDR_LEN;
+    if (type >= 64) hdr += 4;                     // restart marker header
+    if (off == 0) {
+      if (q >= 128) {
+        if (p.size() < hdr + 4) { bad++; return; }
+        size_t qlen = ((size_t)b[hdr + 2] << 8) | b[hdr + 3];
+        if (qlen != 64 && qlen != 128) bad++;
+        hdr += 4 + qlen;
+      }
+      if (in_frame) bad++;                        // frame precedente senza marker
+      in_frame = true;
+      ts = t;
+      next_off = 0;
+      width = j[6] * 8;
+      height = j[7] * 8;
+      if (have_last_ts && (int32_t)(t - last_ts) <= 0) bad++;
+    } else if (!in_frame) {
+      return;                                     // coda di un frame perso
+    }
+    if (p.size() < hdr || off != next_off || t != ts) {
+      bad++;
+      in_frame = false;
+      return;
+    }
+    next_off += p.size() - hdr;
+    if (marker) {
+      frames++;
+      in_frame = false;
+      have_last_ts = true;
+      last_ts = ts;
+    }
+  }
+};
+
+uint32_t parse_ssrc(const std::string& transport) {
+  size_t p = transport.find("ssrc=");
+  return p == std::string::npos ? 0 : (uint32_t)strtoul(transport.c_str() + p + 5, nullptr, 16);
+}
+
+int udp_bound(uint16_t* port) {
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in a = {};
+  a.sin_family = AF_INET;
+  a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t al = sizeof(a);
+  if (fd < 0 || bind(fd, (struct sockaddr*)&a, sizeof(a)) != 0 || getsockname(fd, (struct sockaddr*)&a, &al) != 0) {
+    if (fd >= 0) close(fd);
+    return -1;
+  }
+  *port = ntohs(a.sin_port);
+  return fd;
+}
+
+int rtsp_sessions() {
+  rtsp_stats_t rs;
+  rtsp_get_stats(&rs);
+  return rs.sessions;
+}
+
+}  // namespace
+
+int main() {
+  sim_set_http_port(0);
+  sim_set_rtsp_port(0);
+  if (!sim_boot_online(10000)) {
+    fprintf(stderr, "firmware non online\n");
+    sim_exit(2);
+  }
+  uint16_t port = sim_rtsp_port();
+  std::string url = "rtsp://127.0.0.1:" + std::to_string(port) + "/mjpeg?fs=qvga&fps=10";
+  rtsp_stats_t rs;
+  rtsp_get_stats(&rs);
+  CHECK(rs.listening);
+
+  // ---- sessione 1: TCP interleaved ----
+  RtspConn a;
+  RtspReply r;
+  CHECK(a.open(port));
+  CHECK(a.request("OPTIONS", url, "", &r));
+  CHECK_EQ(r.status, 200);
+  CHECK(r.header("Public").find("DESCRIBE") != std::string::npos);
+
+  CHECK(a.request("DESCRIBE", url, "Accept: application/sdp\r\n", &r));
+  CHECK_EQ(r.status, 200);
+  CHECK(r.body.find("m=video 0 RTP/AVP 26") != std::string::npos);
+  CHECK(r.body.find("a=framerate:10") != std::string::npos);
+  std::string base = r.header("Content-Base");
+  CHECK(base == "rtsp://127.0.0.1:" + std::to_string(port) + "/mjpeg/");
+
+  CHECK(a.request("SETUP", base + "track1", "Transport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n", &r));
+  CHECK_EQ(r.status, 200);
+  CHECK(r.header("Transport").find("interleaved=0-1") != std::string::npos);
+  CHECK(!r.header("Session").empty());
+  uint32_t ssrc_a = parse_ssrc(r.header("Transport"));
+
+  CHECK(a.request("PLAY", base, "Range: npt=0.000-\r\n", &r));
+  CHECK_EQ(r.status, 200);
+  CHECK(r.header("RTP-Info").find("track1;seq=") != std::string::npos);
+
+  // 6 s: ~60 frame a 10 fps e almeno un sender report (ogni 5 s)
+  JpegAssembler ja;
+  ja.ssrc = ssrc_a;
+  int srs = 0, sr_bad = 0;
+  Clock::time_point t0 = Clock::now();
+  while (ms_since(t0) < 6000) {
+    int ch;
+    std::string pkt;
+    if (!a.next_packet(&ch, &pkt, 2000)) break;
+    if (ch == 0) {
+      ja.add(pkt);
+    } else if (ch == 1) {
+      const uint8_t* b = (const uint8_t*)pkt.data();
+      uint32_t src = pkt.size() >= 8 ? ((uint32_t)b[4] << 24) | ((uint32_t)b[5] << 16) | ((uint32_t)b[6] << 8) | b[7] : 0;
+      if (pkt.size() >= 28 && (b[0] >> 6) == 2 && b[1] == 200 && src == ssrc_a) srs++;
+      else sr_bad++;
+    }
+  }
+  printf("TCP: %d frame %dx%d, %d fuori posto, %d persi, %d SR\n", ja.frames, ja.width, ja.height, ja.bad, ja.lost, srs);
+  CHECK(ja.frames >= 40);
+  CHECK_EQ(ja.bad, 0);
+  CHECK_EQ(ja.lost, 0);
+  CHECK_EQ(ja.width, 320);
+  CHECK_EQ(ja.height, 240);
+  CHECK(srs >= 1);
+  CHECK_EQ(sr_bad, 0);
+
+  // ---- sessione 2: UDP (l'unica ammessa dal budget socket) ----
+  uint16_t rtp_port = 0, rtcp_port = 0;
+  int rtp_fd = udp_bound(&rtp_port);
+  int rtcp_fd = udp_bound(&rtcp_port);
+  CHECK(rtp_fd >= 0 && rtcp_fd >= 0);
+  char tr[128];
+  snprintf(tr, sizeof(tr), "Transport: RTP/AVP;unicast;client_port=%u-%u\r\n", rtp_port, rtcp_port);
+  RtspConn b;
+  CHECK(b.open(port));
+  CHECK(b.request("DESCRIBE", url, "", &r));
+  CHECK_EQ(r.status, 200);
+  CHECK(b.request("SETUP", base + "track1", tr, &r));
+  CHECK_EQ(r.status, 200);
+  CHECK(r.header("Transport").find("server_port=") != std::string::npos);
+  JpegAssembler ju;
+  ju.ssrc = parse_ssrc(r.header("Transport"));
+  CHECK(b.request("PLAY", base, "", &r));
+  CHECK_EQ(r.status, 200);
+  t0 = Clock::now();
+  while (ms_since(t0) < 2000 && wait_readable(rtp_fd, 1000)) {
+    char buf[2048];
+    ssize_t n = recv(rtp_fd, buf, sizeof(buf), 0);
+    if (n > 0) ju.add(std::string(buf, (size_t)n));
+  }
+  printf("UDP: %d frame, %d fuori posto\n", ju.frames, ju.bad);
+  CHECK(ju.frames >= 10);
+  CHECK_EQ(ju.bad, 0);
+
+  // ---- sessione 3: UDP oltre il budget -> 461, poi TCP sulla stessa ----
+  RtspConn c;
+  CHECK(c.open(port));
+  CHECK(c.request("DESCRIBE", url, "", &r));
+  CHECK(c.request("SETUP", base + "track1", tr, &r));
+  CHECK_EQ(r.status, 461);
+  CHECK(c.request("SETUP", base + "track1", "Transport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n", &r));
+  CHECK_EQ(r.status, 200);
+
+  // ---- quarta connessione: sessioni finite, chiusa subito ----
+  CHECK_EQ(rtsp_sessions(), RTSP_MAX_SESSIONS);
+  RtspConn d;
+  CHECK(d.open(port));
+  CHECK(d.closed_by_peer(2000));
+
+  // ---- TEARDOWN: sessioni e stream dell'arbitro rilasciati ----
+  CHECK(a.request("TEARDOWN", base, "", &r));
+  CHECK_EQ(r.status, 200);
+  CHECK(b.request("TEARDOWN", base, "", &r));
+  CHECK_EQ(r.status, 200);
+  c.close();                                      // chiusura senza TEARDOWN
+  for (int i = 0; i < 100 && rtsp_sessions() > 0; i++) usleep(20000);
+  CHECK_EQ(rtsp_sessions(), 0);
+  cam_arb_stats_t cs;
+  cam_arb_get_stats(&cs);
+  CHECK_EQ(cs.streams, 0);
+
+  // lo slot UDP è di nuovo libero
+  RtspConn e;
+  CHECK(e.open(port));
+  CHECK(e.request("SETUP", base + "track1", tr, &r));
+  CHECK_EQ(r.status, 200);
+
+  close(rtp_fd);
+  close(rtcp_fd);
+  sim_exit(check_result("test_rtsp"));
+}
@@ -0,0 +1,47 @@
+// Interoperabilità: ffprobe (se installato) legge lo stream RTSP su TCP e
+// su UDP e vede MJPEG alla risoluzione chiesta. Senza ffprobe: skip (77).
+#include "check.h"
+#include "client.h"
+#include "sim.h"
+
+#include <stdio.h>
+#include <string>
+
+namespace {
+
+const int SKIP = 77;   // SKIP_RETURN_CODE in tests/CMakeLists.txt
+
+std::string run(const std::string& cmd) {
+  std::string out;
+  FILE* p = popen(cmd.c_str(), "r");
+  if (!p) return out;
+  char buf[256];
+  while (fgets(buf, sizeof(buf), p)) out += buf;
+  pclose(p);
+  while (!out.empty() && (out.back() == '\n' || out.back() == '\r')) out.pop_back();
+  return out;
+}
+
+}  // namespace
+
+int main() {
+  if (system("ffprobe -version >/dev/null 2>&1") != 0) {
+    printf("test_rtsp_ffprobe: ffprobe non trovato, skip\n");
+    return SKIP;
+  }
+  sim_set_http_port(0);
+  sim_set_rtsp_port(0);
+  if (!sim_boot_online(10000)) {
+    fprintf(stderr, "firmware non online\n");
+    sim_exit(2);
+  }
+  std::string url = "rtsp://127.0.0.1:" + std::to_string(sim_rtsp_port()) + "/mjpeg?fs=qvga&fps=10";
+  for (const char* transport : {"tcp", "udp"}) {
+    std::string out = run(std::string("ffprobe -v error -rw_timeout 5000000 -rtsp_transport ") + transport +
+                          " -select_streams v:0 -show_entries stream=codec_name,width,height -of csv=p=0 '" +
+                          url + "' 2>&1");
+    printf("ffprobe %s: %s\n", transport, out.c_str());
+    CHECK(out == "mjpeg,320,240");
+  }
+  sim_exit(check_result("test_rtsp_ffprobe"));
+}
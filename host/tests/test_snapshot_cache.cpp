@@ -0,0 +1,74 @@
+// Single-flight di cam_cache_get(): richieste concorrenti con max_age 0
+// aspettano la cattura in corso e ne condividono il frame invece di
+// mettersi in fila per una cattura ciascuna.
+#include "check.h"
+#include "client.h"
+#include "birdcam_cam.h"
+#include "sim.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const int CALLERS = 6;
+const int ROUNDS = 5;
+
+}  // namespace
+
+int main() {
+  sim_set_http_port(0);
+  if (!sim_boot_online(10000)) {
+    fprintf(stderr, "firmware non online\n");
+    sim_exit(2);
+  }
+
+  for (int round = 0; round < ROUNDS; round++) {
+    // consuma l'ultimo frame pronto: la prossima cattura aspetta il sensore
+    // (un periodo), abbastanza perché tutti arrivino mentre è in corso
+    cam_cached_t prime;
+    if (cam_cache_get(FRAMESIZE_QVGA, 30, 0, &prime, 3000) == CAM_OK) cam_cache_release(&prime);
+    uint32_t cap0, hit0;
+    cam_cache_get_stats(&cap0, &hit0);
+    std::atomic<int> ready{0}, ok{0};
+    std::vector<std::thread> th;
+    for (int i = 0; i < CALLERS; i++) {
+      th.emplace_back([&] {
+        ready++;
+        while (ready < CALLERS) std::this_thread::yield();
+        cam_cached_t c;
+        if (cam_cache_get(FRAMESIZE_QVGA, 30, 0, &c, 3000) == CAM_OK) {
+          if (c.blob && c.width == 320) ok++;
+          cam_cache_release(&c);
+        }
+      });
+    }
+    for (auto& t : th) t.join();
+    uint32_t cap1, hit1;
+    cam_cache_get_stats(&cap1, &hit1);
+    printf("giro %d: %d ok, %u catture, %u dalla cache\n", round, ok.load(), cap1 - cap0, hit1 - hit0);
+    CHECK_EQ(ok, CALLERS);
+    CHECK_EQ(cap1 - cap0, 1);
+    CHECK_EQ((cap1 - cap0) + (hit1 - hit0), CALLERS);
+  }
+
+  // max_age > 0: dentro la finestra nessuna nuova cattura
+  uint32_t cap0, hit0, cap1, hit1;
+  cam_cached_t c;
+  CHECK(cam_cache_get(FRAMESIZE_QVGA, 30, 0, &c, 3000) == CAM_OK);
+  cam_cache_release(&c);
+  cam_cache_get_stats(&cap0, &hit0);
+  CHECK(cam_cache_get(FRAMESIZE_QVGA, 30, 5000, &c, 3000) == CAM_OK);
+  CHECK(c.hit);
+  cam_cache_release(&c);
+  // altra qualità: altro frame
+  CHECK(cam_cache_get(FRAMESIZE_QVGA, 40, 5000, &c, 3000) == CAM_OK);
+  CHECK(!c.hit);
+  cam_cache_release(&c);
+  cam_cache_get_stats(&cap1, &hit1);
+  CHECK_EQ(cap1 - cap0, 1);
+  CHECK_EQ(hit1 - hit0, 1);
+
+  sim_exit(check_result("test_snapshot_cache"));
+}